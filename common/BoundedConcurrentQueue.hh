@@ -0,0 +1,595 @@
+// ----------------------------------------------------------------------
+//! @file BoundedConcurrentQueue.hh
+//! @brief Bounded lock-free multi-producer multi-consumer queue
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#pragma once
+#include "common/Namespace.hh"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+EOSCOMMONNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Bounded multi-producer multi-consumer queue
+//!
+//! Ring of cells carrying a sequence number (D. Vyukov's bounded MPMC queue):
+//! producers and consumers claim a cell with a single CAS on the enqueue
+//! respectively dequeue cursor and hand it over by publishing the sequence
+//! number, so pushing and popping never takes a mutex. A batch pop claims
+//! all the consecutive ready cells with one CAS.
+//!
+//! The blocking calls first try the lock-free path. Only when the queue is
+//! empty (full) the caller registers itself as waiter and sleeps on a
+//! condition variable; the other side takes the mutex only if it sees a
+//! registered waiter.
+//!
+//! Data must be default constructible and movable.
+//------------------------------------------------------------------------------
+template <typename Data>
+class BoundedConcurrentQueue
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //!
+  //! @param capacity maximum number of queued elements, rounded up to the
+  //!        next power of two
+  //----------------------------------------------------------------------------
+  explicit BoundedConcurrentQueue(size_t capacity = 1024);
+
+  //----------------------------------------------------------------------------
+  //! Destructor
+  //----------------------------------------------------------------------------
+  ~BoundedConcurrentQueue();
+
+  BoundedConcurrentQueue(const BoundedConcurrentQueue&) = delete;
+  BoundedConcurrentQueue& operator=(const BoundedConcurrentQueue&) = delete;
+
+  //----------------------------------------------------------------------------
+  //! Get the capacity of the queue
+  //----------------------------------------------------------------------------
+  size_t capacity() const
+  {
+    return mMask + 1;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the number of queued elements - only a snapshot when other threads
+  //! use the queue
+  //----------------------------------------------------------------------------
+  size_t size() const;
+
+  //----------------------------------------------------------------------------
+  //! Test if the queue is empty - only a snapshot when other threads use the
+  //! queue
+  //----------------------------------------------------------------------------
+  bool empty() const
+  {
+    return (size() == 0);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Push data to the queue if there is space left
+  //!
+  //! @param data object to be pushed, only moved from on success
+  //!
+  //! @return true if pushed, false if the queue is full
+  //----------------------------------------------------------------------------
+  bool try_push(Data&& data);
+  bool try_push(const Data& data)
+  {
+    Data copy(data);
+    return try_push(std::move(copy));
+  }
+
+  //----------------------------------------------------------------------------
+  //! Push data to the queue, if the queue is full then block until space
+  //! becomes available
+  //!
+  //! @param data object to be pushed
+  //----------------------------------------------------------------------------
+  void push(Data&& data);
+  void push(const Data& data)
+  {
+    Data copy(data);
+    push(std::move(copy));
+  }
+
+  //----------------------------------------------------------------------------
+  //! Try to get data from the queue
+  //!
+  //! @param popped_value popped object
+  //!
+  //! @return true if an object was popped, false if the queue is empty
+  //----------------------------------------------------------------------------
+  bool try_pop(Data& popped_value);
+
+  //----------------------------------------------------------------------------
+  //! Get data from the queue, if the queue is empty then block until at least
+  //! one element is added
+  //!
+  //! @param popped_value popped object
+  //----------------------------------------------------------------------------
+  void wait_pop(Data& popped_value);
+
+  //----------------------------------------------------------------------------
+  //! Get data from the queue, waiting at most the given timeout
+  //!
+  //! @param popped_value popped object
+  //! @param timeout maximum time to wait
+  //!
+  //! @return true if an object was popped, false on timeout
+  //----------------------------------------------------------------------------
+  bool wait_pop(Data& popped_value, std::chrono::milliseconds timeout);
+
+  //----------------------------------------------------------------------------
+  //! Pop up to max_items elements without blocking
+  //!
+  //! @param out vector to which the popped objects are appended
+  //! @param max_items maximum number of objects to pop
+  //!
+  //! @return number of popped objects
+  //----------------------------------------------------------------------------
+  size_t pop_batch(std::vector<Data>& out, size_t max_items);
+
+  //----------------------------------------------------------------------------
+  //! Pop up to max_items elements, if the queue is empty then block until at
+  //! least one element is added
+  //!
+  //! @param out vector to which the popped objects are appended
+  //! @param max_items maximum number of objects to pop
+  //!
+  //! @return number of popped objects
+  //----------------------------------------------------------------------------
+  size_t wait_pop_batch(std::vector<Data>& out, size_t max_items);
+
+  //----------------------------------------------------------------------------
+  //! Remove all elements from the queue
+  //----------------------------------------------------------------------------
+  void clear();
+
+private:
+  //----------------------------------------------------------------------------
+  //! Queue cell, a cell at position pos is free for the producer if its
+  //! sequence is pos and ready for the consumer if its sequence is pos + 1
+  //----------------------------------------------------------------------------
+  struct Cell {
+    std::atomic<uint64_t> mSeq;
+    Data mData;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Lock-free enqueue/dequeue without waking up any waiters
+  //----------------------------------------------------------------------------
+  bool Enqueue(Data& data);
+  bool Dequeue(Data& popped_value);
+  size_t DequeueBatch(std::vector<Data>& out, size_t max_items);
+
+  //----------------------------------------------------------------------------
+  //! Wake up the waiting consumers if there are any
+  //----------------------------------------------------------------------------
+  void NotifyConsumers();
+
+  //----------------------------------------------------------------------------
+  //! Wake up the waiting producers if there are any
+  //----------------------------------------------------------------------------
+  void NotifyProducers();
+
+  Cell* mCells;
+  const uint64_t mMask;
+  //! Keep the cursors on separate cache lines to avoid false sharing
+  char mPad0[64];
+  std::atomic<uint64_t> mEnqueuePos;
+  char mPad1[64];
+  std::atomic<uint64_t> mDequeuePos;
+  char mPad2[64];
+  std::atomic<uint32_t> mWaitingConsumers;
+  std::atomic<uint32_t> mWaitingProducers;
+  std::mutex mWaitMutex; ///< Only taken by waiters and their wakers
+  std::condition_variable mNotEmpty;
+  std::condition_variable mNotFull;
+};
+
+//------------------------------------------------------------------------------
+// Round up to the next power of two, at least 2
+//------------------------------------------------------------------------------
+inline uint64_t
+BoundedQueueCapacity(size_t capacity)
+{
+  uint64_t size = 2;
+
+  while (size < capacity) {
+    size <<= 1;
+  }
+
+  return size;
+}
+
+//------------------------------------------------------------------------------
+// Constructor
+//------------------------------------------------------------------------------
+template <typename Data>
+BoundedConcurrentQueue<Data>::BoundedConcurrentQueue(size_t capacity):
+  mCells(new Cell[BoundedQueueCapacity(capacity)]),
+  mMask(BoundedQueueCapacity(capacity) - 1), mEnqueuePos(0), mDequeuePos(0),
+  mWaitingConsumers(0), mWaitingProducers(0)
+{
+  for (uint64_t i = 0; i <= mMask; ++i) {
+    mCells[i].mSeq.store(i, std::memory_order_relaxed);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Destructor
+//------------------------------------------------------------------------------
+template <typename Data>
+BoundedConcurrentQueue<Data>::~BoundedConcurrentQueue()
+{
+  delete[] mCells;
+}
+
+//------------------------------------------------------------------------------
+// Get size of the queue
+//------------------------------------------------------------------------------
+template <typename Data>
+size_t
+BoundedConcurrentQueue<Data>::size() const
+{
+  uint64_t deq = mDequeuePos.load(std::memory_order_relaxed);
+  uint64_t enq = mEnqueuePos.load(std::memory_order_relaxed);
+  return (enq > deq ? enq - deq : 0);
+}
+
+//------------------------------------------------------------------------------
+// Push data to the queue if there is space left
+//------------------------------------------------------------------------------
+template <typename Data>
+bool
+BoundedConcurrentQueue<Data>::try_push(Data&& data)
+{
+  if (!Enqueue(data)) {
+    return false;
+  }
+
+  NotifyConsumers();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Claim a free cell and publish the data, the data is only moved from on
+// success
+//------------------------------------------------------------------------------
+template <typename Data>
+bool
+BoundedConcurrentQueue<Data>::Enqueue(Data& data)
+{
+  uint64_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+  Cell* cell;
+
+  while (true) {
+    cell = &mCells[pos & mMask];
+    uint64_t seq = cell->mSeq.load(std::memory_order_acquire);
+    int64_t diff = (int64_t)seq - (int64_t)pos;
+
+    if (diff == 0) {
+      if (mEnqueuePos.compare_exchange_weak(pos, pos + 1,
+                                            std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false; // full
+    } else {
+      pos = mEnqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+
+  cell->mData = std::move(data);
+  cell->mSeq.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Push data to the queue, blocking while the queue is full
+//------------------------------------------------------------------------------
+template <typename Data>
+void
+BoundedConcurrentQueue<Data>::push(Data&& data)
+{
+  if (try_push(std::move(data))) {
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mWaitMutex);
+    mWaitingProducers.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    while (!Enqueue(data)) {
+      mNotFull.wait(lock);
+    }
+
+    mWaitingProducers.fetch_sub(1);
+  }
+
+  NotifyConsumers();
+}
+
+//------------------------------------------------------------------------------
+// Try to get data from the queue
+//------------------------------------------------------------------------------
+template <typename Data>
+bool
+BoundedConcurrentQueue<Data>::try_pop(Data& popped_value)
+{
+  if (!Dequeue(popped_value)) {
+    return false;
+  }
+
+  NotifyProducers();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Claim a ready cell and hand it back to the producers
+//------------------------------------------------------------------------------
+template <typename Data>
+bool
+BoundedConcurrentQueue<Data>::Dequeue(Data& popped_value)
+{
+  uint64_t pos = mDequeuePos.load(std::memory_order_relaxed);
+  Cell* cell;
+
+  while (true) {
+    cell = &mCells[pos & mMask];
+    uint64_t seq = cell->mSeq.load(std::memory_order_acquire);
+    int64_t diff = (int64_t)seq - (int64_t)(pos + 1);
+
+    if (diff == 0) {
+      if (mDequeuePos.compare_exchange_weak(pos, pos + 1,
+                                            std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false; // empty
+    } else {
+      pos = mDequeuePos.load(std::memory_order_relaxed);
+    }
+  }
+
+  popped_value = std::move(cell->mData);
+  cell->mData = Data();
+  cell->mSeq.store(pos + mMask + 1, std::memory_order_release);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Get data from the queue, blocking while the queue is empty
+//------------------------------------------------------------------------------
+template <typename Data>
+void
+BoundedConcurrentQueue<Data>::wait_pop(Data& popped_value)
+{
+  if (try_pop(popped_value)) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(mWaitMutex);
+  mWaitingConsumers.fetch_add(1);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  while (!Dequeue(popped_value)) {
+    mNotEmpty.wait(lock);
+  }
+
+  mWaitingConsumers.fetch_sub(1);
+  lock.unlock();
+  NotifyProducers();
+}
+
+//------------------------------------------------------------------------------
+// Get data from the queue, waiting at most the given timeout
+//------------------------------------------------------------------------------
+template <typename Data>
+bool
+BoundedConcurrentQueue<Data>::wait_pop(Data& popped_value,
+                                       std::chrono::milliseconds timeout)
+{
+  if (try_pop(popped_value)) {
+    return true;
+  }
+
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  std::unique_lock<std::mutex> lock(mWaitMutex);
+  mWaitingConsumers.fetch_add(1);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  bool done;
+
+  while (!(done = Dequeue(popped_value))) {
+    if (mNotEmpty.wait_until(lock, deadline) == std::cv_status::timeout) {
+      done = Dequeue(popped_value);
+      break;
+    }
+  }
+
+  mWaitingConsumers.fetch_sub(1);
+  lock.unlock();
+
+  if (done) {
+    NotifyProducers();
+  }
+
+  return done;
+}
+
+//------------------------------------------------------------------------------
+// Pop up to max_items elements without blocking
+//------------------------------------------------------------------------------
+template <typename Data>
+size_t
+BoundedConcurrentQueue<Data>::pop_batch(std::vector<Data>& out,
+                                        size_t max_items)
+{
+  size_t count = DequeueBatch(out, max_items);
+
+  if (count) {
+    NotifyProducers();
+  }
+
+  return count;
+}
+
+//------------------------------------------------------------------------------
+// Claim all the consecutive ready cells, up to max_items, with a single CAS
+//------------------------------------------------------------------------------
+template <typename Data>
+size_t
+BoundedConcurrentQueue<Data>::DequeueBatch(std::vector<Data>& out,
+    size_t max_items)
+{
+  uint64_t pos = mDequeuePos.load(std::memory_order_relaxed);
+  uint64_t count;
+
+  while (true) {
+    // Count the consecutive cells which are ready to be consumed
+    count = 0;
+
+    while (count < max_items) {
+      uint64_t seq = mCells[(pos + count) & mMask].mSeq.load(
+                       std::memory_order_acquire);
+
+      if (seq != pos + count + 1) {
+        break;
+      }
+
+      ++count;
+    }
+
+    if (count == 0) {
+      // Either empty or another consumer moved the cursor
+      uint64_t now = mDequeuePos.load(std::memory_order_relaxed);
+
+      if (now == pos) {
+        return 0;
+      }
+
+      pos = now;
+      continue;
+    }
+
+    if (mDequeuePos.compare_exchange_weak(pos, pos + count,
+                                          std::memory_order_relaxed)) {
+      break;
+    }
+  }
+
+  out.reserve(out.size() + count);
+
+  for (uint64_t i = 0; i < count; ++i) {
+    Cell& cell = mCells[(pos + i) & mMask];
+    out.push_back(std::move(cell.mData));
+    cell.mData = Data();
+    cell.mSeq.store(pos + i + mMask + 1, std::memory_order_release);
+  }
+
+  return count;
+}
+
+//------------------------------------------------------------------------------
+// Pop up to max_items elements, blocking while the queue is empty
+//------------------------------------------------------------------------------
+template <typename Data>
+size_t
+BoundedConcurrentQueue<Data>::wait_pop_batch(std::vector<Data>& out,
+    size_t max_items)
+{
+  size_t count = pop_batch(out, max_items);
+
+  if (count || (max_items == 0)) {
+    return count;
+  }
+
+  std::unique_lock<std::mutex> lock(mWaitMutex);
+  mWaitingConsumers.fetch_add(1);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  while ((count = DequeueBatch(out, max_items)) == 0) {
+    mNotEmpty.wait(lock);
+  }
+
+  mWaitingConsumers.fetch_sub(1);
+  lock.unlock();
+  NotifyProducers();
+  return count;
+}
+
+//------------------------------------------------------------------------------
+// Remove all elements from the queue
+//------------------------------------------------------------------------------
+template <typename Data>
+void
+BoundedConcurrentQueue<Data>::clear()
+{
+  Data tmp;
+
+  while (try_pop(tmp)) {
+    tmp = Data();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Wake up the waiting consumers if there are any. The fence pairs with the
+// one done by the waiter after registering: either the waiter sees the new
+// element or we see the waiter.
+//------------------------------------------------------------------------------
+template <typename Data>
+void
+BoundedConcurrentQueue<Data>::NotifyConsumers()
+{
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  if (mWaitingConsumers.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(mWaitMutex);
+    mNotEmpty.notify_all();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Wake up the waiting producers if there are any
+//------------------------------------------------------------------------------
+template <typename Data>
+void
+BoundedConcurrentQueue<Data>::NotifyProducers()
+{
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  if (mWaitingProducers.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(mWaitMutex);
+    mNotFull.notify_all();
+  }
+}
+
+EOSCOMMONNAMESPACE_END
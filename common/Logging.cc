@@ -24,8 +24,15 @@
 #include "common/Namespace.hh"
 #include "common/Logging.hh"
 #include "XrdSys/XrdSysPthread.hh"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <memory>
 #include <new>
+#include <thread>
 #include <type_traits>
+#include <pthread.h>
 
 EOSCOMMONNAMESPACE_BEGIN
 
@@ -63,12 +70,270 @@ Logging::GetInstance()
   return gLogging;
 }
 
+//------------------------------------------------------------------------------
+//! Writer of the asynchronous mode.
+//!
+//! The log lines are passed through a bounded ring of records. Any thread may
+//! claim the next free record by advancing the head, it then copies its line
+//! into the record and publishes it by setting the record sequence number. The
+//! single writer thread consumes the records in order, writes them in batches
+//! and flushes every file once per batch. It also stores the lines of a batch
+//! in the in-memory circular log, taking the logging mutex once per batch, so
+//! the loggers never take that mutex. The strings of the records keep their
+//! capacity so in steady state no memory gets allocated. If the ring is full
+//! the loggers wait for the writer, no log line is dropped.
+//------------------------------------------------------------------------------
+class Logging::AsyncSink
+{
+public:
+  static constexpr uint64_t kCapacity = 16384; ///< must be a power of two
+
+  //----------------------------------------------------------------------------
+  //! Constructor - starts the writer thread
+  //!
+  //! @param logging logging object owning the in-memory circular log
+  //----------------------------------------------------------------------------
+  AsyncSink(Logging& logging):
+    mLogging(logging), mRecords(new Record[kCapacity]), mHead(0), mTail(0),
+    mWritten(0), mSleeping(false), mStop(false)
+  {
+    for (uint64_t i = 0; i < kCapacity; ++i) {
+      mRecords[i].mSeq.store(i, std::memory_order_relaxed);
+    }
+
+    mThread = std::thread(&AsyncSink::Run, this);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Destructor - writes out the pending records and stops the writer
+  //----------------------------------------------------------------------------
+  ~AsyncSink()
+  {
+    mStop = true;
+    Wake();
+    mThread.join();
+  }
+
+  //----------------------------------------------------------------------------
+  //! Queue a log line
+  //!
+  //! @param line line written to stderr and to the '*' fan-out
+  //! @param len length of the line
+  //! @param msg_pos start of the message text in the line, used for syslog
+  //! @param priority priority of the line
+  //! @param to_syslog if true the line is also sent to syslog
+  //! @param all_fd the '*' fan-out or nullptr
+  //! @param fan_fd per source or '#' fan-out or nullptr
+  //! @param fan line written to fan_fd
+  //! @param fan_len length of the fan-out line
+  //----------------------------------------------------------------------------
+  void Push(const char* line, size_t len, size_t msg_pos, int priority,
+            bool to_syslog, FILE* all_fd, FILE* fan_fd, const char* fan,
+            size_t fan_len)
+  {
+    uint64_t pos = mHead.load(std::memory_order_relaxed);
+    Record* rec;
+
+    while (true) {
+      rec = &mRecords[pos & (kCapacity - 1)];
+      uint64_t seq = rec->mSeq.load(std::memory_order_acquire);
+      int64_t diff = (int64_t) seq - (int64_t) pos;
+
+      if (diff == 0) {
+        if (mHead.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // Ring is full - wait for the writer
+        Wake();
+        std::this_thread::yield();
+        pos = mHead.load(std::memory_order_relaxed);
+      } else {
+        pos = mHead.load(std::memory_order_relaxed);
+      }
+    }
+
+    rec->mLine.assign(line, len);
+    rec->mMsgPos = msg_pos;
+    rec->mPriority = priority;
+    rec->mToSysLog = to_syslog;
+    rec->mAllFd = all_fd;
+    rec->mFanFd = fan_fd;
+
+    if (fan_fd) {
+      rec->mFanLine.assign(fan, fan_len);
+    }
+
+    rec->mSeq.store(pos + 1);
+
+    if (mSleeping.load()) {
+      Wake();
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Wait until all records queued so far are written
+  //----------------------------------------------------------------------------
+  void Flush()
+  {
+    uint64_t head = mHead.load();
+
+    while (mWritten.load() < head) {
+      Wake();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+private:
+  //----------------------------------------------------------------------------
+  //! Record of the ring
+  //----------------------------------------------------------------------------
+  struct Record {
+    std::atomic<uint64_t> mSeq;
+    std::string mLine;
+    std::string mFanLine;
+    size_t mMsgPos;
+    int mPriority;
+    bool mToSysLog;
+    FILE* mAllFd;
+    FILE* mFanFd;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Wake up the writer
+  //----------------------------------------------------------------------------
+  void Wake()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCond.notify_one();
+  }
+
+  //----------------------------------------------------------------------------
+  //! Check if a record is published
+  //!
+  //! @param offset position of the record after the next one to be written
+  //----------------------------------------------------------------------------
+  bool HasRecord(uint64_t offset = 0) const
+  {
+    uint64_t pos = mTail + offset;
+    return (mRecords[pos & (kCapacity - 1)].mSeq.load() == pos + 1);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Write all published records and store them in the in-memory log
+  //!
+  //! @return number of written records
+  //----------------------------------------------------------------------------
+  size_t Drain()
+  {
+    std::vector<FILE*> touched;
+    size_t count = 0;
+
+    while (count < kCapacity && HasRecord(count)) {
+      Record& rec = mRecords[(mTail + count) & (kCapacity - 1)];
+
+      if (rec.mToSysLog) {
+        syslog(rec.mPriority, "%s", rec.mLine.c_str() + rec.mMsgPos);
+      }
+
+      if (rec.mAllFd) {
+        fwrite(rec.mLine.c_str(), 1, rec.mLine.length(), rec.mAllFd);
+        fputc('\n', rec.mAllFd);
+        Touch(touched, rec.mAllFd);
+      }
+
+      if (rec.mFanFd) {
+        fwrite(rec.mFanLine.c_str(), 1, rec.mFanLine.length(), rec.mFanFd);
+        Touch(touched, rec.mFanFd);
+      }
+
+      fwrite(rec.mLine.c_str(), 1, rec.mLine.length(), stderr);
+      fputc('\n', stderr);
+      ++count;
+    }
+
+    if (count) {
+      for (auto fd : touched) {
+        fflush(fd);
+      }
+
+      fflush(stderr);
+      {
+        XrdSysMutexHelper scope_lock(mLogging.gMutex);
+
+        for (size_t i = 0; i < count; ++i) {
+          Record& rec = mRecords[(mTail + i) & (kCapacity - 1)];
+          mLogging.StoreInMemory(rec.mPriority, rec.mLine.c_str());
+        }
+      }
+
+      // Hand the records back to the loggers
+      for (size_t i = 0; i < count; ++i) {
+        uint64_t pos = mTail + i;
+        mRecords[pos & (kCapacity - 1)].mSeq.store(pos + kCapacity,
+            std::memory_order_release);
+      }
+
+      mTail += count;
+      mWritten.store(mTail);
+    }
+
+    return count;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Remember a file to be flushed at the end of the batch
+  //----------------------------------------------------------------------------
+  static void Touch(std::vector<FILE*>& touched, FILE* fd)
+  {
+    if (std::find(touched.begin(), touched.end(), fd) == touched.end()) {
+      touched.push_back(fd);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Writer loop
+  //----------------------------------------------------------------------------
+  void Run()
+  {
+    while (true) {
+      if (Drain()) {
+        continue;
+      }
+
+      if (mStop) {
+        Drain();
+        break;
+      }
+
+      std::unique_lock<std::mutex> lock(mMutex);
+      mSleeping = true;
+      mCond.wait_for(lock, std::chrono::milliseconds(100), [&]() {
+        return mStop || HasRecord();
+      });
+      mSleeping = false;
+    }
+  }
+
+  Logging& mLogging; ///< owner of the in-memory circular log
+  std::unique_ptr<Record[]> mRecords;
+  std::atomic<uint64_t> mHead; ///< next record to be claimed by a logger
+  uint64_t mTail; ///< next record to be written, only used by the writer
+  std::atomic<uint64_t> mWritten; ///< number of written records
+  std::atomic<bool> mSleeping; ///< writer waits for records
+  std::atomic<bool> mStop;
+  std::mutex mMutex;
+  std::condition_variable mCond;
+  std::thread mThread;
+};
+
 //------------------------------------------------------------------------------
 // Constructor
 //------------------------------------------------------------------------------
 Logging::Logging():
-  gLogMask(0), gPriorityLevel(0), gToSysLog(false),  gUnit("none"),
-  gShortFormat(0)
+  gLogMask(0), gPriorityLevel(0), gToSysLog(false), gAsync(false),
+  gUnit("none"), gShortFormat(0), gAsyncSink(nullptr), gRateLimitArmed(false)
 {
   // Initialize the log array and sets the log circular size
   gLogCircularIndex.resize(LOG_DEBUG + 1);
@@ -91,6 +356,104 @@ Logging::Logging():
       gToSysLog = true;
     }
   }
+
+  XrdOucString async;
+
+  if (getenv("EOS_LOG_ASYNC")) {
+    async = getenv("EOS_LOG_ASYNC");
+
+    if ((async == "1") || (async == "true")) {
+      gAsync = true;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Destructor
+//------------------------------------------------------------------------------
+Logging::~Logging()
+{
+  delete gAsyncSink.load();
+}
+
+//------------------------------------------------------------------------------
+// Get the asynchronous writer, starting it if needed
+//------------------------------------------------------------------------------
+Logging::AsyncSink*
+Logging::GetAsyncSink()
+{
+  AsyncSink* sink = gAsyncSink.load(std::memory_order_acquire);
+
+  if (!sink) {
+    static std::once_flag atfork_registered;
+    std::call_once(atfork_registered, []() {
+      pthread_atfork(nullptr, nullptr, &Logging::AtForkChild);
+    });
+    std::lock_guard<std::mutex> lock(gAsyncMutex);
+    sink = gAsyncSink.load();
+
+    if (!sink) {
+      sink = new AsyncSink(*this);
+      gAsyncSink.store(sink, std::memory_order_release);
+    }
+  }
+
+  return sink;
+}
+
+//------------------------------------------------------------------------------
+// Drop the writer of the parent process after a fork - its thread does not
+// exist in the child, a new one is started with the next log line
+//------------------------------------------------------------------------------
+void
+Logging::AtForkChild()
+{
+  gLogging.gAsyncSink.store(nullptr);
+}
+
+//------------------------------------------------------------------------------
+// Enable/disable asynchronous writing of the log lines
+//------------------------------------------------------------------------------
+void
+Logging::SetAsync(bool onoff)
+{
+  if (onoff) {
+    gAsync = true;
+    return;
+  }
+
+  // Write out the queued lines before going back to synchronous writing, so
+  // that they don't end up after the newer synchronous ones. The second flush
+  // covers the lines of the threads which still saw the asynchronous mode.
+  Flush();
+  gAsync = false;
+  Flush();
+}
+
+//------------------------------------------------------------------------------
+// Store a log line in the in-memory circular log
+//------------------------------------------------------------------------------
+const char*
+Logging::StoreInMemory(int priority, const char* line)
+{
+  XrdOucString& slot =
+    gLogMemory[priority][gLogCircularIndex[priority] % gCircularIndexSize];
+  slot = line;
+  gLogCircularIndex[priority]++;
+  return slot.c_str();
+}
+
+//------------------------------------------------------------------------------
+// Wait until all asynchronous log lines are written
+//------------------------------------------------------------------------------
+void
+Logging::Flush()
+{
+  AsyncSink* sink = gAsyncSink.load(std::memory_order_acquire);
+
+  if (sink) {
+    sink->Flush();
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -121,6 +484,70 @@ Logging::shouldlog(const char* func, int priority)
   return true;
 }
 
+//------------------------------------------------------------------------------
+// Append formatted text to a per thread buffer at the given position, growing
+// the buffer up to 1MB. Longer text is truncated.
+//
+// @return position after the appended text
+//------------------------------------------------------------------------------
+static size_t
+BufferAppendV(std::vector<char>& buffer, size_t pos, const char* fmt,
+              va_list args)
+{
+  static const size_t logmsgbuffersize = 1024 * 1024;
+  va_list copy;
+  va_copy(copy, args);
+  int len = vsnprintf(buffer.data() + pos, buffer.size() - pos, fmt, copy);
+  va_end(copy);
+
+  if (len < 0) {
+    buffer[pos] = 0;
+    return pos;
+  }
+
+  if ((pos + len >= buffer.size()) && (buffer.size() < logmsgbuffersize)) {
+    buffer.resize(std::min(logmsgbuffersize,
+                           std::max(2 * buffer.size(), pos + len + 1)));
+    va_copy(copy, args);
+    vsnprintf(buffer.data() + pos, buffer.size() - pos, fmt, copy);
+    va_end(copy);
+  }
+
+  return std::min(pos + len, buffer.size() - 1);
+}
+
+static size_t
+BufferAppend(std::vector<char>& buffer, size_t pos, const char* fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  pos = BufferAppendV(buffer, pos, fmt, args);
+  va_end(args);
+  return pos;
+}
+
+//------------------------------------------------------------------------------
+// Get the formatted local time of the given second, the formatting is cached
+// per thread and only done once a second
+//------------------------------------------------------------------------------
+static const char*
+GetTimeString(time_t now)
+{
+  static thread_local time_t last = -1;
+  static thread_local char timestr[32];
+
+  if (now != last) {
+    struct tm tm;
+    localtime_r(&now, &tm);
+    snprintf(timestr, sizeof(timestr), "%02d%02d%02d %02d:%02d:%02d",
+             tm.tm_year - 100, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
+             tm.tm_min, tm.tm_sec);
+    last = now;
+  }
+
+  return timestr;
+}
+
 //------------------------------------------------------------------------------
 // Logging function
 //------------------------------------------------------------------------------
@@ -129,7 +556,6 @@ Logging::log(const char* func, const char* file, int line, const char* logid,
              const Mapping::VirtualIdentity& vid, const char* cident, int priority,
              const char* msg, ...)
 {
-  static int logmsgbuffersize = 1024 * 1024;
   bool silent = (priority == LOG_SILENT);
 
   // short cut if log messages are masked
@@ -152,30 +578,19 @@ Logging::log(const char* func, const char* file, int line, const char* logid,
     }
   }
 
-  static char* buffer = 0;
-
-  if (!buffer) {
-    // 1 M print buffer
-    buffer = (char*) malloc(logmsgbuffersize);
-  }
-
+  // Every thread formats into its own buffers, no lock is needed until the
+  // line is written
+  static thread_local std::vector<char> buffer(4096);
+  static thread_local std::vector<char> fanbuffer(4096);
   XrdOucString File = file;
   // we show only one hierarchy directory like Acl (assuming that we have only
   // file names like *.cc and *.hh
   File.erase(0, File.rfind("/") + 1);
   File.erase(File.length() - 3);
-  static time_t current_time;
-  static struct timeval tv;
-  static struct timezone tz;
-  struct tm tm;
-  XrdSysMutexHelper scope_lock(gMutex);
-  va_list args;
-  va_start(args, msg);
-  gettimeofday(&tv, &tz);
-  current_time = tv.tv_sec;
-  static char linen[16];
-  sprintf(linen, "%d", line);
-  static char fcident[1024];
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  time_t current_time = tv.tv_sec;
+  const char* timestr = GetTimeString(current_time);
   XrdOucString truncname = vid.name;
 
   // we show only the last 16 bytes of the name
@@ -185,128 +600,148 @@ Logging::log(const char* func, const char* file, int line, const char* logid,
   }
 
   char sourceline[64];
+  snprintf(sourceline, sizeof(sourceline) - 1, "%s:%d", File.c_str(), line);
+  size_t len;
 
   if (gShortFormat) {
-    localtime_r(&current_time, &tm);
-    snprintf(sourceline, sizeof(sourceline) - 1, "%s:%s", File.c_str(), linen);
     XrdOucString slog = logid;
 
     if (slog.beginswith("logid:")) {
       slog.erase(0, 6);
-      sprintf(buffer,
-              "%02d%02d%02d %02d:%02d:%02d t=%lu.%06lu f=%-16s l=%s %s s=%-24s ",
-              tm.tm_year - 100, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
-              tm.tm_min, tm.tm_sec, current_time, (unsigned long) tv.tv_usec,
-              func, GetPriorityString(priority), slog.c_str(), sourceline);
+      len = BufferAppend(buffer, 0, "%s t=%lu.%06lu f=%-16s l=%s %s s=%-24s ",
+                         timestr, current_time, (unsigned long) tv.tv_usec,
+                         func, GetPriorityString(priority), slog.c_str(),
+                         sourceline);
     } else {
-      sprintf(buffer,
-              "%02d%02d%02d %02d:%02d:%02d t=%lu.%06lu f=%-16s l=%s tid=%016lx s=%-24s ",
-              tm.tm_year - 100, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
-              tm.tm_min, tm.tm_sec, current_time, (unsigned long) tv.tv_usec,
-              func, GetPriorityString(priority), (unsigned long) XrdSysThread::ID(),
-              sourceline);
+      len = BufferAppend(buffer, 0,
+                         "%s t=%lu.%06lu f=%-16s l=%s tid=%016lx s=%-24s ",
+                         timestr, current_time, (unsigned long) tv.tv_usec,
+                         func, GetPriorityString(priority),
+                         (unsigned long) XrdSysThread::ID(), sourceline);
     }
   } else {
-    sprintf(fcident, "tident=%s sec=%-5s uid=%d gid=%d name=%s geo=\"%s\"", cident,
-            vid.prot.c_str(), vid.uid, vid.gid, truncname.c_str(), vid.geolocation.c_str());
-    localtime_r(&current_time, &tm);
-    snprintf(sourceline, sizeof(sourceline) - 1, "%s:%s", File.c_str(), linen);
-    sprintf(buffer,
-            "%02d%02d%02d %02d:%02d:%02d time=%lu.%06lu func=%-24s level=%s logid=%s unit=%s tid=%016lx source=%-30s %s ",
-            tm.tm_year - 100, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min,
-            tm.tm_sec, current_time, (unsigned long) tv.tv_usec, func,
-            GetPriorityString(priority), logid, gUnit.c_str(),
-            (unsigned long) XrdSysThread::ID(), sourceline, fcident);
-  }
-
-  char* ptr = buffer + strlen(buffer);
-  // limit the length of the output to buffer-1 length
-  vsnprintf(ptr, logmsgbuffersize - (ptr - buffer + 1), msg, args);
+    char fcident[1024];
+    snprintf(fcident, sizeof(fcident),
+             "tident=%s sec=%-5s uid=%d gid=%d name=%s geo=\"%s\"", cident,
+             vid.prot.c_str(), vid.uid, vid.gid, truncname.c_str(),
+             vid.geolocation.c_str());
+    len = BufferAppend(buffer, 0,
+                       "%s time=%lu.%06lu func=%-24s level=%s logid=%s unit=%s tid=%016lx source=%-30s %s ",
+                       timestr, current_time, (unsigned long) tv.tv_usec, func,
+                       GetPriorityString(priority), logid, gUnit.c_str(),
+                       (unsigned long) XrdSysThread::ID(), sourceline, fcident);
+  }
+
+  size_t msg_pos = len;
+  va_list args;
+  va_start(args, msg);
+  len = BufferAppendV(buffer, msg_pos, msg, args);
+  va_end(args);
+  const char* ptr = buffer.data() + msg_pos;
 
   if (!silent && rate_limit(tv, priority, file, line)) {
     return "";
   }
 
-  if (!silent && gToSysLog) {
-    syslog(priority, "%s", ptr);
+  FILE* all_fd = nullptr;
+  FILE* fan_fd = nullptr;
+  size_t fan_len = 0;
+
+  if (!silent && gLogFanOut.size()) {
+    // we do log-message fanout
+    auto it = gLogFanOut.find("*");
+
+    if (it != gLogFanOut.end()) {
+      all_fd = it->second;
+    }
+
+    it = gLogFanOut.find(File.c_str());
+
+    if (it != gLogFanOut.end()) {
+      fan_fd = it->second;
+      fan_len = BufferAppend(fanbuffer, 0, "%.15s %s%s%s %-30s %s \n",
+                             buffer.data(),
+                             GetLogColour(GetPriorityString(priority)),
+                             GetPriorityString(priority), EOS_TEXTNORMAL,
+                             sourceline, ptr);
+    } else if ((it = gLogFanOut.find("#")) != gLogFanOut.end()) {
+      fan_fd = it->second;
+      fan_len = BufferAppend(fanbuffer, 0,
+                             "%.15s %s%s%s [%05d/%05d] %16s ::%-16s %s \n",
+                             buffer.data(),
+                             GetLogColour(GetPriorityString(priority)),
+                             GetPriorityString(priority), EOS_TEXTNORMAL,
+                             vid.uid, vid.gid, truncname.c_str(), func, ptr);
+    }
+  }
+
+  bool async = (!silent && gAsync);
+
+  if (async) {
+    // The writer thread also stores the line in the in-memory log, the
+    // caller gets the copy formatted in its own buffer
+    GetAsyncSink()->Push(buffer.data(), len, msg_pos, priority, gToSysLog,
+                         all_fd, fan_fd, fanbuffer.data(), fan_len);
+    return buffer.data();
   }
 
+  XrdSysMutexHelper scope_lock(gMutex);
+
   if (!silent) {
-    if (gLogFanOut.size()) {
-      // we do log-message fanout
-      if (gLogFanOut.count("*")) {
-        fprintf(gLogFanOut["*"], "%s\n", buffer);
-        fflush(gLogFanOut["*"]);
-      }
+    if (gToSysLog) {
+      syslog(priority, "%s", ptr);
+    }
 
-      if (gLogFanOut.count(File.c_str())) {
-        buffer[15] = 0;
-        fprintf(gLogFanOut[File.c_str()], "%s %s%s%s %-30s %s \n",
-                buffer,
-                GetLogColour(GetPriorityString(priority)),
-                GetPriorityString(priority),
-                EOS_TEXTNORMAL,
-                sourceline,
-                ptr);
-        fflush(gLogFanOut[File.c_str()]);
-        buffer[15] = ' ';
-      } else {
-        if (gLogFanOut.count("#")) {
-          buffer[15] = 0;
-          fprintf(gLogFanOut["#"], "%s %s%s%s [%05d/%05d] %16s ::%-16s %s \n",
-                  buffer,
-                  GetLogColour(GetPriorityString(priority)),
-                  GetPriorityString(priority),
-                  EOS_TEXTNORMAL,
-                  vid.uid,
-                  vid.gid,
-                  truncname.c_str(),
-                  func,
-                  ptr
-                 );
-          fflush(gLogFanOut["#"]);
-          buffer[15] = ' ';
-        }
-      }
+    if (all_fd) {
+      fprintf(all_fd, "%s\n", buffer.data());
+      fflush(all_fd);
+    }
 
-      fprintf(stderr, "%s\n", buffer);
-      fflush(stderr);
-    } else {
-      fprintf(stderr, "%s\n", buffer);
-      fflush(stderr);
+    if (fan_fd) {
+      fwrite(fanbuffer.data(), 1, fan_len, fan_fd);
+      fflush(fan_fd);
     }
-  }
 
-  va_end(args);
-  const char* rptr;
+    fprintf(stderr, "%s\n", buffer.data());
+    fflush(stderr);
+  }
 
   if (silent) {
     priority = LOG_DEBUG;
   }
 
   // store into global log memory
-  gLogMemory[priority][(gLogCircularIndex[priority]) % gCircularIndexSize] =
-    buffer;
-  rptr = gLogMemory[priority][(gLogCircularIndex[priority]) %
-                              gCircularIndexSize].c_str();
-  gLogCircularIndex[priority]++;
-  return rptr;
+  return StoreInMemory(priority, buffer.data());
 }
 
+//------------------------------------------------------------------------------
+// Suppress repeated error messages coming from the same source line
+//------------------------------------------------------------------------------
 bool
 Logging::rate_limit(struct timeval& tv, int priority, const char* file,
                     int line)
 {
+  // Messages below the error levels are never suppressed, they only end a
+  // sequence of identical error messages. This path takes no lock.
+  if (priority >= LOG_WARNING) {
+    if (gRateLimitArmed.load(std::memory_order_relaxed)) {
+      gRateLimitArmed.store(false, std::memory_order_relaxed);
+    }
+
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(gRateMutex);
   static bool do_limit = false;
   static std::string last_file = "";
   static int last_line = 0;
   static int last_priority = priority;
   static struct timeval last_tv;
 
-  if ((line == last_line) &&
+  if (gRateLimitArmed.load(std::memory_order_relaxed) &&
+      (line == last_line) &&
       (priority == last_priority) &&
-      (last_file == file) &&
-      (priority < LOG_WARNING)) {
+      (last_file == file)) {
     float elapsed = (1.0 * (tv.tv_sec - last_tv.tv_sec)) - ((
                       tv.tv_usec - last_tv.tv_usec) / 1000000.0);
 
@@ -329,6 +764,7 @@ Logging::rate_limit(struct timeval& tv, int priority, const char* file,
     last_line = line;
     last_file = file;
     last_priority = priority;
+    gRateLimitArmed.store(true, std::memory_order_relaxed);
   }
 
   return do_limit;
@@ -41,6 +41,11 @@
  * all messages which are not in any other fan-out (besides '*') into that file.
  * The fan-out functionality assumes that
  * source filenames follow the pattern <fan-out-name>.xx !!!!
+ *
+ * With 'SetAsync' (or EOS_LOG_ASYNC=1 in the environment) the log lines are
+ * formatted by the calling thread and handed over to a dedicated writer thread
+ * which writes them in batches and stores them in the in-memory log, so the
+ * callers neither wait for the output nor take the logging mutex.
  */
 
 #ifndef __EOSCOMMON_LOGGING_HH__
@@ -56,6 +61,8 @@
 #include <sys/syslog.h>
 #include <sys/time.h>
 #include <uuid/uuid.h>
+#include <atomic>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <sstream>
@@ -337,7 +344,8 @@ public:
   int gLogMask; //< log mask
   int gPriorityLevel; //< log priority
   bool gToSysLog; //< duplicate into syslog
-  XrdSysMutex gMutex; //< global mutex
+  std::atomic<bool> gAsync; //< write the log lines from a dedicated thread
+  XrdSysMutex gMutex; //< global mutex protecting the log memory
   XrdOucString gUnit; //< global unit name
   //! Global list of function names allowed to log
   XrdOucHash<const char*> gAllowFilter;
@@ -358,9 +366,9 @@ public:
   Logging();
 
   //----------------------------------------------------------------------------
-  //! Destructor
+  //! Destructor - writes out all pending log lines
   //----------------------------------------------------------------------------
-  ~Logging() = default;
+  ~Logging();
 
   //----------------------------------------------------------------------------
   //! Get current loglevel
@@ -396,6 +404,18 @@ public:
     gToSysLog = onoff;
   }
 
+  //----------------------------------------------------------------------------
+  //! Enable/disable asynchronous writing of the log lines. The writer thread
+  //! is started with the first asynchronous log line. When disabling, the
+  //! lines queued so far are written before returning.
+  //----------------------------------------------------------------------------
+  void SetAsync(bool onoff);
+
+  //----------------------------------------------------------------------------
+  //! Wait until all log lines logged so far in asynchronous mode are written
+  //----------------------------------------------------------------------------
+  void Flush();
+
   //----------------------------------------------------------------------------
   //! Set the log filter
   //----------------------------------------------------------------------------
@@ -621,6 +641,35 @@ public:
   //---------------------------------------------------------------------------
 
   bool rate_limit(struct timeval& tv, int priority, const char* file, int line);
+
+private:
+  class AsyncSink;
+
+  //----------------------------------------------------------------------------
+  //! Get the asynchronous writer, starting it if needed
+  //----------------------------------------------------------------------------
+  AsyncSink* GetAsyncSink();
+
+  //----------------------------------------------------------------------------
+  //! Drop the writer of the parent process after a fork
+  //----------------------------------------------------------------------------
+  static void AtForkChild();
+
+  //----------------------------------------------------------------------------
+  //! Store a log line in the in-memory circular log, must be called with
+  //! gMutex locked
+  //!
+  //! @param priority priority of the line
+  //! @param line log line
+  //!
+  //! @return pointer to the stored line
+  //----------------------------------------------------------------------------
+  const char* StoreInMemory(int priority, const char* line);
+
+  std::atomic<AsyncSink*> gAsyncSink; //< writer of the asynchronous mode
+  std::mutex gAsyncMutex; //< mutex serializing the writer start
+  std::atomic<bool> gRateLimitArmed; //< last rate limited message was an error
+  std::mutex gRateMutex; //< mutex protecting the rate limit state
 };
 
 extern Logging& gLogging; ///< Global logging object
@@ -26,6 +26,7 @@
 #include "common/RWMutex.hh"
 #include "common/PthreadRWMutex.hh"
 #include "common/SharedMutex.hh"
+#include "common/StripedRWMutex.hh"
 #include <sstream>
 #include <exception>
 
@@ -190,6 +191,7 @@ RWMutex::~RWMutex()
 
 #endif
   delete mMutexImpl;
+  delete mProfiler.load();
 }
 
 
@@ -200,9 +202,11 @@ RWMutex&
 RWMutex::operator=(RWMutex&& other) noexcept
 {
   if (this != &other) {
+    delete this->mMutexImpl;
     this->mMutexImpl = other.mMutexImpl;
     other.mMutexImpl = nullptr;
     this->mBlocking = other.mBlocking;
+    delete this->mProfiler.exchange(other.mProfiler.exchange(nullptr));
   }
 
   return *this;
@@ -217,6 +221,70 @@ RWMutex::RWMutex(RWMutex&& other) noexcept
 }
 
 
+//------------------------------------------------------------------------------
+// Switch to the reader-scalable striped implementation
+//------------------------------------------------------------------------------
+void
+RWMutex::SetStriped()
+{
+  delete mMutexImpl;
+  mMutexImpl = new StripedRWMutex();
+}
+
+//------------------------------------------------------------------------------
+// Enable/disable the per call site contention profiling
+//------------------------------------------------------------------------------
+void
+RWMutex::SetContentionProfiling(bool on, uint32_t modulo)
+{
+  RWMutexProfiler* profiler = mProfiler.load();
+
+  if (!profiler) {
+    if (!on) {
+      return;
+    }
+
+    RWMutexProfiler* created = new RWMutexProfiler();
+
+    if (mProfiler.compare_exchange_strong(profiler, created)) {
+      profiler = created;
+    } else {
+      delete created;
+    }
+  }
+
+  profiler->Enable(on, modulo);
+}
+
+//------------------------------------------------------------------------------
+// Print the contention profile
+//------------------------------------------------------------------------------
+std::string
+RWMutex::PrintContentionProfile(const std::string& name, size_t max_sites,
+                                bool monitoring, bool histograms) const
+{
+  RWMutexProfiler* profiler = mProfiler.load();
+
+  if (!profiler) {
+    return "";
+  }
+
+  return profiler->PrintOut(name, max_sites, monitoring, histograms);
+}
+
+//------------------------------------------------------------------------------
+// Drop the contention profile collected so far
+//------------------------------------------------------------------------------
+void
+RWMutex::ResetContentionProfile()
+{
+  RWMutexProfiler* profiler = mProfiler.load();
+
+  if (profiler) {
+    profiler->Reset();
+  }
+}
+
 //------------------------------------------------------------------------------
 // Try to read lock the mutex within the timeout value
 //------------------------------------------------------------------------------
@@ -1277,24 +1345,41 @@ RWMutex::ResetCheckOrder()
 //------------------------------------------------------------------------------
 // Constructor
 //------------------------------------------------------------------------------
-RWMutexWriteLock::RWMutexWriteLock(RWMutex& mutex):
-  mWrMutex(&mutex)
+RWMutexWriteLock::RWMutexWriteLock(RWMutex& mutex, const char* file,
+                                   int line):
+  mWrMutex(nullptr)
 {
-  mWrMutex->LockWrite();
+  Grab(mutex, file, line);
 }
 
 //----------------------------------------------------------------------------
 // Grab mutex and write lock it
 //----------------------------------------------------------------------------
 void
-RWMutexWriteLock::Grab(RWMutex& mutex)
+RWMutexWriteLock::Grab(RWMutex& mutex, const char* file, int line)
 {
   if (mWrMutex) {
     throw std::runtime_error("already holding a mutex");
   }
 
   mWrMutex = &mutex;
+  RWMutexProfiler* profiler = mutex.GetContentionProfiler();
+
+  if (profiler && profiler->ShouldSample()) {
+    mProfiler = profiler;
+    mFile = file;
+    mLine = line;
+    mAcquiredAt = std::chrono::steady_clock::now();
+  }
+
   mWrMutex->LockWrite();
+
+  if (mProfiler) {
+    auto now = std::chrono::steady_clock::now();
+    mWaitNs = std::chrono::duration_cast<std::chrono::nanoseconds>
+              (now - mAcquiredAt).count();
+    mAcquiredAt = now;
+  }
 }
 
 
@@ -1307,6 +1392,13 @@ RWMutexWriteLock::Release()
   if (mWrMutex) {
     mWrMutex->UnLockWrite();
     mWrMutex = nullptr;
+
+    if (mProfiler) {
+      uint64_t hold_ns = std::chrono::duration_cast<std::chrono::nanoseconds>
+                         (std::chrono::steady_clock::now() - mAcquiredAt).count();
+      mProfiler->Record(mFile, mLine, true, mWaitNs, hold_ns);
+      mProfiler = nullptr;
+    }
   }
 }
 
@@ -1325,27 +1417,42 @@ RWMutexWriteLock::~RWMutexWriteLock()
 //------------------------------------------------------------------------------
 // Constructor
 //------------------------------------------------------------------------------
-RWMutexReadLock::RWMutexReadLock(RWMutex& mutex)
+RWMutexReadLock::RWMutexReadLock(RWMutex& mutex, const char* file, int line)
 {
-  Grab(mutex);
+  Grab(mutex, file, line);
 }
 
 //----------------------------------------------------------------------------
 // Grab mutex and write lock it
 //----------------------------------------------------------------------------
 void
-RWMutexReadLock::Grab(RWMutex& mutex)
+RWMutexReadLock::Grab(RWMutex& mutex, const char* file, int line)
 {
   if (mRdMutex) {
     throw std::runtime_error("already holding a mutex");
   }
 
   mRdMutex = &mutex;
+  RWMutexProfiler* profiler = mutex.GetContentionProfiler();
+  std::chrono::steady_clock::time_point wait_start;
+
+  if (profiler && profiler->ShouldSample()) {
+    mProfiler = profiler;
+    mFile = file;
+    mLine = line;
+    wait_start = std::chrono::steady_clock::now();
+  }
+
   mRdMutex->LockRead();
 
   // acquiredAt must be updated _after_ we get the lock, since LockRead
   // may take a long time to complete
   mAcquiredAt = std::chrono::steady_clock::now();
+
+  if (mProfiler) {
+    mWaitNs = std::chrono::duration_cast<std::chrono::nanoseconds>
+              (mAcquiredAt - wait_start).count();
+  }
 }
 
 void
@@ -1356,9 +1463,16 @@ RWMutexReadLock::Release()
     int64_t blockedinterval = mRdMutex->BlockedForMsInterval();
     bool blockedtracing = mRdMutex->BlockedStackTracing();
     mRdMutex = nullptr;
+    auto held = std::chrono::steady_clock::now() - mAcquiredAt;
     std::chrono::milliseconds blockedFor =
-      std::chrono::duration_cast<std::chrono::milliseconds>
-      (std::chrono::steady_clock::now() - mAcquiredAt);
+      std::chrono::duration_cast<std::chrono::milliseconds>(held);
+
+    if (mProfiler) {
+      mProfiler->Record(mFile, mLine, false, mWaitNs,
+                        std::chrono::duration_cast<std::chrono::nanoseconds>
+                        (held).count());
+      mProfiler = nullptr;
+    }
 
     if (blockedFor.count() > blockedinterval) {
       std::ostringstream ss;
@@ -54,6 +54,7 @@
 
 #include "common/Namespace.hh"
 #include "common/IRWMutex.hh"
+#include "common/RWMutexProfiler.hh"
 #include "XrdSys/XrdSysPthread.hh"
 #include <stdio.h>
 #include <stdint.h>
@@ -133,6 +134,53 @@ public:
     mBlocking = block;
   }
 
+  //----------------------------------------------------------------------------
+  //! Switch to the reader-scalable StripedRWMutex implementation. Meant for
+  //! heavily read-locked mutexes on machines with many cores. Must be called
+  //! before the mutex is used for the first time.
+  //----------------------------------------------------------------------------
+  void SetStriped();
+
+  //----------------------------------------------------------------------------
+  //! Enable/disable the per call site contention profiling done by the
+  //! RWMutexReadLock/RWMutexWriteLock helpers
+  //!
+  //! @param on enable if true, otherwise disable
+  //! @param modulo profile one in modulo lock acquisitions
+  //----------------------------------------------------------------------------
+  void SetContentionProfiling(bool on, uint32_t modulo = 100);
+
+  //----------------------------------------------------------------------------
+  //! Get the contention profiler if the profiling is enabled
+  //!
+  //! @return profiler or nullptr
+  //----------------------------------------------------------------------------
+  inline RWMutexProfiler* GetContentionProfiler() const
+  {
+    RWMutexProfiler* profiler = mProfiler.load(std::memory_order_acquire);
+    return ((profiler && profiler->IsEnabled()) ? profiler : nullptr);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Print the contention profile
+  //!
+  //! @param name name of the mutex in the report
+  //! @param max_sites maximum number of call sites to print, 0 for all
+  //! @param monitoring print in <key>=<value> monitoring format
+  //! @param histograms print the histograms of every call site
+  //!
+  //! @return profile report, empty if the profiling was never enabled
+  //----------------------------------------------------------------------------
+  std::string PrintContentionProfile(const std::string& name,
+                                     size_t max_sites = 0,
+                                     bool monitoring = false,
+                                     bool histograms = false) const;
+
+  //----------------------------------------------------------------------------
+  //! Drop the contention profile collected so far
+  //----------------------------------------------------------------------------
+  void ResetContentionProfile();
+
   //----------------------------------------------------------------------------
   //! Set the time interval when to stacktrace a long lasting lock
   //!
@@ -497,9 +545,12 @@ public:
 
 private:
   std::atomic<uint64_t> mLastWriteLock;
+  //! Contention profiler, created with the first enabling and kept until the
+  //! mutex is destroyed since lock helpers may still use it
+  std::atomic<RWMutexProfiler*> mProfiler {nullptr};
 
-  bool mBlocking;
-  IRWMutex* mMutexImpl;
+  bool mBlocking {false};
+  IRWMutex* mMutexImpl {nullptr};
   pthread_rwlock_t rwlock;
   pthread_rwlockattr_t attr;
   struct timespec wlocktime;
@@ -591,15 +642,21 @@ public:
   //! Constructor
   //!
   //! @param mutex mutex to lock for write
+  //! @param file source file of the caller, for the contention profiling
+  //! @param line source line of the caller, for the contention profiling
   //----------------------------------------------------------------------------
-  RWMutexWriteLock(RWMutex& mutex);
+  RWMutexWriteLock(RWMutex& mutex, const char* file = __builtin_FILE(),
+                   int line = __builtin_LINE());
 
   //----------------------------------------------------------------------------
   //! Grab mutex and write lock it
   //!
   //! @param mutex mutex to lock for write
+  //! @param file source file of the caller, for the contention profiling
+  //! @param line source line of the caller, for the contention profiling
   //----------------------------------------------------------------------------
-  void Grab(RWMutex& mutex);
+  void Grab(RWMutex& mutex, const char* file = __builtin_FILE(),
+            int line = __builtin_LINE());
 
   //----------------------------------------------------------------------------
   //! Release the write lock after grab
@@ -613,6 +670,11 @@ public:
 
 private:
   RWMutex* mWrMutex;
+  RWMutexProfiler* mProfiler = nullptr; ///< Set if this lock is sampled
+  const char* mFile = nullptr;
+  int mLine = 0;
+  uint64_t mWaitNs = 0;
+  std::chrono::steady_clock::time_point mAcquiredAt;
 };
 
 //------------------------------------------------------------------------------
@@ -630,15 +692,21 @@ public:
   //! Constructor
   //!
   //! @param mutex mutex to handle
+  //! @param file source file of the caller, for the contention profiling
+  //! @param line source line of the caller, for the contention profiling
   //----------------------------------------------------------------------------
-  RWMutexReadLock(RWMutex& mutex);
+  RWMutexReadLock(RWMutex& mutex, const char* file = __builtin_FILE(),
+                  int line = __builtin_LINE());
 
   //----------------------------------------------------------------------------
   //! Grab mutex and read lock it
   //!
   //! @param mutex mutex to lock for read
+  //! @param file source file of the caller, for the contention profiling
+  //! @param line source line of the caller, for the contention profiling
   //----------------------------------------------------------------------------
-  void Grab(RWMutex& mutex);
+  void Grab(RWMutex& mutex, const char* file = __builtin_FILE(),
+            int line = __builtin_LINE());
 
   //----------------------------------------------------------------------------
   //! Release the write lock after grab
@@ -653,6 +721,10 @@ public:
 private:
   std::chrono::steady_clock::time_point mAcquiredAt;
   RWMutex* mRdMutex = nullptr;
+  RWMutexProfiler* mProfiler = nullptr; ///< Set if this lock is sampled
+  const char* mFile = nullptr;
+  int mLine = 0;
+  uint64_t mWaitNs = 0;
 };
 
 //------------------------------------------------------------------------------
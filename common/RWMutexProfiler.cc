@@ -0,0 +1,233 @@
+//------------------------------------------------------------------------------
+// File: RWMutexProfiler.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2019 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "common/RWMutexProfiler.hh"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+EOSCOMMONNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+// Decide if the current lock acquisition is sampled
+//------------------------------------------------------------------------------
+bool
+RWMutexProfiler::ShouldSample() const
+{
+  static thread_local uint32_t countdown = 0;
+
+  if (countdown) {
+    --countdown;
+    return false;
+  }
+
+  countdown = mSamplingModulo.load(std::memory_order_relaxed) - 1;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Get the histogram bucket of the given duration
+//------------------------------------------------------------------------------
+size_t
+RWMutexProfiler::GetBucket(uint64_t ns)
+{
+  uint64_t us = ns / 1000;
+  size_t bucket = 0;
+
+  while (us && (bucket < kNumBuckets - 1)) {
+    us >>= 1;
+    ++bucket;
+  }
+
+  return bucket;
+}
+
+//------------------------------------------------------------------------------
+// Add a sampled lock acquisition
+//------------------------------------------------------------------------------
+void
+RWMutexProfiler::Record(const char* file, int line, bool write,
+                        uint64_t wait_ns, uint64_t hold_ns)
+{
+  size_t wait_bucket = GetBucket(wait_ns);
+  size_t hold_bucket = GetBucket(hold_ns);
+  std::lock_guard<std::mutex> lock(mMutex);
+  CallSite& site = mSites[Key(file, line, write)];
+  ++site.mSamples;
+  site.mWaitSum += wait_ns;
+  site.mWaitMax = std::max(site.mWaitMax, wait_ns);
+  site.mHoldSum += hold_ns;
+  site.mHoldMax = std::max(site.mHoldMax, hold_ns);
+  ++site.mWaitHist[wait_bucket];
+  ++site.mHoldHist[hold_bucket];
+}
+
+//------------------------------------------------------------------------------
+// Get the profiles of all call sites
+//------------------------------------------------------------------------------
+std::vector<RWMutexProfiler::CallSite>
+RWMutexProfiler::GetCallSites() const
+{
+  // The same source location may come with different file name literals e.g.
+  // from inline functions, merge them by name
+  std::map<std::tuple<std::string, int, bool>, CallSite> merged;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (const auto& elem : mSites) {
+      const char* file = std::get<0>(elem.first);
+      const char* pos = strrchr(file, '/');
+      std::string name = (pos ? pos + 1 : file);
+      CallSite& site = merged[std::make_tuple(name, std::get<1>(elem.first),
+                                              std::get<2>(elem.first))];
+      const CallSite& other = elem.second;
+
+      if (site.mFile.empty()) {
+        site = other;
+        site.mFile = name;
+        site.mLine = std::get<1>(elem.first);
+        site.mWrite = std::get<2>(elem.first);
+        continue;
+      }
+
+      site.mSamples += other.mSamples;
+      site.mWaitSum += other.mWaitSum;
+      site.mWaitMax = std::max(site.mWaitMax, other.mWaitMax);
+      site.mHoldSum += other.mHoldSum;
+      site.mHoldMax = std::max(site.mHoldMax, other.mHoldMax);
+
+      for (size_t i = 0; i < kNumBuckets; ++i) {
+        site.mWaitHist[i] += other.mWaitHist[i];
+        site.mHoldHist[i] += other.mHoldHist[i];
+      }
+    }
+  }
+  std::vector<CallSite> sites;
+  sites.reserve(merged.size());
+
+  for (auto& elem : merged) {
+    sites.push_back(elem.second);
+  }
+
+  std::sort(sites.begin(), sites.end(),
+  [](const CallSite & a, const CallSite & b) {
+    return a.mHoldSum > b.mHoldSum;
+  });
+  return sites;
+}
+
+//------------------------------------------------------------------------------
+// Drop all profiles
+//------------------------------------------------------------------------------
+void
+RWMutexProfiler::Reset()
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  mSites.clear();
+}
+
+//------------------------------------------------------------------------------
+// Print the non-empty buckets of a histogram as <upper bound>:<count>
+//------------------------------------------------------------------------------
+static void
+PrintHistogram(std::ostringstream& oss, const uint64_t* hist, size_t num)
+{
+  for (size_t i = 0; i < num; ++i) {
+    if (!hist[i]) {
+      continue;
+    }
+
+    if (i == num - 1) {
+      oss << " >=" << (1ull << (i - 1)) << "us:" << hist[i];
+    } else {
+      oss << " <" << (1ull << i) << "us:" << hist[i];
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Print the profile
+//------------------------------------------------------------------------------
+std::string
+RWMutexProfiler::PrintOut(const std::string& name, size_t max_sites,
+                          bool monitoring, bool histograms) const
+{
+  std::vector<CallSite> sites = GetCallSites();
+
+  if (max_sites && (sites.size() > max_sites)) {
+    sites.resize(max_sites);
+  }
+
+  std::ostringstream oss;
+
+  if (monitoring) {
+    for (const auto& site : sites) {
+      oss << "uid=all gid=all ns.contention." << name << "." << site.mFile
+          << ":" << site.mLine << "." << (site.mWrite ? "w" : "r")
+          << " samples=" << site.mSamples
+          << " wait.avg=" << site.mWaitSum / site.mSamples
+          << " wait.max=" << site.mWaitMax
+          << " hold.avg=" << site.mHoldSum / site.mSamples
+          << " hold.max=" << site.mHoldMax
+          << " hold.sum=" << site.mHoldSum << std::endl;
+    }
+
+    return oss.str();
+  }
+
+  std::string line = "# ------------------------------------------------------"
+                     "------------------------------";
+  char buffer[256];
+  oss << line << std::endl
+      << "# Lock contention of " << name << " [ sampling 1/"
+      << mSamplingModulo << " " << (IsEnabled() ? "on" : "off") << " ]"
+      << std::endl << line << std::endl;
+  snprintf(buffer, sizeof(buffer), "%-2s %-32s %10s %10s %10s %10s %10s %12s",
+           "rw", "call site", "samples", "wait-avg", "wait-max", "hold-avg",
+           "hold-max", "hold-total");
+  oss << buffer << std::endl;
+
+  for (const auto& site : sites) {
+    std::string location = site.mFile + ":" + std::to_string(site.mLine);
+    snprintf(buffer, sizeof(buffer),
+             "%-2s %-32s %10lu %8.01fus %8.01fus %8.01fus %8.01fus %10.03fs",
+             site.mWrite ? "w" : "r", location.c_str(),
+             (unsigned long) site.mSamples,
+             site.mWaitSum / 1000.0 / site.mSamples, site.mWaitMax / 1000.0,
+             site.mHoldSum / 1000.0 / site.mSamples, site.mHoldMax / 1000.0,
+             site.mHoldSum / 1e9);
+    oss << buffer << std::endl;
+
+    if (histograms) {
+      oss << "   wait:";
+      PrintHistogram(oss, site.mWaitHist, kNumBuckets);
+      oss << std::endl << "   hold:";
+      PrintHistogram(oss, site.mHoldHist, kNumBuckets);
+      oss << std::endl;
+    }
+  }
+
+  oss << line << std::endl;
+  return oss.str();
+}
+
+EOSCOMMONNAMESPACE_END
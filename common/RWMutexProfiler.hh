@@ -0,0 +1,159 @@
+//------------------------------------------------------------------------------
+// File: RWMutexProfiler.hh
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2019 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#pragma once
+#include "common/Namespace.hh"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+EOSCOMMONNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Class RWMutexProfiler - sampled lock contention profile of one RWMutex.
+//!
+//! The RWMutexReadLock/RWMutexWriteLock helpers capture the source location
+//! where they are created. For a sample of the lock acquisitions they measure
+//! how long the caller waited for the lock and for how long it held it, and
+//! add both to the histograms of that call site. The histograms have
+//! logarithmic buckets: bucket 0 counts durations below 1 microsecond and
+//! bucket i those in [2^(i-1), 2^i) microseconds, the last bucket takes all
+//! longer ones.
+//------------------------------------------------------------------------------
+class RWMutexProfiler
+{
+public:
+  static constexpr size_t kNumBuckets = 24;
+
+  //----------------------------------------------------------------------------
+  //! Profile of one call site
+  //----------------------------------------------------------------------------
+  struct CallSite {
+    CallSite(): mLine(0), mWrite(false), mSamples(0), mWaitSum(0),
+      mWaitMax(0), mHoldSum(0), mHoldMax(0), mWaitHist(), mHoldHist() {}
+
+    std::string mFile; ///< source file name without directories
+    int mLine; ///< source line
+    bool mWrite; ///< true for write locks
+    uint64_t mSamples; ///< number of sampled acquisitions
+    uint64_t mWaitSum, mWaitMax; ///< wait time in nanoseconds
+    uint64_t mHoldSum, mHoldMax; ///< hold time in nanoseconds
+    uint64_t mWaitHist[kNumBuckets]; ///< wait time histogram
+    uint64_t mHoldHist[kNumBuckets]; ///< hold time histogram
+  };
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //----------------------------------------------------------------------------
+  RWMutexProfiler(): mEnabled(false), mSamplingModulo(100) {}
+
+  //----------------------------------------------------------------------------
+  //! Enable/disable the profiling
+  //!
+  //! @param on enable if true, otherwise disable
+  //! @param modulo profile one in modulo lock acquisitions
+  //----------------------------------------------------------------------------
+  void Enable(bool on, uint32_t modulo = 100)
+  {
+    mSamplingModulo = (modulo ? modulo : 1);
+    mEnabled = on;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Check if the profiling is enabled
+  //----------------------------------------------------------------------------
+  bool IsEnabled() const
+  {
+    return mEnabled.load(std::memory_order_relaxed);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the sampling modulo
+  //----------------------------------------------------------------------------
+  uint32_t GetSamplingModulo() const
+  {
+    return mSamplingModulo;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Decide if the current lock acquisition is sampled, uses a per thread
+  //! countdown so that the decision does not touch any shared data
+  //----------------------------------------------------------------------------
+  bool ShouldSample() const;
+
+  //----------------------------------------------------------------------------
+  //! Add a sampled lock acquisition
+  //!
+  //! @param file source file of the call site
+  //! @param line source line of the call site
+  //! @param write true for a write lock
+  //! @param wait_ns time waited for the lock
+  //! @param hold_ns time the lock was held
+  //----------------------------------------------------------------------------
+  void Record(const char* file, int line, bool write, uint64_t wait_ns,
+              uint64_t hold_ns);
+
+  //----------------------------------------------------------------------------
+  //! Get the profiles of all call sites, sorted by decreasing total hold time
+  //----------------------------------------------------------------------------
+  std::vector<CallSite> GetCallSites() const;
+
+  //----------------------------------------------------------------------------
+  //! Drop all profiles
+  //----------------------------------------------------------------------------
+  void Reset();
+
+  //----------------------------------------------------------------------------
+  //! Print the profile
+  //!
+  //! @param name name of the mutex
+  //! @param max_sites maximum number of call sites to print, 0 for all
+  //! @param monitoring print in <key>=<value> monitoring format
+  //! @param histograms print the histograms of every call site
+  //!
+  //! @return profile report
+  //----------------------------------------------------------------------------
+  std::string PrintOut(const std::string& name, size_t max_sites,
+                       bool monitoring, bool histograms) const;
+
+  //----------------------------------------------------------------------------
+  //! Get the histogram bucket of the given duration
+  //!
+  //! @param ns duration in nanoseconds
+  //----------------------------------------------------------------------------
+  static size_t GetBucket(uint64_t ns);
+
+private:
+  //! Key of a call site - the file names are string literals
+  typedef std::tuple<const char*, int, bool> Key;
+
+  std::atomic<bool> mEnabled;
+  std::atomic<uint32_t> mSamplingModulo;
+  mutable std::mutex mMutex; ///< Mutex protecting the call sites
+  std::map<Key, CallSite> mSites;
+};
+
+EOSCOMMONNAMESPACE_END
@@ -25,15 +25,13 @@
 #define SHARDED_CACHE__HH__
 
 #include "common/AssistedThread.hh"
+#include "common/Murmur3.hh"
 
-#ifdef __APPLE__
 #include <cmath>
-#endif
-
 #include <memory>
 #include <vector>
 #include <mutex>
-#include <map>
+#include <unordered_map>
 
 using Milliseconds = int64_t;
 
@@ -47,6 +45,8 @@ using Milliseconds = int64_t;
 //    form of a shared pointer. No need to worry about locks or races after
 //    acquiring such a snapshot.
 // 3. Hashing: You can specify a custom hasing function to map from Key -> shard id.
+//    The hash is mixed before picking the shard from its top bits, so weak
+//    hashes like a plain pid still spread over all shards.
 // 4. Garbage collection: Thanks to shared pointers, we can keep track of how many
 //    references currently exist for each element in the cache by calling use_count.
 //
@@ -56,6 +56,11 @@ using Milliseconds = int64_t;
 //    - If this element is retrieved after that, we unset the mark.
 //    - If during the next pass the mark is still there, it means it hasn't been
 //      used for at least N seconds, so we evict it.
+// 5. Capacity: Optionally the number of elements is bounded. Every shard keeps
+//    its elements in a CLOCK ring: retrieving an element sets its reference
+//    bit, and when a shard is full the clock hand evicts the first element
+//    which was neither referenced since the hand last passed nor is in use
+//    by a client.
 
 template<typename Key>
 struct IdentityHash {
@@ -65,41 +70,98 @@ struct IdentityHash {
   }
 };
 
+// Cache counters, the memory is an estimate of the cache bookkeeping plus
+// sizeof(Value) per element, excluding memory owned by keys and values.
+struct ShardedCacheStatistics {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+  uint64_t expirations = 0;
+  uint64_t entries = 0;
+  uint64_t memory = 0;
+};
+
 template<typename Key, typename Value, typename Hash>
 class ShardedCache
 {
 private:
+  struct CacheEntry {
+    std::shared_ptr<Value> value;
+    bool marked;       // unused since the last garbage collector pass
+    bool referenced;   // retrieved since the clock hand last passed
+    size_t clockPos;   // position in the clock ring of the shard
+  };
+
+  static uint64_t mixHash(const Key& key) {
+    return Murmur3::MurmurHasher<uint64_t>()(Hash::hash(key));
+  }
+
+  struct KeyHasher {
+    size_t operator()(const Key& key) const {
+      return mixHash(key);
+    }
+  };
+
+  // The keys only need to provide operator<
+  struct KeyEqual {
+    bool operator()(const Key& a, const Key& b) const {
+      return !(a < b) && !(b < a);
+    }
+  };
+
+  typedef std::unordered_map<Key, CacheEntry, KeyHasher, KeyEqual> Map;
+  typedef typename Map::value_type Item;
+
+  struct Shard {
+    std::mutex mtx;
+    Map contents;
+    std::vector<Item*> clock; // elements never move in an unordered_map
+    size_t hand = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t expirations = 0;
+  };
+
   class ShardGuard
   {
   public:
     ShardGuard(ShardedCache *cache, const Key &key) {
-      shardId = cache->calculateShard(key);
-      mtx = &cache->mutexes[shardId];
-
-      mtx->lock();
+      shard = &cache->shards[cache->calculateShard(key)];
+      shard->mtx.lock();
     }
 
-    int64_t getShard() const
+    Shard& getShard() const
     {
-      return shardId;
+      return *shard;
     }
 
     ~ShardGuard() {
-      mtx->unlock();
+      shard->mtx.unlock();
     }
   private:
-    std::mutex *mtx;
-    int64_t shardId;
+    Shard *shard;
   };
 
-  int64_t calculateShard(const Key &key) {
-    return Hash::hash(key) >> shardBits;
+  // Take the top bits of the mixed hash
+  size_t calculateShard(const Key &key) {
+    if (shardBits == 0) {
+      return 0;
+    }
+
+    return mixHash(key) >> (64 - shardBits);
   }
 
 public:
   // TTL is approximate. An element can stay while unused from [ttl, 2*ttl]
-  ShardedCache(size_t shardBits_, Milliseconds ttl_)
-  : shardBits(shardBits_), shards(pow(2, shardBits)), ttl(ttl_), mutexes(shards), contents(shards) {
+  // A capacity of 0 means unbounded, otherwise every shard holds at most
+  // capacity / 2^shardBits elements (at least one).
+  ShardedCache(size_t shardBits_, Milliseconds ttl_, size_t capacity_ = 0)
+  : shardBits(std::min<size_t>(shardBits_, 63)), numShards(1ull << shardBits),
+    ttl(ttl_),
+    shardCapacity(capacity_ ? std::max<size_t>(1, (capacity_ + numShards - 1) /
+                                               numShards) : 0),
+    shards(numShards) {
     cleanupThread.reset(&ShardedCache<Key, Value, Hash>::garbageCollector, this);
   }
 
@@ -108,14 +170,17 @@ public:
   // Retrieves an item from the cache. If there isn't any, return a null shared_ptr.
   std::shared_ptr<Value> retrieve(const Key& key) {
     ShardGuard guard(this, key);
-    typename std::map<Key, CacheEntry>::iterator it = contents[guard.getShard()].find(key);
+    Shard& shard = guard.getShard();
+    typename Map::iterator it = shard.contents.find(key);
 
-    if (it == contents[guard.getShard()].end()) {
+    if (it == shard.contents.end()) {
+      shard.misses++;
       return std::shared_ptr<Value>();
     }
 
-    // if(it->first == 4) std::cerr << "erasing " << it->first << std::endl;
+    shard.hits++;
     it->second.marked = false;
+    it->second.referenced = true;
     return it->second.value;
   }
 
@@ -127,20 +192,34 @@ public:
   {
     CacheEntry entry;
     entry.marked = false;
+    entry.referenced = false;
+    entry.clockPos = 0;
     entry.value = std::move(value);
     ShardGuard guard(this, key);
+    Shard& shard = guard.getShard();
+    typename Map::iterator it = shard.contents.find(key);
+
+    if (it != shard.contents.end()) {
+      if (replace) {
+        it->second.value = entry.value;
+        it->second.marked = false;
+        it->second.referenced = true;
+      }
+
+      retval = it->second.value;
+      return replace;
+    }
+
+    it = shard.contents.emplace(key, entry).first;
+    it->second.clockPos = shard.clock.size();
+    shard.clock.push_back(&*it);
 
-    if (replace) {
-      contents[guard.getShard()][key] = entry;
-      retval = entry.value;
-      return true;
+    if (shardCapacity && (shard.contents.size() > shardCapacity)) {
+      evictOne(shard, &*it);
     }
 
-    std::pair<typename std::map<Key, CacheEntry>::iterator, bool> status;
-    status = contents[guard.getShard()].insert(std::pair<Key, CacheEntry>(key,
-             entry));
-    retval = status.first->second.value;
-    return status.second;
+    retval = entry.value;
+    return true;
   }
 
   // store overload without retval
@@ -164,38 +243,117 @@ public:
   // If you want to replace an entry, just call store with replace set to false.
   bool invalidate(const Key& key) {
     ShardGuard guard(this, key);
-    typename std::map<Key, CacheEntry>::iterator it = contents[guard.getShard()].find(key);
-    contents[guard.getShard()].erase(it);
+    Shard& shard = guard.getShard();
+    typename Map::iterator it = shard.contents.find(key);
+
+    if (it == shard.contents.end()) {
+      return false;
+    }
+
+    erase(shard, it);
     return true;
   }
 
+  // Get the sum of the counters of all shards
+  ShardedCacheStatistics getStatistics() {
+    ShardedCacheStatistics stats;
+
+    for (size_t i = 0; i < numShards; i++) {
+      std::lock_guard<std::mutex> lock(shards[i].mtx);
+      stats.hits += shards[i].hits;
+      stats.misses += shards[i].misses;
+      stats.evictions += shards[i].evictions;
+      stats.expirations += shards[i].expirations;
+      stats.entries += shards[i].contents.size();
+    }
+
+    // Hash node with its bucket pointer, clock slot and shared_ptr control
+    // block allocated together with the value
+    stats.memory = stats.entries * (sizeof(Item) + 2 * sizeof(void*) +
+                                    sizeof(Item*) + 2 * sizeof(long) +
+                                    sizeof(Value)) +
+                   numShards * sizeof(Shard);
+    return stats;
+  }
+
+  // Maximum number of elements, 0 if unbounded
+  size_t getCapacity() const {
+    return shardCapacity * numShards;
+  }
+
 private:
   size_t shardBits;
-  size_t shards;
+  size_t numShards;
   Milliseconds ttl;
+  size_t shardCapacity;
 
-  struct CacheEntry {
-    std::shared_ptr<Value> value;
-    bool marked;
-  };
-
-  std::vector<std::mutex> mutexes;
-  std::vector<std::map<Key, CacheEntry>> contents;
+  std::vector<Shard> shards;
 
   AssistedThread cleanupThread;
 
+  // Remove an element, the last element of the clock ring takes its slot.
+  // Must be called with the shard locked.
+  void erase(Shard& shard, typename Map::iterator it) {
+    size_t pos = it->second.clockPos;
+    Item* last = shard.clock.back();
+    shard.clock[pos] = last;
+    last->second.clockPos = pos;
+    shard.clock.pop_back();
+
+    if (shard.hand >= shard.clock.size()) {
+      shard.hand = 0;
+    }
+
+    shard.contents.erase(it);
+  }
+
+  // Advance the clock hand until an element can be evicted, never evicting
+  // the protected one. After two full rounds elements which are in use by
+  // clients are evicted too, they stay alive as long as they are referenced.
+  // Must be called with the shard locked.
+  void evictOne(Shard& shard, Item* protect) {
+    size_t limit = 2 * shard.clock.size();
+
+    for (size_t step = 0; ; step++) {
+      if (shard.hand >= shard.clock.size()) {
+        shard.hand = 0;
+      }
+
+      Item* item = shard.clock[shard.hand];
+
+      if (item != protect) {
+        CacheEntry& entry = item->second;
+
+        if ((step >= limit) ||
+            (!entry.referenced && (entry.value.use_count() <= 1))) {
+          erase(shard, shard.contents.find(item->first));
+          shard.evictions++;
+          return;
+        }
+
+        entry.referenced = false;
+      }
+
+      shard.hand++;
+    }
+  }
+
   // Sweep through all entries in all shards to either mark them as unused or
   // remove them
   void collectorPass() {
-    for(size_t i = 0; i < shards; i++) {
-      std::lock_guard<std::mutex> lock(mutexes[i]);
+    for(size_t i = 0; i < numShards; i++) {
+      std::lock_guard<std::mutex> lock(shards[i].mtx);
+      Map& contents = shards[i].contents;
 
-      typename std::map<Key, CacheEntry>::iterator iterator;
+      typename Map::iterator iterator;
 
-      for (iterator = contents[i].begin();
-           iterator != contents[i].end(); /* no increment */) {
+      for (iterator = contents.begin();
+           iterator != contents.end(); /* no increment */) {
         if (iterator->second.marked) {
-          iterator = contents[i].erase(iterator);
+          typename Map::iterator next = std::next(iterator);
+          erase(shards[i], iterator);
+          shards[i].expirations++;
+          iterator = next;
           continue;
         }
 
@@ -0,0 +1,300 @@
+//------------------------------------------------------------------------------
+// File: StripedRWMutex.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2019 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "common/StripedRWMutex.hh"
+#include <errno.h>
+#include <thread>
+
+EOSCOMMONNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Striped mutex read locked by the current thread
+//------------------------------------------------------------------------------
+struct HeldReadLock {
+  const StripedRWMutex* mMutex;
+  uint32_t mDepth;
+};
+
+static constexpr uint32_t sMaxHeldReadLocks = 8;
+static std::atomic<uint32_t> sNextThreadIndex {0};
+static thread_local uint32_t tThreadIndex = UINT32_MAX;
+static thread_local HeldReadLock tHeld[sMaxHeldReadLocks];
+static thread_local uint32_t tNumHeld = 0;
+
+//------------------------------------------------------------------------------
+// Get the index of the current thread - threads are spread round robin over
+// the stripes and always use the same one
+//------------------------------------------------------------------------------
+static inline uint32_t
+GetThreadIndex()
+{
+  if (tThreadIndex == UINT32_MAX) {
+    tThreadIndex = sNextThreadIndex++ & (UINT32_MAX >> 1);
+  }
+
+  return tThreadIndex;
+}
+
+//------------------------------------------------------------------------------
+// Find the read lock of the current thread on the given mutex
+//------------------------------------------------------------------------------
+static inline HeldReadLock*
+FindHeld(const StripedRWMutex* mutex)
+{
+  for (uint32_t i = 0; i < tNumHeld; ++i) {
+    if (tHeld[i].mMutex == mutex) {
+      return &tHeld[i];
+    }
+  }
+
+  return nullptr;
+}
+
+//------------------------------------------------------------------------------
+// Constructor
+//------------------------------------------------------------------------------
+StripedRWMutex::StripedRWMutex():
+  mNumStripes(1), mWriter(false), mWaitingReaders(0)
+{
+  // Twice as many stripes as cores, but not more than 256 cache lines
+  size_t wanted = 2 * std::max(1u, std::thread::hardware_concurrency());
+
+  while ((mNumStripes < wanted) && (mNumStripes < 256)) {
+    mNumStripes <<= 1;
+  }
+
+  mStripes.reset(new Stripe[mNumStripes]);
+}
+
+//------------------------------------------------------------------------------
+// Lock for read
+//------------------------------------------------------------------------------
+int
+StripedRWMutex::LockRead()
+{
+  return DoLockRead(false, std::chrono::steady_clock::time_point());
+}
+
+//------------------------------------------------------------------------------
+// Try to read lock the mutex within the timeout
+//------------------------------------------------------------------------------
+int
+StripedRWMutex::TimedRdLock(uint64_t timeout_ns)
+{
+  return DoLockRead(true, std::chrono::steady_clock::now() +
+                    std::chrono::nanoseconds(timeout_ns));
+}
+
+//------------------------------------------------------------------------------
+// Unlock a read lock
+//------------------------------------------------------------------------------
+int
+StripedRWMutex::UnLockRead()
+{
+  HeldReadLock* held = FindHeld(this);
+
+  if (held) {
+    if (--held->mDepth) {
+      return 0;
+    }
+
+    // Replace the entry by the last one
+    *held = tHeld[--tNumHeld];
+  }
+
+  mStripes[GetThreadIndex() & (mNumStripes - 1)].mReaders.fetch_sub(1);
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+// Lock for write
+//------------------------------------------------------------------------------
+int
+StripedRWMutex::LockWrite()
+{
+  return DoLockWrite(false, std::chrono::steady_clock::time_point());
+}
+
+//------------------------------------------------------------------------------
+// Try to write lock the mutex within the timeout
+//------------------------------------------------------------------------------
+int
+StripedRWMutex::TimedWrLock(uint64_t timeout_ns)
+{
+  return DoLockWrite(true, std::chrono::steady_clock::now() +
+                     std::chrono::nanoseconds(timeout_ns));
+}
+
+//------------------------------------------------------------------------------
+// Unlock a write lock
+//------------------------------------------------------------------------------
+int
+StripedRWMutex::UnLockWrite()
+{
+  ReleaseWriter();
+  mWriterMutex.unlock();
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+// Read lock, waiting at most until the deadline if timed
+//------------------------------------------------------------------------------
+int
+StripedRWMutex::DoLockRead(bool timed,
+                           std::chrono::steady_clock::time_point deadline)
+{
+  // Re-entrant read lock, the writer waits for us anyway
+  HeldReadLock* held = FindHeld(this);
+
+  if (held) {
+    ++held->mDepth;
+    return 0;
+  }
+
+  Stripe& stripe = mStripes[GetThreadIndex() & (mNumStripes - 1)];
+
+  while (true) {
+    // Both operations are sequentially consistent: either the writer sees
+    // our counter or we see its flag
+    stripe.mReaders.fetch_add(1);
+
+    if (!mWriter.load()) {
+      break;
+    }
+
+    stripe.mReaders.fetch_sub(1);
+
+    // Writers usually hold the lock briefly - spin a bit before blocking
+    for (int spin = 0; (spin < 64) && mWriter.load(); ++spin) {
+      std::this_thread::yield();
+    }
+
+    if (!mWriter.load()) {
+      continue;
+    }
+
+    ++mWaitingReaders;
+    std::unique_lock<std::mutex> lock(mWaitMutex);
+    bool acquired = true;
+
+    if (timed) {
+      acquired = mWaitCond.wait_until(lock, deadline, [&]() {
+        return !mWriter.load();
+      });
+    } else {
+      mWaitCond.wait(lock, [&]() {
+        return !mWriter.load();
+      });
+    }
+
+    --mWaitingReaders;
+
+    if (!acquired) {
+      return ETIMEDOUT;
+    }
+  }
+
+  // Without a free slot the lock is simply not tracked, it is then not
+  // re-entrant while a writer waits
+  if (tNumHeld < sMaxHeldReadLocks) {
+    tHeld[tNumHeld].mMutex = this;
+    tHeld[tNumHeld].mDepth = 1;
+    ++tNumHeld;
+  }
+
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+// Write lock, waiting at most until the deadline if timed
+//------------------------------------------------------------------------------
+int
+StripedRWMutex::DoLockWrite(bool timed,
+                            std::chrono::steady_clock::time_point deadline)
+{
+  if (timed) {
+    for (int spin = 0; !mWriterMutex.try_lock(); ++spin) {
+      if (std::chrono::steady_clock::now() >= deadline) {
+        return ETIMEDOUT;
+      }
+
+      if (spin < 64) {
+        std::this_thread::yield();
+      } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(20));
+      }
+    }
+  } else {
+    mWriterMutex.lock();
+  }
+
+  // Stop new readers and wait for the current ones to leave
+  mWriter.store(true);
+
+  for (int spin = 0; !NoReaders(); ++spin) {
+    if (timed && (std::chrono::steady_clock::now() >= deadline)) {
+      ReleaseWriter();
+      mWriterMutex.unlock();
+      return ETIMEDOUT;
+    }
+
+    if (spin < 64) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(20));
+    }
+  }
+
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+// Check if there are no readers in any of the stripes
+//------------------------------------------------------------------------------
+bool
+StripedRWMutex::NoReaders() const
+{
+  // A thread always uses the same stripe so no counter goes below zero
+  for (size_t i = 0; i < mNumStripes; ++i) {
+    if (mStripes[i].mReaders.load()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Clear the writer flag and wake up the waiting readers
+//------------------------------------------------------------------------------
+void
+StripedRWMutex::ReleaseWriter()
+{
+  mWriter.store(false);
+
+  if (mWaitingReaders.load()) {
+    std::lock_guard<std::mutex> lock(mWaitMutex);
+    mWaitCond.notify_all();
+  }
+}
+
+EOSCOMMONNAMESPACE_END
@@ -0,0 +1,176 @@
+//------------------------------------------------------------------------------
+// File: StripedRWMutex.hh
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2019 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#pragma once
+#include "common/Namespace.hh"
+#include "common/IRWMutex.hh"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+EOSCOMMONNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Class StripedRWMutex - read-write mutex whose read lock scales with the
+//! number of cores.
+//!
+//! Every reader thread only increments the counter of its own stripe, each
+//! stripe living in its own cache line, so readers on different cores do not
+//! bounce a shared cache line. A writer raises the writer flag, which makes
+//! new readers step back, and waits until the counters of all stripes drop
+//! to zero. Writers are serialized by a separate mutex and get preference
+//! over new readers, but a thread already holding the read lock may always
+//! take it again, so re-entrant read locks do not deadlock against a pending
+//! writer. Read and write locks must be released by the thread which took
+//! them.
+//------------------------------------------------------------------------------
+class StripedRWMutex: public IRWMutex
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Constructor
+  // ---------------------------------------------------------------------------
+  StripedRWMutex();
+
+  //----------------------------------------------------------------------------
+  //! Destructor
+  //----------------------------------------------------------------------------
+  ~StripedRWMutex() = default;
+
+  //----------------------------------------------------------------------------
+  //! Move constructor
+  //----------------------------------------------------------------------------
+  StripedRWMutex(StripedRWMutex&& other) = delete;
+
+  //----------------------------------------------------------------------------
+  //! Move assignment operator
+  //----------------------------------------------------------------------------
+  StripedRWMutex& operator=(StripedRWMutex&& other) = delete;
+
+  //----------------------------------------------------------------------------
+  //! Copy constructor
+  //----------------------------------------------------------------------------
+  StripedRWMutex(const StripedRWMutex&) = delete;
+
+  //----------------------------------------------------------------------------
+  //! Copy assignment operator
+  //----------------------------------------------------------------------------
+  StripedRWMutex& operator=(const StripedRWMutex&) = delete;
+
+  //----------------------------------------------------------------------------
+  //! Lock for read
+  //----------------------------------------------------------------------------
+  int LockRead() override;
+
+  //----------------------------------------------------------------------------
+  //! Unlock a read lock
+  //----------------------------------------------------------------------------
+  int UnLockRead() override;
+
+  //----------------------------------------------------------------------------
+  //! Try to read lock the mutex within the timeout
+  //!
+  //! @param timeout_ns nano seconds timeout
+  //!
+  //! @return 0 if successful, otherwise error number
+  //----------------------------------------------------------------------------
+  int TimedRdLock(uint64_t timeout_ns) override;
+
+  //----------------------------------------------------------------------------
+  //! Lock for write
+  //----------------------------------------------------------------------------
+  int LockWrite() override;
+
+  //----------------------------------------------------------------------------
+  //! Unlock a write lock
+  //----------------------------------------------------------------------------
+  int UnLockWrite() override;
+
+  //----------------------------------------------------------------------------
+  //! Try to write lock the mutex within the timeout
+  //!
+  //! @param timeout_ns nano seconds timeout
+  //!
+  //! @return 0 if successful, otherwise error number
+  //----------------------------------------------------------------------------
+  int TimedWrLock(uint64_t timeout_ns) override;
+
+  //----------------------------------------------------------------------------
+  //! Get the number of stripes
+  //----------------------------------------------------------------------------
+  size_t GetNumStripes() const
+  {
+    return mNumStripes;
+  }
+
+private:
+  //----------------------------------------------------------------------------
+  //! Reader counter of one stripe, padded to a cache line so that no two
+  //! counters share one
+  //----------------------------------------------------------------------------
+  struct Stripe {
+    std::atomic<int64_t> mReaders {0};
+    char mPad[64 - sizeof(std::atomic<int64_t>)];
+  };
+
+  //----------------------------------------------------------------------------
+  //! Read lock, waiting at most until the deadline if one is given
+  //!
+  //! @param timed if true give up at the deadline, otherwise wait forever
+  //! @param deadline deadline of a timed lock
+  //!
+  //! @return 0 if successful, otherwise ETIMEDOUT
+  //----------------------------------------------------------------------------
+  int DoLockRead(bool timed, std::chrono::steady_clock::time_point deadline);
+
+  //----------------------------------------------------------------------------
+  //! Write lock, waiting at most until the deadline if one is given
+  //!
+  //! @param timed if true give up at the deadline, otherwise wait forever
+  //! @param deadline deadline of a timed lock
+  //!
+  //! @return 0 if successful, otherwise ETIMEDOUT
+  //----------------------------------------------------------------------------
+  int DoLockWrite(bool timed, std::chrono::steady_clock::time_point deadline);
+
+  //----------------------------------------------------------------------------
+  //! Check if there are no readers in any of the stripes
+  //----------------------------------------------------------------------------
+  bool NoReaders() const;
+
+  //----------------------------------------------------------------------------
+  //! Clear the writer flag and wake up the waiting readers
+  //----------------------------------------------------------------------------
+  void ReleaseWriter();
+
+  size_t mNumStripes; ///< number of stripes, a power of two
+  std::unique_ptr<Stripe[]> mStripes; ///< reader counters
+  std::atomic<bool> mWriter; ///< a writer holds or waits for the lock
+  std::atomic<uint64_t> mWaitingReaders; ///< readers blocked by a writer
+  std::mutex mWriterMutex; ///< mutex serializing the writers
+  std::mutex mWaitMutex; ///< mutex used by the blocked readers
+  std::condition_variable mWaitCond; ///< blocked readers wait here
+};
+
+EOSCOMMONNAMESPACE_END
@@ -23,22 +23,85 @@
 
 #pragma once
 #include "common/Namespace.hh"
-#include "common/ConcurrentQueue.hh"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <future>
+#include <memory>
+#include <mutex>
 #include <sstream>
-
-#ifdef __APPLE__
-#include <cmath>
-#endif
+#include <thread>
+#include <vector>
 
 EOSCOMMONNAMESPACE_BEGIN
 
 //------------------------------------------------------------------------------------
 //! @brief Dynamically scaling pool of threads which will asynchronously execute tasks
+//!
+//! Tasks have a priority, workers always pick high priority tasks first and
+//! low priority tasks only when there is nothing else to do.
+//!
+//! In work stealing mode every worker has its own deque: normal priority
+//! tasks pushed from a worker of the pool go to the back of its own deque and
+//! are popped LIFO by the owner, tasks pushed from outside go to the shared
+//! queue from which an idle worker grabs a batch at once. Workers running out
+//! of own tasks steal from the front of the deque of a random victim before
+//! going back to the shared queue. This avoids that bursts of tiny tasks
+//! serialize on the lock of the shared queue.
 //------------------------------------------------------------------------------------
 class ThreadPool
 {
 public:
+  //! Task priorities
+  enum class Priority { High = 0, Normal = 1, Low = 2 };
+  static constexpr size_t kNumPriorities = 3;
+  //! Number of log2 microsecond buckets of the task latency histogram
+  static constexpr size_t kNumLatencyBuckets = 24;
+
+  //----------------------------------------------------------------------------
+  //! Snapshot of the pool metrics, the latency is the time a task waited in
+  //! the queue before starting, in microseconds
+  //----------------------------------------------------------------------------
+  struct Metrics {
+    uint64_t mQueued;
+    uint64_t mThreads;
+    uint64_t mExecuted;
+    uint64_t mStolen;
+    uint64_t mLatencySum;
+    uint64_t mLatencyMax;
+    uint64_t mLatencyHist[kNumLatencyBuckets];
+
+    //--------------------------------------------------------------------------
+    //! Get the given latency percentile as the upper bound of its histogram
+    //! bucket
+    //--------------------------------------------------------------------------
+    uint64_t GetLatencyPercentile(double percentile) const
+    {
+      uint64_t total = 0;
+
+      for (size_t i = 0; i < kNumLatencyBuckets; ++i) {
+        total += mLatencyHist[i];
+      }
+
+      uint64_t threshold = (uint64_t)(total * percentile / 100.0);
+      uint64_t sum = 0;
+
+      for (size_t i = 0; i < kNumLatencyBuckets; ++i) {
+        sum += mLatencyHist[i];
+
+        if (total && (sum >= threshold)) {
+          return (1ull << i);
+        }
+      }
+
+      return 0;
+    }
+  };
+
   //----------------------------------------------------------------------------------
   //! @brief Create a new thread pool
   //!
@@ -50,12 +113,14 @@ public:
   //!        required for dynamic scaling, defaults to 10 seconds
   //! @param samplingNumber number of samples to collect before making a scaling
   //!        decision, scaling decision will be made after samplingInterval *
-  //!        samplingNumber seconds
+  //!        samplingNumber seconds. A burst of waiting jobs which already
+  //!        justifies new threads is handled at the next sample.
   //! @param averageWaitingJobsPerNewThread the average number of waiting jobs per which
   //!        one new thread should be started, defaults to 10,
   //!        e.g. if in average 27.8 jobs were waiting for execution, then 2 new
   //!        threads will be added to the pool
   //! @param name identifier for the thread pool
+  //! @param workStealing use per worker deques and work stealing
   //----------------------------------------------------------------------------------
   explicit ThreadPool(unsigned int threadsMin =
                         std::thread::hardware_concurrency(),
@@ -63,36 +128,27 @@ public:
                       unsigned int samplingInterval = 10,
                       unsigned int samplingNumber = 12,
                       unsigned int averageWaitingJobsPerNewThread = 10,
-                      const std::string& identifier = "default"):
-    mId(identifier)
+                      const std::string& identifier = "default",
+                      bool workStealing = false):
+    mId(identifier), mWorkStealing(workStealing)
   {
+    threadsMin = std::max(threadsMin, 1u);
     threadsMax = threadsMin > threadsMax ? threadsMin : threadsMax;
-    auto threadPoolFunc = [this] {
-      std::pair<bool, std::shared_ptr<std::function<void(void)>>> task;
-      bool toContinue = true;
 
-      do {
-        mTasks.wait_pop(task);
-        toContinue = task.first;
-
-        // Termination is signalled by false
-        if (toContinue)
-        {
-          (*(task.second))();
-        }
-      } while (toContinue);
-    };
+    for (auto i = 0u; i < threadsMax; i++) {
+      mWorkers.emplace_back(new Worker());
+    }
 
-    for (auto i = 0u; i < std::max(threadsMin, 1u); i++) {
+    for (auto i = 0u; i < threadsMin; i++) {
       mThreadPool.emplace_back(
-        std::async(std::launch::async, threadPoolFunc)
+        std::async(std::launch::async, &ThreadPool::WorkerLoop, this)
       );
     }
 
     mThreadCount += threadsMin;
 
     if (threadsMax > threadsMin) {
-      auto maintainerThreadFunc = [this, threadPoolFunc, threadsMin, threadsMax,
+      auto maintainerThreadFunc = [this, threadsMin, threadsMax,
       samplingInterval, samplingNumber, averageWaitingJobsPerNewThread] {
         auto rounds = 0u, sumQueueSize = 0u;
         auto signalFuture = mMaintainerSignal.get_future();
@@ -119,20 +175,34 @@ public:
             ),
           mThreadPool.end()
           );
-          sumQueueSize += mTasks.size();
+          unsigned int queueSize = GetQueueSize();
+          sumQueueSize += queueSize;
+          ++rounds;
+          // Don't wait for the full sampling period to react to a burst
+          bool burst = (queueSize >= averageWaitingJobsPerNewThread *
+                        std::max(mThreadCount.load(), 1u)) &&
+                       (mThreadCount < threadsMax);
 
-          if (++rounds == samplingNumber) {
-            auto averageQueueSize = (double) sumQueueSize / rounds;
+          if (burst || (rounds == samplingNumber)) {
+            auto averageQueueSize = burst ? (double) queueSize :
+                                    (double) sumQueueSize / rounds;
 
             if (averageQueueSize > mThreadCount) {
               auto threadsToAdd =
                 std::min((unsigned int) floor(averageQueueSize /
                                               averageWaitingJobsPerNewThread),
                          threadsMax - mThreadCount);
+              // Withdraw stop requests not yet taken by any thread before
+              // starting new threads
+              auto toAdd = threadsToAdd;
+
+              while (toAdd && ConsumeStopRequest()) {
+                --toAdd;
+              }
 
-              for (auto i = 0u; i < threadsToAdd; i++) {
+              for (auto i = 0u; i < toAdd; i++) {
                 mThreadPool.emplace_back(
-                  std::async(std::launch::async, threadPoolFunc)
+                  std::async(std::launch::async, &ThreadPool::WorkerLoop, this)
                 );
               }
 
@@ -141,12 +211,12 @@ public:
               unsigned int threadsToRemove =
                 mThreadCount - std::max((unsigned int) floor(averageQueueSize), threadsMin);
 
-              // Push in fake tasks for each threads to be stopped so threads can wake up and
-              // notice that they should terminate. Termination is signalled with false.
-              for (auto i = 0u; i < threadsToRemove; i++) {
-                auto fakeTask = std::make_pair(false,
-                                               std::make_shared<std::function<void(void)>>([] {}));
-                mTasks.push(fakeTask);
+              // Ask the threads to be stopped to terminate once they are done
+              // with their current task
+              if (threadsToRemove) {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mStopRequests += threadsToRemove;
+                mCond.notify_all();
               }
 
               mThreadCount -= threadsToRemove;
@@ -168,28 +238,25 @@ public:
   //!
   //! @param Ret return type of the task
   //! @param func the function for the task to execute
+  //! @param priority priority of the task
   //!
   //! @return future of the return type to communicate with your task
   //----------------------------------------------------------------------------
   template<typename Ret>
-  std::future<Ret> PushTask(std::function<Ret(void)> func)
+  std::future<Ret> PushTask(std::function<Ret(void)> func,
+                            Priority priority = Priority::Normal)
   {
     auto task = std::make_shared<std::packaged_task<Ret(void)>>(func);
-    auto taskFunc = std::make_pair(
-                      true,
-                      std::make_shared<std::function<void(void)>>(
-    [task] {
+    auto future = task->get_future();
+    Submit([task] {
       (*task)();
-    }
-                      )
-                    );
-    mTasks.push(taskFunc);
-    return task->get_future();
+    }, priority);
+    return future;
   }
 
   //----------------------------------------------------------------------------
-  //! @brief Stop the thread pool. All threads will be stopped and the pool
-  //! cannot be used again.
+  //! @brief Stop the thread pool. All threads will be stopped once the
+  //! queued tasks are done and the pool cannot be used again.
   //----------------------------------------------------------------------------
   void Stop()
   {
@@ -198,12 +265,10 @@ public:
       mMaintainerThread->join();
     }
 
-    // Push in fake tasks for each threads so all waiting can wake up and
-    // notice that running is over. Termination is signalled with false.
-    for (auto i = 0u; i < mThreadPool.size(); i++) {
-      auto fakeTask = std::make_pair(false,
-                                     std::make_shared<std::function<void(void)>>([] {}));
-      mTasks.push(fakeTask);
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mShutdown = true;
+      mCond.notify_all();
     }
 
     for (auto& future : mThreadPool) {
@@ -212,7 +277,12 @@ public:
       }
     }
 
-    mTasks.clear();
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (auto& queue : mQueues) {
+      queue.clear();
+    }
+
     mThreadPool.clear();
   }
 
@@ -224,14 +294,80 @@ public:
     Stop();
   }
 
+  //----------------------------------------------------------------------------
+  //! Get the number of queued tasks
+  //----------------------------------------------------------------------------
+  unsigned int GetQueueSize() const
+  {
+    int64_t pending = mPending.load();
+    return (pending > 0 ? (unsigned int) pending : 0u);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get a snapshot of the pool metrics
+  //----------------------------------------------------------------------------
+  Metrics GetMetrics() const
+  {
+    Metrics metrics;
+    metrics.mQueued = GetQueueSize();
+    metrics.mThreads = mThreadCount;
+    metrics.mExecuted = mExecuted.load(std::memory_order_relaxed);
+    metrics.mStolen = mStolen.load(std::memory_order_relaxed);
+    metrics.mLatencySum = mLatencySum.load(std::memory_order_relaxed);
+    metrics.mLatencyMax = mLatencyMax.load(std::memory_order_relaxed);
+
+    for (size_t i = 0; i < kNumLatencyBuckets; ++i) {
+      metrics.mLatencyHist[i] = mLatencyHist[i].load(std::memory_order_relaxed);
+    }
+
+    return metrics;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Print the pool metrics
+  //!
+  //! @param monitoring print in <key>=<value> monitoring format
+  //----------------------------------------------------------------------------
+  std::string PrintMetrics(bool monitoring) const
+  {
+    Metrics metrics = GetMetrics();
+    uint64_t avg = (metrics.mExecuted ? metrics.mLatencySum / metrics.mExecuted :
+                    0);
+    std::ostringstream oss;
+
+    if (monitoring) {
+      std::string key = "uid=all gid=all threadpool." + mId;
+      oss << key << ".queued=" << metrics.mQueued << std::endl
+          << key << ".threads=" << metrics.mThreads << std::endl
+          << key << ".executed=" << metrics.mExecuted << std::endl
+          << key << ".stolen=" << metrics.mStolen << std::endl
+          << key << ".latency.avg=" << avg << std::endl
+          << key << ".latency.p99=" << metrics.GetLatencyPercentile(99)
+          << std::endl
+          << key << ".latency.max=" << metrics.mLatencyMax << std::endl;
+    } else {
+      char line[256];
+      snprintf(line, sizeof(line), "ALL      Thread pool %-20s queued=%lu "
+               "threads=%lu executed=%lu stolen=%lu latency avg=%luus "
+               "p99<%luus max=%luus", mId.c_str(), metrics.mQueued,
+               metrics.mThreads, metrics.mExecuted, metrics.mStolen, avg,
+               metrics.GetLatencyPercentile(99), metrics.mLatencyMax);
+      oss << line << std::endl;
+    }
+
+    return oss.str();
+  }
+
   //----------------------------------------------------------------------------
   //! Get thread pool information
   //----------------------------------------------------------------------------
   std::string GetInfo()
   {
     std::ostringstream oss;
-    oss <<  "id=" << mId << ", queue_size=" << mTasks.size()
-        << ",thread_pool_size=" << mThreadPool.size();
+    oss <<  "id=" << mId << ", queue_size=" << GetQueueSize()
+        << ",thread_pool_size=" << mThreadCount
+        << ",work_stealing=" << mWorkStealing
+        << ",executed=" << mExecuted.load() << ",stolen=" << mStolen.load();
     return oss.str();
   }
 
@@ -242,13 +378,380 @@ public:
   ThreadPool& operator=(ThreadPool&&) = delete;
 
 private:
+  //! Maximum number of tasks grabbed at once from the shared queue
+  static constexpr size_t kGrabBatch = 32;
+
+  //----------------------------------------------------------------------------
+  //! Queued task
+  //----------------------------------------------------------------------------
+  struct Task {
+    std::function<void(void)> mFunc;
+    std::chrono::steady_clock::time_point mQueued;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Per worker deque, the owner pops from the back, thieves from the front
+  //----------------------------------------------------------------------------
+  struct Worker {
+    std::mutex mMutex;
+    std::deque<Task> mDeque;
+    std::atomic<size_t> mSize {0};
+    bool mUsed {false}; ///< Slot taken by a thread, protected by mMutex
+  };
+
+  //----------------------------------------------------------------------------
+  //! Pool and worker slot of the current thread
+  //----------------------------------------------------------------------------
+  struct CurrentWorker {
+    ThreadPool* mPool;
+    Worker* mWorker;
+    uint64_t mRandom;
+  };
+
+  static CurrentWorker& GetCurrentWorker()
+  {
+    static thread_local CurrentWorker current {nullptr, nullptr, 0};
+    return current;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Queue a task
+  //----------------------------------------------------------------------------
+  void Submit(std::function<void(void)>&& func, Priority priority)
+  {
+    Task task {std::move(func), std::chrono::steady_clock::now()};
+    CurrentWorker& current = GetCurrentWorker();
+    // Account the task before it becomes visible so that the counter never
+    // goes negative
+    mPending.fetch_add(1);
+
+    if (mWorkStealing && (priority == Priority::Normal) &&
+        (current.mPool == this)) {
+      {
+        std::lock_guard<std::mutex> lock(current.mWorker->mMutex);
+        current.mWorker->mDeque.push_back(std::move(task));
+        current.mWorker->mSize.fetch_add(1);
+      }
+
+      // Pairs with the idle registration in WaitForTask
+      if (mIdle.load()) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCond.notify_one();
+      }
+
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mQueues[(size_t) priority].push_back(std::move(task));
+    mQueueSize[(size_t) priority].fetch_add(1);
+
+    if (mIdle.load()) {
+      mCond.notify_one();
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Main loop of a worker thread
+  //----------------------------------------------------------------------------
+  void WorkerLoop()
+  {
+    Worker* self = AcquireSlot();
+    CurrentWorker& current = GetCurrentWorker();
+    current.mPool = this;
+    current.mWorker = self;
+    current.mRandom = std::hash<std::thread::id>()(std::this_thread::get_id()) |
+                      1;
+    Task task;
+
+    while (WaitForTask(self, task)) {
+      RunTask(task);
+      task.mFunc = nullptr;
+    }
+
+    ReleaseSlot(self);
+    current.mPool = nullptr;
+    current.mWorker = nullptr;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the next task, blocking while there is none
+  //!
+  //! @return false if the thread should terminate
+  //----------------------------------------------------------------------------
+  bool WaitForTask(Worker* self, Task& task)
+  {
+    while (true) {
+      if (ConsumeStopRequest()) {
+        return false;
+      }
+
+      if (FindTask(self, task)) {
+        return true;
+      }
+
+      std::unique_lock<std::mutex> lock(mMutex);
+      mIdle.fetch_add(1);
+
+      while ((mPending.load() <= 0) && !mStopRequests && !mShutdown) {
+        mCond.wait(lock);
+      }
+
+      mIdle.fetch_sub(1);
+
+      if (mShutdown && (mPending.load() <= 0)) {
+        return false;
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Find a task in priority order: shared high priority queue, own deque,
+  //! other deques, shared normal priority queue, shared low priority queue.
+  //! Stealing comes before the shared queue so that tasks grabbed by a worker
+  //! busy with a long task are not parked behind it while peers are idle.
+  //----------------------------------------------------------------------------
+  bool FindTask(Worker* self, Task& task)
+  {
+    if (PopShared(Priority::High, self, task)) {
+      return true;
+    }
+
+    if (mWorkStealing && PopLocal(self, task)) {
+      return true;
+    }
+
+    if (mWorkStealing && Steal(self, task)) {
+      return true;
+    }
+
+    if (PopShared(Priority::Normal, self, task)) {
+      return true;
+    }
+
+    return PopShared(Priority::Low, self, task);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Pop from the shared queue of the given priority. In work stealing mode a
+  //! batch of normal priority tasks is moved to the own deque at once.
+  //----------------------------------------------------------------------------
+  bool PopShared(Priority priority, Worker* self, Task& task)
+  {
+    size_t prio = (size_t) priority;
+
+    if (mQueueSize[prio].load() == 0) {
+      return false;
+    }
+
+    std::vector<Task> batch;
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      auto& queue = mQueues[prio];
+
+      if (queue.empty()) {
+        return false;
+      }
+
+      size_t num = 1;
+
+      if (mWorkStealing && (priority == Priority::Normal)) {
+        num = std::min((size_t) kGrabBatch, 1 + queue.size() /
+                       std::max(mThreadCount.load(), 1u));
+      }
+
+      task = std::move(queue.front());
+      queue.pop_front();
+
+      for (size_t i = 1; i < num; ++i) {
+        batch.push_back(std::move(queue.front()));
+        queue.pop_front();
+      }
+
+      mQueueSize[prio].fetch_sub(num);
+    }
+    mPending.fetch_sub(1);
+
+    if (!batch.empty()) {
+      // The oldest task goes to the back which is popped first
+      std::lock_guard<std::mutex> lock(self->mMutex);
+
+      for (auto it = batch.rbegin(); it != batch.rend(); ++it) {
+        self->mDeque.push_back(std::move(*it));
+      }
+
+      self->mSize.fetch_add(batch.size());
+    }
+
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Pop from the back of the own deque
+  //----------------------------------------------------------------------------
+  bool PopLocal(Worker* self, Task& task)
+  {
+    if (self->mSize.load() == 0) {
+      return false;
+    }
+
+    std::lock_guard<std::mutex> lock(self->mMutex);
+
+    if (self->mDeque.empty()) {
+      return false;
+    }
+
+    task = std::move(self->mDeque.back());
+    self->mDeque.pop_back();
+    self->mSize.fetch_sub(1);
+    mPending.fetch_sub(1);
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Steal from the front of the deque of a random victim
+  //----------------------------------------------------------------------------
+  bool Steal(Worker* self, Task& task)
+  {
+    // xorshift, only used to spread the thieves
+    uint64_t& rnd = GetCurrentWorker().mRandom;
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 7;
+    rnd ^= rnd << 17;
+    size_t num = mWorkers.size();
+    size_t start = rnd % num;
+
+    for (size_t i = 0; i < num; ++i) {
+      Worker* victim = mWorkers[(start + i) % num].get();
+
+      if ((victim == self) || (victim->mSize.load() == 0)) {
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(victim->mMutex, std::try_to_lock);
+
+      if (!lock.owns_lock() || victim->mDeque.empty()) {
+        continue;
+      }
+
+      task = std::move(victim->mDeque.front());
+      victim->mDeque.pop_front();
+      victim->mSize.fetch_sub(1);
+      mPending.fetch_sub(1);
+      mStolen.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+
+    return false;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Run a task and account its latency
+  //----------------------------------------------------------------------------
+  void RunTask(Task& task)
+  {
+    uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>
+                       (std::chrono::steady_clock::now() - task.mQueued).count();
+    size_t bucket = 0;
+
+    for (uint64_t us = latency; us && (bucket < kNumLatencyBuckets - 1);
+         us >>= 1) {
+      ++bucket;
+    }
+
+    mLatencyHist[bucket].fetch_add(1, std::memory_order_relaxed);
+    mLatencySum.fetch_add(latency, std::memory_order_relaxed);
+    uint64_t max = mLatencyMax.load(std::memory_order_relaxed);
+
+    while ((latency > max) &&
+           !mLatencyMax.compare_exchange_weak(max, latency,
+                                              std::memory_order_relaxed)) {}
+
+    task.mFunc();
+    mExecuted.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Take one stop request if there is any
+  //----------------------------------------------------------------------------
+  bool ConsumeStopRequest()
+  {
+    unsigned int requests = mStopRequests.load();
+
+    while (requests &&
+           !mStopRequests.compare_exchange_weak(requests, requests - 1)) {}
+
+    return (requests != 0);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Take a free worker slot, waiting for exiting threads to release theirs
+  //----------------------------------------------------------------------------
+  Worker* AcquireSlot()
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (true) {
+      for (auto& worker : mWorkers) {
+        if (!worker->mUsed) {
+          worker->mUsed = true;
+          return worker.get();
+        }
+      }
+
+      mSlotCond.wait(lock);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Release the worker slot, the tasks left in the deque go back to the
+  //! shared queue
+  //----------------------------------------------------------------------------
+  void ReleaseSlot(Worker* self)
+  {
+    std::deque<Task> left;
+    {
+      std::lock_guard<std::mutex> lock(self->mMutex);
+      left.swap(self->mDeque);
+      self->mSize.store(0);
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto& queue = mQueues[(size_t) Priority::Normal];
+
+    for (auto& task : left) {
+      queue.push_back(std::move(task));
+    }
+
+    mQueueSize[(size_t) Priority::Normal].fetch_add(left.size());
+    self->mUsed = false;
+    mSlotCond.notify_one();
+
+    if (!left.empty()) {
+      mCond.notify_all();
+    }
+  }
+
   std::vector<std::future<void>> mThreadPool;
-  eos::common::ConcurrentQueue<std::pair<bool, std::shared_ptr<std::function<void(void)>>>>
-  mTasks;
+  std::vector<std::unique_ptr<Worker>> mWorkers; ///< Worker slots
+  std::mutex mMutex; ///< Protects the shared queues and the slots
+  std::condition_variable mCond; ///< Idle workers wait for tasks
+  std::condition_variable mSlotCond; ///< New threads wait for a slot
+  std::deque<Task> mQueues[kNumPriorities]; ///< Shared queues
+  std::atomic<size_t> mQueueSize[kNumPriorities] {};
+  std::atomic<int64_t> mPending {0}; ///< Tasks queued anywhere
+  std::atomic<unsigned int> mIdle {0}; ///< Number of idle workers
+  std::atomic<unsigned int> mStopRequests {0}; ///< Threads asked to stop
+  bool mShutdown {false}; ///< Set by Stop, protected by mMutex
   std::unique_ptr<std::thread> mMaintainerThread;
   std::promise<void> mMaintainerSignal;
   std::atomic_uint mThreadCount {0};
   std::string mId; ///< Thread pool identifier
+  bool mWorkStealing; ///< Use per worker deques and work stealing
+  std::atomic<uint64_t> mExecuted {0};
+  std::atomic<uint64_t> mStolen {0};
+  std::atomic<uint64_t> mLatencySum {0};
+  std::atomic<uint64_t> mLatencyMax {0};
+  std::atomic<uint64_t> mLatencyHist[kNumLatencyBuckets] {};
 };
 
 EOSCOMMONNAMESPACE_END
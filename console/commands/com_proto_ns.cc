@@ -113,6 +113,20 @@ NsHelper::ParseCommand(const char* arg)
           mutex->set_toggle_order(true);
         } else if (soption == "--toggledeadlock") {
           mutex->set_toggle_deadlock(true);
+        } else if (soption == "--togglecontention") {
+          mutex->set_toggle_contention(true);
+        } else if (soption == "--contention") {
+          mutex->set_contention(true);
+        } else if (soption == "--dump") {
+          if (!(option = tokenizer.GetToken()) || strchr(option, '/') ||
+              !strcmp(option, ".") || !strcmp(option, "..")) {
+            return false;
+          }
+
+          mutex->set_contention(true);
+          mutex->set_contention_dump(option);
+        } else if (soption == "--resetcontention") {
+          mutex->set_reset_contention(true);
         } else if (soption == "--smplrate1") {
           mutex->set_sample_rate1(true);
         } else if (soption == "--smplrate10") {
@@ -398,6 +412,17 @@ void com_ns_help()
       << std::endl
       << "    --smplrate100    : set timing sample rate at 100% (severe slow-down)"
       << std::endl
+      << "    --togglecontention : toggle the per call site contention profiling,"
+      << std::endl
+      << "                         sampled at the timing sample rate" << std::endl
+      << "    --contention       : print the contention profile with histograms"
+      << std::endl
+      << "    --dump <name>      : print the contention profile and also dump it"
+      << std::endl
+      << "                         to the file /var/log/eos/mgm/<name> on the MGM"
+      << std::endl
+      << "    --resetcontention  : drop the contention profile collected so far"
+      << std::endl
       << std::endl
       << "  ns compact off|on <delay> [<interval>] [<type>]" << std::endl
       << "    enable online compaction after <delay> seconds" << std::endl
@@ -444,7 +469,8 @@ void com_ns_help()
       << "    -d         : control the directory cache" << std::endl
       << "    -f         : control the file cache" << std::endl
       << "    <max_num>  : max number of entries" << std::endl
-      << "    <max_size> : max size of the cache - not implemented yet"
+      << "    <max_size> : max estimated memory footprint of the cache, 0 means"
+      << " no limit"
       << std::endl;
   std::cerr << oss.str() << std::endl;
 }
@@ -623,6 +623,52 @@ XrdFstOfs::Configure(XrdSysError& Eroute, XrdOucEnv* envP)
   ObjectManager.mEnableQueue = true;
   ObjectManager.SetAutoReplyQueue("/eos/*/mgm");
   ObjectManager.SetDebug(false);
+
+  // Publish only significant changes of the filesystem statistics
+  if (getenv("EOS_FST_DELTA_PUBLISHING") &&
+      (atoi(getenv("EOS_FST_DELTA_PUBLISHING")) == 1)) {
+    struct {
+      const char* key;
+      double absolute;
+      double relative;
+    } thresholds[] = {
+      {"stat.disk.load", 0.05, 0.1},
+      {"stat.disk.readratemb", 1, 0.1},
+      {"stat.disk.writeratemb", 1, 0.1},
+      {"stat.net.inratemib", 1, 0.1},
+      {"stat.net.outratemib", 1, 0.1},
+      {"stat.ropen", 0, 0.1},
+      {"stat.wopen", 0, 0.1},
+      {"stat.usedfiles", 0, 0.001},
+      {"stat.statfs.bfree", 0, 0.0001},
+      {"stat.statfs.bavail", 0, 0.0001},
+      {"stat.statfs.ffree", 0, 0.0001},
+      {"stat.statfs.freebytes", 1024ll * 1024 * 1024, 0},
+      {"stat.statfs.usedbytes", 1024ll * 1024 * 1024, 0},
+      {"stat.statfs.fused", 1024ll * 1024 * 1024, 0},
+      {"stat.statfs.filled", 0.1, 0}
+    };
+
+    for (const auto& threshold : thresholds) {
+      ObjectManager.SetPublishThreshold(threshold.key, threshold.absolute,
+                                        threshold.relative);
+    }
+
+    ObjectManager.EnableDeltaPublishing(true);
+    Eroute.Say("=====> fstofs.deltapublishing : enabled");
+  }
+
+  // Coalesce the updates done outside of the publishing cycle
+  if (getenv("EOS_FST_PUBLISH_COALESCE_MS")) {
+    long coalesce_ms = strtol(getenv("EOS_FST_PUBLISH_COALESCE_MS"), 0, 10);
+
+    if (coalesce_ms > 0) {
+      ObjectManager.SetCoalescingWindow(std::chrono::milliseconds(coalesce_ms));
+      Eroute.Say("=====> fstofs.publishcoalesce : ",
+                 std::to_string(coalesce_ms).c_str(), " ms");
+    }
+  }
+
   // create the specific listener class
   Messaging = new eos::fst::Messaging(
     eos::fst::Config::gConfig.FstOfsBrokerUrl.c_str(),
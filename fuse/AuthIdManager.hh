@@ -174,7 +174,8 @@ public:
     connectionId(0)
   {
     uidCache = new ShardedCache<CredKey, uint64_t, CredKeyHasher>
-    (16 /* 16 shard bits */, 1000 * 60 * 60 * 3 /* 3 hours */);
+    (12 /* 12 shard bits */, 1000 * 60 * 60 * 3 /* 3 hours */,
+     1 << 18 /* max entries */);
     resize(proccachenbins);
   }
 
@@ -56,8 +56,9 @@ class CredentialCache
 {
 public:
 
-  CredentialCache() : cache(16 /* 2^16 shards */,
-                              1000 * 60 * 60 * 12 /* 12 hours */) { }
+  CredentialCache() : cache(12 /* 2^12 shards */,
+                              1000 * 60 * 60 * 12 /* 12 hours */,
+                              1 << 16 /* max entries */) { }
 
   std::shared_ptr<const BoundIdentity> retrieve(const UserCredentials& credInfo)
   {
@@ -44,7 +44,8 @@ ExecveAlert::~ExecveAlert()
 ProcessCache::ProcessCache(const CredentialConfig &conf,
   BoundIdentityProvider &bip, ProcessInfoProvider &pip, JailResolver &jr)
   : credConfig(conf),
-  cache(16 /* 2^16 shards */, 1000 * 60 * 10 /* 10 minutes inactivity TTL */),
+  cache(12 /* 2^12 shards */, 1000 * 60 * 10 /* 10 minutes inactivity TTL */,
+        1 << 18 /* max entries */),
   boundIdentityProvider(bip),
   processInfoProvider(pip),
   jailResolver(jr)
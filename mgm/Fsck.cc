@@ -36,7 +36,7 @@
 #include "mgm/FsView.hh"
 #include "namespace/interface/IView.hh"
 #include "namespace/interface/IFsView.hh"
-#include "namespace/Prefetcher.cc"
+#include "namespace/Prefetcher.hh"
 
 EOSMGMNAMESPACE_BEGIN
 
@@ -258,8 +258,6 @@ Fsck::Check(ThreadAssistant& assistant) noexcept
         } else {
           // Not ok and contributes to replica offline errors
           try {
-            eos::Prefetcher::prefetchFilesystemFileListAndWait(gOFS->eosView,
-                gOFS->eosFsView, fsid);
             XrdSysMutexHelper lock(eMutex);
             // Only need the view lock if we're in-memory
             eos::common::RWMutexReadLock nslock;
@@ -268,19 +266,17 @@ Fsck::Check(ThreadAssistant& assistant) noexcept
               nslock.Grab(gOFS->eosViewRWMutex);
             }
 
-            std::deque<std::pair<FileIdentifier, folly::Future<bool>>> futs;
+            // Stream through the file list keeping a bounded number of
+            // metadata lookups in flight
+            eos::PrefetchingFileListIterator it_fid(gOFS->eosView,
+                                                    gOFS->eosFsView->getStreamingFileList(fsid));
 
-            for (auto it_fid = gOFS->eosFsView->getFileList(fsid);
-                 (it_fid && it_fid->valid()); it_fid->next()) {
-              eos::FileIdentifier fid(it_fid->getElement());
-              futs.emplace_back(fid, gOFS->eosFileService->hasFileMD(fid));
-            }
-
-            for (size_t i = 0; i < futs.size(); i++) {
-              if (futs[i].second.get() == true) {
+            for (; it_fid.valid(); it_fid.next()) {
+              if (it_fid.getFileMD()) {
+                eos::IFileMD::id_t fid = it_fid.getElement();
                 eFsUnavail[fsid]++;
-                eFsMap["rep_offline"][fsid].insert(futs[i].first.getUnderlyingUInt64());
-                eMap["rep_offline"].insert(futs[i].first.getUnderlyingUInt64());
+                eFsMap["rep_offline"][fsid].insert(fid);
+                eMap["rep_offline"].insert(fid);
                 eCount["rep_offline"]++;
               }
             }
@@ -381,12 +377,18 @@ Fsck::Check(ThreadAssistant& assistant) noexcept
         fid2check.insert(*it);
       }
 
+      auto prefetched = fid2check.begin();
+
       for (auto it = fid2check.begin(); it != fid2check.end(); ++it) {
         std::shared_ptr<eos::IFileMD> fmd;
 
+        if (it == prefetched) {
+          prefetched = eos::Prefetcher::prefetchFileMDsAndWait(gOFS->eosView, it,
+                       fid2check.end());
+        }
+
         // Check if locations are online
         try {
-          eos::Prefetcher::prefetchFileMDAndWait(gOFS->eosView, *it);
           eos::common::RWMutexReadLock nslock(gOFS->eosViewRWMutex);
           fmd = gOFS->eosFileService->getFileMD(*it);
         } catch (eos::MDException& e) {}
@@ -579,12 +581,18 @@ Fsck::Report(XrdOucString& out, XrdOucString& err, XrdOucString option,
         if (printlfn) {
           out += "    \"lfn\": [";
           std::set <eos::common::FileId::fileid_t>::const_iterator fidit;
+          auto prefetched = emapit->second.cbegin();
 
           for (fidit = emapit->second.begin();
                fidit != emapit->second.end();
                fidit++) {
             std::shared_ptr<eos::IFileMD> fmd;
-            eos::Prefetcher::prefetchFileMDWithParentsAndWait(gOFS->eosView, *fidit);
+
+            if (fidit == prefetched) {
+              prefetched = eos::Prefetcher::prefetchFileMDsAndWait(gOFS->eosView,
+                           fidit, emapit->second.cend(), true);
+            }
+
             eos::common::RWMutexReadLock lock(gOFS->eosViewRWMutex);
 
             try {
@@ -679,13 +687,19 @@ Fsck::Report(XrdOucString& out, XrdOucString& err, XrdOucString option,
           if (printlfn) {
             out += "        \"lfn\": [";
             std::set <eos::common::FileId::fileid_t>::const_iterator fidit;
+            auto prefetched = efsmapit->second.cbegin();
 
             for (fidit = efsmapit->second.begin();
                  fidit != efsmapit->second.end();
                  fidit++) {
               std::shared_ptr<eos::IFileMD> fmd = std::shared_ptr<eos::IFileMD>((
                                                     eos::IFileMD*)0);
-              eos::Prefetcher::prefetchFileMDWithParentsAndWait(gOFS->eosView, *fidit);
+
+              if (fidit == prefetched) {
+                prefetched = eos::Prefetcher::prefetchFileMDsAndWait(gOFS->eosView,
+                             fidit, efsmapit->second.cend(), true);
+              }
+
               eos::common::RWMutexReadLock lock(gOFS->eosViewRWMutex);
 
               try {
@@ -783,11 +797,18 @@ Fsck::Report(XrdOucString& out, XrdOucString& err, XrdOucString option,
         if (printlfn) {
           out += " lfn=";
 
+          auto prefetched = emapit->second.cbegin();
+
           for (auto fidit = emapit->second.cbegin();
                fidit != emapit->second.cend(); fidit++) {
             std::shared_ptr<eos::IFileMD> fmd =
               std::shared_ptr<eos::IFileMD>((eos::IFileMD*)0);
-            eos::Prefetcher::prefetchFileMDWithParentsAndWait(gOFS->eosView, *fidit);
+
+            if (fidit == prefetched) {
+              prefetched = eos::Prefetcher::prefetchFileMDsAndWait(gOFS->eosView,
+                           fidit, emapit->second.cend(), true);
+            }
+
             eos::common::RWMutexReadLock lock(gOFS->eosViewRWMutex);
 
             try {
@@ -880,10 +901,17 @@ Fsck::Report(XrdOucString& out, XrdOucString& err, XrdOucString option,
             if (printlfn) {
               out += " lfn=";
 
+              auto prefetched = efsmapit->second.cbegin();
+
               for (auto fidit = efsmapit->second.cbegin();
                    fidit != efsmapit->second.cend(); ++fidit) {
                 std::shared_ptr<eos::IFileMD> fmd;
-                eos::Prefetcher::prefetchFileMDWithParentsAndWait(gOFS->eosView, *fidit);
+
+                if (fidit == prefetched) {
+                  prefetched = eos::Prefetcher::prefetchFileMDsAndWait(
+                                 gOFS->eosView, fidit, efsmapit->second.cend(), true);
+                }
+
                 eos::common::RWMutexReadLock lock(gOFS->eosViewRWMutex);
 
                 try {
@@ -972,11 +1000,18 @@ Fsck::Repair(XrdOucString& out, XrdOucString& err, XrdOucString option)
     // Loop over all filesystems
     for (auto efsmapit = fid2check.cbegin();
          efsmapit != fid2check.cend(); ++efsmapit) {
+      auto prefetched = efsmapit->second.cbegin();
+
       for (auto it = efsmapit->second.cbegin();
            it != efsmapit->second.cend(); ++it) {
         std::string path = "";
         std::shared_ptr<eos::IFileMD> fmd;
-        eos::Prefetcher::prefetchFileMDWithParentsAndWait(gOFS->eosView, *it);
+
+        if (it == prefetched) {
+          prefetched = eos::Prefetcher::prefetchFileMDsAndWait(gOFS->eosView, it,
+                       efsmapit->second.cend(), true);
+        }
+
         eos::common::RWMutexReadLock lock(gOFS->eosViewRWMutex);
 
         try {
@@ -1049,12 +1084,19 @@ Fsck::Repair(XrdOucString& out, XrdOucString& err, XrdOucString option)
     // Loop over all filesystems
     for (auto  efsmapit = fid2check.cbegin();
          efsmapit != fid2check.cend(); ++efsmapit) {
+      auto prefetched = efsmapit->second.cbegin();
+
       for (auto it = efsmapit->second.cbegin();
            it != efsmapit->second.cend(); ++it) {
         std::string path = "";
         std::shared_ptr<eos::IFileMD> fmd =
           std::shared_ptr<eos::IFileMD>((eos::IFileMD*)0);
-        eos::Prefetcher::prefetchFileMDAndWait(gOFS->eosView, *it);
+
+        if (it == prefetched) {
+          prefetched = eos::Prefetcher::prefetchFileMDsAndWait(gOFS->eosView, it,
+                       efsmapit->second.cend());
+        }
+
         eos::common::RWMutexReadLock lock(gOFS->eosViewRWMutex);
 
         try {
@@ -1105,6 +1147,8 @@ Fsck::Repair(XrdOucString& out, XrdOucString& err, XrdOucString option)
     // Loop over all filesystems
     for (auto efsmapit = eFsMap["unreg_n"].cbegin();
          efsmapit != eFsMap["unreg_n"].cend(); ++efsmapit) {
+      auto prefetched = efsmapit->second.cbegin();
+
       // Loop over all fids
       for (auto it = efsmapit->second.cbegin();
            it != efsmapit->second.cend(); ++it) {
@@ -1112,9 +1156,13 @@ Fsck::Repair(XrdOucString& out, XrdOucString& err, XrdOucString option)
         bool haslocation = false;
         std::string spath = "";
 
+        if (it == prefetched) {
+          prefetched = eos::Prefetcher::prefetchFileMDsAndWait(gOFS->eosView, it,
+                       efsmapit->second.cend(), true);
+        }
+
         // Crosscheck if the location really is not attached
         try {
-          eos::Prefetcher::prefetchFileMDWithParentsAndWait(gOFS->eosView, *it);
           eos::common::RWMutexReadLock lock(gOFS->eosViewRWMutex);
           fmd = gOFS->eosFileService->getFileMD(*it);
           spath = gOFS->eosView->getUri(fmd.get());
@@ -1171,11 +1219,18 @@ Fsck::Repair(XrdOucString& out, XrdOucString& err, XrdOucString option)
     // Loop over all filesystems
     for (auto efsmapit = eFsMap["orphans_n"].cbegin();
          efsmapit != eFsMap["orphans_n"].cend(); ++efsmapit) {
+      auto prefetched = efsmapit->second.cbegin();
+
       // Loop over all fids
       for (auto it = efsmapit->second.cbegin();
            it != efsmapit->second.cend(); ++it) {
         std::shared_ptr<eos::IFileMD> fmd;
-        eos::Prefetcher::prefetchFileMDWithParentsAndWait(gOFS->eosView, *it);
+
+        if (it == prefetched) {
+          prefetched = eos::Prefetcher::prefetchFileMDsAndWait(gOFS->eosView, it,
+                       efsmapit->second.cend(), true);
+        }
+
         eos::common::RWMutexReadLock lock(gOFS->eosViewRWMutex);
         bool haslocation = false;
 
@@ -1225,15 +1280,21 @@ Fsck::Repair(XrdOucString& out, XrdOucString& err, XrdOucString option)
     // Loop over all filesystems
     for (auto efsmapit = eFsMap["rep_diff_n"].cbegin();
          efsmapit != eFsMap["rep_diff_n"].cend(); ++efsmapit) {
+      auto prefetched = efsmapit->second.cbegin();
+
       // Loop over all fids
       for (auto it = efsmapit->second.cbegin();
            it != efsmapit->second.cend(); ++it) {
         std::shared_ptr<eos::IFileMD> fmd;
         std::string path = "";
 
+        if (it == prefetched) {
+          prefetched = eos::Prefetcher::prefetchFileMDsAndWait(gOFS->eosView, it,
+                       efsmapit->second.cend(), true);
+        }
+
         try {
           {
-            eos::Prefetcher::prefetchFileMDWithParentsAndWait(gOFS->eosView, *it);
             eos::common::RWMutexReadLock lock(gOFS->eosViewRWMutex);
             fmd = gOFS->eosFileService->getFileMD(*it);
             path = gOFS->eosView->getUri(fmd.get());
@@ -1285,6 +1346,8 @@ Fsck::Repair(XrdOucString& out, XrdOucString& err, XrdOucString option)
     // Loop over all filesystems
     for (auto efsmapit = eFsMap["rep_missing_n"].cbegin();
          efsmapit != eFsMap["rep_missing_n"].cend(); ++efsmapit) {
+      auto prefetched = efsmapit->second.cbegin();
+
       // Loop over all fids
       for (auto it = efsmapit->second.cbegin();
            it != efsmapit->second.cend(); ++it) {
@@ -1292,9 +1355,13 @@ Fsck::Repair(XrdOucString& out, XrdOucString& err, XrdOucString option)
         bool haslocation = false;
         std::string path = "";
 
+        if (it == prefetched) {
+          prefetched = eos::Prefetcher::prefetchFileMDsAndWait(gOFS->eosView, it,
+                       efsmapit->second.cend(), true);
+        }
+
         // Crosscheck if the location really is not attached
         try {
-          eos::Prefetcher::prefetchFileMDWithParentsAndWait(gOFS->eosView, *it);
           eos::common::RWMutexReadLock lock(gOFS->eosViewRWMutex);
           fmd = gOFS->eosFileService->getFileMD(*it);
           path = gOFS->eosView->getUri(fmd.get());
@@ -1365,6 +1432,7 @@ Fsck::Repair(XrdOucString& out, XrdOucString& err, XrdOucString option)
     // Drop all namespace entries which are older than 48 hours and have no
     // files attached. Loop over all fids ...
     auto const& set_fids = eMap["zero_replica"];
+    auto prefetched = set_fids.cbegin();
 
     for (auto it = set_fids.cbegin(); it != set_fids.cend(); ++it) {
       std::shared_ptr<eos::IFileMD> fmd;
@@ -1377,8 +1445,12 @@ Fsck::Repair(XrdOucString& out, XrdOucString& err, XrdOucString option)
       ctime.tv_sec = 0;
       ctime.tv_nsec = 0;
 
+      if (it == prefetched) {
+        prefetched = eos::Prefetcher::prefetchFileMDsAndWait(gOFS->eosView, it,
+                     set_fids.cend(), true);
+      }
+
       try {
-        eos::Prefetcher::prefetchFileMDWithParentsAndWait(gOFS->eosView, *it);
         eos::common::RWMutexReadLock lock(gOFS->eosViewRWMutex);
         fmd = gOFS->eosFileService->getFileMD(*it);
         path = gOFS->eosView->getUri(fmd.get());
@@ -1422,12 +1494,21 @@ Fsck::Repair(XrdOucString& out, XrdOucString& err, XrdOucString option)
 
     // Loop over all filesystems
     for (const auto& efsmapit : eFsMap["d_mem_sz_diff"]) {
+      auto prefetched = efsmapit.second.cbegin();
+
       // Loop over all fids
-      for (const auto& fid : efsmapit.second) {
+      for (auto it_fid = efsmapit.second.cbegin();
+           it_fid != efsmapit.second.cend(); ++it_fid) {
+        const auto fid = *it_fid;
         std::string path;
         std::shared_ptr<eos::IFileMD> fmd;
+
+        if (it_fid == prefetched) {
+          prefetched = eos::Prefetcher::prefetchFileMDsAndWait(gOFS->eosView,
+                       it_fid, efsmapit.second.cend(), true);
+        }
+
         {
-          eos::Prefetcher::prefetchFileMDWithParentsAndWait(gOFS->eosView, fid);
           eos::common::RWMutexReadLock lock(gOFS->eosViewRWMutex);
 
           try {
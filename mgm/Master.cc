@@ -74,6 +74,8 @@ Master::Master()
   f2MasterTransitionTime = time(nullptr) - 3600; // start without service delays
   fHasSystemd = false;
   fDirCompactingRatio = 0.0;
+  fSnapshotInterval = 0;
+  fSnapshotLast = 0;
 }
 
 //------------------------------------------------------------------------------
@@ -105,6 +107,11 @@ Master::Init()
     fRemoteHost = getenv("EOS_MGM_MASTER1");
   }
 
+  // Interval for writing namespace snapshots, used to speed up the boot
+  if (getenv("EOS_NS_SNAPSHOT_INTERVAL")) {
+    fSnapshotInterval = strtoul(getenv("EOS_NS_SNAPSHOT_INTERVAL"), 0, 10);
+  }
+
   // Start the online compacting background thread
   XrdSysThread::Run(&fCompactingThread, Master::StaticOnlineCompacting,
                     static_cast<void*>(this), XRDSYSTHREAD_HOLD,
@@ -881,6 +888,28 @@ Master::Compacting()
       }
     }
 
+    // A compacted change log invalidates the previous snapshot, so write a
+    // new one right after compacting
+    if (fSnapshotInterval && IsMaster() &&
+        (runcompacting || (time(nullptr) >= fSnapshotLast + fSnapshotInterval))) {
+      bool runsnapshot = false;
+      {
+        XrdSysMutexHelper cLock(fCompactingMutex);
+
+        if (fCompactingState == Compact::State::kIsNotCompacting) {
+          fCompactingState = Compact::State::kIsCompacting;
+          runsnapshot = true;
+        }
+      }
+
+      if (runsnapshot) {
+        WriteNsSnapshot(eos_chlog_filesvc, eos_chlog_dirsvc);
+        fSnapshotLast = time(nullptr);
+        XrdSysMutexHelper cLock(fCompactingMutex);
+        fCompactingState = Compact::State::kIsNotCompacting;
+      }
+    }
+
     // Check only once a minute
     XrdSysThread::CancelPoint();
     std::this_thread::sleep_for(std::chrono::seconds(60));
@@ -890,6 +919,43 @@ Master::Compacting()
   return nullptr;
 }
 
+//------------------------------------------------------------------------------
+// Write the namespace snapshots
+//------------------------------------------------------------------------------
+void
+Master::WriteNsSnapshot(eos::IChLogFileMDSvc* file_svc,
+                        eos::IChLogContainerMDSvc* dir_svc)
+{
+  time_t start = time(nullptr);
+  uint64_t file_bytes = 0;
+  uint64_t dir_bytes = 0;
+
+  try {
+    void* snapshot_data = nullptr;
+    {
+      // Require NS read lock
+      eos::common::RWMutexReadLock lock(gOFS->eosViewRWMutex);
+      snapshot_data = dir_svc->snapshotPrepare();
+    }
+    // Does not require namespace lock
+    dir_bytes = dir_svc->snapshotWrite(snapshot_data);
+    {
+      eos::common::RWMutexReadLock lock(gOFS->eosViewRWMutex);
+      snapshot_data = file_svc->snapshotPrepare();
+    }
+    file_bytes = file_svc->snapshotWrite(snapshot_data);
+  } catch (eos::MDException& e) {
+    MasterLog(eos_err("msg=\"namespace snapshot failed\" ec=%d %s",
+                      e.getErrno(), e.getMessage().str().c_str()));
+    return;
+  }
+
+  MasterLog(eos_info("msg=\"namespace snapshot done\" dir-bytes=%llu "
+                     "file-bytes=%llu elapsed=%lu",
+                     (unsigned long long) dir_bytes,
+                     (unsigned long long) file_bytes, time(nullptr) - start));
+}
+
 //------------------------------------------------------------------------------
 // Print out compacting status
 //------------------------------------------------------------------------------
@@ -1820,6 +1886,11 @@ Master::BootNamespace()
     ns_preset = true;
   }
 
+  if (getenv("EOS_NS_BOOT_THREADS")) {
+    contSettings["boot_threads"] = getenv("EOS_NS_BOOT_THREADS");
+    fileSettings["boot_threads"] = getenv("EOS_NS_BOOT_THREADS");
+  }
+
   if (ns_preset) {
     eos_alert("msg=\"namespace size optimization\" nfiles=%s ndirs=%s",
               getenv("EOS_NS_DIR_SIZE"), getenv("EOS_NS_FILE_SIZE"));
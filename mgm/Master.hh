@@ -31,6 +31,12 @@
 #include "XrdOuc/XrdOucString.hh"
 #include <atomic>
 
+namespace eos
+{
+class IChLogFileMDSvc;
+class IChLogContainerMDSvc;
+}
+
 EOSMGMNAMESPACE_BEGIN
 
 //------------------------------------------------------------------------------
@@ -262,6 +268,8 @@ private:
   double fCompactingRatio;
   //! compacting ratio for directory changelog e.g. 4:1 => 4 times smaller after compaction
   double fDirCompactingRatio;
+  time_t fSnapshotInterval; ///< namespace snapshot interval, 0 disables it
+  time_t fSnapshotLast; ///< timestamp of the last namespace snapshot
   XrdSysLogger* fDevNullLogger; ///< /dev/null logger
   XrdSysError* fDevNullErr; ///< /dev/null error
   unsigned long long
@@ -416,6 +424,16 @@ private:
   //----------------------------------------------------------------------------
   void* Compacting();
 
+  //----------------------------------------------------------------------------
+  //! Write the snapshots of the file and directory change logs, runs in the
+  //! compacting thread
+  //!
+  //! @param file_svc change log file service
+  //! @param dir_svc change log container service
+  //----------------------------------------------------------------------------
+  void WriteNsSnapshot(eos::IChLogFileMDSvc* file_svc,
+                       eos::IChLogContainerMDSvc* dir_svc);
+
   //----------------------------------------------------------------------------
   //! Supervisor Thread Start Function
   //----------------------------------------------------------------------------
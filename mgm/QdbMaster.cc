@@ -506,6 +506,11 @@ QdbMaster::DisableNsCaching()
   map_cfg[constants::sMaxNumCacheDirs] = "0";
   gOFS->eosFileService->configure(map_cfg);
   gOFS->eosDirectoryService->configure(map_cfg);
+  // Paths can't be tracked, changes happen behind our back
+  std::map<std::string, std::string> view_cfg;
+  view_cfg[constants::sMaxNumCachePaths] = "0";
+  view_cfg[constants::sReconfigureCachesOnly] = "true";
+  gOFS->eosView->configure(view_cfg);
 }
 
 //------------------------------------------------------------------------------
@@ -519,6 +524,10 @@ QdbMaster::EnableNsCaching()
   map_cfg[constants::sMaxNumCacheDirs] = std::to_string(3e6);
   gOFS->eosFileService->configure(map_cfg);
   gOFS->eosDirectoryService->configure(map_cfg);
+  std::map<std::string, std::string> view_cfg;
+  view_cfg[constants::sMaxNumCachePaths] = std::to_string(1e6);
+  view_cfg[constants::sReconfigureCachesOnly] = "true";
+  gOFS->eosView->configure(view_cfg);
 }
 
 EOSMGMNAMESPACE_END
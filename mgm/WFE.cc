@@ -44,7 +44,8 @@
 XrdSysMutex eos::mgm::WFE::gSchedulerMutex;
 XrdScheduler* eos::mgm::WFE::gScheduler;
 
-eos::common::ThreadPool eos::mgm::WFE::gAsyncCommunicationPool(1, 10, 2, 5, 5);
+eos::common::ThreadPool eos::mgm::WFE::gAsyncCommunicationPool(1, 10, 2, 5, 5,
+    "wfe_pool");
 
 /*----------------------------------------------------------------------------*/
 extern XrdSysError gMgmOfsEroute;
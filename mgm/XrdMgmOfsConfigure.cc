@@ -274,6 +274,13 @@ XrdMgmOfs::Configure(XrdSysError& Eroute)
   // set stream error window
   XrdCl::DefaultEnv::GetEnv()->PutInt("StreamErrorWindow", 0);
   UTF8 = getenv("EOS_UTF8") != nullptr;
+
+  // Reader-scalable namespace lock, must be set before the first use
+  if (getenv("EOS_USE_STRIPED_NS_MUTEX")) {
+    eosViewRWMutex.SetStriped();
+    Eroute.Say("=====> mgmofs uses the striped namespace mutex");
+  }
+
   Shutdown = false;
   setenv("XrdSecPROTOCOL", "sss", 1);
   Eroute.Say("=====> mgmofs enforces SSS authentication for XROOT clients");
@@ -28,6 +28,7 @@
 #include "common/ThreadPool.hh"
 #include "namespace/interface/IFsView.hh"
 #include "namespace/interface/IView.hh"
+#include "namespace/Prefetcher.hh"
 #include <sstream>
 
 EOSMGMNAMESPACE_BEGIN
@@ -47,6 +48,7 @@ DrainFs::DrainFs(eos::common::ThreadPool& thread_pool,
   mStatus(eos::common::FileSystem::kNoDrain),
   mDrainStop(false), mMaxRetries(1), mMaxJobs(10),
   mDrainPeriod(0), mThreadPool(thread_pool), mTotalFiles(0ull),
+  mNumStarted(0ull),
   mLastNumToDrain(0ull), mLastNumFailed(0ull),
   mLastRefreshTime(steady_clock::now()),
   mLastProgressTime(steady_clock::now()),
@@ -114,14 +116,14 @@ DrainFs::DoIt()
     }
 
     do { // Loop to drain the files
-      auto it_job = mJobsPending.begin();
-
       while ((mJobsRunning.size() <= mMaxJobs.load()) &&
-             (it_job != mJobsPending.end())) {
-        auto job = *it_job;
+             mFileIterator->valid()) {
+        std::shared_ptr<DrainTransferJob> job
+        (new DrainTransferJob(mFileIterator->getElement(), mFsId, mTargetFsId));
+        mFileIterator->next();
+        ++mNumStarted;
         mThreadPool.PushTask<void>([job] {return job->DoIt();});
-        mJobsRunning.push_back(*it_job);
-        it_job = mJobsPending.erase(it_job);
+        mJobsRunning.push_back(job);
       }
 
       for (auto it = mJobsRunning.begin(); it !=  mJobsRunning.end();) {
@@ -300,29 +302,56 @@ DrainFs::PrepareFs()
 }
 
 //------------------------------------------------------------------------------
-// Collect and prepare all the drain jobs
+// Start collecting the drain jobs
 //------------------------------------------------------------------------------
 uint64_t
 DrainFs::CollectDrainJobs()
 {
-  eos::common::RWMutexReadLock ns_rd_lock;
+  mNumStarted = 0ull;
+  mFileSnapshot.clear();
 
   if (gOFS->eosView->inMemory()) {
-    ns_rd_lock.Grab(gOFS->eosViewRWMutex);
-  }
+    // The in-memory file list can only be traversed under the namespace lock,
+    // take a compact snapshot of the file ids instead
+    eos::common::RWMutexReadLock ns_rd_lock(gOFS->eosViewRWMutex);
 
-  mTotalFiles = 0ull;
+    for (auto it_fid = gOFS->eosFsView->getFileList(mFsId);
+         (it_fid && it_fid->valid()); it_fid->next()) {
+      mFileSnapshot.insert(it_fid->getElement());
+    }
 
-  for (auto it_fid = gOFS->eosFsView->getStreamingFileList(mFsId);
-       (it_fid && it_fid->valid()); it_fid->next()) {
-    mJobsPending.emplace_back
-    (new DrainTransferJob(it_fid->getElement(), mFsId, mTargetFsId));
-    ++mTotalFiles;
+    mTotalFiles = mFileSnapshot.size();
+    mFileIterator = std::make_shared<eos::FileIterator>(mFileSnapshot);
+  } else {
+    mTotalFiles = gOFS->eosFsView->getNumFilesOnFs(mFsId);
+    mFileIterator = std::make_shared<eos::PrefetchingFileListIterator>
+                    (gOFS->eosView, gOFS->eosFsView->getStreamingFileList(mFsId),
+                     eos::PrefetchingFileListIterator::kDefaultWindow, true);
+
+    // The count and the streaming list may disagree while files are written
+    if (!mFileIterator->valid()) {
+      mTotalFiles = 0ull;
+    } else if (mTotalFiles == 0ull) {
+      mTotalFiles = 1ull;
+    }
   }
 
   return mTotalFiles;
 }
 
+//------------------------------------------------------------------------------
+// Get the number of files not yet handed over to a drain job
+//------------------------------------------------------------------------------
+uint64_t
+DrainFs::GetNumPending()
+{
+  if (!mFileIterator || !mFileIterator->valid()) {
+    return 0ull;
+  }
+
+  return (mTotalFiles > mNumStarted) ? (mTotalFiles - mNumStarted) : 1ull;
+}
+
 //-----------------------------------------------------------------------------
 // Mark the file system as draining
 //-----------------------------------------------------------------------------
@@ -360,7 +389,8 @@ DrainFs::UpdateProgress()
 {
   bool is_expired = false;
   auto now = steady_clock::now();
-  uint64_t num_to_drain = mJobsPending.size() + mJobsFailed.size() +
+  uint64_t num_pending = GetNumPending();
+  uint64_t num_to_drain = num_pending + mJobsFailed.size() +
                           mJobsRunning.size();
 
   if ((mLastNumToDrain != num_to_drain) ||
@@ -381,7 +411,7 @@ DrainFs::UpdateProgress()
             duration_cast<milliseconds>(now.time_since_epoch()).count(),
             duration_cast<milliseconds>(mLastProgressTime.time_since_epoch()).count(),
             is_stalled, mTotalFiles, num_to_drain, mLastNumToDrain,
-            mJobsRunning.size(), mJobsPending.size(), mJobsFailed.size());
+            mJobsRunning.size(), num_pending, mJobsFailed.size());
 
   // Check if drain expired
   if (mDrainPeriod.count() && (mDrainEnd < now)) {
@@ -455,7 +485,7 @@ DrainFs::UpdateProgress()
 
   // If we have only failed jobs check if files still exist
   if ((mJobsRunning.size() == 0) &&
-      (mJobsPending.size() == 0) &&
+      (num_pending == 0) &&
       (mJobsFailed.size())) {
     auto now_tstamp = steady_clock::now();
     auto dur = now_tstamp - mLastRefreshTime;
@@ -479,8 +509,6 @@ DrainFs::UpdateProgress()
   if (num_to_drain == 0) {
     // Check one more time if there are any files left on the file system -
     // these could be files being written while draining was started
-    mJobsPending.clear();
-
     if (CollectDrainJobs() == 0) {
       CompleteDrain();
       return State::Done;
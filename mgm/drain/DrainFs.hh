@@ -26,6 +26,7 @@
 #include "mgm/FileSystem.hh"
 #include "mgm/drain/DrainTransferJob.hh"
 #include "common/Logging.hh"
+#include "namespace/interface/IFsView.hh"
 #include <thread>
 #include <future>
 #include <map>
@@ -161,12 +162,19 @@ private:
   bool MarkFsDraining();
 
   //---------------------------------------------------------------------------
-  //! Collect and prepare all the drain jobs
+  //! Start collecting the drain jobs. The jobs are created on demand from the
+  //! file list of the file system, with the file metadata being prefetched
+  //! ahead of them, so draining starts without going through the whole list.
   //!
-  //! @returns number of drain jobs prepared
+  //! @returns number of files to drain
   //---------------------------------------------------------------------------
   uint64_t CollectDrainJobs();
 
+  //---------------------------------------------------------------------------
+  //! Get the number of files not yet handed over to a drain job
+  //---------------------------------------------------------------------------
+  uint64_t GetNumPending();
+
   //---------------------------------------------------------------------------
   //! Update progress of the drain
   //!
@@ -190,8 +198,10 @@ private:
   std::chrono::seconds mDrainPeriod; ///< Allowed time for file system to drain
   std::chrono::time_point<std::chrono::steady_clock> mDrainStart;
   std::chrono::time_point<std::chrono::steady_clock> mDrainEnd;
-  //! Collection of drain jobs to run
-  std::list<std::shared_ptr<DrainTransferJob>> mJobsPending;
+  //! Iterator over the files still to be turned into drain jobs
+  std::shared_ptr<eos::ICollectionIterator<eos::IFileMD::id_t>> mFileIterator;
+  //! Snapshot of the file list with the in-memory namespace
+  eos::IFsView::FileList mFileSnapshot;
   //! Collection of failed drain jobs
   std::list<std::shared_ptr<DrainTransferJob>> mJobsFailed;
   //! Collection of running drain jobs
@@ -199,6 +209,7 @@ private:
   eos::common::ThreadPool& mThreadPool;
   std::future<State> mFuture;
   uint64_t mTotalFiles; ///< Total number of files to drain
+  uint64_t mNumStarted; ///< Number of drain jobs created from the file list
   uint64_t mLastNumToDrain; ///< Last number of drain jobs recorded
   uint64_t mLastNumFailed; ///< Last number of failed drain jobs
   //! Last timestamp when a refresh of failed transfers was performed
@@ -34,7 +34,8 @@ EOSMGMNAMESPACE_BEGIN
 // Constructor
 //------------------------------------------------------------------------------
 Drainer::Drainer():
-  mThreadPool(std::thread::hardware_concurrency(), 400, 10, 6, 5)
+  mThreadPool(std::thread::hardware_concurrency(), 400, 10, 6, 5, "drain",
+              true)
 {}
 
 //------------------------------------------------------------------------------
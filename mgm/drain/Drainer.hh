@@ -121,6 +121,14 @@ public:
   //----------------------------------------------------------------------------
   void PrintJobsTable(TableFormatterBase&, DrainTransferJob*);
 
+  //----------------------------------------------------------------------------
+  //! Get the thread pool running the drain jobs
+  //----------------------------------------------------------------------------
+  const eos::common::ThreadPool& GetThreadPool() const
+  {
+    return mThreadPool;
+  }
+
 private:
   using ListPendingT = std::list<std::pair<eos::common::FileSystem::fsid_t,
         eos::common::FileSystem::fsid_t>>;
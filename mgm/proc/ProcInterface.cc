@@ -40,7 +40,7 @@ std::unordered_map<std::string, std::unique_ptr<IProcCommand>>
 eos::common::ThreadPool ProcInterface::sProcThreads(
   std::max(std::thread::hardware_concurrency() / 10, 64u),
   std::max(std::thread::hardware_concurrency() / 4, 256u),
-  3, 2, 2, "proc_pool");
+  3, 2, 2, "proc_pool", true);
 
 //------------------------------------------------------------------------------
 // Factory method to get a ProcCommand object
@@ -518,18 +518,25 @@ FsCmd::Status(const eos::console::FsProto::StatusProto& statusProto)
           unsigned long long nfids_risky = 0;
           unsigned long long nfids_inaccessible = 0;
           unsigned long long nfids_todelete = 0;
-          eos::Prefetcher::prefetchFilesystemFileListWithFileMDsAndParentsAndWait(
-            gOFS->eosView, gOFS->eosFsView, fsid);
-          eos::common::RWMutexReadLock viewLock(gOFS->eosViewRWMutex);
+          // Only need the view lock if we're in-memory, the QuarkDB file
+          // list is streamed without blocking the namespace
+          eos::common::RWMutexReadLock viewLock;
+
+          if (gOFS->eosView->inMemory()) {
+            viewLock.Grab(gOFS->eosViewRWMutex);
+          }
 
           try {
             nfids_todelete = gOFS->eosFsView->getNumUnlinkedFilesOnFs(fsid);
             nfids = gOFS->eosFsView->getNumFilesOnFs(fsid);
-
-            for (auto it_fid = gOFS->eosFsView->getFileList(fsid);
-                 (it_fid && it_fid->valid()); it_fid->next()) {
-              std::shared_ptr<eos::IFileMD> fmd =
-                gOFS->eosFileService->getFileMD(it_fid->getElement());
+            // Stream through the file list with the metadata of the files and
+            // their parents prefetched ahead of the current entry
+            eos::PrefetchingFileListIterator it_fid(gOFS->eosView,
+                                                    gOFS->eosFsView->getStreamingFileList(fsid),
+                                                    eos::PrefetchingFileListIterator::kDefaultWindow, true);
+
+            for (; it_fid.valid(); it_fid.next()) {
+              std::shared_ptr<eos::IFileMD> fmd = it_fid.getFileMD();
 
               if (fmd) {
                 size_t nloc_ok = 0;
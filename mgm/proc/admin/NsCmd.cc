@@ -32,6 +32,10 @@
 #include "namespace/interface/ContainerIterators.hh"
 #include "namespace/ns_quarkdb/Constants.hh"
 #include "namespace/ns_quarkdb_static/explorer/NamespaceExplorer.hh"
+#include "namespace/ns_quarkdb_static/accounting/ContainerAccounting.hh"
+#include "namespace/ns_quarkdb_static/accounting/SyncTimeAccounting.hh"
+#include "namespace/ns_quarkdb_static/flusher/MetadataFlusher.hh"
+#include "namespace/ns_quarkdb/accounting/QuotaStats.hh"
 #include "namespace/ns_quarkdb/BackendClient.hh"
 #include "namespace/Resolver.hh"
 #include "namespace/Constants.hh"
@@ -40,7 +44,10 @@
 #include "mgm/Stat.hh"
 #include "mgm/Master.hh"
 #include "mgm/ZMQ.hh"
+#include "mgm/WFE.hh"
+#include "mgm/proc/ProcInterface.hh"
 #include <sstream>
+#include <fstream>
 
 EOSMGMNAMESPACE_BEGIN
 
@@ -90,7 +97,8 @@ NsCmd::MutexSubcmd(const eos::console::NsProto_MutexProto& mutex,
 
     if (mutex.sample_rate1() || mutex.sample_rate10() ||
         mutex.sample_rate100() || mutex.toggle_timing() ||
-        mutex.toggle_order()) {
+        mutex.toggle_order() || mutex.toggle_contention() ||
+        mutex.contention() || mutex.reset_contention()) {
       no_option = false;
     }
 
@@ -135,6 +143,16 @@ NsCmd::MutexSubcmd(const eos::console::NsProto_MutexProto& mutex,
             << "% of the mutex lock/unlock cycle duration)";
       }
 
+      oss << std::endl
+          << "contention     is : ";
+      eos::common::RWMutexProfiler* profiler = ns_mtx->GetContentionProfiler();
+
+      if (profiler) {
+        oss << "on  (sampling 1/" << profiler->GetSamplingModulo() << ")";
+      } else {
+        oss << "off";
+      }
+
       oss << std::endl;
     }
 
@@ -189,6 +207,72 @@ NsCmd::MutexSubcmd(const eos::console::NsProto_MutexProto& mutex,
       ns_mtx->SetSampling(true, rate);
     }
 
+    if (mutex.toggle_contention()) {
+      if (ns_mtx->GetContentionProfiler()) {
+        fs_mtx->SetContentionProfiling(false);
+        quota_mtx->SetContentionProfiling(false);
+        ns_mtx->SetContentionProfiling(false);
+        oss << "mutex contention profiling is off" << std::endl;
+      } else {
+        // Follow the timing sample rate, by default profile 1% of the locks
+        float sr = fs_mtx->GetSampling();
+        uint32_t modulo = ((sr > 0) ? std::max(1, (int)(1.0 / sr + 0.5)) : 100);
+        fs_mtx->SetContentionProfiling(true, modulo);
+        quota_mtx->SetContentionProfiling(true, modulo);
+        ns_mtx->SetContentionProfiling(true, modulo);
+        oss << "mutex contention profiling is on (sampling 1/" << modulo << ")"
+            << std::endl;
+      }
+    }
+
+    if (mutex.reset_contention()) {
+      fs_mtx->ResetContentionProfile();
+      quota_mtx->ResetContentionProfile();
+      ns_mtx->ResetContentionProfile();
+      oss << "mutex contention profile has been reset" << std::endl;
+    }
+
+    if (mutex.contention()) {
+      std::string report = ns_mtx->PrintContentionProfile("eosViewRWMutex", 0,
+                           false, true);
+      report += fs_mtx->PrintContentionProfile("FsView::ViewMutex", 0, false,
+                true);
+      report += quota_mtx->PrintContentionProfile("Quota::pMapMutex", 0, false,
+                true);
+
+      if (report.empty()) {
+        oss << "mutex contention profiling was never enabled" << std::endl;
+      } else {
+        oss << report;
+        const std::string& dump_name = mutex.contention_dump();
+
+        if (!dump_name.empty()) {
+          if ((dump_name.find('/') != std::string::npos) ||
+              (dump_name == ".") || (dump_name == "..")) {
+            // Only a file name is accepted, the dump always goes to the MGM
+            // log directory so that clients can't overwrite arbitrary files
+            reply.set_std_err("error: the dump has to be a file name without '/'");
+            reply.set_retc(EINVAL);
+          } else {
+            const std::string dump_path = "/var/log/eos/mgm/" + dump_name;
+            std::ofstream dump(dump_path, std::ios::out | std::ios::trunc);
+
+            if (dump.is_open()) {
+              dump << report;
+            }
+
+            if (dump.good()) {
+              oss << "# dumped to " << dump_path << std::endl;
+            } else {
+              eos_err("msg=\"failed to write mutex contention dump\" path=%s",
+                      dump_path.c_str());
+              oss << "# failed to dump to " << dump_path << std::endl;
+            }
+          }
+        }
+      }
+    }
+
     reply.set_std_out(oss.str());
   } else {
     reply.set_std_err("error: you have to take role 'root' to execute this"
@@ -197,6 +281,45 @@ NsCmd::MutexSubcmd(const eos::console::NsProto_MutexProto& mutex,
   }
 }
 
+//------------------------------------------------------------------------------
+// Print the batch statistics of an accounting listener
+//------------------------------------------------------------------------------
+static void
+PrintAccountingStatistics(std::ostringstream& oss, const std::string& key,
+                          const std::string& label,
+                          const eos::AccountingStatistics& stats, bool monitor)
+{
+  if (monitor) {
+    std::string prefix = "uid=all gid=all ns.accounting." + key + ".";
+    oss << prefix << "batches=" << stats.batches << std::endl
+        << prefix << "queued=" << stats.queued << std::endl
+        << prefix << "updated=" << stats.updated << std::endl
+        << prefix << "merged=" << stats.merged << std::endl
+        << prefix << "last_queued=" << stats.lastQueued << std::endl
+        << prefix << "last_updated=" << stats.lastUpdated << std::endl
+        << prefix << "last_resolve_us=" << stats.lastResolveUs << std::endl
+        << prefix << "last_lock_us=" << stats.lastLockUs << std::endl
+        << prefix << "total_lock_us=" << stats.totalLockUs << std::endl
+        << prefix << "max_lock_us=" << stats.maxLockUs << std::endl;
+  } else {
+    char sline[256];
+    snprintf(sline, sizeof(sline), "ALL      %-20s batches     %lu\n"
+             "ALL      %-20s queued      %lu\n"
+             "ALL      %-20s updated     %lu\n"
+             "ALL      %-20s merged      %lu\n", label.c_str(), stats.batches,
+             label.c_str(), stats.queued, label.c_str(), stats.updated,
+             label.c_str(), stats.merged);
+    oss << sline;
+    snprintf(sline, sizeof(sline), "ALL      %-20s last batch  %lu queued "
+             "%lu updated %lu us resolve %lu us locked\n"
+             "ALL      %-20s lock time   %lu us total %lu us max\n",
+             label.c_str(), stats.lastQueued, stats.lastUpdated,
+             stats.lastResolveUs, stats.lastLockUs, label.c_str(),
+             stats.totalLockUs, stats.maxLockUs);
+    oss << sline;
+  }
+}
+
 //------------------------------------------------------------------------------
 // Execute stat command
 //------------------------------------------------------------------------------
@@ -279,10 +402,15 @@ NsCmd::StatSubcmd(const eos::console::NsProto_StatProto& stat)
   auto chlog_dir_svc = dynamic_cast<eos::IChLogContainerMDSvc*>
                        (gOFS->eosDirectoryService);
 
+  std::vector<eos::BootPhaseStatistics> boot_phases;
+
   if (chlog_file_svc && chlog_dir_svc) {
     latencyf = statf.st_size - chlog_file_svc->getFollowOffset();
     latencyd = statd.st_size - chlog_dir_svc->getFollowOffset();
     latencyp = chlog_file_svc->getFollowPending();
+    boot_phases = chlog_dir_svc->getBootStatistics();
+    auto file_phases = chlog_file_svc->getBootStatistics();
+    boot_phases.insert(boot_phases.end(), file_phases.begin(), file_phases.end());
   }
 
   std::string master_status = gOFS->mMaster->PrintOut();
@@ -293,6 +421,40 @@ NsCmd::StatSubcmd(const eos::console::NsProto_StatProto& stat)
     master->PrintOutCompacting(compact_status);
   }
 
+  // Statistics of the tree size and sync time accounting, only available for
+  // the QDB namespace
+  eos::QuarkContainerAccounting* cont_acc =
+    dynamic_cast<eos::QuarkContainerAccounting*>(gOFS->eosContainerAccounting);
+  eos::QuarkSyncTimeAccounting* sync_acc =
+    dynamic_cast<eos::QuarkSyncTimeAccounting*>(gOFS->eosSyncTimeAccounting);
+  eos::QuarkContainerAccounting::Statistics cont_acc_stats;
+  eos::QuarkSyncTimeAccounting::Statistics sync_acc_stats;
+
+  if (cont_acc) {
+    cont_acc_stats = cont_acc->GetStatistics();
+  }
+
+  if (sync_acc) {
+    sync_acc_stats = sync_acc->GetStatistics();
+  }
+
+  // Statistics of the quota updates and of the flusher queues, only available
+  // for the QDB namespace. The in-memory namespace has its own QuotaStats
+  // class, therefore check the namespace type before casting.
+  eos::QuotaStats* quota_stats = nullptr;
+  eos::QuotaStats::Statistics quota_upd_stats;
+  std::map<std::string, eos::MetadataFlusher::Statistics> flusher_stats;
+
+  if (gOFS->NsInQDB) {
+    quota_stats = dynamic_cast<eos::QuotaStats*>(gOFS->eosView->getQuotaStats());
+
+    if (quota_stats) {
+      quota_upd_stats = quota_stats->getStatistics();
+    }
+
+    flusher_stats = eos::MetadataFlusherFactory::getStatistics();
+  }
+
   if (stat.monitor()) {
     oss << "uid=all gid=all ns.total.files=" << f << std::endl
         << "uid=all gid=all ns.total.directories=" << d << std::endl
@@ -343,6 +505,71 @@ NsCmd::StatSubcmd(const eos::console::NsProto_StatProto& stat)
     oss << "uid=all gid=all ns.uptime="
         << (int)(time(NULL) - gOFS->mStartTime)
         << std::endl;
+
+    for (const auto& phase : boot_phases) {
+      std::string key = "uid=all gid=all ns.boot.phase." + phase.name;
+      oss << key << ".time=" << phase.seconds << std::endl
+          << key << ".items=" << phase.items << std::endl
+          << key << ".rate="
+          << (phase.seconds ? phase.items / phase.seconds : 0.0) << std::endl
+          << key << ".threads=" << phase.threads << std::endl;
+    }
+
+    CacheStatistics fileCacheStats = gOFS->eosFileService->getCacheStatistics();
+    CacheStatistics containerCacheStats =
+      gOFS->eosDirectoryService->getCacheStatistics();
+
+    if (fileCacheStats.enabled || containerCacheStats.enabled) {
+      oss << "uid=all gid=all ns.cache.files.hits=" << fileCacheStats.hits
+          << std::endl
+          << "uid=all gid=all ns.cache.files.misses=" << fileCacheStats.misses
+          << std::endl
+          << "uid=all gid=all ns.cache.files.coalesced="
+          << fileCacheStats.coalesced << std::endl
+          << "uid=all gid=all ns.cache.files.inflight=" << fileCacheStats.inFlight
+          << std::endl
+          << "uid=all gid=all ns.cache.containers.hits=" << containerCacheStats.hits
+          << std::endl
+          << "uid=all gid=all ns.cache.containers.misses="
+          << containerCacheStats.misses << std::endl
+          << "uid=all gid=all ns.cache.containers.coalesced="
+          << containerCacheStats.coalesced << std::endl
+          << "uid=all gid=all ns.cache.containers.inflight="
+          << containerCacheStats.inFlight << std::endl;
+    }
+
+    if (cont_acc) {
+      PrintAccountingStatistics(oss, "container", "", cont_acc_stats, true);
+    }
+
+    if (sync_acc) {
+      PrintAccountingStatistics(oss, "synctime", "", sync_acc_stats, true);
+      oss << "uid=all gid=all ns.accounting.synctime.skipped="
+          << sync_acc_stats.skipped << std::endl
+          << "uid=all gid=all ns.accounting.synctime.last_skipped="
+          << sync_acc_stats.lastSkipped << std::endl;
+    }
+
+    if (quota_stats) {
+      oss << "uid=all gid=all ns.quota.updates=" << quota_upd_stats.updates
+          << std::endl
+          << "uid=all gid=all ns.quota.flushes=" << quota_upd_stats.flushes
+          << std::endl
+          << "uid=all gid=all ns.quota.requests=" << quota_upd_stats.requests
+          << std::endl
+          << "uid=all gid=all ns.quota.replayed=" << quota_upd_stats.replayed
+          << std::endl
+          << "uid=all gid=all ns.quota.pending_nodes="
+          << quota_upd_stats.pendingNodes << std::endl;
+    }
+
+    for (const auto& elem : flusher_stats) {
+      std::string prefix = "uid=all gid=all ns.flusher." + elem.first + ".";
+      oss << prefix << "pending=" << elem.second.pending << std::endl
+          << prefix << "max_pending=" << elem.second.maxPending << std::endl
+          << prefix << "enqueued=" << elem.second.enqueued << std::endl
+          << prefix << "acknowledged=" << elem.second.acknowledged << std::endl;
+    }
   } else {
     std::string line = "# ------------------------------------------------------"
                        "------------------------------";
@@ -357,6 +584,20 @@ NsCmd::StatSubcmd(const eos::console::NsProto_StatProto& stat)
         << boot_time << " s" << std::endl
         << line << std::endl;
 
+    if (!boot_phases.empty()) {
+      for (const auto& phase : boot_phases) {
+        char sphase[256];
+        snprintf(sphase, sizeof(sphase), "ALL      Boot %-28s%.01f s "
+                 "[ %lu items %.0f Hz %u threads ]", phase.name.c_str(),
+                 phase.seconds, phase.items,
+                 phase.seconds ? phase.items / phase.seconds : 0.0,
+                 phase.threads);
+        oss << sphase << std::endl;
+      }
+
+      oss << line << std::endl;
+    }
+
     if (compact_status.length()) {
       oss << "ALL      Compactification                 "
           << compact_status.c_str() << std::endl
@@ -402,23 +643,89 @@ NsCmd::StatSubcmd(const eos::console::NsProto_StatProto& stat)
     CacheStatistics containerCacheStats =
       gOFS->eosDirectoryService->getCacheStatistics();
 
+    auto cache_size_str = [](uint64_t size) -> std::string {
+      if (size == UINT64_MAX) {
+        return "unlimited";
+      }
+
+      std::string ssize;
+      return StringConversion::GetReadableSizeString(ssize, size, "B");
+    };
+
     if (fileCacheStats.enabled || containerCacheStats.enabled) {
       oss << "ALL      File cache max num               " << fileCacheStats.maxNum <<
           std::endl
           << "ALL      File cache occupancy             " << fileCacheStats.occupancy <<
           std::endl
+          << "ALL      File cache max size              "
+          << cache_size_str(fileCacheStats.maxSize) << std::endl
+          << "ALL      File cache estimated size        "
+          << cache_size_str(fileCacheStats.sizeBytes) << std::endl
           << "ALL      In-flight FileMD                 " << fileCacheStats.inFlight <<
           std::endl
+          << "ALL      File cache hits                  " << fileCacheStats.hits
+          << std::endl
+          << "ALL      File cache misses                " << fileCacheStats.misses
+          << std::endl
+          << "ALL      File cache coalesced             "
+          << fileCacheStats.coalesced << std::endl
           << "ALL      Container cache max num          " << containerCacheStats.maxNum
           << std::endl
           << "ALL      Container cache occupancy        " << containerCacheStats.occupancy
           << std::endl
+          << "ALL      Container cache max size         "
+          << cache_size_str(containerCacheStats.maxSize) << std::endl
+          << "ALL      Container cache estimated size   "
+          << cache_size_str(containerCacheStats.sizeBytes) << std::endl
           << "ALL      In-flight ContainerMD            " << containerCacheStats.inFlight
-          <<
-          std::endl
+          << std::endl
+          << "ALL      Container cache hits             " << containerCacheStats.hits
+          << std::endl
+          << "ALL      Container cache misses           "
+          << containerCacheStats.misses << std::endl
+          << "ALL      Container cache coalesced        "
+          << containerCacheStats.coalesced << std::endl
           << line << std::endl;
     }
 
+    if (cont_acc) {
+      PrintAccountingStatistics(oss, "container", "Container accounting",
+                                cont_acc_stats, false);
+      oss << line << std::endl;
+    }
+
+    if (sync_acc) {
+      PrintAccountingStatistics(oss, "synctime", "Sync time accounting",
+                                sync_acc_stats, false);
+      oss << "ALL      Sync time accounting skipped     "
+          << sync_acc_stats.skipped << " total " << sync_acc_stats.lastSkipped
+          << " last batch" << std::endl
+          << line << std::endl;
+    }
+
+    if (quota_stats) {
+      oss << "ALL      Quota updates                    "
+          << quota_upd_stats.updates << " accounted "
+          << quota_upd_stats.requests << " requests "
+          << quota_upd_stats.flushes << " flushes" << std::endl
+          << "ALL      Quota pending nodes              "
+          << quota_upd_stats.pendingNodes << " ("
+          << quota_upd_stats.replayed << " replayed at boot)" << std::endl;
+    }
+
+    for (const auto& elem : flusher_stats) {
+      char sline[256];
+      snprintf(sline, sizeof(sline), "ALL      Flusher %-16s queue  %ld pending "
+               "%ld max %ld enqueued %ld acknowledged\n", elem.first.c_str(),
+               elem.second.pending, elem.second.maxPending, elem.second.enqueued,
+               elem.second.acknowledged);
+      oss << sline;
+    }
+
+    if (quota_stats || !flusher_stats.empty()) {
+      oss << line << std::endl;
+    }
+
     // Do them one at a time otherwise sizestring is saved only the first time
     oss << "ALL      memory virtual                   "
         << StringConversion::GetReadableSizeString(sizestring, (unsigned long long)
@@ -455,6 +762,26 @@ NsCmd::StatSubcmd(const eos::console::NsProto_StatProto& stat)
         << line << std::endl;
   }
 
+  // Queue depth, task latency and steals of the main thread pools
+  oss << ProcInterface::sProcThreads.PrintMetrics(stat.monitor())
+      << gOFS->mDrainEngine.GetThreadPool().PrintMetrics(stat.monitor())
+      << WFE::gAsyncCommunicationPool.PrintMetrics(stat.monitor());
+
+  if (!stat.monitor()) {
+    oss << "# ------------------------------------------------------"
+        "------------------------------" << std::endl;
+  }
+
+  // Top contended call sites of the main mutexes
+  if (gOFS->eosViewRWMutex.GetContentionProfiler()) {
+    oss << gOFS->eosViewRWMutex.PrintContentionProfile("eosViewRWMutex", 10,
+        stat.monitor())
+        << FsView::gFsView.ViewMutex.PrintContentionProfile("FsView::ViewMutex",
+            10, stat.monitor())
+        << Quota::pMapMutex.PrintContentionProfile("Quota::pMapMutex", 10,
+            stat.monitor());
+  }
+
   if (!stat.summary()) {
     XrdOucString stats_out;
     gOFS->MgmStats.PrintOutTotal(stats_out, stat.groupids(), stat.monitor(),
@@ -38,6 +38,31 @@
 
 EOSMGMNAMESPACE_BEGIN
 
+//------------------------------------------------------------------------------
+// Get the max number of containers a QDB find fetches ahead of its cursor,
+// configurable through EOS_MGM_FIND_CONTAINERS_IN_FLIGHT, 0 disables the
+// prefetching
+//------------------------------------------------------------------------------
+static size_t getFindContainersInFlight()
+{
+  static const size_t sMaxInFlight = []() -> size_t {
+    const char* ptr = getenv("EOS_MGM_FIND_CONTAINERS_IN_FLIGHT");
+
+    if (ptr == nullptr) {
+      return 1000;
+    }
+
+    try {
+      return std::stoull(ptr);
+    } catch (const std::exception& e) {
+      eos_static_err("msg=\"invalid EOS_MGM_FIND_CONTAINERS_IN_FLIGHT, using "
+                     "the default\" value=\"%s\"", ptr);
+      return 1000;
+    }
+  }();
+  return sMaxInFlight;
+}
+
 //------------------------------------------------------------------------------
 // Based on the Uid/Gid of given FileMd / ContainerMd, should it be included
 // in the search results?
@@ -577,6 +602,7 @@ public:
     : qcl(qc), path(target)
   {
     ExplorationOptions options;
+    options.maxContainersInFlight = getFindContainersInFlight();
     explorer.reset(new NamespaceExplorer(path, options, *qcl));
   }
 
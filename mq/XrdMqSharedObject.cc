@@ -25,11 +25,16 @@
 #include "mq/XrdMqMessaging.hh"
 #include "common/Logging.hh"
 #include "common/StringConversion.hh"
+#include "common/SymKeys.hh"
 #include "XrdSys/XrdSysTimer.hh"
 #include "XrdOuc/XrdOucEnv.hh"
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <memory>
 #include <curl/curl.h>
 
 using eos::common::RWMutexReadLock;
@@ -183,7 +188,8 @@ XrdMqSharedHash::XrdMqSharedHash(const char* subject, const char* bcast_queue,
                                  XrdMqSharedObjectManager* som):
   mType("hash"), mSOM(som), mSubject((subject ? subject : "")),
   mIsTransaction(false), mBroadcastQueue((bcast_queue ? bcast_queue : "")),
-  mTransactMutex(new XrdSysMutex()), mStoreMutex(new eos::common::RWMutex())
+  mTransactMutex(new XrdSysMutex()), mStoreMutex(new eos::common::RWMutex()),
+  mPendingMutex(new XrdSysMutex())
 {}
 
 //------------------------------------------------------------------------------
@@ -205,6 +211,7 @@ XrdMqSharedHash::operator=(XrdMqSharedHash&& other)
     mSOM = nullptr;
     mTransactMutex.reset(nullptr);
     mStoreMutex.reset(nullptr);
+    mPendingMutex.reset(nullptr);
     mType = other.mType;
     std::swap(mSOM, other.mSOM);
     mSubject = other.mSubject;
@@ -215,6 +222,9 @@ XrdMqSharedHash::operator=(XrdMqSharedHash&& other)
     std::swap(mTransactions, other.mTransactions);
     std::swap(mTransactMutex, other.mTransactMutex);
     std::swap(mStoreMutex, other.mStoreMutex);
+    std::swap(mPending, other.mPending);
+    std::swap(mPendingMutex, other.mPendingMutex);
+    std::swap(mPublished, other.mPublished);
   }
 
   return *this;
@@ -401,56 +411,82 @@ XrdMqSharedHash::CloseTransaction()
   bool retval = true;
 
   if (mSOM->mBroadcast && mTransactions.size()) {
-    XrdOucString txmessage = "";
-    MakeUpdateEnvHeader(txmessage);
-    AddTransactionsToEnvString(txmessage, false);
-
-    if (txmessage.length() > (2 * 1000 * 1000)) {
-      // Set the message size limit to 2M, if the message is bigger then just
-      // send transaction item by item.
-      for (auto it = mTransactions.begin(); it != mTransactions.end(); ++it) {
-        txmessage = "";
-        MakeUpdateEnvHeader(txmessage);
-        txmessage += "&";
-        txmessage += XRDMQSHAREDHASH_PAIRS;
-        txmessage += "=";
-        RWMutexReadLock rd_lock(*mStoreMutex);
-
-        if ((mStore.count(it->c_str()))) {
-          txmessage += "|";
-          txmessage += it->c_str();
-          txmessage += "~";
-          txmessage += mStore[it->c_str()].GetValue();
-          txmessage += "%";
-          char cid[1024];
-          snprintf(cid, sizeof(cid) - 1, "%llu", mStore[it->c_str()].GetChangeId());
-          txmessage += cid;
-        }
+    std::string body;
+    size_t header_len = 0;
 
-        XrdMqMessage message("XrdMqSharedHashMessage");
-        message.SetBody(txmessage.c_str());
-        message.MarkAsMonitor();
-        retval &= XrdMqMessaging::gMessageClient.SendMessage(message,
-                  mBroadcastQueue.c_str(), false, false, true);
-      }
+    if (mSOM->mBinaryEncoding) {
+      MakeBinaryHeader(body, "update");
+      header_len = body.length();
+      AddTransactionsToBinary(body, mTransactions.cbegin());
     } else {
-      XrdMqMessage message("XrdMqSharedHashMessage");
-      message.SetBody(txmessage.c_str());
-      message.MarkAsMonitor();
-      retval &= XrdMqMessaging::gMessageClient.SendMessage(message,
-                mBroadcastQueue.c_str(), false, false, true);
+      XrdOucString txmessage = "";
+      MakeUpdateEnvHeader(txmessage);
+      AddTransactionsToEnvString(txmessage, false);
+      body = txmessage.c_str();
+    }
+
+    mSOM->CompressBody(body);
+
+    if (body.length() > sMaxMessageSize) {
+      // Set the message size limit to 2M, if the message is bigger even after
+      // compression then split it
+      if (mSOM->mBinaryEncoding) {
+        // Fill every message up to the limit
+        auto it = mTransactions.cbegin();
+
+        while (it != mTransactions.cend()) {
+          MakeBinaryHeader(body, "update");
+          it = AddTransactionsToBinary(body, it, sMaxMessageSize);
+
+          if (body.length() > header_len) {
+            retval &= mSOM->SendBody(body, mBroadcastQueue.c_str());
+          }
+        }
+      } else {
+        // Send transaction item by item
+        for (auto it = mTransactions.begin(); it != mTransactions.end(); ++it) {
+          XrdOucString txmessage = "";
+          MakeUpdateEnvHeader(txmessage);
+          txmessage += "&";
+          txmessage += XRDMQSHAREDHASH_PAIRS;
+          txmessage += "=";
+          {
+            RWMutexReadLock rd_lock(*mStoreMutex);
+
+            if ((mStore.count(it->c_str()))) {
+              txmessage += "|";
+              txmessage += it->c_str();
+              txmessage += "~";
+              txmessage += mStore[it->c_str()].GetValue();
+              txmessage += "%";
+              char cid[1024];
+              snprintf(cid, sizeof(cid) - 1, "%llu", mStore[it->c_str()].GetChangeId());
+              txmessage += cid;
+            }
+          }
+          body = txmessage.c_str();
+          retval &= mSOM->SendBody(body, mBroadcastQueue.c_str());
+        }
+      }
+    } else if (body.length() != header_len) {
+      retval &= mSOM->SendBody(body, mBroadcastQueue.c_str());
     }
   }
 
   if (mSOM->mBroadcast && mDeletions.size()) {
-    XrdOucString txmessage = "";
-    MakeDeletionEnvHeader(txmessage);
-    AddDeletionsToEnvString(txmessage);
-    XrdMqMessage message("XrdMqSharedHashMessage");
-    message.SetBody(txmessage.c_str());
-    message.MarkAsMonitor();
-    retval &= XrdMqMessaging::gMessageClient.SendMessage(message,
-              mBroadcastQueue.c_str(), false, false, true);
+    std::string body;
+
+    if (mSOM->mBinaryEncoding) {
+      MakeBinaryHeader(body, "delete");
+      AddDeletionsToBinary(body);
+    } else {
+      XrdOucString txmessage = "";
+      MakeDeletionEnvHeader(txmessage);
+      AddDeletionsToEnvString(txmessage);
+      body = txmessage.c_str();
+    }
+
+    retval &= mSOM->SendBody(body, mBroadcastQueue.c_str());
   }
 
   mTransactions.clear();
@@ -459,6 +495,27 @@ XrdMqSharedHash::CloseTransaction()
   return retval;
 }
 
+//-------------------------------------------------------------------------------
+// Broadcast the updates held back by the coalescing window
+//-------------------------------------------------------------------------------
+bool
+XrdMqSharedHash::FlushPending()
+{
+  std::set<std::string> pending;
+  {
+    XrdSysMutexHelper lock(*mPendingMutex);
+    pending.swap(mPending);
+  }
+
+  if (pending.empty()) {
+    return true;
+  }
+
+  mTransactMutex->Lock();
+  mTransactions = std::move(pending);
+  return CloseTransaction();
+}
+
 //-------------------------------------------------------------------------------
 // Construct broadcast env header
 //-------------------------------------------------------------------------------
@@ -527,13 +584,30 @@ XrdMqSharedHash::MakeRemoveEnvHeader(XrdOucString& out)
   out += mType.c_str();
 }
 
+//-------------------------------------------------------------------------------
+// Construct header of a binary encoded message
+//-------------------------------------------------------------------------------
+void
+XrdMqSharedHash::MakeBinaryHeader(std::string& out, const char* cmd)
+{
+  // Encode the header as "mqsh.bin:<cmd><subject><type><reply>" with each of
+  // them being a length-prefixed field
+  out = XRDMQSHAREDHASH_BINARY;
+  XrdMqSharedObjectManager::AppendBinaryField(out, cmd, strlen(cmd));
+  XrdMqSharedObjectManager::AppendBinaryField(out, mSubject.c_str(),
+      mSubject.length());
+  XrdMqSharedObjectManager::AppendBinaryField(out, mType.c_str(),
+      mType.length());
+  XrdMqSharedObjectManager::AppendBinaryField(out, "", 0);
+}
+
 //-------------------------------------------------------------------------------
 // Broadcast hash as env string
 //-------------------------------------------------------------------------------
 bool
 XrdMqSharedHash::BroadCastEnvString(const char* receiver)
 {
-  XrdOucString txmessage = "";
+  std::string body;
   {
     XrdSysMutexHelper lock(*mTransactMutex);
     mTransactions.clear();
@@ -545,24 +619,31 @@ XrdMqSharedHash::BroadCastEnvString(const char* receiver)
         mTransactions.insert(it->first);
       }
     }
-    MakeBroadCastEnvHeader(txmessage);
-    // This will also clear the mTransactions set
-    AddTransactionsToEnvString(txmessage);
+
+    if (mSOM->mBinaryEncoding) {
+      // The receiver clears the hash for every broadcast reply, therefore
+      // it is never split into several messages
+      MakeBinaryHeader(body, "bcreply");
+      AddTransactionsToBinary(body, mTransactions.cbegin());
+      mTransactions.clear();
+    } else {
+      XrdOucString txmessage = "";
+      MakeBroadCastEnvHeader(txmessage);
+      // This will also clear the mTransactions set
+      AddTransactionsToEnvString(txmessage);
+      body = txmessage.c_str();
+    }
+
     mIsTransaction = false;
   }
 
   if (mSOM->mBroadcast) {
-    XrdMqMessage message("XrdMqSharedHashMessage");
-    message.SetBody(txmessage.c_str());
-    message.MarkAsMonitor();
-
     if (XrdMqSharedObjectManager::sDebug) {
       fprintf(stderr, "XrdMqSharedObjectManager::BroadCastEnvString=>[%s]=>%s \n",
               mSubject.c_str(), receiver);
     }
 
-    return XrdMqMessaging::gMessageClient.SendMessage(message, receiver, false,
-           false, true);
+    return mSOM->SendBody(body, receiver);
   }
 
   return true;
@@ -620,6 +701,51 @@ XrdMqSharedHash::AddDeletionsToEnvString(XrdOucString& out)
   mDeletions.clear();
 }
 
+//-------------------------------------------------------------------------------
+// Encode transactions as binary records - this must be called with the
+// mTransactMutex locked.
+//-------------------------------------------------------------------------------
+std::set<std::string>::const_iterator
+XrdMqSharedHash::AddTransactionsToBinary(std::string& out,
+    std::set<std::string>::const_iterator it, size_t max_size)
+{
+  // Encode every transaction as "<key><value>" with both of them being
+  // length-prefixed fields, keys which are gone in the meantime are skipped
+  RWMutexReadLock rd_lock(*mStoreMutex);
+  bool added = false;
+
+  for (; it != mTransactions.cend(); ++it) {
+    if (added && (out.length() > max_size)) {
+      break;
+    }
+
+    auto entry = mStore.find(*it);
+
+    if (entry != mStore.end()) {
+      const char* value = entry->second.GetValue();
+      XrdMqSharedObjectManager::AppendBinaryField(out, it->c_str(), it->length());
+      XrdMqSharedObjectManager::AppendBinaryField(out, value, strlen(value));
+      added = true;
+    }
+  }
+
+  return it;
+}
+
+//-------------------------------------------------------------------------------
+// Encode deletions as binary records - this must be called with the
+// mTransactMutex locked.
+//-------------------------------------------------------------------------------
+void
+XrdMqSharedHash::AddDeletionsToBinary(std::string& out)
+{
+  for (auto it = mDeletions.begin(); it != mDeletions.end(); ++it) {
+    XrdMqSharedObjectManager::AppendBinaryField(out, it->c_str(), it->length());
+  }
+
+  mDeletions.clear();
+}
+
 //-------------------------------------------------------------------------------
 // Build and send broadcast request
 //-------------------------------------------------------------------------------
@@ -676,6 +802,7 @@ XrdMqSharedHash::Delete(const std::string& key, bool broadcast)
 
   if (mStore.count(key)) {
     mStore.erase(key);
+    mPublished.erase(key);
     deleted = true;
 
     if (mSOM->mBroadcast && broadcast) {
@@ -736,6 +863,7 @@ XrdMqSharedHash::Clear(bool broadcast)
   }
 
   mStore.clear();
+  mPublished.clear();
 }
 
 //-------------------------------------------------------------------------------
@@ -748,10 +876,26 @@ XrdMqSharedHash::SetImpl(const char* key, const char* value, bool broadcast)
   {
     RWMutexWriteLock wr_lock(*mStoreMutex);
 
-    if (mStore.count(skey) == 0) {
+    auto it = mStore.find(skey);
+
+    if (it == mStore.end()) {
       mStore.insert(std::make_pair(skey, XrdMqSharedHashEntry(key, value)));
     } else {
-      mStore[skey] = XrdMqSharedHashEntry(key, value);
+      it->second = XrdMqSharedHashEntry(key, value);
+    }
+
+    // In delta publishing mode insignificant updates are only stored locally,
+    // the significance is judged against the last value broadcast for the key
+    if (broadcast && mSOM->mBroadcast && mSOM->mDeltaPublishing) {
+      auto pit = mPublished.find(skey);
+
+      if ((pit != mPublished.end()) &&
+          !mSOM->IsSignificantChange(skey, pit->second.GetValue(), value,
+                                     pit->second.GetAgeInSeconds())) {
+        broadcast = false;
+      } else {
+        mPublished[skey] = XrdMqSharedHashEntry(key, value);
+      }
     }
   }
 
@@ -770,7 +914,13 @@ XrdMqSharedHash::SetImpl(const char* key, const char* value, bool broadcast)
       }
     }
 
-    if (!is_transact) {
+    if (!is_transact && !mIsTransaction && mSOM->mCoalescingWindowMs &&
+        (mType == "hash")) {
+      // Held back and broadcast by the coalescer together with the other
+      // updates of the current window
+      XrdSysMutexHelper lock(*mPendingMutex);
+      mPending.insert(skey);
+    } else if (!is_transact) {
       // Emulate a transaction for a single set operation
       bool emulate_transact = false;
 
@@ -2419,6 +2569,10 @@ XrdMqSharedObjectManager::XrdMqSharedObjectManager():
     XrdSysMutexHelper mLock(MuxTransactionsMutex);
     MuxTransactions.clear();
   }
+  const char* binary = getenv("EOS_MQ_BINARY_ENCODING");
+  mBinaryEncoding = (binary && (atoi(binary) == 1));
+  const char* compression = getenv("EOS_MQ_COMPRESSION_THRESHOLD");
+  mCompressionThreshold = (compression ? strtoull(compression, 0, 10) : 0);
 }
 
 //------------------------------------------------------------------------------
@@ -2426,6 +2580,7 @@ XrdMqSharedObjectManager::XrdMqSharedObjectManager():
 //------------------------------------------------------------------------------
 XrdMqSharedObjectManager::~XrdMqSharedObjectManager()
 {
+  mCoalescerTid.join();
   mDumperTid.join();
 
   for (auto it = mHashSubjects.begin(); it != mHashSubjects.end(); ++it) {
@@ -2759,37 +2914,95 @@ XrdMqSharedObjectManager::ParseEnvMessage(XrdMqMessage* message,
     return false;
   }
 
-  XrdOucEnv env(message->GetBody());
-  int envlen;
-  env.Env(envlen);
+  const char* body = message->GetBody();
+  std::string uncompressed;
 
-  if (sDebug) {
-    env.Env(envlen);
-    fprintf(stderr, "XrdMqSharedObjectManager::ParseEnvMessage=> size=%d text=%s\n",
-            envlen, env.Env(envlen));
-  }
+  if (!strncmp(body, XRDMQSHAREDHASH_COMPRESSED,
+               strlen(XRDMQSHAREDHASH_COMPRESSED))) {
+    std::string compressed = body;
 
-  if (env.Get(XRDMQSHAREDHASH_SUBJECT)) {
-    subject = env.Get(XRDMQSHAREDHASH_SUBJECT);
-  } else {
-    error = "no subject in message body";
-    return false;
-  }
+    if (!eos::common::SymKey::ZDeBase64(compressed, uncompressed)) {
+      error = "cannot uncompress message body";
+      return false;
+    }
 
-  if (env.Get(XRDMQSHAREDHASH_REPLY)) {
-    reply = env.Get(XRDMQSHAREDHASH_REPLY);
-  } else {
-    reply = "";
+    body = uncompressed.c_str();
   }
 
-  if (env.Get(XRDMQSHAREDHASH_TYPE)) {
-    type = env.Get(XRDMQSHAREDHASH_TYPE);
+  std::unique_ptr<XrdOucEnv> env;
+  int envlen = 0;
+  // Binary encoded messages are parsed in place in a copy of the body
+  std::string bin_body;
+  size_t bin_pos = 0;
+  std::string cmd;
+
+  if (!strncmp(body, XRDMQSHAREDHASH_BINARY, strlen(XRDMQSHAREDHASH_BINARY))) {
+    bin_body = body;
+    bin_pos = strlen(XRDMQSHAREDHASH_BINARY);
+    const char* fields[4];
+
+    for (size_t i = 0; i < 4; ++i) {
+      if (!(fields[i] = ParseBinaryField(bin_body, bin_pos))) {
+        error = "binary message with malformed header";
+        return false;
+      }
+    }
+
+    cmd = fields[0];
+    subject = fields[1];
+    type = fields[2];
+    reply = fields[3];
+
+    if (sDebug) {
+      fprintf(stderr, "XrdMqSharedObjectManager::ParseEnvMessage=> size=%zu "
+              "binary cmd=%s subject=%s\n", bin_body.length(), cmd.c_str(),
+              subject.c_str());
+    }
+
+    if (subject.empty()) {
+      error = "no subject in message body";
+      return false;
+    }
+
+    if (type.empty()) {
+      error = "no hash type in message body";
+      return false;
+    }
   } else {
-    error = "no hash type in message body";
-    return false;
+    env.reset(new XrdOucEnv(body));
+    env->Env(envlen);
+
+    if (sDebug) {
+      fprintf(stderr, "XrdMqSharedObjectManager::ParseEnvMessage=> size=%d text=%s\n",
+              envlen, env->Env(envlen));
+    }
+
+    if (env->Get(XRDMQSHAREDHASH_SUBJECT)) {
+      subject = env->Get(XRDMQSHAREDHASH_SUBJECT);
+    } else {
+      error = "no subject in message body";
+      return false;
+    }
+
+    if (env->Get(XRDMQSHAREDHASH_REPLY)) {
+      reply = env->Get(XRDMQSHAREDHASH_REPLY);
+    } else {
+      reply = "";
+    }
+
+    if (env->Get(XRDMQSHAREDHASH_TYPE)) {
+      type = env->Get(XRDMQSHAREDHASH_TYPE);
+    } else {
+      error = "no hash type in message body";
+      return false;
+    }
+
+    if (env->Get(XRDMQSHAREDHASH_CMD)) {
+      cmd = env->Get(XRDMQSHAREDHASH_CMD);
+    }
   }
 
-  if (env.Get(XRDMQSHAREDHASH_CMD)) {
+  if (!cmd.empty()) {
     HashMutex.LockRead();
     XrdMqSharedHash* sh = 0;
     std::vector<std::string> subjectlist;
@@ -2845,7 +3058,7 @@ XrdMqSharedObjectManager::ParseEnvMessage(XrdMqMessage* message,
 
     XrdOucString ftag = XRDMQSHAREDHASH_CMD;
     ftag += "=";
-    ftag += env.Get(XRDMQSHAREDHASH_CMD);
+    ftag += cmd.c_str();
 
     if (subjectlist.size() > 0) {
       sh = GetObject(subjectlist[0].c_str(), type.c_str());
@@ -2944,7 +3157,12 @@ XrdMqSharedObjectManager::ParseEnvMessage(XrdMqMessage* message,
       // from here on we have a read lock on 'sh'
 
       if ((ftag == XRDMQSHAREDHASH_UPDATE) || (ftag == XRDMQSHAREDHASH_BCREPLY)) {
-        std::string val = (env.Get(XRDMQSHAREDHASH_PAIRS) ? env.Get(
+        if (!env) {
+          return ApplyBinaryPairs(bin_body, bin_pos, subjectlist, type,
+                                  (ftag == XRDMQSHAREDHASH_BCREPLY), error);
+        }
+
+        std::string val = (env->Get(XRDMQSHAREDHASH_PAIRS) ? env->Get(
                              XRDMQSHAREDHASH_PAIRS) : "");
 
         if (val.length() == 0) {
@@ -3071,13 +3289,29 @@ XrdMqSharedObjectManager::ParseEnvMessage(XrdMqMessage* message,
         return success;
       }
 
-      if (ftag == XRDMQSHAREDHASH_DELETE) {
-        std::string val = (env.Get(XRDMQSHAREDHASH_KEYS) ? env.Get(
+      if ((ftag == XRDMQSHAREDHASH_DELETE) && !env) {
+        if (bin_pos >= bin_body.length()) {
+          error = "no keys in message body";
+          return false;
+        }
+
+        while (bin_pos < bin_body.length()) {
+          const char* key = ParseBinaryField(bin_body, bin_pos);
+
+          if (!key) {
+            error = "delete: parsing error in binary keys";
+            return false;
+          }
+
+          sh->Delete(key, false);
+        }
+      } else if (ftag == XRDMQSHAREDHASH_DELETE) {
+        std::string val = (env->Get(XRDMQSHAREDHASH_KEYS) ? env->Get(
                              XRDMQSHAREDHASH_KEYS) : "");
 
         if (val.length() <= 1) {
           error = "no keys in message body : ";
-          error += env.Env(envlen);
+          error += env->Env(envlen);
           return false;
         }
 
@@ -3126,6 +3360,276 @@ XrdMqSharedObjectManager::ParseEnvMessage(XrdMqMessage* message,
   return false;
 }
 
+//------------------------------------------------------------------------------
+// Loop broadcasting the updates held back by the coalescing window
+//------------------------------------------------------------------------------
+void
+XrdMqSharedObjectManager::Coalescer(ThreadAssistant& assistant) noexcept
+{
+  while (!assistant.terminationRequested()) {
+    assistant.wait_for(std::chrono::milliseconds(mCoalescingWindowMs));
+    RWMutexReadLock lock(HashMutex);
+
+    for (auto it = mHashSubjects.begin(); it != mHashSubjects.end(); ++it) {
+      it->second->FlushPending();
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Set the coalescing window
+//------------------------------------------------------------------------------
+void
+XrdMqSharedObjectManager::SetCoalescingWindow(std::chrono::milliseconds
+    window)
+{
+  mCoalescerTid.join();
+  mCoalescingWindowMs = window.count();
+
+  if (window.count() > 0) {
+    mCoalescerTid.reset(&XrdMqSharedObjectManager::Coalescer, this);
+  } else {
+    // Send what is still held back
+    RWMutexReadLock lock(HashMutex);
+
+    for (auto it = mHashSubjects.begin(); it != mHashSubjects.end(); ++it) {
+      it->second->FlushPending();
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Switch the delta publishing mode on or off
+//------------------------------------------------------------------------------
+void
+XrdMqSharedObjectManager::EnableDeltaPublishing(bool enable,
+    std::chrono::seconds refresh)
+{
+  mPublishRefresh = refresh.count();
+  mDeltaPublishing = enable;
+}
+
+//------------------------------------------------------------------------------
+// Set the significance threshold of a numeric key
+//------------------------------------------------------------------------------
+void
+XrdMqSharedObjectManager::SetPublishThreshold(const std::string& key,
+    double absolute, double relative)
+{
+  XrdSysMutexHelper lock(mPublishMutex);
+  mPublishThresholds[key] = PublishThreshold {absolute, relative};
+}
+
+//------------------------------------------------------------------------------
+// Decide if an update of a published value has to be broadcast
+//------------------------------------------------------------------------------
+bool
+XrdMqSharedObjectManager::IsSignificantChange(const std::string& key,
+    const char* old_value, const char* new_value, double age)
+{
+  if (age >= mPublishRefresh) {
+    return true;
+  }
+
+  if (!strcmp(old_value, new_value)) {
+    return false;
+  }
+
+  PublishThreshold threshold;
+  {
+    XrdSysMutexHelper lock(mPublishMutex);
+    auto it = mPublishThresholds.find(key);
+
+    if (it == mPublishThresholds.end()) {
+      return true;
+    }
+
+    threshold = it->second;
+  }
+  char* old_end = nullptr;
+  char* new_end = nullptr;
+  double old_num = strtod(old_value, &old_end);
+  double new_num = strtod(new_value, &new_end);
+
+  if ((old_end == old_value) || *old_end || (new_end == new_value) || *new_end) {
+    // Not numeric
+    return true;
+  }
+
+  double delta = fabs(new_num - old_num);
+  return ((delta > threshold.mAbsolute) &&
+          (delta > threshold.mRelative * fabs(old_num)));
+}
+
+//------------------------------------------------------------------------------
+// Compress the message body if it exceeds the compression threshold
+//------------------------------------------------------------------------------
+void
+XrdMqSharedObjectManager::CompressBody(std::string& body)
+{
+  size_t threshold = mCompressionThreshold;
+
+  if (!threshold || (body.length() <= threshold) ||
+      !body.compare(0, strlen(XRDMQSHAREDHASH_COMPRESSED),
+                    XRDMQSHAREDHASH_COMPRESSED)) {
+    return;
+  }
+
+  std::string compressed;
+
+  if (eos::common::SymKey::ZBase64(body, compressed) &&
+      (compressed.length() < body.length())) {
+    body.swap(compressed);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Send a shared hash message
+//------------------------------------------------------------------------------
+bool
+XrdMqSharedObjectManager::SendBody(std::string& body, const char* receiver)
+{
+  CompressBody(body);
+  XrdMqMessage message("XrdMqSharedHashMessage");
+  message.SetBody(body.c_str());
+  message.MarkAsMonitor();
+  return XrdMqMessaging::gMessageClient.SendMessage(message, receiver, false,
+         false, true);
+}
+
+//------------------------------------------------------------------------------
+// Apply the key-value records of a binary encoded update message
+//------------------------------------------------------------------------------
+bool
+XrdMqSharedObjectManager::ApplyBinaryPairs(std::string& buf, size_t pos,
+    const std::vector<std::string>& subjects, const std::string& type,
+    bool bcreply, XrdOucString& error)
+{
+  if (pos >= buf.length()) {
+    error = "no pairs in message body";
+    return false;
+  }
+
+  std::vector<XrdMqSharedHash*> hashes;
+  hashes.reserve(subjects.size());
+
+  for (const auto& subject : subjects) {
+    XrdMqSharedHash* sh = GetObject(subject.c_str(), type.c_str());
+
+    if (!sh) {
+      error = "update: subject does not exist (FATAL!)";
+      return false;
+    }
+
+    if (bcreply) {
+      // we don't have to broad cast this clear => it is a broad cast reply
+      sh->Clear(false);
+    }
+
+    hashes.push_back(sh);
+  }
+
+  if (hashes.empty()) {
+    error = "update: no subject in message";
+    return false;
+  }
+
+  while (pos < buf.length()) {
+    size_t value_len = 0;
+    const char* key = ParseBinaryField(buf, pos);
+    const char* value = (key ? ParseBinaryField(buf, pos, &value_len) : nullptr);
+
+    if (!value) {
+      error = "update: parsing error in binary pairs";
+      return false;
+    }
+
+    // Multiplexed updates have the #<subject-index># as key prefix
+    XrdMqSharedHash* sh = hashes[0];
+
+    if (key[0] == '#') {
+      char* end = nullptr;
+      unsigned long index = strtoul(key + 1, &end, 10);
+
+      if ((end != key + 1) && (*end == '#') && (index < hashes.size())) {
+        sh = hashes[index];
+        key = end + 1;
+      }
+    }
+
+    if (sDebug) {
+      fprintf(stderr,
+              "XrdMqSharedObjectManager::ParseEnvMessage=>Setting [%s] %s=> %s\n",
+              sh->GetSubject(), key, value);
+    }
+
+    if (value_len == 0) {
+      fprintf(stderr, "Error: key=%s uses an empty value!\n", key);
+      continue;
+    }
+
+    // Set entry without broadcast straight from the message buffer
+    XrdMqSharedHash::sSetCounter++;
+    sh->SetImpl(key, value, false);
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Append a length-prefixed field to a binary encoded message
+//------------------------------------------------------------------------------
+void
+XrdMqSharedObjectManager::AppendBinaryField(std::string& out, const char* data,
+    size_t len)
+{
+  char prefix[32];
+  int prefix_len = snprintf(prefix, sizeof(prefix), "%zu:", len);
+  out.append(prefix, prefix_len);
+  out.append(data, len);
+  out += ',';
+}
+
+//------------------------------------------------------------------------------
+// Parse a length-prefixed field of a binary encoded message in place
+//------------------------------------------------------------------------------
+const char*
+XrdMqSharedObjectManager::ParseBinaryField(std::string& buf, size_t& pos,
+    size_t* len)
+{
+  size_t field_len = 0;
+  size_t ptr = pos;
+
+  while ((ptr < buf.length()) && isdigit(buf[ptr])) {
+    field_len = 10 * field_len + (buf[ptr] - '0');
+
+    if (field_len > buf.length()) {
+      return nullptr;
+    }
+
+    ++ptr;
+  }
+
+  if ((ptr == pos) || (ptr >= buf.length()) || (buf[ptr] != ':')) {
+    return nullptr;
+  }
+
+  ++ptr;
+
+  if ((buf.length() - ptr <= field_len) || (buf[ptr + field_len] != ',')) {
+    return nullptr;
+  }
+
+  buf[ptr + field_len] = '\0';
+  pos = ptr + field_len + 1;
+
+  if (len) {
+    *len = field_len;
+  }
+
+  return &buf[ptr];
+}
+
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
@@ -3154,14 +3658,18 @@ XrdMqSharedObjectManager::CloseMuxTransaction()
   XrdSysMutexHelper mLock(MuxTransactionsMutex);
 
   if (MuxTransactions.size()) {
-    XrdOucString txmessage = "";
-    MakeMuxUpdateEnvHeader(txmessage);
-    AddMuxTransactionEnvString(txmessage);
-    XrdMqMessage message("XrdMqSharedHashMessage");
-    message.SetBody(txmessage.c_str());
-    message.MarkAsMonitor();
-    XrdMqMessaging::gMessageClient.SendMessage(message,
-        MuxTransactionBroadCastQueue.c_str(), false, false, true);
+    std::string body;
+
+    if (mBinaryEncoding) {
+      MakeMuxTransactionBinary(body);
+    } else {
+      XrdOucString txmessage = "";
+      MakeMuxUpdateEnvHeader(txmessage);
+      AddMuxTransactionEnvString(txmessage);
+      body = txmessage.c_str();
+    }
+
+    SendBody(body, MuxTransactionBroadCastQueue.c_str());
   }
 
   IsMuxTransaction = false;
@@ -3245,6 +3753,57 @@ XrdMqSharedObjectManager::AddMuxTransactionEnvString(XrdOucString& out)
   }
 }
 
+//------------------------------------------------------------------------------
+// Encode the mux transactions as a binary message
+//------------------------------------------------------------------------------
+void
+XrdMqSharedObjectManager::MakeMuxTransactionBinary(std::string& out)
+{
+  // Same layout as the update of a single hash with the subjects separated
+  // by '%' and the subject index as key prefix "#<subject-index>#"
+  std::string subjects;
+
+  for (auto it = MuxTransactions.begin(); it != MuxTransactions.end(); ++it) {
+    if (!subjects.empty()) {
+      subjects += "%";
+    }
+
+    subjects += it->first;
+  }
+
+  out = XRDMQSHAREDHASH_BINARY;
+  AppendBinaryField(out, "update", 6);
+  AppendBinaryField(out, subjects.c_str(), subjects.length());
+  AppendBinaryField(out, MuxTransactionType.c_str(), MuxTransactionType.length());
+  AppendBinaryField(out, "", 0);
+  size_t index = 0;
+  std::string key;
+
+  for (auto it_subj = MuxTransactions.begin(); it_subj != MuxTransactions.end();
+       ++it_subj, ++index) {
+    XrdMqSharedHash* hash = GetObject(it_subj->first.c_str(),
+                                      MuxTransactionType.c_str());
+
+    if (!hash) {
+      continue;
+    }
+
+    std::string prefix = "#" + std::to_string(index) + "#";
+    RWMutexReadLock lock(*(hash->mStoreMutex));
+
+    for (auto it = it_subj->second.begin(); it != it_subj->second.end(); ++it) {
+      auto entry = hash->mStore.find(*it);
+
+      if (entry != hash->mStore.end()) {
+        const char* value = entry->second.GetValue();
+        key = prefix;
+        key += *it;
+        AppendBinaryField(out, key.c_str(), key.length());
+        AppendBinaryField(out, value, strlen(value));
+      }
+    }
+  }
+}
 
 //-------------------------------------------------------------------------------
 //
@@ -38,6 +38,7 @@
 #include <deque>
 #include <regex.h>
 #include <atomic>
+#include <chrono>
 
 #define XRDMQSHAREDHASH_CMD       "mqsh.cmd"
 #define XRDMQSHAREDHASH_UPDATE    "mqsh.cmd=update"
@@ -51,6 +52,10 @@
 #define XRDMQSHAREDHASH_KEYS      "mqsh.keys"
 #define XRDMQSHAREDHASH_REPLY     "mqsh.reply"
 #define XRDMQSHAREDHASH_TYPE      "mqsh.type"
+//! Prefix of length-prefixed (binary) encoded message bodies
+#define XRDMQSHAREDHASH_BINARY    "mqsh.bin:"
+//! Prefix of compressed message bodies, see SymKey::ZBase64
+#define XRDMQSHAREDHASH_COMPRESSED "zbase64:"
 
 //! Forward declaration
 class XrdMqSharedObjectManager;
@@ -429,6 +434,13 @@ public:
   //----------------------------------------------------------------------------
   bool CloseTransaction();
 
+  //----------------------------------------------------------------------------
+  //! Broadcast the updates held back by the coalescing window
+  //!
+  //! @return true if successful, otherwise false
+  //----------------------------------------------------------------------------
+  bool FlushPending();
+
 protected:
   std::string mType; ///< Type of objec
   XrdMqSharedObjectManager* mSOM; ///< Pointer to shared object manager
@@ -456,6 +468,13 @@ private:
   std::unique_ptr<XrdSysMutex> mTransactMutex;
   //! RW Mutex protecting the mStore object
   std::unique_ptr<eos::common::RWMutex> mStoreMutex;
+  //! Last values broadcast in delta publishing mode, protected by mStoreMutex
+  std::map<std::string, XrdMqSharedHashEntry> mPublished;
+  std::set<std::string> mPending; ///< Updates held back by coalescing
+  //! Mutex protecting the set of pending updates
+  std::unique_ptr<XrdSysMutex> mPendingMutex;
+  //! Size limit above which transactions are split into several messages
+  static constexpr size_t sMaxMessageSize = 2 * 1000 * 1000;
 
   //----------------------------------------------------------------------------
   //! Construct broadcast env header
@@ -500,6 +519,38 @@ private:
   //----------------------------------------------------------------------------
   void AddDeletionsToEnvString(XrdOucString& out);
 
+  //----------------------------------------------------------------------------
+  //! Construct header of a binary encoded message
+  //!
+  //! @param out output string containing the header
+  //! @param cmd command e.g. "update", "bcreply" or "delete"
+  //----------------------------------------------------------------------------
+  void MakeBinaryHeader(std::string& out, const char* cmd);
+
+  //----------------------------------------------------------------------------
+  //! Encode transactions as binary records - this must be called with the
+  //! mTransactMutex locked.
+  //!
+  //! @param out output string
+  //! @param it first transaction to encode
+  //! @param max_size stop adding records once out exceeds this size, at
+  //!        least one record is added anyway
+  //!
+  //! @return iterator to the first transaction not encoded
+  //----------------------------------------------------------------------------
+  std::set<std::string>::const_iterator
+  AddTransactionsToBinary(std::string& out,
+                          std::set<std::string>::const_iterator it,
+                          size_t max_size = std::string::npos);
+
+  //----------------------------------------------------------------------------
+  //! Encode deletions as binary records and clear them - this must be called
+  //! with the mTransactMutex locked.
+  //!
+  //! @param out ouput string
+  //----------------------------------------------------------------------------
+  void AddDeletionsToBinary(std::string& out);
+
   //----------------------------------------------------------------------------
   //! Broadcast hash as env string
   //!
@@ -672,6 +723,102 @@ public:
     return mBroadcast;
   }
 
+  //----------------------------------------------------------------------------
+  //! Significance threshold of a numeric key used by the delta publishing
+  //----------------------------------------------------------------------------
+  struct PublishThreshold {
+    double mAbsolute; ///< Minimum absolute change
+    double mRelative; ///< Minimum change relative to the published value
+  };
+
+  //----------------------------------------------------------------------------
+  //! Switch the delta publishing mode on or off. In this mode updates which
+  //! leave the last broadcast value unchanged or change it less than the
+  //! threshold of the key are stored locally but not broadcast, unless the
+  //! broadcast value is older than the refresh interval.
+  //!
+  //! @param enable if true enable delta publishing, otherwise disable it
+  //! @param refresh maximum age of a published value before it is sent again
+  //----------------------------------------------------------------------------
+  void EnableDeltaPublishing(bool enable, std::chrono::seconds refresh =
+                               std::chrono::seconds(30));
+
+  //----------------------------------------------------------------------------
+  //! Set the significance threshold of a numeric key. A change is broadcast
+  //! only if it exceeds both the absolute and the relative threshold.
+  //!
+  //! @param key key name
+  //! @param absolute minimum absolute change
+  //! @param relative minimum change relative to the published value
+  //----------------------------------------------------------------------------
+  void SetPublishThreshold(const std::string& key, double absolute,
+                           double relative);
+
+  //----------------------------------------------------------------------------
+  //! Set the coalescing window. Updates done outside a transaction are
+  //! collected per hash and broadcast together once per window instead of
+  //! one message per update.
+  //!
+  //! @param window coalescing window, 0 sends every update immediately
+  //----------------------------------------------------------------------------
+  void SetCoalescingWindow(std::chrono::milliseconds window);
+
+  //----------------------------------------------------------------------------
+  //! Set the size above which message bodies are sent compressed
+  //!
+  //! @param bytes size threshold, 0 disables the compression - default is
+  //!        taken from EOS_MQ_COMPRESSION_THRESHOLD
+  //----------------------------------------------------------------------------
+  inline void SetCompressionThreshold(size_t bytes)
+  {
+    mCompressionThreshold = bytes;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Switch between the env string and the length-prefixed (binary) encoding
+  //! of the messages sent for shared hashes. Receivers understand both
+  //! encodings, therefore all of them have to be updated before enabling it.
+  //!
+  //! @param enable if true use the binary encoding, otherwise the env string
+  //!        one - default is taken from EOS_MQ_BINARY_ENCODING
+  //----------------------------------------------------------------------------
+  inline void EnableBinaryEncoding(bool enable)
+  {
+    mBinaryEncoding = enable;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Indicate if we send binary encoded messages
+  //----------------------------------------------------------------------------
+  inline bool UsesBinaryEncoding() const
+  {
+    return mBinaryEncoding;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Append a length-prefixed field "<length>:<data>," to a binary encoded
+  //! message
+  //!
+  //! @param out output string
+  //! @param data field data
+  //! @param len field length
+  //----------------------------------------------------------------------------
+  static void AppendBinaryField(std::string& out, const char* data, size_t len);
+
+  //----------------------------------------------------------------------------
+  //! Parse a length-prefixed field of a binary encoded message in place. The
+  //! field terminator is overwritten with '\0' so that the returned pointer
+  //! can be used as a C string without copying the data.
+  //!
+  //! @param buf message buffer
+  //! @param pos position of the field, updated to point after it
+  //! @param len if not null, set to the length of the field
+  //!
+  //! @return pointer to the field data or nullptr if the field is malformed
+  //----------------------------------------------------------------------------
+  static const char* ParseBinaryField(std::string& buf, size_t& pos,
+                                      size_t* len = nullptr);
+
   //----------------------------------------------------------------------------
   //!
   //----------------------------------------------------------------------------
@@ -797,6 +944,11 @@ public:
   //----------------------------------------------------------------------------
   void FileDumper(ThreadAssistant& assistant) noexcept;
 
+  //----------------------------------------------------------------------------
+  //! Loop broadcasting the updates held back by the coalescing window
+  //----------------------------------------------------------------------------
+  void Coalescer(ThreadAssistant& assistant) noexcept;
+
   //----------------------------------------------------------------------------
   //! Clear all managed hashes and queues
   //----------------------------------------------------------------------------
@@ -824,6 +976,13 @@ public:
   //----------------------------------------------------------------------------
   void AddMuxTransactionEnvString(XrdOucString& out);
 
+  //----------------------------------------------------------------------------
+  //! Encode the mux transactions as a binary message
+  //!
+  //! @param out output string
+  //----------------------------------------------------------------------------
+  void MakeMuxTransactionBinary(std::string& out);
+
 protected:
   XrdSysMutex MuxTransactionsMutex; ///< protects the mux transaction map
   std::string MuxTransactionType; ///<
@@ -838,6 +997,14 @@ protected:
 
 private:
   std::atomic<bool> mBroadcast {true}; ///< Broadcast mode, default on
+  std::atomic<bool> mBinaryEncoding {false}; ///< Send binary encoded messages
+  std::atomic<size_t> mCompressionThreshold {0}; ///< Compress bodies above
+  std::atomic<bool> mDeltaPublishing {false}; ///< Publish significant changes
+  std::atomic<long long> mPublishRefresh {30}; ///< Max age of published values
+  XrdSysMutex mPublishMutex; ///< Mutex protecting the publish thresholds
+  std::map<std::string, PublishThreshold> mPublishThresholds;
+  std::atomic<long long> mCoalescingWindowMs {0}; ///< Coalescing window
+  AssistedThread mCoalescerTid; ///< Coalescer thread tid
   AssistedThread mDumperTid; ///< Dumper thread tid
   ///! Map of subjects to shared hash objects
   std::map<std::string, XrdMqSharedHash*> mHashSubjects;
@@ -849,6 +1016,57 @@ private:
   //! True if the reply queue is derived from the subject e.g. the subject
   // "/eos/<host>/fst/<path>" derives as "/eos/<host>/fst"
   bool AutoReplyQueueDerive;
+
+  //----------------------------------------------------------------------------
+  //! Apply the key-value records of a binary encoded update message. Keys of
+  //! multiplexed updates carry the "#<subject-index>#" prefix. This must be
+  //! called with a read lock on the HashMutex.
+  //!
+  //! @param buf message buffer, parsed in place
+  //! @param pos position of the first record
+  //! @param subjects list of subjects of the message
+  //! @param type hash type
+  //! @param bcreply if true clear the hashes first since this is a broadcast
+  //!        reply
+  //! @param error error message
+  //!
+  //! @return true if successful, otherwise false
+  //----------------------------------------------------------------------------
+  bool ApplyBinaryPairs(std::string& buf, size_t pos,
+                        const std::vector<std::string>& subjects,
+                        const std::string& type, bool bcreply,
+                        XrdOucString& error);
+
+  //----------------------------------------------------------------------------
+  //! Decide if an update of a published value has to be broadcast
+  //!
+  //! @param key key name
+  //! @param old_value published value
+  //! @param new_value new value
+  //! @param age age of the published value in seconds
+  //!
+  //! @return true if the update is significant, otherwise false
+  //----------------------------------------------------------------------------
+  bool IsSignificantChange(const std::string& key, const char* old_value,
+                           const char* new_value, double age);
+
+  //----------------------------------------------------------------------------
+  //! Compress the message body in place if it exceeds the compression
+  //! threshold and compression makes it smaller
+  //!
+  //! @param body message body
+  //----------------------------------------------------------------------------
+  void CompressBody(std::string& body);
+
+  //----------------------------------------------------------------------------
+  //! Send a shared hash message
+  //!
+  //! @param body message body, compressed if it exceeds the threshold
+  //! @param receiver receiver queue
+  //!
+  //! @return true if message sent successful, otherwise false
+  //----------------------------------------------------------------------------
+  bool SendBody(std::string& body, const char* receiver);
 };
 
 //------------------------------------------------------------------------------
@@ -30,6 +30,9 @@
 
 EOSNSNAMESPACE_BEGIN
 
+constexpr size_t Prefetcher::kDefaultWindow;
+constexpr size_t PrefetchingFileListIterator::kDefaultWindow;
+
 //------------------------------------------------------------------------------
 // Constructor
 //------------------------------------------------------------------------------
@@ -403,5 +406,106 @@ void Prefetcher::prefetchFilesystemFileListWithFileMDsAndParentsAndWait(
   prefetcher.wait();
 }
 
+//------------------------------------------------------------------------------
+// Constructor
+//------------------------------------------------------------------------------
+PrefetchingFileListIterator::PrefetchingFileListIterator(IView* view,
+    std::shared_ptr<ICollectionIterator<IFileMD::id_t>> it, size_t window,
+    bool parents)
+  : pView(view), pFileMDSvc(view->getFileMDSvc()), mIterator(it),
+    mWindow(window ? window : 1), mParents(parents)
+{
+  fill();
+}
+
+//------------------------------------------------------------------------------
+// Destructor
+//------------------------------------------------------------------------------
+PrefetchingFileListIterator::~PrefetchingFileListIterator()
+{
+  // The continuations refer to the view, don't leave them running behind
+  for (auto& entry : mPending) {
+    entry.fmd.wait();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Check if iterator is valid
+//------------------------------------------------------------------------------
+bool PrefetchingFileListIterator::valid()
+{
+  return !mPending.empty();
+}
+
+//------------------------------------------------------------------------------
+// Get current file id
+//------------------------------------------------------------------------------
+IFileMD::id_t PrefetchingFileListIterator::getElement()
+{
+  mPending.front().fmd.wait();
+  return mPending.front().id;
+}
+
+//------------------------------------------------------------------------------
+// Progress iterator
+//------------------------------------------------------------------------------
+void PrefetchingFileListIterator::next()
+{
+  if (mPending.empty()) {
+    return;
+  }
+
+  mPending.pop_front();
+  fill();
+}
+
+//------------------------------------------------------------------------------
+// Get FileMD of the current file
+//------------------------------------------------------------------------------
+IFileMDPtr PrefetchingFileListIterator::getFileMD()
+{
+  Entry& entry = mPending.front();
+
+  try {
+    if (pView->inMemory()) {
+      return pFileMDSvc->getFileMD(entry.id);
+    }
+
+    entry.fmd.wait();
+    return entry.fmd.value();
+  } catch (const MDException& e) {
+    return nullptr;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Stage fetches until the window is full or the file list exhausted
+//------------------------------------------------------------------------------
+void PrefetchingFileListIterator::fill()
+{
+  // With the in-memory namespace there is nothing to prefetch, just keep the
+  // current entry
+  size_t window = (pView->inMemory() ? 1 : mWindow);
+
+  while ((mPending.size() < window) && mIterator && mIterator->valid()) {
+    IFileMD::id_t id = mIterator->getElement();
+    mIterator->next();
+
+    if (pView->inMemory()) {
+      mPending.emplace_back(id, folly::makeFuture<IFileMDPtr>(nullptr));
+    } else if (mParents) {
+      IView* view = pView;
+      mPending.emplace_back(id, pFileMDSvc->getFileMDFut(id).then(
+      [view](IFileMDPtr fmd) {
+        // A broken parent chain must not hide the file itself
+        return view->getUriFut(fmd.get()).then([fmd](folly::Try<std::string>&&) {
+          return fmd;
+        });
+      }));
+    } else {
+      mPending.emplace_back(id, pFileMDSvc->getFileMDFut(id));
+    }
+  }
+}
 
 EOSNSNAMESPACE_END
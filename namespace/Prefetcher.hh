@@ -24,7 +24,10 @@
 #pragma once
 #include "namespace/Namespace.hh"
 #include "namespace/interface/IFileMD.hh"
+#include "namespace/interface/IFsView.hh"
 #include <folly/futures/Future.h>
+#include <deque>
+#include <memory>
 
 EOSNSNAMESPACE_BEGIN
 
@@ -36,6 +39,9 @@ class IFsView;
 class Prefetcher
 {
 public:
+  //! Default maximum number of ids prefetched at once
+  static constexpr size_t kDefaultWindow = 1000;
+
   //----------------------------------------------------------------------------
   //! Constructor
   //----------------------------------------------------------------------------
@@ -118,6 +124,40 @@ public:
   //----------------------------------------------------------------------------
   static void prefetchFileMDWithParentsAndWait(IView* view, IFileMD::id_t id);
 
+  //----------------------------------------------------------------------------
+  //! Prefetch the FileMDs of a window of file ids, optionally along with
+  //! their parents, and wait. All fetches are issued before waiting so that
+  //! they are pipelined instead of paying one round-trip per id. Loops over
+  //! large id collections call it again once they reach the returned
+  //! iterator, which bounds the memory used by the fetches in flight.
+  //!
+  //! @param view namespace view
+  //! @param begin first file id to prefetch
+  //! @param end end of the file ids
+  //! @param parents if true prefetch the parent containers as well
+  //! @param window maximum number of file ids to prefetch
+  //!
+  //! @return iterator past the last prefetched file id
+  //----------------------------------------------------------------------------
+  template <typename Iterator>
+  static Iterator prefetchFileMDsAndWait(IView* view, Iterator begin,
+                                         Iterator end, bool parents = false,
+                                         size_t window = kDefaultWindow)
+  {
+    Prefetcher prefetcher(view);
+
+    for (; (begin != end) && (window > 0); ++begin, --window) {
+      if (parents) {
+        prefetcher.stageFileMDWithParents(*begin);
+      } else {
+        prefetcher.stageFileMD(*begin);
+      }
+    }
+
+    prefetcher.wait();
+    return begin;
+  }
+
   //----------------------------------------------------------------------------
   //! Prefetch ContainerMD inode, along with all its parents, and wait
   //----------------------------------------------------------------------------
@@ -168,4 +208,80 @@ private:
   std::vector<folly::Future<std::string>> mUris;
 };
 
+//------------------------------------------------------------------------------
+//! Iterator over a file list, typically the streaming file list of a
+//! filesystem, which keeps a bounded window of FileMD fetches in flight.
+//!
+//! Unlike the prefetchFilesystem*AndWait functions, neither the file list nor
+//! the FileMDs are materialized up front: the first entries are available as
+//! soon as they have been fetched and memory usage is bounded by the window.
+//! Entries are returned in the order of the underlying iterator, waiting for
+//! the fetch of the current entry if needed. With the in-memory namespace
+//! nothing is prefetched and the FileMDs are looked up on demand.
+//------------------------------------------------------------------------------
+class PrefetchingFileListIterator : public ICollectionIterator<IFileMD::id_t>
+{
+public:
+  static constexpr size_t kDefaultWindow = 1000;
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //!
+  //! @param view namespace view
+  //! @param it file list iterator
+  //! @param window maximum number of FileMD fetches in flight
+  //! @param parents prefetch the parent containers of the files as well
+  //----------------------------------------------------------------------------
+  PrefetchingFileListIterator(IView* view,
+                              std::shared_ptr<ICollectionIterator<IFileMD::id_t>> it,
+                              size_t window = kDefaultWindow, bool parents = false);
+
+  //----------------------------------------------------------------------------
+  //! Destructor - waits for the fetches still in flight
+  //----------------------------------------------------------------------------
+  virtual ~PrefetchingFileListIterator();
+
+  //----------------------------------------------------------------------------
+  //! Check if iterator is valid
+  //----------------------------------------------------------------------------
+  bool valid() override;
+
+  //----------------------------------------------------------------------------
+  //! Get current file id
+  //----------------------------------------------------------------------------
+  IFileMD::id_t getElement() override;
+
+  //----------------------------------------------------------------------------
+  //! Progress iterator, refilling the window
+  //----------------------------------------------------------------------------
+  void next() override;
+
+  //----------------------------------------------------------------------------
+  //! Get FileMD of the current file, waiting for its fetch if needed
+  //!
+  //! @return FileMD object or nullptr if the file no longer exists
+  //----------------------------------------------------------------------------
+  IFileMDPtr getFileMD();
+
+private:
+  //----------------------------------------------------------------------------
+  //! Stage fetches until the window is full or the file list exhausted
+  //----------------------------------------------------------------------------
+  void fill();
+
+  struct Entry {
+    Entry(IFileMD::id_t i, folly::Future<IFileMDPtr>&& f):
+      id(i), fmd(std::move(f)) {}
+    IFileMD::id_t id;
+    folly::Future<IFileMDPtr> fmd;
+  };
+
+  IView* pView;
+  IFileMDSvc* pFileMDSvc;
+  std::shared_ptr<ICollectionIterator<IFileMD::id_t>> mIterator;
+  size_t mWindow; ///< Maximum number of fetches in flight
+  bool mParents; ///< Prefetch parent containers
+  std::deque<Entry> mPending; ///< Current entry and fetches in flight
+};
+
 EOSNSNAMESPACE_END
@@ -25,6 +25,7 @@
 #define __EOS_NS_ICHLOGCONTAINERMDSVC_HH__
 
 #include "namespace/Namespace.hh"
+#include "namespace/interface/Misc.hh"
 #include <map>
 #include <vector>
 #include <string>
@@ -92,6 +93,27 @@ public:
   //----------------------------------------------------------------------------
   virtual void compactCommit(void* comp_data, bool autorepair = false) = 0;
 
+  //----------------------------------------------------------------------------
+  //! Prepare writing a binary snapshot of the container change log.
+  //!
+  //! No external container metadata mutation may occur while the method is
+  //! running.
+  //!
+  //! @return snapshot information that needs to be passed to snapshotWrite
+  //----------------------------------------------------------------------------
+  virtual void* snapshotPrepare() = 0;
+
+  //----------------------------------------------------------------------------
+  //! Write the snapshot next to the change log. This does not access any of
+  //! the in-memory structures so it may run without the namespace lock.
+  //!
+  //! @param snapshotData snapshot information returned by snapshotPrepare,
+  //!                     it is released and reset
+  //!
+  //! @return size of the snapshot in bytes
+  //----------------------------------------------------------------------------
+  virtual uint64_t snapshotWrite(void*& snapshotData) = 0;
+
   //----------------------------------------------------------------------------
   //! Make transition from slave to master
   //!
@@ -135,6 +157,11 @@ public:
   //! @return offset value
   //----------------------------------------------------------------------------
   virtual uint64_t getFollowOffset() = 0;
+
+  //----------------------------------------------------------------------------
+  //! Get the timing of the phases of the last boot
+  //----------------------------------------------------------------------------
+  virtual std::vector<BootPhaseStatistics> getBootStatistics() = 0;
 };
 
 EOSNSNAMESPACE_END
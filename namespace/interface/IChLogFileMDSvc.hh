@@ -25,6 +25,8 @@
 #define __EOS_NS_ICHLOGFILEMDSVC_HH__
 
 #include "namespace/Namespace.hh"
+#include "namespace/interface/Misc.hh"
+#include <vector>
 
 EOSNSNAMESPACE_BEGIN
 
@@ -91,6 +93,27 @@ public:
   //----------------------------------------------------------------------------
   virtual void compactCommit(void* comp_data, bool autorepair = false) = 0;
 
+  //----------------------------------------------------------------------------
+  //! Prepare writing a binary snapshot of the file change log.
+  //!
+  //! No external file metadata mutation may occur while the method is
+  //! running.
+  //!
+  //! @return snapshot information that needs to be passed to snapshotWrite
+  //----------------------------------------------------------------------------
+  virtual void* snapshotPrepare() = 0;
+
+  //----------------------------------------------------------------------------
+  //! Write the snapshot next to the change log. This does not access any of
+  //! the in-memory structures so it may run without the namespace lock.
+  //!
+  //! @param snapshotData snapshot information returned by snapshotPrepare,
+  //!                     it is released and reset
+  //!
+  //! @return size of the snapshot in bytes
+  //----------------------------------------------------------------------------
+  virtual uint64_t snapshotWrite(void*& snapshotData) = 0;
+
   //----------------------------------------------------------------------------
   //! Make transition from slave to master
   //!
@@ -139,6 +162,11 @@ public:
   //! Resize container service map
   //------------------------------------------------------------------------
   virtual void resize() = 0;
+
+  //----------------------------------------------------------------------------
+  //! Get the timing of the phases of the last boot
+  //----------------------------------------------------------------------------
+  virtual std::vector<BootPhaseStatistics> getBootStatistics() = 0;
 };
 
 EOSNSNAMESPACE_END
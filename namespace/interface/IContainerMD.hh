@@ -29,6 +29,7 @@
 #include "namespace/utils/LocalityHint.hh"
 #include "namespace/MDException.hh"
 #include "namespace/interface/Identifiers.hh"
+#include "namespace/utils/CompactNameMap.hh"
 #include "common/Murmur3.hh"
 #include <stdint.h>
 #include <unistd.h>
@@ -78,12 +79,8 @@ public:
   typedef struct timespec mtime_t;
   typedef struct timespec tmtime_t;
   typedef std::map<std::string, std::string> XAttrMap;
-  typedef google::dense_hash_map <
-  std::string, IContainerMD::id_t,
-      Murmur3::MurmurHasher<std::string> > ContainerMap;
-  typedef google::dense_hash_map <
-  std::string, IContainerMD::id_t,
-      Murmur3::MurmurHasher<std::string> > FileMap;
+  typedef CompactNameMap<IContainerMD::id_t> ContainerMap;
+  typedef CompactNameMap<IContainerMD::id_t> FileMap;
 
   //----------------------------------------------------------------------------
   //! Constructor
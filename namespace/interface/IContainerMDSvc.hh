@@ -46,7 +46,8 @@ public:
     Updated = 0,
     Deleted,
     Created,
-    MTimeChange
+    MTimeChange,
+    SubcontainerRemoved
   };
 
   virtual ~IContainerMDChangeListener() {}
@@ -27,6 +27,7 @@
 #include "namespace/Namespace.hh"
 #include "namespace/MDException.hh"
 #include "namespace/interface/IFileMDSvc.hh"
+#include "namespace/utils/CompressedIdSet.hh"
 #include <google/dense_hash_set>
 #include <set>
 
@@ -73,15 +74,12 @@ class IFsView: public IFileMDChangeListener
 public:
 
   //------------------------------------------------------------------------
-  // Google sparse table is used for much lower memory overhead per item
-  // than a list and it's fragmented structure speeding up deletions.
-  // The filelists we keep are quite big - a list would be faster
-  // but more memory consuming, a vector would be slower but less
-  // memory consuming. We changed to dense hash set since it is much faster
-  // and the memory overhead is not visible in a million file namespace.
+  // The file lists hold one entry per replica, which adds up to hundreds of
+  // millions of entries on large instances. A compressed sorted set needs a
+  // bit over 2 bytes per entry compared to 16 to 32 bytes for the dense hash
+  // set used previously, and iterates in ascending file id order.
   //------------------------------------------------------------------------
-  typedef google::dense_hash_set <IFileMD::id_t,
-          Murmur3::MurmurHasher<uint64_t> > FileList;
+  typedef CompressedIdSet FileList;
 
   //----------------------------------------------------------------------------
   //! Contructor
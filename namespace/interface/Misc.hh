@@ -25,6 +25,8 @@
 #define EOS_NS_MISC_H
 
 #include "namespace/Namespace.hh"
+#include <cstdint>
+#include <string>
 
 EOSNSNAMESPACE_BEGIN
 
@@ -35,7 +37,22 @@ struct CacheStatistics {
   bool enabled = false;
   int64_t maxNum = 0;
   int64_t occupancy = 0;
+  uint64_t maxSize = UINT64_MAX;
+  uint64_t sizeBytes = 0;
   int64_t inFlight = 0;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t coalesced = 0;
+};
+
+//------------------------------------------------------------------------------
+//! Struct to retrieve the timing of one phase of the namespace boot
+//------------------------------------------------------------------------------
+struct BootPhaseStatistics {
+  std::string name;
+  uint64_t items = 0;
+  double seconds = 0;
+  unsigned threads = 1;
 };
 
 EOSNSNAMESPACE_END
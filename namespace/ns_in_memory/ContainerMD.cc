@@ -39,11 +39,6 @@ ContainerMD::ContainerMD(ContainerMD::id_t id, IFileMDSvc* file_svc,
   pCGid(0), pMode(040755), pACLId(0), pFileSvc(file_svc),
   pContSvc(cont_svc)
 {
-  mSubcontainers.set_deleted_key("");
-  mFiles.set_deleted_key("");
-  mSubcontainers.set_empty_key("##_EMPTY_##");
-  mFiles.set_empty_key("##_EMPTY_##");
-
   pCTime.tv_sec = 0;
   pCTime.tv_nsec = 0;
   pMTime.tv_sec = 0;
@@ -172,7 +167,6 @@ void
 ContainerMD::removeContainer(const std::string& name)
 {
   mSubcontainers.erase(name);
-  mSubcontainers.resize(0);
 }
 
 //------------------------------------------------------------------------------
@@ -182,7 +176,7 @@ void
 ContainerMD::addContainer(IContainerMD* container)
 {
   container->setParentId(pId);
-  mSubcontainers[container->getName()] = container->getId();
+  mSubcontainers.insert_or_assign(container->getName(), container->getId());
 }
 
 //------------------------------------------------------------------------------
@@ -215,26 +209,36 @@ ContainerMD::findFile(const std::string& name)
 void
 ContainerMD::addFile(IFileMD* file)
 {
-  file->setContainerId(pId);
-  mFiles[file->getName()] = file->getId();
+  addFileNoNotify(file);
   IFileMDChangeListener::Event e(file, IFileMDChangeListener::SizeChange,
                                  0, file->getSize());
   file->getFileMDSvc()->notifyListeners(&e);
 }
 
+//------------------------------------------------------------------------------
+// Add file without notifying the listeners
+//------------------------------------------------------------------------------
+void
+ContainerMD::addFileNoNotify(IFileMD* file)
+{
+  file->setContainerId(pId);
+  mFiles.insert_or_assign(file->getName(), file->getId());
+}
+
 //------------------------------------------------------------------------------
 // Remove file
 //------------------------------------------------------------------------------
 void
 ContainerMD::removeFile(const std::string& name)
 {
-  if (mFiles.count(name)) {
-    std::shared_ptr<IFileMD> file = pFileSvc->getFileMD(mFiles[name]);
+  IFileMD::id_t id;
+
+  if (mFiles.get(name, id)) {
+    std::shared_ptr<IFileMD> file = pFileSvc->getFileMD(id);
     IFileMDChangeListener::Event e(file.get(), IFileMDChangeListener::SizeChange,
                                    0, -file->getSize());
     file->getFileMDSvc()->notifyListeners(&e);
     mFiles.erase(name);
-    mFiles.resize(0);
   }
 }
 
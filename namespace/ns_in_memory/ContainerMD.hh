@@ -153,6 +153,13 @@ public:
   //----------------------------------------------------------------------------
   virtual void addFile(IFileMD* file) override;
 
+  //----------------------------------------------------------------------------
+  //! Add file without notifying the file listeners about the size change,
+  //! the caller has to do it. Used by the parallel boot, since the listeners
+  //! are not thread safe.
+  //----------------------------------------------------------------------------
+  void addFileNoNotify(IFileMD* file);
+
   //----------------------------------------------------------------------------
   //! Remove file
   //----------------------------------------------------------------------------
@@ -24,29 +24,202 @@
 #include "namespace/ns_in_memory/FileMD.hh"
 #include "namespace/interface/IContainerMD.hh"
 #include "namespace/interface/IFileMDSvc.hh"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 #include <sstream>
 
 namespace eos
 {
 
+//------------------------------------------------------------------------------
+// Process wide table of file services referenced by the files
+//------------------------------------------------------------------------------
+static std::atomic<IFileMDSvc*> sFileMDSvcTable[256];
+static std::atomic<uint32_t> sFileMDSvcCount(1);
+static std::mutex sFileMDSvcMutex;
+
+//------------------------------------------------------------------------------
+//           ************* FileLocations Class ************
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Assignment operator
+//------------------------------------------------------------------------------
+FileLocations&
+FileLocations::operator = (const FileLocations& other)
+{
+  if (this != &other) {
+    mNumLinked = mNumUnlinked = 0;
+    reserve(other.mNumLinked + other.mNumUnlinked);
+    memcpy(data(), other.data(),
+           (other.mNumLinked + other.mNumUnlinked) * sizeof(location_t));
+    mNumLinked = other.mNumLinked;
+    mNumUnlinked = other.mNumUnlinked;
+  }
+
+  return *this;
+}
+
+//------------------------------------------------------------------------------
+// Find linked location
+//------------------------------------------------------------------------------
+int
+FileLocations::findLinked(location_t location) const
+{
+  const location_t* locs = data();
+
+  for (int i = 0; i < mNumLinked; ++i) {
+    if (locs[i] == location) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+//------------------------------------------------------------------------------
+// Find unlinked location
+//------------------------------------------------------------------------------
+int
+FileLocations::findUnlinked(location_t location) const
+{
+  const location_t* locs = data() + mNumLinked;
+
+  for (int i = 0; i < mNumUnlinked; ++i) {
+    if (locs[i] == location) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+//------------------------------------------------------------------------------
+// Append linked location
+//------------------------------------------------------------------------------
+void
+FileLocations::pushLinked(location_t location)
+{
+  reserve(mNumLinked + mNumUnlinked + 1);
+  location_t* locs = data();
+  memmove(locs + mNumLinked + 1, locs + mNumLinked,
+          mNumUnlinked * sizeof(location_t));
+  locs[mNumLinked++] = location;
+}
+
+//------------------------------------------------------------------------------
+// Append unlinked location
+//------------------------------------------------------------------------------
+void
+FileLocations::pushUnlinked(location_t location)
+{
+  reserve(mNumLinked + mNumUnlinked + 1);
+  data()[mNumLinked + mNumUnlinked] = location;
+  ++mNumUnlinked;
+}
+
+//------------------------------------------------------------------------------
+// Remove the i-th linked location
+//------------------------------------------------------------------------------
+void
+FileLocations::eraseLinked(size_t i)
+{
+  location_t* locs = data();
+  memmove(locs + i, locs + i + 1,
+          (mNumLinked + mNumUnlinked - i - 1) * sizeof(location_t));
+  --mNumLinked;
+}
+
+//------------------------------------------------------------------------------
+// Remove the i-th unlinked location
+//------------------------------------------------------------------------------
+void
+FileLocations::eraseUnlinked(size_t i)
+{
+  location_t* locs = data() + mNumLinked;
+  memmove(locs + i, locs + i + 1, (mNumUnlinked - i - 1) * sizeof(location_t));
+  --mNumUnlinked;
+}
+
+//------------------------------------------------------------------------------
+// Move the i-th linked location to the end of the unlinked locations
+//------------------------------------------------------------------------------
+void
+FileLocations::unlink(size_t i)
+{
+  location_t* locs = data();
+  location_t location = locs[i];
+  size_t total = mNumLinked + mNumUnlinked;
+  memmove(locs + i, locs + i + 1, (total - i - 1) * sizeof(location_t));
+  locs[total - 1] = location;
+  --mNumLinked;
+  ++mNumUnlinked;
+}
+
+//------------------------------------------------------------------------------
+// Remove all linked locations
+//------------------------------------------------------------------------------
+void
+FileLocations::clearLinked()
+{
+  location_t* locs = data();
+  memmove(locs, locs + mNumLinked, mNumUnlinked * sizeof(location_t));
+  mNumLinked = 0;
+}
+
+//------------------------------------------------------------------------------
+// Make room for at least the given number of locations
+//------------------------------------------------------------------------------
+void
+FileLocations::reserve(size_t num)
+{
+  if (num <= mCapacity) {
+    return;
+  }
+
+  if (num > UINT16_MAX) {
+    MDException e(ENOSPC);
+    e.getMessage() << "Too many locations for file: " << num;
+    throw e;
+  }
+
+  size_t capacity = std::min<size_t>(std::max<size_t>(num, 2 * mCapacity),
+                                     UINT16_MAX);
+  location_t* locs = new location_t[capacity];
+  memcpy(locs, data(), (mNumLinked + mNumUnlinked) * sizeof(location_t));
+
+  if (isHeap()) {
+    delete[] mHeap;
+  }
+
+  mHeap = locs;
+  mCapacity = capacity;
+}
+
+//------------------------------------------------------------------------------
+//           ************* FileMD Class ************
+//------------------------------------------------------------------------------
+
 //------------------------------------------------------------------------------
 // Constructor
 //------------------------------------------------------------------------------
 FileMD::FileMD(IFileMD::id_t id, IFileMDSvc* fileMDSvc):
   IFileMD(),
-  pId(id),
-  pSize(0),
-  pContainerId(0),
+  pFlags(0),
+  pChecksumSize(0),
+  pFileMDSvcIndex(registerFileMDSvc(fileMDSvc)),
   pCUid(0),
   pCGid(0),
   pLayoutId(0),
-  pFlags(0),
-  pChecksum(0),
-  pFileMDSvc(fileMDSvc)
-{
-  pCTime.tv_sec = pCTime.tv_nsec = 0;
-  pMTime.tv_sec = pMTime.tv_nsec = 0;
-}
+  pCTimeNsec(0),
+  pMTimeNsec(0),
+  pId(id),
+  pSize(0),
+  pContainerId(0),
+  pCTimeSec(0),
+  pMTimeSec(0)
+{}
 
 //------------------------------------------------------------------------------
 // Virtual copy constructor
@@ -71,7 +244,11 @@ FileMD::FileMD(const FileMD& other)
 FileMD&
 FileMD::operator = (const FileMD& other)
 {
-  pName        = other.pName;
+  if (this == &other) {
+    return *this;
+  }
+
+  setName(other.getName());
   pId          = other.pId;
   pSize        = other.pSize;
   pContainerId = other.pContainerId;
@@ -79,17 +256,123 @@ FileMD::operator = (const FileMD& other)
   pCGid        = other.pCGid;
   pLayoutId    = other.pLayoutId;
   pFlags       = other.pFlags;
-  pLinkName    = other.pLinkName;
-  pLocation    = other.pLocation;
-  pUnlinkedLocation = other.pUnlinkedLocation;
-  pCTime       = other.pCTime;
-  pMTime       = other.pMTime;
-  pChecksum    = other.pChecksum;
-  pXAttrs      = other.pXAttrs;
-  pFileMDSvc   = 0;
+  pLocations   = other.pLocations;
+  pCTimeSec    = other.pCTimeSec;
+  pCTimeNsec   = other.pCTimeNsec;
+  pMTimeSec    = other.pMTimeSec;
+  pMTimeNsec   = other.pMTimeNsec;
+  pChecksumSize = other.pChecksumSize;
+  memcpy(pChecksum, other.pChecksum, sizeof(pChecksum));
+  pExtra.reset(other.pExtra ? new Extra(*other.pExtra) : nullptr);
+  pFileMDSvcIndex = 0;
   return *this;
 }
 
+//------------------------------------------------------------------------------
+// Get the index of the given file service in the process wide table
+//------------------------------------------------------------------------------
+uint8_t
+FileMD::registerFileMDSvc(IFileMDSvc* fileMDSvc)
+{
+  if (!fileMDSvc) {
+    return 0;
+  }
+
+  uint32_t count = sFileMDSvcCount.load();
+
+  for (uint32_t i = 1; i < count; ++i) {
+    if (sFileMDSvcTable[i].load() == fileMDSvc) {
+      return i;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(sFileMDSvcMutex);
+  count = sFileMDSvcCount.load();
+
+  for (uint32_t i = 1; i < count; ++i) {
+    if (sFileMDSvcTable[i].load() == fileMDSvc) {
+      return i;
+    }
+  }
+
+  if (count == 256) {
+    MDException e(ENOSPC);
+    e.getMessage() << "Too many file metadata services";
+    throw e;
+  }
+
+  sFileMDSvcTable[count].store(fileMDSvc);
+  sFileMDSvcCount.store(count + 1);
+  return count;
+}
+
+//------------------------------------------------------------------------------
+// Get the file service for the given index
+//------------------------------------------------------------------------------
+IFileMDSvc*
+FileMD::lookupFileMDSvc(uint8_t index)
+{
+  return index ? sFileMDSvcTable[index].load() : nullptr;
+}
+
+//------------------------------------------------------------------------------
+// Get checksum
+//------------------------------------------------------------------------------
+const Buffer
+FileMD::getChecksum() const
+{
+  Buffer checksum(pChecksumSize);
+  checksum.putData(getChecksumPtr(), pChecksumSize);
+  return checksum;
+}
+
+//------------------------------------------------------------------------------
+// Set checksum
+//------------------------------------------------------------------------------
+void
+FileMD::setChecksum(const void* checksum, uint8_t size)
+{
+  if (size > kInlineChecksumSize) {
+    getExtra().mChecksum.assign((const char*)checksum, size);
+  } else {
+    memcpy(pChecksum, checksum, size);
+
+    if (pExtra && !pExtra->mChecksum.empty()) {
+      pExtra->mChecksum.clear();
+      releaseExtraIfEmpty();
+    }
+  }
+
+  pChecksumSize = size;
+}
+
+//------------------------------------------------------------------------------
+// Clear checksum - appends the given number of zero bytes like the Buffer
+// based implementation did
+//------------------------------------------------------------------------------
+void
+FileMD::clearChecksum(uint8_t size)
+{
+  std::string checksum(getChecksumPtr(), pChecksumSize);
+  checksum.append(size, '\0');
+  setChecksum(checksum.data(), std::min<size_t>(checksum.size(), UINT8_MAX));
+}
+
+//------------------------------------------------------------------------------
+// Set name
+//------------------------------------------------------------------------------
+void
+FileMD::setName(const std::string& name)
+{
+  if (name.empty()) {
+    pName.reset();
+    return;
+  }
+
+  pName.reset(new char[name.length() + 1]);
+  memcpy(pName.get(), name.c_str(), name.length() + 1);
+}
+
 //------------------------------------------------------------------------------
 // Add location
 //------------------------------------------------------------------------------
@@ -99,11 +382,11 @@ void FileMD::addLocation(location_t location)
     return;
   }
 
-  pLocation.push_back(location);
+  pLocations.pushLinked(location);
   IFileMDChangeListener::Event e(this,
                                  IFileMDChangeListener::LocationAdded,
                                  location);
-  pFileMDSvc->notifyListeners(&e);
+  notifyListeners(&e);
 }
 
 //------------------------------------------------------------------------------
@@ -111,17 +394,14 @@ void FileMD::addLocation(location_t location)
 //------------------------------------------------------------------------------
 void FileMD::removeLocation(location_t location)
 {
-  std::vector<location_t>::iterator it;
+  int pos = pLocations.findUnlinked(location);
 
-  for (it = pUnlinkedLocation.begin(); it < pUnlinkedLocation.end(); ++it) {
-    if (*it == location) {
-      pUnlinkedLocation.erase(it);
-      IFileMDChangeListener::Event e(this,
-                                     IFileMDChangeListener::LocationRemoved,
-                                     location);
-      pFileMDSvc->notifyListeners(&e);
-      return;
-    }
+  if (pos != -1) {
+    pLocations.eraseUnlinked(pos);
+    IFileMDChangeListener::Event e(this,
+                                   IFileMDChangeListener::LocationRemoved,
+                                   location);
+    notifyListeners(&e);
   }
 }
 
@@ -130,14 +410,14 @@ void FileMD::removeLocation(location_t location)
 //------------------------------------------------------------------------------
 void FileMD::removeAllLocations()
 {
-  std::vector<location_t>::reverse_iterator it;
-
-  while ((it = pUnlinkedLocation.rbegin()) != pUnlinkedLocation.rend()) {
-    pUnlinkedLocation.pop_back();
+  while (pLocations.numUnlinked()) {
+    size_t last = pLocations.numUnlinked() - 1;
+    location_t location = pLocations.unlinked(last);
+    pLocations.eraseUnlinked(last);
     IFileMDChangeListener::Event e(this,
                                    IFileMDChangeListener::LocationRemoved,
-                                   *it);
-    pFileMDSvc->notifyListeners(&e);
+                                   location);
+    notifyListeners(&e);
   }
 }
 
@@ -146,18 +426,14 @@ void FileMD::removeAllLocations()
 //------------------------------------------------------------------------------
 void FileMD::unlinkLocation(location_t location)
 {
-  std::vector<location_t>::iterator it;
-
-  for (it = pLocation.begin() ; it < pLocation.end(); it++) {
-    if (*it == location) {
-      pUnlinkedLocation.push_back(*it);
-      pLocation.erase(it);
-      IFileMDChangeListener::Event e(this,
-                                     IFileMDChangeListener::LocationUnlinked,
-                                     location);
-      pFileMDSvc->notifyListeners(&e);
-      return;
-    }
+  int pos = pLocations.findLinked(location);
+
+  if (pos != -1) {
+    pLocations.unlink(pos);
+    IFileMDChangeListener::Event e(this,
+                                   IFileMDChangeListener::LocationUnlinked,
+                                   location);
+    notifyListeners(&e);
   }
 }
 
@@ -166,18 +442,20 @@ void FileMD::unlinkLocation(location_t location)
 //------------------------------------------------------------------------------
 void FileMD::unlinkAllLocations()
 {
-  std::vector<location_t>::reverse_iterator it;
+  // Unlink in location order, same as the QuarkDB namespace
+  while (pLocations.numLinked()) {
+    location_t loc = pLocations.linked(0);
 
-  while ((it = pLocation.rbegin()) != pLocation.rend()) {
-    location_t loc = *it;
     if (!hasUnlinkedLocation(loc)) {
-      pUnlinkedLocation.push_back(loc);
+      pLocations.unlink(0);
+    } else {
+      pLocations.eraseLinked(0);
     }
-    pLocation.pop_back();
+
     IFileMDChangeListener::Event e(this,
                                    IFileMDChangeListener::LocationUnlinked,
                                    loc);
-    pFileMDSvc->notifyListeners(&e);
+    notifyListeners(&e);
   }
 }
 
@@ -188,7 +466,7 @@ void FileMD::getEnv(std::string& env, bool escapeAnd)
 {
   env = "";
   std::ostringstream o;
-  std::string saveName = pName;
+  std::string saveName = getName();
 
   if (escapeAnd) {
     if (!saveName.empty()) {
@@ -203,36 +481,34 @@ void FileMD::getEnv(std::string& env, bool escapeAnd)
     }
   }
 
-  o << "name=" << saveName << "&id=" << pId << "&ctime=" << pCTime.tv_sec;
-  o << "&ctime_ns=" << pCTime.tv_nsec << "&mtime=" << pMTime.tv_sec;
-  o << "&mtime_ns=" << pMTime.tv_nsec << "&size=" << pSize;
+  o << "name=" << saveName << "&id=" << pId << "&ctime=" << pCTimeSec;
+  o << "&ctime_ns=" << pCTimeNsec << "&mtime=" << pMTimeSec;
+  o << "&mtime_ns=" << pMTimeNsec << "&size=" << pSize;
   o << "&cid=" << pContainerId << "&uid=" << pCUid << "&gid=" << pCGid;
   o << "&lid=" << pLayoutId;
   env += o.str();
   env += "&location=";
-  LocationVector::iterator it;
   char locs[16];
 
-  for (it = pLocation.begin(); it != pLocation.end(); ++it) {
-    snprintf(locs, sizeof(locs), "%u", *it);
+  for (size_t i = 0; i < pLocations.numLinked(); ++i) {
+    snprintf(locs, sizeof(locs), "%u", pLocations.linked(i));
     env += locs;
     env += ",";
   }
 
-  for (it = pUnlinkedLocation.begin(); it != pUnlinkedLocation.end(); ++it) {
-    snprintf(locs, sizeof(locs), "!%u", *it);
+  for (size_t i = 0; i < pLocations.numUnlinked(); ++i) {
+    snprintf(locs, sizeof(locs), "!%u", pLocations.unlinked(i));
     env += locs;
     env += ",";
   }
 
   env += "&checksum=";
-  uint8_t size = pChecksum.getSize();
+  const char* checksum = getChecksumPtr();
 
-  for (uint8_t i = 0; i < size; i++) {
+  for (uint8_t i = 0; i < pChecksumSize; i++) {
     char hx[3];
     hx[0] = 0;
-    snprintf(hx, sizeof(hx), "%02x",
-             *((unsigned char*)(pChecksum.getDataPtr() + i)));
+    snprintf(hx, sizeof(hx), "%02x", *((unsigned char*)(checksum + i)));
     env += hx;
   }
 }
@@ -243,62 +519,63 @@ void FileMD::getEnv(std::string& env, bool escapeAnd)
 //------------------------------------------------------------------------------
 void FileMD::serialize(Buffer& buffer)
 {
-  if (!pFileMDSvc) {
+  if (!pFileMDSvcIndex) {
     MDException ex(ENOTSUP);
     ex.getMessage() << "This was supposed to be a read only copy!";
     throw ex;
   }
 
+  ctime_t ctime, mtime;
+  getCTime(ctime);
+  getMTime(mtime);
   buffer.putData(&pId,          sizeof(pId));
-  buffer.putData(&pCTime,       sizeof(pCTime));
-  buffer.putData(&pMTime,       sizeof(pMTime));
+  buffer.putData(&ctime,        sizeof(ctime));
+  buffer.putData(&mtime,        sizeof(mtime));
   uint64_t tmp = pFlags;
   tmp <<= 48;
   tmp |= (pSize & 0x0000ffffffffffff);
   buffer.putData(&tmp,          sizeof(tmp));
   buffer.putData(&pContainerId, sizeof(pContainerId));
   // Symbolic links are serialized as <name>//<link>
-  std::string nameAndLink = pName;
+  std::string nameAndLink = getName();
 
-  if (pLinkName.length()) {
+  if (isLink()) {
     nameAndLink += "//";
-    nameAndLink += pLinkName;
+    nameAndLink += pExtra->mLinkName;
   }
 
   uint16_t len = nameAndLink.length() + 1;
   buffer.putData(&len,          sizeof(len));
   buffer.putData(nameAndLink.c_str(), len);
-  len = pLocation.size();
+  len = pLocations.numLinked();
   buffer.putData(&len, sizeof(len));
-  LocationVector::iterator it;
 
-  for (it = pLocation.begin(); it != pLocation.end(); ++it) {
-    location_t location = *it;
+  for (size_t i = 0; i < pLocations.numLinked(); ++i) {
+    location_t location = pLocations.linked(i);
     buffer.putData(&location, sizeof(location_t));
   }
 
-  len = pUnlinkedLocation.size();
+  len = pLocations.numUnlinked();
   buffer.putData(&len, sizeof(len));
 
-  for (it = pUnlinkedLocation.begin(); it != pUnlinkedLocation.end(); ++it) {
-    location_t location = *it;
+  for (size_t i = 0; i < pLocations.numUnlinked(); ++i) {
+    location_t location = pLocations.unlinked(i);
     buffer.putData(&location, sizeof(location_t));
   }
 
   buffer.putData(&pCUid,      sizeof(pCUid));
   buffer.putData(&pCGid,      sizeof(pCGid));
   buffer.putData(&pLayoutId, sizeof(pLayoutId));
-  uint8_t size = pChecksum.getSize();
-  buffer.putData(&size, sizeof(size));
-  buffer.putData(pChecksum.getDataPtr(), size);
+  buffer.putData(&pChecksumSize, sizeof(pChecksumSize));
+  buffer.putData(getChecksumPtr(), pChecksumSize);
 
   // May store xattr
-  if (pXAttrs.size()) {
-    uint16_t len = pXAttrs.size();
+  if (numAttributes()) {
+    uint16_t len = pExtra->mXAttrs.size();
     buffer.putData(&len, sizeof(len));
     XAttrMap::iterator it;
 
-    for (it = pXAttrs.begin(); it != pXAttrs.end(); ++it) {
+    for (it = pExtra->mXAttrs.begin(); it != pExtra->mXAttrs.end(); ++it) {
       uint16_t strLen = it->first.length() + 1;
       buffer.putData(&strLen, sizeof(strLen));
       buffer.putData(it->first.c_str(), strLen);
@@ -315,9 +592,12 @@ void FileMD::serialize(Buffer& buffer)
 void FileMD::deserialize(const Buffer& buffer)
 {
   uint16_t offset = 0;
+  ctime_t ctime, mtime;
   offset = buffer.grabData(offset, &pId,          sizeof(pId));
-  offset = buffer.grabData(offset, &pCTime,       sizeof(pCTime));
-  offset = buffer.grabData(offset, &pMTime,       sizeof(pMTime));
+  offset = buffer.grabData(offset, &ctime,        sizeof(ctime));
+  offset = buffer.grabData(offset, &mtime,        sizeof(mtime));
+  setCTime(ctime);
+  setMTime(mtime);
   uint64_t tmp;
   offset = buffer.grabData(offset, &tmp,          sizeof(tmp));
   pSize = tmp & 0x0000ffffffffffff;
@@ -328,21 +608,22 @@ void FileMD::deserialize(const Buffer& buffer)
   offset = buffer.grabData(offset, &len, 2);
   char strBuffer[len];
   offset = buffer.grabData(offset, strBuffer, len);
-  pName = strBuffer;
+  std::string name = strBuffer;
   // Possibly extract symbolic link
-  size_t link_pos = pName.find("//");
+  size_t link_pos = name.find("//");
 
   if (link_pos != std::string::npos) {
-    pLinkName = pName.substr(link_pos + 2);
-    pName.erase(link_pos);
+    setLink(name.substr(link_pos + 2));
+    name.erase(link_pos);
   }
 
+  setName(name);
   offset = buffer.grabData(offset, &len, 2);
 
   for (uint16_t i = 0; i < len; ++i) {
     location_t location;
     offset = buffer.grabData(offset, &location, sizeof(location_t));
-    pLocation.push_back(location);
+    pLocations.pushLinked(location);
   }
 
   offset = buffer.grabData(offset, &len, 2);
@@ -350,7 +631,7 @@ void FileMD::deserialize(const Buffer& buffer)
   for (uint16_t i = 0; i < len; ++i) {
     location_t location;
     offset = buffer.grabData(offset, &location, sizeof(location_t));
-    pUnlinkedLocation.push_back(location);
+    pLocations.pushUnlinked(location);
   }
 
   offset = buffer.grabData(offset, &pCUid,      sizeof(pCUid));
@@ -358,10 +639,11 @@ void FileMD::deserialize(const Buffer& buffer)
   offset = buffer.grabData(offset, &pLayoutId, sizeof(pLayoutId));
   uint8_t size = 0;
   offset = buffer.grabData(offset, &size, sizeof(size));
-  pChecksum.resize(size);
-  offset = buffer.grabData(offset, pChecksum.getDataPtr(), size);
+  char checksum[UINT8_MAX];
+  offset = buffer.grabData(offset, checksum, size);
+  setChecksum(checksum, size);
 
-  if ((buffer.size() - offset) >= 4) {
+  if ((buffer.getSize() - offset) >= 4) {
     // XAttr are optional
     uint16_t len1 = 0;
     uint16_t len2 = 0;
@@ -375,7 +657,8 @@ void FileMD::deserialize(const Buffer& buffer)
       offset = buffer.grabData(offset, &len2, sizeof(len2));
       char strBuffer2[len2];
       offset = buffer.grabData(offset, strBuffer2, len2);
-      pXAttrs.insert(std::make_pair <char*, char*>(strBuffer1, strBuffer2));
+      getExtra().mXAttrs.insert(std::make_pair <char*, char*>(strBuffer1,
+                                strBuffer2));
     }
   }
 }
@@ -386,7 +669,14 @@ void FileMD::deserialize(const Buffer& buffer)
 IFileMD::LocationVector
 FileMD::getLocations() const
 {
-  return pLocation;
+  LocationVector locations;
+  locations.reserve(pLocations.numLinked());
+
+  for (size_t i = 0; i < pLocations.numLinked(); ++i) {
+    locations.push_back(pLocations.linked(i));
+  }
+
+  return locations;
 }
 
 //------------------------------------------------------------------------------
@@ -395,7 +685,14 @@ FileMD::getLocations() const
 IFileMD::LocationVector
 FileMD::getUnlinkedLocations() const
 {
-  return pUnlinkedLocation;
+  LocationVector locations;
+  locations.reserve(pLocations.numUnlinked());
+
+  for (size_t i = 0; i < pLocations.numUnlinked(); ++i) {
+    locations.push_back(pLocations.unlinked(i));
+  }
+
+  return locations;
 }
 
 //------------------------------------------------------------------------------
@@ -409,7 +706,7 @@ FileMD::setSize(uint64_t size)
   IFileMDChangeListener::Event e(this,
                                  IFileMDChangeListener::SizeChange,
                                  0, sizeChange);
-  pFileMDSvc->notifyListeners(&e);
+  notifyListeners(&e);
 }
 
 //------------------------------------------------------------------------------
@@ -418,7 +715,39 @@ FileMD::setSize(uint64_t size)
 eos::IFileMD::XAttrMap
 FileMD::getAttributes() const
 {
-  return pXAttrs;
+  return pExtra ? pExtra->mXAttrs : XAttrMap();
+}
+
+//------------------------------------------------------------------------------
+// Get an estimate of the memory used by this object. Strings which do not fit
+// the small string buffer and map nodes are accounted with their payload plus
+// the node overhead, allocator overhead is ignored.
+//------------------------------------------------------------------------------
+size_t
+FileMD::getMemoryUsage() const
+{
+  static constexpr size_t kSsoSize = 15;
+  static constexpr size_t kMapNodeOverhead = 32;
+  auto heapSize = [](const std::string & str) {
+    return (str.capacity() > kSsoSize) ? str.capacity() + 1 : 0;
+  };
+  size_t usage = sizeof(FileMD) + pLocations.getHeapUsage();
+
+  if (pName) {
+    usage += strlen(pName.get()) + 1;
+  }
+
+  if (pExtra) {
+    usage += sizeof(Extra) + heapSize(pExtra->mLinkName) +
+             heapSize(pExtra->mChecksum);
+
+    for (const auto& xattr : pExtra->mXAttrs) {
+      usage += kMapNodeOverhead + sizeof(xattr) + heapSize(xattr.first) +
+               heapSize(xattr.second);
+    }
+  }
+
+  return usage;
 }
 
 }
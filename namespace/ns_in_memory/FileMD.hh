@@ -28,6 +28,7 @@
 #include "namespace/interface/IFileMDSvc.hh"
 #include <stdint.h>
 #include <cstring>
+#include <memory>
 #include <string>
 #include <vector>
 #include <sys/time.h>
@@ -38,8 +39,182 @@ EOSNSNAMESPACE_BEGIN
 class IFileMDSvc;
 class IContainerMD;
 
+//------------------------------------------------------------------------------
+//! Compact storage for the linked and unlinked locations of a file. Both
+//! lists share one array, the linked locations first followed by the unlinked
+//! ones. Up to two locations are stored inline, only files with more replicas
+//! or stripes allocate memory on the heap.
+//------------------------------------------------------------------------------
+class FileLocations
+{
+public:
+  typedef IFileMD::location_t location_t;
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //----------------------------------------------------------------------------
+  FileLocations():
+    mNumLinked(0), mNumUnlinked(0), mCapacity(kNumInline)
+  {}
+
+  //----------------------------------------------------------------------------
+  //! Destructor
+  //----------------------------------------------------------------------------
+  ~FileLocations()
+  {
+    if (isHeap()) {
+      delete[] mHeap;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Copy constructor
+  //----------------------------------------------------------------------------
+  FileLocations(const FileLocations& other):
+    FileLocations()
+  {
+    *this = other;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Assignment operator
+  //----------------------------------------------------------------------------
+  FileLocations& operator = (const FileLocations& other);
+
+  //----------------------------------------------------------------------------
+  //! Get number of linked locations
+  //----------------------------------------------------------------------------
+  size_t numLinked() const
+  {
+    return mNumLinked;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get number of unlinked locations
+  //----------------------------------------------------------------------------
+  size_t numUnlinked() const
+  {
+    return mNumUnlinked;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the i-th linked location, no bounds checking
+  //----------------------------------------------------------------------------
+  location_t linked(size_t i) const
+  {
+    return data()[i];
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the i-th unlinked location, no bounds checking
+  //----------------------------------------------------------------------------
+  location_t unlinked(size_t i) const
+  {
+    return data()[mNumLinked + i];
+  }
+
+  //----------------------------------------------------------------------------
+  //! Find linked location
+  //!
+  //! @return index of the location or -1 if not found
+  //----------------------------------------------------------------------------
+  int findLinked(location_t location) const;
+
+  //----------------------------------------------------------------------------
+  //! Find unlinked location
+  //!
+  //! @return index of the location or -1 if not found
+  //----------------------------------------------------------------------------
+  int findUnlinked(location_t location) const;
+
+  //----------------------------------------------------------------------------
+  //! Append linked location
+  //----------------------------------------------------------------------------
+  void pushLinked(location_t location);
+
+  //----------------------------------------------------------------------------
+  //! Append unlinked location
+  //----------------------------------------------------------------------------
+  void pushUnlinked(location_t location);
+
+  //----------------------------------------------------------------------------
+  //! Remove the i-th linked location
+  //----------------------------------------------------------------------------
+  void eraseLinked(size_t i);
+
+  //----------------------------------------------------------------------------
+  //! Remove the i-th unlinked location
+  //----------------------------------------------------------------------------
+  void eraseUnlinked(size_t i);
+
+  //----------------------------------------------------------------------------
+  //! Move the i-th linked location to the end of the unlinked locations
+  //----------------------------------------------------------------------------
+  void unlink(size_t i);
+
+  //----------------------------------------------------------------------------
+  //! Remove all linked locations
+  //----------------------------------------------------------------------------
+  void clearLinked();
+
+  //----------------------------------------------------------------------------
+  //! Remove all unlinked locations
+  //----------------------------------------------------------------------------
+  void clearUnlinked()
+  {
+    mNumUnlinked = 0;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the heap memory used in bytes
+  //----------------------------------------------------------------------------
+  size_t getHeapUsage() const
+  {
+    return isHeap() ? mCapacity * sizeof(location_t) : 0;
+  }
+
+private:
+  //! Number of locations fitting in the space of the heap pointer
+  static constexpr uint16_t kNumInline = 2;
+
+  bool isHeap() const
+  {
+    return mCapacity > kNumInline;
+  }
+
+  location_t* data()
+  {
+    return isHeap() ? mHeap : mInline;
+  }
+
+  const location_t* data() const
+  {
+    return isHeap() ? mHeap : mInline;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Make room for at least the given number of locations
+  //----------------------------------------------------------------------------
+  void reserve(size_t num);
+
+  union {
+    location_t mInline[kNumInline];
+    location_t* mHeap;
+  };
+  uint16_t mNumLinked;
+  uint16_t mNumUnlinked;
+  uint16_t mCapacity;
+};
+
 //------------------------------------------------------------------------------
 //! Class holding the metadata information concerning a single file
+//!
+//! The in-memory namespace keeps every file resident so the layout is packed:
+//! times are split in seconds and nanoseconds, checksums of up to 20 bytes
+//! and up to two locations are stored inline, the name is a single exact size
+//! allocation and the rarely used link name and extended attributes live in
+//! a lazily allocated block. The file service pointer is replaced by a one
+//! byte index into a process wide table of file services.
 //------------------------------------------------------------------------------
 class FileMD: public IFileMD
 {
@@ -90,8 +265,8 @@ public:
   //----------------------------------------------------------------------------
   void getCTime(ctime_t& ctime) const override
   {
-    ctime.tv_sec = pCTime.tv_sec;
-    ctime.tv_nsec = pCTime.tv_nsec;
+    ctime.tv_sec = pCTimeSec;
+    ctime.tv_nsec = pCTimeNsec;
   }
 
   //----------------------------------------------------------------------------
@@ -99,8 +274,8 @@ public:
   //----------------------------------------------------------------------------
   void setCTime(ctime_t ctime) override
   {
-    pCTime.tv_sec = ctime.tv_sec;
-    pCTime.tv_nsec = ctime.tv_nsec;
+    pCTimeSec = ctime.tv_sec;
+    pCTimeNsec = ctime.tv_nsec;
   }
 
   //----------------------------------------------------------------------------
@@ -108,14 +283,9 @@ public:
   //----------------------------------------------------------------------------
   void setCTimeNow() override
   {
-#ifdef __APPLE__
-    struct timeval tv;
-    gettimeofday(&tv, 0);
-    pCTime.tv_sec = tv.tv_sec;
-    pCTime.tv_nsec = tv.tv_usec * 1000;
-#else
-    clock_gettime(CLOCK_REALTIME, &pCTime);
-#endif
+    ctime_t now;
+    getTimeNow(now);
+    setCTime(now);
   }
 
   //----------------------------------------------------------------------------
@@ -123,8 +293,8 @@ public:
   //----------------------------------------------------------------------------
   void getMTime(ctime_t& mtime) const override
   {
-    mtime.tv_sec = pMTime.tv_sec;
-    mtime.tv_nsec = pMTime.tv_nsec;
+    mtime.tv_sec = pMTimeSec;
+    mtime.tv_nsec = pMTimeNsec;
   }
 
   //----------------------------------------------------------------------------
@@ -132,8 +302,8 @@ public:
   //----------------------------------------------------------------------------
   void setMTime(ctime_t mtime) override
   {
-    pMTime.tv_sec = mtime.tv_sec;
-    pMTime.tv_nsec = mtime.tv_nsec;
+    pMTimeSec = mtime.tv_sec;
+    pMTimeNsec = mtime.tv_nsec;
   }
 
   //----------------------------------------------------------------------------
@@ -141,14 +311,9 @@ public:
   //----------------------------------------------------------------------------
   void setMTimeNow() override
   {
-#ifdef __APPLE__
-    struct timeval tv;
-    gettimeofday(&tv, 0);
-    pMTime.tv_sec = tv.tv_sec;
-    pMTime.tv_nsec = tv.tv_usec * 1000;
-#else
-    clock_gettime(CLOCK_REALTIME, &pMTime);
-#endif
+    ctime_t now;
+    getTimeNow(now);
+    setMTime(now);
   }
 
   //----------------------------------------------------------------------------
@@ -183,10 +348,7 @@ public:
   //----------------------------------------------------------------------------
   //! Get checksum
   //----------------------------------------------------------------------------
-  const Buffer getChecksum() const override
-  {
-    return pChecksum;
-  }
+  const Buffer getChecksum() const override;
 
   //----------------------------------------------------------------------------
   //! Compare checksums
@@ -195,7 +357,7 @@ public:
   //----------------------------------------------------------------------------
   bool checksumMatch(const void* checksum) const override
   {
-    return !memcmp(checksum, pChecksum.getDataPtr(), pChecksum.getSize());
+    return !memcmp(checksum, getChecksumPtr(), pChecksumSize);
   }
 
   //----------------------------------------------------------------------------
@@ -203,20 +365,13 @@ public:
   //----------------------------------------------------------------------------
   void setChecksum(const Buffer& checksum) override
   {
-    pChecksum = checksum;
+    setChecksum(checksum.getDataPtr(), checksum.getSize());
   }
 
   //----------------------------------------------------------------------------
   //! Clear checksum
   //----------------------------------------------------------------------------
-  void clearChecksum(uint8_t size = 20) override
-  {
-    char zero = 0;
-
-    for (uint8_t i = 0; i < size; i++) {
-      pChecksum.putData(&zero, 1);
-    }
-  }
+  void clearChecksum(uint8_t size = 20) override;
 
   //----------------------------------------------------------------------------
   //! Set checksum
@@ -224,27 +379,20 @@ public:
   //! @param checksum address of a memory location string the checksum
   //! @param size     size of the checksum in bytes
   //----------------------------------------------------------------------------
-  void setChecksum(const void* checksum, uint8_t size) override
-  {
-    pChecksum.clear();
-    pChecksum.putData(checksum, size);
-  }
+  void setChecksum(const void* checksum, uint8_t size) override;
 
   //----------------------------------------------------------------------------
   //! Get name
   //----------------------------------------------------------------------------
   const std::string getName() const override
   {
-    return pName;
+    return pName ? std::string(pName.get()) : std::string();
   }
 
   //----------------------------------------------------------------------------
   //! Set name
   //----------------------------------------------------------------------------
-  void setName(const std::string& name) override
-  {
-    pName = name;
-  }
+  void setName(const std::string& name) override;
 
   //----------------------------------------------------------------------------
   //! Add location
@@ -261,8 +409,8 @@ public:
   //----------------------------------------------------------------------------
   location_t getLocation(unsigned int index) override
   {
-    if (index < pLocation.size()) {
-      return pLocation[index];
+    if (index < pLocations.numLinked()) {
+      return pLocations.linked(index);
     }
 
     return 0;
@@ -298,7 +446,7 @@ public:
   //----------------------------------------------------------------------------
   void clearUnlinkedLocations() override
   {
-    pUnlinkedLocation.clear();
+    pLocations.clearUnlinked();
   }
 
   //----------------------------------------------------------------------------
@@ -306,13 +454,7 @@ public:
   //----------------------------------------------------------------------------
   bool hasUnlinkedLocation(location_t location) override
   {
-    for (unsigned int i = 0; i < pUnlinkedLocation.size(); i++) {
-      if (pUnlinkedLocation[i] == location) {
-        return true;
-      }
-    }
-
-    return false;
+    return (pLocations.findUnlinked(location) != -1);
   }
 
   //----------------------------------------------------------------------------
@@ -320,7 +462,7 @@ public:
   //----------------------------------------------------------------------------
   size_t getNumUnlinkedLocation() const override
   {
-    return pUnlinkedLocation.size();
+    return pLocations.numUnlinked();
   }
 
   //----------------------------------------------------------------------------
@@ -328,7 +470,7 @@ public:
   //----------------------------------------------------------------------------
   void clearLocations() override
   {
-    pLocation.clear();
+    pLocations.clearLinked();
   }
 
   //----------------------------------------------------------------------------
@@ -336,13 +478,7 @@ public:
   //----------------------------------------------------------------------------
   bool hasLocation(location_t location) override
   {
-    for (unsigned int i = 0; i < pLocation.size(); i++) {
-      if (pLocation[i] == location) {
-        return true;
-      }
-    }
-
-    return false;
+    return (pLocations.findLinked(location) != -1);
   }
 
   //----------------------------------------------------------------------------
@@ -350,7 +486,7 @@ public:
   //----------------------------------------------------------------------------
   size_t getNumLocation() const override
   {
-    return pLocation.size();
+    return pLocations.numLinked();
   }
 
   //----------------------------------------------------------------------------
@@ -447,7 +583,7 @@ public:
   //----------------------------------------------------------------------------
   void setFileMDSvc(IFileMDSvc* fileMDSvc) override
   {
-    pFileMDSvc = fileMDSvc;
+    pFileMDSvcIndex = registerFileMDSvc(fileMDSvc);
   }
 
   //----------------------------------------------------------------------------
@@ -455,7 +591,7 @@ public:
   //----------------------------------------------------------------------------
   virtual IFileMDSvc* getFileMDSvc() override
   {
-    return pFileMDSvc;
+    return lookupFileMDSvc(pFileMDSvcIndex);
   }
 
   //----------------------------------------------------------------------------
@@ -473,7 +609,7 @@ public:
   //----------------------------------------------------------------------------
   std::string getLink() const override
   {
-    return pLinkName;
+    return pExtra ? pExtra->mLinkName : std::string();
   }
 
   //----------------------------------------------------------------------------
@@ -481,7 +617,10 @@ public:
   //----------------------------------------------------------------------------
   void setLink(std::string link_name) override
   {
-    pLinkName = link_name;
+    if (!link_name.empty() || pExtra) {
+      getExtra().mLinkName = link_name;
+      releaseExtraIfEmpty();
+    }
   }
 
   //----------------------------------------------------------------------------
@@ -489,7 +628,7 @@ public:
   //----------------------------------------------------------------------------
   bool isLink() const override
   {
-    return pLinkName.length() ? true : false;
+    return pExtra && pExtra->mLinkName.length();
   }
 
   //----------------------------------------------------------------------------
@@ -497,7 +636,7 @@ public:
   //----------------------------------------------------------------------------
   void setAttribute(const std::string& name, const std::string& value) override
   {
-    pXAttrs[name] = value;
+    getExtra().mXAttrs[name] = value;
   }
 
   //----------------------------------------------------------------------------
@@ -505,10 +644,9 @@ public:
   //----------------------------------------------------------------------------
   void removeAttribute(const std::string& name) override
   {
-    XAttrMap::iterator it = pXAttrs.find(name);
-
-    if (it != pXAttrs.end()) {
-      pXAttrs.erase(it);
+    if (pExtra) {
+      pExtra->mXAttrs.erase(name);
+      releaseExtraIfEmpty();
     }
   }
 
@@ -517,7 +655,10 @@ public:
   //----------------------------------------------------------------------------
   void clearAttributes() override
   {
-    pXAttrs.clear();
+    if (pExtra) {
+      pExtra->mXAttrs.clear();
+      releaseExtraIfEmpty();
+    }
   }
 
   //----------------------------------------------------------------------------
@@ -525,7 +666,7 @@ public:
   //----------------------------------------------------------------------------
   bool hasAttribute(const std::string& name) const override
   {
-    return pXAttrs.find(name) != pXAttrs.end();
+    return pExtra && (pExtra->mXAttrs.find(name) != pExtra->mXAttrs.end());
   }
 
   //----------------------------------------------------------------------------
@@ -533,7 +674,7 @@ public:
   //----------------------------------------------------------------------------
   size_t numAttributes() const override
   {
-    return pXAttrs.size();
+    return pExtra ? pExtra->mXAttrs.size() : 0;
   }
 
   //----------------------------------------------------------------------------
@@ -541,15 +682,17 @@ public:
   //----------------------------------------------------------------------------
   std::string getAttribute(const std::string& name) const override
   {
-    XAttrMap::const_iterator it = pXAttrs.find(name);
+    if (pExtra) {
+      XAttrMap::const_iterator it = pExtra->mXAttrs.find(name);
 
-    if (it == pXAttrs.end()) {
-      MDException e(ENOENT);
-      e.getMessage() << "Attribute: " << name << " not found";
-      throw e;
+      if (it != pExtra->mXAttrs.end()) {
+        return it->second;
+      }
     }
 
-    return it->second;
+    MDException e(ENOENT);
+    e.getMessage() << "Attribute: " << name << " not found";
+    throw e;
   }
 
   //----------------------------------------------------------------------------
@@ -559,26 +702,111 @@ public:
   //----------------------------------------------------------------------------
   eos::IFileMD::XAttrMap getAttributes() const override;
 
+  //----------------------------------------------------------------------------
+  //! Get an estimate of the memory used by this object, including the heap
+  //! allocations it owns
+  //----------------------------------------------------------------------------
+  size_t getMemoryUsage() const;
+
 protected:
   //----------------------------------------------------------------------------
-  // Data members
-  //----------------------------------------------------------------------------
-  IFileMD::id_t       pId;
-  ctime_t             pCTime;
-  ctime_t             pMTime;
-  uint64_t            pSize;
-  IContainerMD::id_t  pContainerId;
-  uid_t               pCUid;
-  gid_t               pCGid;
-  layoutId_t          pLayoutId;
-  uint16_t            pFlags;
-  std::string         pName;
-  std::string         pLinkName;
-  LocationVector      pLocation;
-  LocationVector      pUnlinkedLocation;
-  Buffer              pChecksum;
-  XAttrMap            pXAttrs;
-  IFileMDSvc*         pFileMDSvc;
+  //! Rarely used metadata, only allocated when needed
+  //----------------------------------------------------------------------------
+  struct Extra {
+    std::string mLinkName;
+    XAttrMap    mXAttrs;
+    std::string mChecksum; ///< Checksums not fitting the inline storage
+  };
+
+  static constexpr uint8_t kInlineChecksumSize = 20;
+
+  //----------------------------------------------------------------------------
+  //! Get the current time
+  //----------------------------------------------------------------------------
+  static void getTimeNow(ctime_t& now)
+  {
+#ifdef __APPLE__
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    now.tv_sec = tv.tv_sec;
+    now.tv_nsec = tv.tv_usec * 1000;
+#else
+    clock_gettime(CLOCK_REALTIME, &now);
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the index of the given file service in the process wide table,
+  //! registering it if needed. The null service has index 0.
+  //----------------------------------------------------------------------------
+  static uint8_t registerFileMDSvc(IFileMDSvc* fileMDSvc);
+
+  //----------------------------------------------------------------------------
+  //! Get the file service for the given index
+  //----------------------------------------------------------------------------
+  static IFileMDSvc* lookupFileMDSvc(uint8_t index);
+
+  //----------------------------------------------------------------------------
+  //! Notify the listeners of the file service
+  //----------------------------------------------------------------------------
+  void notifyListeners(IFileMDChangeListener::Event* e)
+  {
+    lookupFileMDSvc(pFileMDSvcIndex)->notifyListeners(e);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get pointer to the checksum bytes
+  //----------------------------------------------------------------------------
+  const char* getChecksumPtr() const
+  {
+    return (pChecksumSize > kInlineChecksumSize) ? pExtra->mChecksum.data() :
+           pChecksum;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the extra metadata, allocating it if needed
+  //----------------------------------------------------------------------------
+  Extra& getExtra()
+  {
+    if (!pExtra) {
+      pExtra.reset(new Extra());
+    }
+
+    return *pExtra;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Drop the extra metadata if it holds nothing
+  //----------------------------------------------------------------------------
+  void releaseExtraIfEmpty()
+  {
+    if (pExtra && pExtra->mLinkName.empty() && pExtra->mXAttrs.empty() &&
+        pExtra->mChecksum.empty()) {
+      pExtra.reset();
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Data members - ordered to avoid padding, the small ones first so that
+  // they can share the tail padding of the base class
+  //----------------------------------------------------------------------------
+  uint16_t                pFlags;
+  uint8_t                 pChecksumSize;
+  uint8_t                 pFileMDSvcIndex;
+  uid_t                   pCUid;
+  gid_t                   pCGid;
+  layoutId_t              pLayoutId;
+  uint32_t                pCTimeNsec;
+  uint32_t                pMTimeNsec;
+  IFileMD::id_t           pId;
+  uint64_t                pSize;
+  IContainerMD::id_t      pContainerId;
+  int64_t                 pCTimeSec;
+  int64_t                 pMTimeSec;
+  FileLocations           pLocations;
+  std::unique_ptr<char[]> pName;
+  std::unique_ptr<Extra>  pExtra;
+  char                    pChecksum[kInlineChecksumSize];
 };
 
 EOSNSNAMESPACE_END
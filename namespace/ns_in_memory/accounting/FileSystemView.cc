@@ -40,11 +40,6 @@ static void resize(Cont& d, size_t size)
   }
 
   d.resize(size);
-
-  for (size_t i = oldSize; i < size; ++i) {
-    d[i].set_deleted_key(0);
-    d[i].set_empty_key(0xffffffffffffffffll);
-  }
 }
 
 //----------------------------------------------------------------------------
@@ -52,8 +47,6 @@ static void resize(Cont& d, size_t size)
 //----------------------------------------------------------------------------
 FileSystemView::FileSystemView()
 {
-  pNoReplicas.set_empty_key(0xffffffffffffffffll);
-  pNoReplicas.set_deleted_key(0);
 }
 
 //----------------------------------------------------------------------------
@@ -250,12 +243,14 @@ void FileSystemView::finalize()
 void FileSystemView::shrink()
 {
   for (size_t i = 0; i < pFiles.size(); ++i) {
-    pFiles[i].resize(0);
+    pFiles[i].shrink();
   }
 
   for (size_t i = 0; i < pUnlinkedFiles.size(); ++i) {
-    pUnlinkedFiles[i].resize(0);
+    pUnlinkedFiles[i].shrink();
   }
+
+  pNoReplicas.shrink();
 }
 
 //------------------------------------------------------------------------------
@@ -295,7 +290,7 @@ FileSystemView::hasFileId(IFileMD::id_t fid, IFileMD::location_t fs_id)
     return false;
   }
 
-  return (pFiles[fs_id].find(fid) != pFiles[fs_id].end());
+  return pFiles[fs_id].contains(fid);
 }
 
 EOSNSNAMESPACE_END
@@ -32,7 +32,7 @@
 #include "namespace/ns_in_memory/accounting/ContainerAccounting.hh"
 #include "namespace/ns_in_memory/persistency/ChangeLogContainerMDSvc.hh"
 #include "namespace/ns_in_memory/persistency/ChangeLogConstants.hh"
-#include "common/Parallel.hh"
+#include "namespace/ns_in_memory/persistency/ChangeLogSnapshot.hh"
 #include <memory>
 
 //------------------------------------------------------------------------------
@@ -572,105 +572,49 @@ void ChangeLogContainerMDSvc::initialize()
   pFollowStart = pChangeLog->getFirstOffset();
 
   if (!pSlaveMode || logIsCompacted) {
+    {
+      std::lock_guard<std::mutex> lock(pBootStatsMutex);
+      pBootStats.clear();
+    }
+
     ContainerMDScanner scanner(pIdMap, pSlaveMode);
+    unsigned nthreads = pBootThreads;
+    // In master mode start from the snapshot if possible, then only the tail
+    // of the change log needs to be scanned. Containers updated in the tail
+    // are reset and get reloaded from the change log.
+    uint64_t scan_offset = pChangeLog->getFirstOffset();
+    uint64_t snapshot_largest_id = 0;
+
+    if (!pSlaveMode) {
+      loadSnapshot(scan_offset, snapshot_largest_id);
+    }
+
     pChangeLog->mmap();
-    pFollowStart = pChangeLog->scanAllRecords(&scanner , pAutoRepair);
-    pFirstFreeId = scanner.getLargestId() + 1;
+    BootPhase scan_phase("", "container-scan", 0);
+    pFollowStart = pChangeLog->scanAllRecordsAtOffset(&scanner, scan_offset,
+                   pAutoRepair);
+    pFirstFreeId = std::max<uint64_t>(scanner.getLargestId(),
+                                      snapshot_largest_id) + 1;
+    addBootPhase(scan_phase, pIdMap.size());
     // Recreate the container structure
-    IdMap::iterator it;
     ContainerList   orphans;
     ContainerList   nameConflicts;
-    time_t start_time = time(0);
-    time_t now = start_time;
-    size_t progress = 0;
     uint64_t end = pIdMap.size();
-    uint64_t cnt = 0;
-#if __GNUC_PREREQ(4,8)
-    int nthread = std::thread::hardware_concurrency() ;
-
-    if (pIdMap.size() / nthread && getenv("EOS_NS_BOOT_PARALLEL")) {
-      fprintf(stderr, "INFO     [ doing parallel boot ]\n");
-      // Parallel boot
-      std::mutex critical;
-      size_t chunk = pIdMap.size() / nthread;
-      size_t last_chunk = chunk + pIdMap.size() - (chunk * nthread);
-      eos::common::Parallel::For(0, nthread , [&](int i) {
-        IdMap::iterator it = pIdMap.begin();
-        std::advance(it, i * chunk);
-
-        for (size_t n = 0; n < ((i == (nthread - 1)) ? last_chunk : chunk); ++n) {
-          {
-            std::lock_guard<std::mutex> lock(critical);
-            cnt++;
-          }
-
-          if (it->second.ptr) {
-            ++it;
-            continue;
-          }
-
-          loadContainer(it);
-          {
-            std::lock_guard<std::mutex> lock(critical);
-
-            if ((100.0 * cnt / end) > progress) {
-              now = time(0);
-              double estimate = (1 + end - cnt) / ((1.0 * cnt / (now + 1 - start_time)));
-
-              if (progress == 0) {
-                fprintf(stderr, "PROGRESS [ %-64s ] %02u%% estimate none \n", "container-load",
-                        (unsigned int)progress);
-              } else {
-                fprintf(stderr,
-                        "PROGRESS [ %-64s ] %02u%% estimate %3.01fs [ %lus/%.0fs ] [%lu/%lu]\n",
-                        "container-load", (unsigned int)progress, estimate, time(NULL) - start_time,
-                        (double)time(NULL) - (double)start_time + estimate, cnt, end);
-              }
+    BootPhase load_phase("", "container-load", end, nthreads);
+    ForEachChunked(pIdMap, nthreads, [&](IdMap::iterator & it, unsigned) {
+      load_phase.tick();
 
-              progress += 2;
-            }
-          }
-          ++it;
-        }
-      });
-    } else
-#endif
-    {
-      for (it = pIdMap.begin(); it != pIdMap.end(); ++it) {
-        if (it->second.ptr) {
-          continue;
-        }
-
-        ++cnt;
+      if (!it->second.ptr) {
         loadContainer(it);
-
-        if ((100.0 * cnt / end) > progress) {
-          now = time(0);
-          double estimate = (1 + end - cnt) / ((1.0 * cnt / (now + 1 - start_time)));
-
-          if (progress == 0) {
-            fprintf(stderr, "PROGRESS [ %-64s ] %02u%% estimate none \n",
-                    "container-load", (unsigned int)progress);
-          } else {
-            fprintf(stderr, "PROGRESS [ %-64s ] %02u%% estimate %3.02fs\n",
-                    "container-load", (unsigned int)progress, estimate);
-          }
-
-          progress += 2;
-        }
       }
-    }
-
+    });
     pChangeLog->munmap();
-    now = time(0);
-    fprintf(stderr, "ALERT    [ %-64s ] finished in %ds\n", "container-load",
-            (int)(now - start_time));
-    start_time = time(0);
-    progress = 0;
-    cnt = 0;
+    addBootPhase(load_phase);
+    // Attaching recreates the parents recursively, this stays sequential
+    BootPhase attach_phase("", "container-attach", end);
 
-    for (it = pIdMap.begin(); it != pIdMap.end(); ++it) {
-      cnt++;
+    for (auto it = pIdMap.begin(); it != pIdMap.end(); ++it) {
+      attach_phase.tick();
 
       if (it->second.attached) {
         continue;
@@ -678,28 +622,9 @@ void ChangeLogContainerMDSvc::initialize()
 
       recreateContainer(it, orphans, nameConflicts);
       notifyListeners(it->second.ptr.get() , IContainerMDChangeListener::MTimeChange);
-
-      if ((100.0 * cnt / end) > progress) {
-        now = time(0);
-        double estimate = (1 + end - cnt) / ((1.0 * cnt / (now + 1 - start_time)));
-
-        if (progress == 0) {
-          fprintf(stderr, "PROGRESS [ %-64s ] %02u%% estimate none \n",
-                  "container-create", (unsigned int)progress);
-        } else {
-          fprintf(stderr,
-                  "PROGRESS [ %-64s ] %02u%% estimate %3.01fs [ %lus/%.0fs ] [%lu/%lu]\n",
-                  "container-create", (unsigned int)progress, estimate, time(NULL) - start_time,
-                  (double)time(NULL) - (double)start_time + estimate, cnt, end);
-        }
-
-        progress += 2;
-      }
     }
 
-    now = time(0);
-    fprintf(stderr, "ALERT    [ %-64s ] finished in %ds\n", "container-attach",
-            (int)(now - start_time));
+    addBootPhase(attach_phase);
 
     // Deal with broken containers if we're not in the slave mode
     if (!pSlaveMode) {
@@ -709,6 +634,81 @@ void ChangeLogContainerMDSvc::initialize()
   }
 }
 
+//----------------------------------------------------------------------------
+// Load the containers from the snapshot of the change log
+//----------------------------------------------------------------------------
+bool
+ChangeLogContainerMDSvc::loadSnapshot(uint64_t& logOffset, uint64_t& largestId)
+{
+  if (getenv("EOS_NS_BOOT_NOSNAPSHOT")) {
+    return false;
+  }
+
+  ChangeLogSnapshot snapshot;
+  std::string path = ChangeLogSnapshot::getPath(pChangeLogPath);
+  std::string reason;
+
+  if (!snapshot.open(path, pChangeLog, pChangeLogPath, CONTAINER_LOG_MAGIC,
+                     reason)) {
+    fprintf(stderr, "INFO     [ not using directory snapshot %s: %s ]\n",
+            path.c_str(), reason.c_str());
+    return false;
+  }
+
+  bool checksum = !getenv("EOS_NS_BOOT_NOCRC32");
+  uint64_t num = snapshot.getNumRecords();
+  unsigned nthreads = pBootThreads;
+
+  try {
+    // The map can not be modified concurrently so insert the ids first, the
+    // threads then only fill in the objects
+    BootPhase index_phase("snapshot ", "container-snapshot-index", num);
+    pIdMap.reserve(num);
+
+    for (uint64_t i = 0; i < num; ++i) {
+      const ChangeLogSnapshot::Entry& entry = snapshot.getEntry(i);
+      pIdMap.insert(std::make_pair(entry.id,
+                                   DataInfo(entry.logOffset, nullptr)));
+    }
+
+    addBootPhase(index_phase, num);
+    BootPhase load_phase("snapshot ", "container-snapshot-load", num, nthreads);
+    ParallelFor(snapshot.getNumChunks(), nthreads, [&](size_t chunk, unsigned) {
+      snapshot.scanChunk(chunk, checksum, [&](uint64_t i, Buffer & buffer) {
+        std::shared_ptr<IContainerMD> container = std::make_shared<ContainerMD>
+            (IContainerMD::id_t(0), pFileSvc, this);
+        container->deserialize(buffer);
+        IdMap::iterator it = pIdMap.find(snapshot.getEntry(i).id);
+
+        if ((it == pIdMap.end()) || (it->first != container->getId())) {
+          MDException e(EFAULT);
+          e.getMessage() << "Snapshot: Container #" << container->getId()
+                         << " does not match the index";
+          throw e;
+        }
+
+        it.value().ptr = container;
+        load_phase.tick();
+      });
+    });
+    addBootPhase(load_phase);
+  } catch (MDException& e) {
+    fprintf(stderr, "ALERT    [ failed to load directory snapshot %s: %s - "
+            "scanning the whole change log ]\n", path.c_str(),
+            e.getMessage().str().c_str());
+    pIdMap.clear();
+    std::lock_guard<std::mutex> lock(pBootStatsMutex);
+    pBootStats.clear();
+    return false;
+  }
+
+  logOffset = snapshot.getLogOffset();
+  largestId = snapshot.getLargestId();
+  fprintf(stderr, "INFO     [ loaded %lu directories from snapshot %s, scanning "
+          "the change log from offset=%lu ]\n", num, path.c_str(), logOffset);
+  return true;
+}
+
 //----------------------------------------------------------------------------
 // Make a transition from slave to master
 //----------------------------------------------------------------------------
@@ -831,6 +831,17 @@ void ChangeLogContainerMDSvc::configure(
     pResSize = strtoull(it->second.c_str(), 0, 10);
   }
 
+  // Number of threads used for booting, 1 means sequential boot
+  it = config.find("boot_threads");
+
+  if (it != config.end()) {
+    pBootThreads = strtoul(it->second.c_str(), 0, 10);
+
+    if (pBootThreads == 0) {
+      pBootThreads = getDefaultBootThreads();
+    }
+  }
+
   pAutoRepair = false;
   it = config.find("auto_repair");
 
@@ -977,6 +988,53 @@ ChangeLogContainerMDSvc::compactPrepare(const std::string& newLogFileName)
   return data;
 }
 
+//----------------------------------------------------------------------------
+// Prepare writing a snapshot
+//----------------------------------------------------------------------------
+void*
+ChangeLogContainerMDSvc::snapshotPrepare()
+{
+  ChangeLogSnapshot::Data* data = new ChangeLogSnapshot::Data();
+
+  try {
+    ChangeLogSnapshot::prepare(*data, pChangeLog, pChangeLogPath,
+                               CONTAINER_LOG_MAGIC);
+  } catch (MDException& e) {
+    delete data;
+    throw;
+  }
+
+  data->largestId = pFirstFreeId ? pFirstFreeId - 1 : 0;
+  data->entries.reserve(pIdMap.size());
+
+  for (auto it = pIdMap.begin(); it != pIdMap.end(); ++it) {
+    if (it->second.logOffset) {
+      data->entries.emplace_back(it->first, it->second.logOffset);
+    }
+  }
+
+  return data;
+}
+
+//----------------------------------------------------------------------------
+// Write the snapshot
+//----------------------------------------------------------------------------
+uint64_t
+ChangeLogContainerMDSvc::snapshotWrite(void*& snapshotData)
+{
+  std::unique_ptr<ChangeLogSnapshot::Data> data(
+    (ChangeLogSnapshot::Data*)snapshotData);
+  snapshotData = 0;
+
+  if (!data) {
+    MDException e(EINVAL);
+    e.getMessage() << "Snapshot data incorrect";
+    throw e;
+  }
+
+  return ChangeLogSnapshot::write(*data);
+}
+
 //----------------------------------------------------------------------------
 // Do the compacting
 //----------------------------------------------------------------------------
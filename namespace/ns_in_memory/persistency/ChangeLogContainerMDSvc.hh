@@ -32,6 +32,7 @@
 #include "namespace/interface/IFileMDSvc.hh"
 #include "namespace/interface/IQuota.hh"
 #include "namespace/ns_in_memory/persistency/ChangeLogFile.hh"
+#include "namespace/ns_in_memory/persistency/ParallelBoot.hh"
 #include "common/Murmur3.hh"
 #include "common/hopscotch_map.hh"
 #include <list>
@@ -63,7 +64,8 @@ public:
   ChangeLogContainerMDSvc():
     pFirstFreeId(1), pFollowerThread(0), pSlaveLock(0), pSlaveMode(false),
     pSlaveStarted(false), pSlavePoll(1000), pFollowStart(0), pQuotaStats(0),
-    pFileSvc(NULL), pAutoRepair(0), pResSize(1000000), pContainerAccounting(0)
+    pFileSvc(NULL), pAutoRepair(0), pResSize(1000000), pContainerAccounting(0),
+    pBootThreads(getDefaultBootThreads())
   {
     pChangeLog = new ChangeLogFile();
     pthread_mutex_init(&pFollowStartMutex, 0);
@@ -198,6 +200,27 @@ public:
   //--------------------------------------------------------------------------
   void compactCommit(void* compactingData, bool autorepair = false) override;
 
+  //----------------------------------------------------------------------------
+  //! Prepare writing a binary snapshot of the live records.
+  //!
+  //! No external container metadata mutation may occur while the method is
+  //! running.
+  //!
+  //! @return snapshot information that needs to be passed to snapshotWrite
+  //----------------------------------------------------------------------------
+  void* snapshotPrepare() override;
+
+  //----------------------------------------------------------------------------
+  //! Write the snapshot next to the change log. This does not access any of
+  //! the in-memory structures so it may run without the namespace lock.
+  //!
+  //! @param snapshotData snapshot information returned by snapshotPrepare,
+  //!                     it is released and reset
+  //!
+  //! @return size of the snapshot in bytes
+  //----------------------------------------------------------------------------
+  uint64_t snapshotWrite(void*& snapshotData) override;
+
   //--------------------------------------------------------------------------
   //! Make a transition from slave to master
   // -----------------------------------------------------------------------
@@ -358,6 +381,15 @@ public:
     return {};
   }
 
+  //----------------------------------------------------------------------------
+  //! Get the timing of the phases of the last boot
+  //----------------------------------------------------------------------------
+  std::vector<BootPhaseStatistics> getBootStatistics() override
+  {
+    std::lock_guard<std::mutex> lock(pBootStatsMutex);
+    return pBootStats;
+  }
+
 private:
   //--------------------------------------------------------------------------
   // Placeholder for the record info
@@ -411,6 +443,28 @@ private:
   //--------------------------------------------------------------------------
   virtual void loadContainer(IdMap::iterator& it);
 
+  //--------------------------------------------------------------------------
+  //! Load the containers from the snapshot of the change log, if there is a
+  //! usable one
+  //!
+  //! @param logOffset change log offset from which the scan has to continue
+  //! @param largestId largest id seen at the time of the snapshot
+  //!
+  //! @return true if the snapshot was loaded, false if the whole change log
+  //!         has to be scanned
+  //--------------------------------------------------------------------------
+  bool loadSnapshot(uint64_t& logOffset, uint64_t& largestId);
+
+  //--------------------------------------------------------------------------
+  //! Record the statistics of a finished boot phase
+  //--------------------------------------------------------------------------
+  void addBootPhase(BootPhase& phase, uint64_t items = UINT64_MAX)
+  {
+    BootPhaseStatistics stats = phase.finish(items);
+    std::lock_guard<std::mutex> lock(pBootStatsMutex);
+    pBootStats.push_back(stats);
+  }
+
   //--------------------------------------------------------------------------
   // Recreate the container structure recursively and create the list
   // of orphans and name conflicts
@@ -445,6 +499,9 @@ private:
   bool               pAutoRepair;
   uint64_t           pResSize;
   IFileMDChangeListener* pContainerAccounting;
+  unsigned           pBootThreads; ///< Number of threads used for booting
+  std::mutex         pBootStatsMutex;
+  std::vector<BootPhaseStatistics> pBootStats; ///< Timing of the boot phases
 };
 
 EOSNSNAMESPACE_END
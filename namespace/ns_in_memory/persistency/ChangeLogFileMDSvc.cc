@@ -24,11 +24,12 @@
 #include "ChangeLogFileMDSvc.hh"
 #include "ChangeLogContainerMDSvc.hh"
 #include "ChangeLogConstants.hh"
+#include "ChangeLogSnapshot.hh"
 #include "common/ShellCmd.hh"
-#include "common/Parallel.hh"
 #include "namespace/Constants.hh"
 #include "namespace/utils/Locking.hh"
 #include "namespace/utils/ThreadUtils.hh"
+#include "namespace/ns_in_memory/ContainerMD.hh"
 #include "namespace/ns_in_memory/FileMD.hh"
 #include "namespace/ns_in_memory/persistency/ChangeLogContainerMDSvc.hh"
 #include "XrdSys/XrdSysTimer.hh"
@@ -36,6 +37,7 @@
 #include <algorithm>
 #include <utility>
 #include <set>
+#include <unordered_set>
 #include <features.h>
 #if __GNUC_PREREQ(4,8) || defined(__clang__)
 #include <atomic>
@@ -741,229 +743,228 @@ void ChangeLogFileMDSvc::initialize()
   pFollowStart = pChangeLog->getFirstOffset();
 
   if (!pSlaveMode || logIsCompacted) {
+    {
+      std::lock_guard<std::mutex> lock(pBootStatsMutex);
+      pBootStats.clear();
+    }
+
     FileMDScanner scanner(pIdMap, pSlaveMode);
+    unsigned nthreads = pBootThreads;
+    fprintf(stderr, "INFO     [ booting with %u threads ]\n", nthreads);
+    // In master mode start from the snapshot if possible, then only the tail
+    // of the change log needs to be scanned
+    uint64_t scan_offset = pChangeLog->getFirstOffset();
+    uint64_t snapshot_largest_id = 0;
+
+    if (!pSlaveMode) {
+      loadSnapshot(scan_offset, snapshot_largest_id);
+    }
+
     pChangeLog->mmap();
-    pFollowStart = pChangeLog->scanAllRecords(&scanner);
-    pFirstFreeId = scanner.getLargestId() + 1;
-    time_t start_time = time(0);
-    time_t now = start_time;
+    BootPhase scan_phase("scan ", "file-scan", 0);
+    pFollowStart = pChangeLog->scanAllRecordsAtOffset(&scanner, scan_offset);
+    pFirstFreeId = std::max(scanner.getLargestId(), snapshot_largest_id) + 1;
+    addBootPhase(scan_phase, pIdMap.size());
     uint64_t end = pIdMap.size();
-#if __GNUC_PREREQ(4,8) || defined(__clang__)
-    std::atomic_ulong cnt(0);
-    int nthread = std::thread::hardware_concurrency();
-
-    if (pIdMap.size() / nthread && getenv("EOS_NS_BOOT_PARALLEL")) {
-      fprintf(stderr, "INFO     [ doing parallel boot ]\n");
-      // Recreate the files
-      std::mutex critical;
-      size_t chunk = pIdMap.size() / nthread;
-      size_t last_chunk = chunk + pIdMap.size() - (chunk * nthread);
-
-      if (!(pIdMap.size() / nthread)) {
-        nthread = 1;
-        last_chunk = chunk = pIdMap.size();
+    // Recreate the files updated after the snapshot, i.e. all of them if
+    // there is no snapshot
+    BootPhase load_phase("load ", "file-load", end, nthreads);
+    ForEachChunked(pIdMap, nthreads, [&](IdMap::iterator & it, unsigned) {
+      if (!it->second.buffer) {
+        load_phase.tick();
+        return;
       }
 
-      eos::common::Parallel::For(0, nthread , [&](int i) {
-        IdMap::iterator it = pIdMap.begin();
-        std::advance(it, i * chunk);
-        time_t now = time(NULL);
-        size_t progress = 0;
-
-        for (size_t n = 0; n < ((i == (nthread - 1)) ? last_chunk : chunk); ++n) {
-          cnt++;
-          //------------------------------------------------------------------
-          // Unpack the serialized buffers
-          //------------------------------------------------------------------
-          std::shared_ptr<IFileMD> file = std::make_shared<FileMD>(0, this);
-          file->deserialize(*it->second.buffer);
-          it.value().ptr = file;
-          delete it->second.buffer;
-          it.value().buffer = 0;
-          uint64_t lcnt = cnt.load();
-
-          if ((!i) && ((100.0 * lcnt / end) > progress)) {
-            //std::lock_guard<std::mutex> lock(critical);
-            now = time(NULL);
-            double estimate = (1 + end - lcnt) / ((1.0 * lcnt / (now + 1 - start_time)));
-
-            if (progress == 0) {
-              fprintf(stderr, "PROGRESS [ load %-64s ] %02u%% estimate none \n", "file-load",
-                      (unsigned int) progress);
-            } else {
-              fprintf(stderr, "PROGRESS [ load %-64s ] %02u%% estimate %3.01fs "
-                      "[ %lus/%.0fs ] [%lu/%lu]\n", "file-load",
-                      (unsigned int) progress, estimate,  time(NULL) - start_time,
-                      (double) time(NULL) - (double) start_time + estimate, lcnt, end);
-            }
-
-            progress += 2;
-          }
-
-          ++it;
-        }
-      });
-      pChangeLog->munmap();
-      IdMap::iterator it;
-      start_time = time(0);
-      uint64_t gcnt = 0;
-      size_t progress = 0;
-
-      for (it = pIdMap.begin(); it != pIdMap.end(); ++it) {
-        std::shared_ptr<IFileMD> file = it->second.ptr;
-        gcnt++;
-        ListenerList::iterator lit;
-
-        for (lit = pListeners.begin(); lit != pListeners.end(); ++lit) {
-          (*lit)->fileMDRead(file.get());
-        }
-
-        if ((100.0 * gcnt / end) > progress) {
-          now = time(NULL);
-          double estimate = (1 + end - gcnt) / ((1.0 * gcnt / (now + 1 - start_time)));
-
-          if (progress == 0) {
-            fprintf(stderr, "PROGRESS [ load %-64s ] %02u%% estimate none \n",
-                    "file-notify", (unsigned int) progress);
-          } else {
-            fprintf(stderr,
-                    "PROGRESS [ load %-64s ] %02u%% estimate %3.01fs  [ %lus/%.0fs ] [%lu/%lu]\n",
-                    "file-notify", (unsigned int) progress, estimate,  time(NULL) - start_time,
-                    (double) time(NULL) - (double) start_time + estimate, gcnt, end);
-          }
-
-          progress += 2;
-        }
+      std::shared_ptr<IFileMD> file = std::make_shared<FileMD>(0, this);
+      file->deserialize(*it->second.buffer);
+      it.value().ptr = file;
+      delete it->second.buffer;
+      it.value().buffer = 0;
+      load_phase.tick();
+    });
+    pChangeLog->munmap();
+    addBootPhase(load_phase);
+    // Notify the listeners, they are not thread safe
+    uint64_t obj_bytes = 0;
+    BootPhase notify_phase("load ", "file-notify", end);
+
+    for (auto it = pIdMap.begin(); it != pIdMap.end(); ++it) {
+      FileMD* file = static_cast<FileMD*>(it->second.ptr.get());
+      obj_bytes += file->getMemoryUsage();
+
+      for (auto lit = pListeners.begin(); lit != pListeners.end(); ++lit) {
+        (*lit)->fileMDRead(file);
       }
 
-      cnt.store(0);
-      std::mutex c_critical[256];
-      start_time = time(NULL);
-      eos::common::Parallel::For(0, nthread , [&](int i) {
-        IdMap::iterator it = pIdMap.begin();
-        std::advance(it, i * chunk);
-        time_t now = time(NULL);
-        size_t progress = 0;
-
-        for (size_t n = 0; n < ((i == (nthread - 1)) ? last_chunk : chunk); ++n) {
-          std::shared_ptr<IFileMD> file = it->second.ptr;
-          cnt++;
-
-          // Attach to the hierarchy
-          if (file->getContainerId() == 0) {
-            ++it;
-            continue;
-          }
+      notify_phase.tick();
+    }
 
-          std::shared_ptr<IContainerMD> cont;
+    addBootPhase(notify_phase);
+    // Attach to the hierarchy, files of the same container are serialized.
+    // The listeners are not thread safe, e.g. the container accounting
+    // updates the tree sizes, therefore the size changes are notified in a
+    // sequential pass afterwards. Broken files are rare and also handled
+    // sequentially, with the usual notifications. On a name conflict the file
+    // with the lowest id keeps the name whatever the thread timing, and the
+    // broken files are attached in id order.
+    std::mutex broken_mutex;
+    std::mutex cont_mutex[256];
+    std::vector<std::pair<const char*, IFileMD*>> broken;
+    BootPhase attach_phase("load ", "file-attach", end, nthreads);
+    ForEachChunked(pIdMap, nthreads, [&](IdMap::iterator & it, unsigned) {
+      attach_phase.tick();
+      IFileMD* file = it->second.ptr.get();
+
+      if (file->getContainerId() == 0) {
+        return;
+      }
 
-          try {
-            cont = pContSvc->getContainerMD(file->getContainerId());
-          } catch (MDException& e) {}
+      std::shared_ptr<IContainerMD> cont;
 
-          if (!cont) {
-            std::lock_guard<std::mutex> lock(critical);
+      try {
+        cont = pContSvc->getContainerMD(file->getContainerId());
+      } catch (MDException& e) {}
 
-            if (!pSlaveMode) {
-              attachBroken("orphans", file.get());
-            }
+      if (!cont) {
+        std::lock_guard<std::mutex> lock(broken_mutex);
+        broken.emplace_back("orphans", file);
+        return;
+      }
 
-            ++it;
-            continue;
-          }
+      std::lock_guard<std::mutex> lock(cont_mutex[cont->getId() % 256]);
+      std::shared_ptr<IFileMD> other = cont->findFile(file->getName());
 
-          std::lock_guard<std::mutex> lock(c_critical[cont->getId() % 256]);
+      if (other) {
+        IFileMD* conflict = file;
 
-          if (cont->findFile(file->getName())) {
-            std::lock_guard<std::mutex> lock(critical);
+        if (other->getId() > file->getId()) {
+          // Replaces the entry of the other file
+          static_cast<ContainerMD*>(cont.get())->addFileNoNotify(file);
+          conflict = other.get();
+        }
 
-            if (!pSlaveMode) {
-              attachBroken("name_conflicts", file.get());
-            }
+        std::lock_guard<std::mutex> lock(broken_mutex);
+        broken.emplace_back("name_conflicts", conflict);
+      } else {
+        static_cast<ContainerMD*>(cont.get())->addFileNoNotify(file);
+      }
+    });
+    addBootPhase(attach_phase);
+    typedef std::pair<const char*, IFileMD*> BrokenT;
+    std::sort(broken.begin(), broken.end(),
+    [](const BrokenT & a, const BrokenT & b) {
+      return a.second->getId() < b.second->getId();
+    });
+
+    if (!pListeners.empty()) {
+      std::unordered_set<IFileMD*> broken_files;
+
+      for (const auto& elem : broken) {
+        broken_files.insert(elem.second);
+      }
 
-            ++it;
-            continue;
-          } else {
-            cont->addFile(file.get());
-          }
+      BootPhase size_phase("load ", "file-attach-notify", end);
 
-          uint64_t lcnt = cnt.load();
+      for (auto it = pIdMap.begin(); it != pIdMap.end(); ++it) {
+        IFileMD* file = it->second.ptr.get();
+        size_phase.tick();
 
-          if ((i == (nthread - 1)) && ((100.0 * lcnt / end) > progress)) {
-            now = time(NULL);
-            double estimate = (1 + end - lcnt) / ((1.0 * lcnt / (now + 1 - start_time)));
+        if ((file->getContainerId() == 0) || broken_files.count(file)) {
+          continue;
+        }
 
-            if (progress == 0) {
-              fprintf(stderr, "PROGRESS [ load %-64s ] %02u%% estimate none \n",
-                      "file-attach", (unsigned int) progress);
-            } else {
-              fprintf(stderr,
-                      "PROGRESS [ load %-64s ] %02u%% estimate %3.01fs  [ %lus/%.0fs ] [%lu/%lu]\n",
-                      "file-attach", (unsigned int) progress, estimate,  time(NULL) - start_time,
-                      (double) time(NULL) - (double) start_time + estimate, lcnt, end);
-            }
+        IFileMDChangeListener::Event e(file, IFileMDChangeListener::SizeChange,
+                                       0, file->getSize());
+        notifyListeners(&e);
+      }
 
-            progress += 2;
-          }
+      addBootPhase(size_phase);
+    }
 
-          ++it;
-        }
-      });
-    } else
-#endif
-    {
-      // Recreate the files
-      IdMap::iterator it;
+    if (!pSlaveMode) {
+      for (const auto& elem : broken) {
+        attachBroken(elem.first, elem.second);
+      }
+    }
+    printMemoryUsage(obj_bytes);
+  }
 
-      for (it = pIdMap.begin(); it != pIdMap.end(); ++it) {
-        // Unpack the serialized buffers
-        std::shared_ptr<IFileMD> file = std::make_shared<FileMD>(0, this);
-        file->deserialize(*it->second.buffer);
-        it.value().ptr = file;
-        delete it->second.buffer;
-        it.value().buffer = 0;
-        ListenerList::iterator it;
+  if (!pSlaveMode && !logIsCompacted) {
+    // If we have a new changelog file in master mode we add the compaction mark
+    pChangeLog->addCompactionMark();
+  }
+}
 
-        for (it = pListeners.begin(); it != pListeners.end(); ++it) {
-          (*it)->fileMDRead(file.get());
-        }
+//------------------------------------------------------------------------------
+// Load the files from the snapshot of the change log
+//------------------------------------------------------------------------------
+bool ChangeLogFileMDSvc::loadSnapshot(uint64_t& logOffset, uint64_t& largestId)
+{
+  if (getenv("EOS_NS_BOOT_NOSNAPSHOT")) {
+    return false;
+  }
 
-        // Attach to the hierarchy
-        if (file->getContainerId() == 0) {
-          continue;
-        }
+  ChangeLogSnapshot snapshot;
+  std::string path = ChangeLogSnapshot::getPath(pChangeLogPath);
+  std::string reason;
 
-        std::shared_ptr<IContainerMD> cont;
+  if (!snapshot.open(path, pChangeLog, pChangeLogPath, FILE_LOG_MAGIC,
+                     reason)) {
+    fprintf(stderr, "INFO     [ not using file snapshot %s: %s ]\n",
+            path.c_str(), reason.c_str());
+    return false;
+  }
 
-        try {
-          cont = pContSvc->getContainerMD(file->getContainerId());
-        } catch (MDException& e) {}
+  bool checksum = !getenv("EOS_NS_BOOT_NOCRC32");
+  uint64_t num = snapshot.getNumRecords();
+  unsigned nthreads = pBootThreads;
 
-        if (!cont) {
-          if (!pSlaveMode) {
-            attachBroken("orphans", file.get());
-          }
+  try {
+    // The map can not be modified concurrently so insert the ids first, the
+    // threads then only fill in the objects
+    BootPhase index_phase("snapshot ", "file-snapshot-index", num);
+    pIdMap.reserve(num);
+
+    for (uint64_t i = 0; i < num; ++i) {
+      const ChangeLogSnapshot::Entry& entry = snapshot.getEntry(i);
+      pIdMap.insert(std::make_pair(entry.id,
+                                   DataInfo(entry.logOffset, nullptr)));
+    }
 
-          continue;
+    addBootPhase(index_phase, num);
+    BootPhase load_phase("snapshot ", "file-snapshot-load", num, nthreads);
+    ParallelFor(snapshot.getNumChunks(), nthreads, [&](size_t chunk, unsigned) {
+      snapshot.scanChunk(chunk, checksum, [&](uint64_t i, Buffer & buffer) {
+        std::shared_ptr<IFileMD> file = std::make_shared<FileMD>(0, this);
+        file->deserialize(buffer);
+        IdMap::iterator it = pIdMap.find(snapshot.getEntry(i).id);
+
+        if ((it == pIdMap.end()) || (it->first != file->getId())) {
+          MDException e(EFAULT);
+          e.getMessage() << "Snapshot: File #" << file->getId()
+                         << " does not match the index";
+          throw e;
         }
 
-        if (cont->findFile(file->getName())) {
-          if (!pSlaveMode) {
-            attachBroken("name_conflicts", file.get());
-          }
-
-          continue;
-        } else {
-          cont->addFile(file.get());
-        }
-      }
-    }
+        it.value().ptr = file;
+        load_phase.tick();
+      });
+    });
+    addBootPhase(load_phase);
+  } catch (MDException& e) {
+    fprintf(stderr, "ALERT    [ failed to load file snapshot %s: %s - scanning "
+            "the whole change log ]\n", path.c_str(), e.getMessage().str().c_str());
+    pIdMap.clear();
+    std::lock_guard<std::mutex> lock(pBootStatsMutex);
+    pBootStats.clear();
+    return false;
   }
 
-  if (!pSlaveMode && !logIsCompacted) {
-    // If we have a new changelog file in master mode we add the compaction mark
-    pChangeLog->addCompactionMark();
-  }
+  logOffset = snapshot.getLogOffset();
+  largestId = snapshot.getLargestId();
+  fprintf(stderr, "INFO     [ loaded %lu files from snapshot %s, scanning the "
+          "change log from offset=%lu ]\n", num, path.c_str(), logOffset);
+  return true;
 }
 
 //------------------------------------------------------------------------------
@@ -1087,6 +1088,17 @@ void ChangeLogFileMDSvc::configure(
   if (it != config.end()) {
     pResSize = strtoull(it->second.c_str(), 0, 10);
   }
+
+  // Number of threads used for booting, 1 means sequential boot
+  it = config.find("boot_threads");
+
+  if (it != config.end()) {
+    pBootThreads = strtoul(it->second.c_str(), 0, 10);
+
+    if (pBootThreads == 0) {
+      pBootThreads = getDefaultBootThreads();
+    }
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -1333,6 +1345,51 @@ void* ChangeLogFileMDSvc::compactPrepare(const std::string& newLogFileName)
   return data;
 }
 
+//------------------------------------------------------------------------------
+// Prepare writing a snapshot
+//------------------------------------------------------------------------------
+void* ChangeLogFileMDSvc::snapshotPrepare()
+{
+  ChangeLogSnapshot::Data* data = new ChangeLogSnapshot::Data();
+
+  try {
+    ChangeLogSnapshot::prepare(*data, pChangeLog, pChangeLogPath,
+                               FILE_LOG_MAGIC);
+  } catch (MDException& e) {
+    delete data;
+    throw;
+  }
+
+  data->largestId = pFirstFreeId ? pFirstFreeId - 1 : 0;
+  data->entries.reserve(pIdMap.size());
+
+  for (auto it = pIdMap.begin(); it != pIdMap.end(); ++it) {
+    if (it->second.logOffset) {
+      data->entries.emplace_back(it->first, it->second.logOffset);
+    }
+  }
+
+  return data;
+}
+
+//------------------------------------------------------------------------------
+// Write the snapshot
+//------------------------------------------------------------------------------
+uint64_t ChangeLogFileMDSvc::snapshotWrite(void*& snapshotData)
+{
+  std::unique_ptr<ChangeLogSnapshot::Data> data(
+    (ChangeLogSnapshot::Data*)snapshotData);
+  snapshotData = 0;
+
+  if (!data) {
+    MDException e(EINVAL);
+    e.getMessage() << "Snapshot data incorrect" ;
+    throw e;
+  }
+
+  return ChangeLogSnapshot::write(*data);
+}
+
 //------------------------------------------------------------------------------
 // Do the compacting
 //------------------------------------------------------------------------------
@@ -1509,6 +1566,30 @@ void ChangeLogFileMDSvc::stopSlave()
   pFollowerThread = 0;
 }
 
+//------------------------------------------------------------------------------
+// Print the memory used per file after booting. Besides the file objects we
+// account for the shared pointer control blocks and the id map buckets.
+//------------------------------------------------------------------------------
+void ChangeLogFileMDSvc::printMemoryUsage(uint64_t objBytes)
+{
+  uint64_t num_files = pIdMap.size();
+
+  if (num_files == 0) {
+    return;
+  }
+
+  // Control block of std::make_shared: the use and weak counters plus vptr
+  static constexpr uint64_t kSharedPtrOverhead = 16;
+  uint64_t ptr_bytes = num_files * kSharedPtrOverhead;
+  uint64_t index_bytes = pIdMap.bucket_count() * sizeof(IdMap::value_type);
+  double total = objBytes + ptr_bytes + index_bytes;
+  fprintf(stderr, "INFO     [ file metadata uses %.01f bytes/file: %.01f object "
+          "%.01f pointer %.01f index ] [ %lu files %.02f GB ]\n",
+          total / num_files, 1.0 * objBytes / num_files,
+          1.0 * ptr_bytes / num_files, 1.0 * index_bytes / num_files,
+          num_files, total / (1024 * 1024 * 1024));
+}
+
 //------------------------------------------------------------------------------
 // Attach a broken file to lost+found
 //------------------------------------------------------------------------------
@@ -0,0 +1,408 @@
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "namespace/ns_in_memory/persistency/ChangeLogSnapshot.hh"
+#include "namespace/ns_in_memory/persistency/ChangeLogConstants.hh"
+#include "namespace/ns_in_memory/persistency/ChangeLogFile.hh"
+#include "namespace/utils/DataHelper.hh"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+
+EOSNSNAMESPACE_BEGIN
+
+constexpr uint32_t ChangeLogSnapshot::kMagic;
+constexpr uint32_t ChangeLogSnapshot::kVersion;
+constexpr uint64_t ChangeLogSnapshot::kChunkSize;
+
+namespace
+{
+//------------------------------------------------------------------------------
+// Compute the crc32 of a memory region of any size
+//------------------------------------------------------------------------------
+uint32_t
+computeCRC32(const void* ptr, uint64_t len)
+{
+  static constexpr uint64_t kMaxBlock = 1ull << 30;
+  uint32_t crc = 0;
+  const char* pos = (const char*)ptr;
+
+  while (len) {
+    uint64_t block = std::min(len, kMaxBlock);
+    crc = DataHelper::updateCRC32(crc, (void*)pos, block);
+    pos += block;
+    len -= block;
+  }
+
+  return crc;
+}
+
+//------------------------------------------------------------------------------
+// Write the whole buffer at the given offset
+//------------------------------------------------------------------------------
+void
+writeAt(int fd, const void* ptr, uint64_t len, uint64_t offset,
+        const std::string& path)
+{
+  const char* pos = (const char*)ptr;
+
+  while (len) {
+    ssize_t nwrite = ::pwrite(fd, pos, len, offset);
+
+    if (nwrite < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      MDException ex(errno);
+      ex.getMessage() << "Snapshot: Unable to write to " << path << ": ";
+      ex.getMessage() << strerror(errno);
+      throw ex;
+    }
+
+    pos += nwrite;
+    len -= nwrite;
+    offset += nwrite;
+  }
+}
+}
+
+//------------------------------------------------------------------------------
+// Fill in the change log information of the snapshot data
+//------------------------------------------------------------------------------
+void
+ChangeLogSnapshot::prepare(Data& data, ChangeLogFile* log,
+                           const std::string& changelog_path,
+                           uint16_t log_magic)
+{
+  struct stat info;
+
+  if (::stat(changelog_path.c_str(), &info)) {
+    MDException ex(errno);
+    ex.getMessage() << "Snapshot: Unable to stat " << changelog_path << ": ";
+    ex.getMessage() << strerror(errno);
+    throw ex;
+  }
+
+  data.path = getPath(changelog_path);
+  data.log = log;
+  data.logMagic = log_magic;
+  data.logDevice = info.st_dev;
+  data.logInode = info.st_ino;
+  data.logOffset = log->getNextOffset();
+}
+
+//------------------------------------------------------------------------------
+// Write the snapshot
+//------------------------------------------------------------------------------
+uint64_t
+ChangeLogSnapshot::write(Data& data)
+{
+  // Read the change log sequentially
+  std::sort(data.entries.begin(), data.entries.end(),
+  [](const Entry & a, const Entry & b) {
+    return a.logOffset < b.logOffset;
+  });
+  Header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = kMagic;
+  hdr.version = kVersion;
+  hdr.logMagic = data.logMagic;
+  hdr.logDevice = data.logDevice;
+  hdr.logInode = data.logInode;
+  hdr.logOffset = data.logOffset;
+  hdr.largestId = data.largestId;
+  hdr.numRecords = data.entries.size();
+  hdr.numChunks = (hdr.numRecords + kChunkSize - 1) / kChunkSize;
+  hdr.ctime = time(0);
+  uint64_t index_offset = sizeof(Header);
+  uint64_t chunks_offset = index_offset + hdr.numRecords * sizeof(Entry);
+  hdr.dataOffset = chunks_offset + hdr.numChunks * sizeof(Chunk);
+  std::string tmp_path = data.path + ".tmp";
+  int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+  if (fd == -1) {
+    MDException ex(errno);
+    ex.getMessage() << "Snapshot: Unable to create " << tmp_path << ": ";
+    ex.getMessage() << strerror(errno);
+    throw ex;
+  }
+
+  try {
+    std::vector<Chunk> chunks(hdr.numChunks);
+    Buffer record;
+    Buffer out(0);
+    uint64_t data_pos = 0;
+
+    for (uint64_t i = 0; i < hdr.numRecords; ++i) {
+      Chunk& chunk = chunks[i / kChunkSize];
+
+      if (i % kChunkSize == 0) {
+        chunk.dataPos = data_pos;
+      }
+
+      uint8_t type = data.log->readRecord(data.entries[i].logOffset, record);
+
+      if (type != UPDATE_RECORD_MAGIC) {
+        MDException ex(EFAULT);
+        ex.getMessage() << "Snapshot: Not an update record at offset ";
+        ex.getMessage() << data.entries[i].logOffset;
+        throw ex;
+      }
+
+      uint32_t len = record.getSize();
+      size_t pos = out.getSize();
+      out.putData(&len, sizeof(len));
+      out.putData(record.getDataPtr(), len);
+      chunk.crc = DataHelper::updateCRC32(chunk.crc, out.getDataPtr() + pos,
+                                          out.getSize() - pos);
+      chunk.dataLen += out.getSize() - pos;
+      data_pos += out.getSize() - pos;
+
+      if (out.getSize() >= (4 << 20)) {
+        writeAt(fd, out.getDataPtr(), out.getSize(),
+                hdr.dataOffset + data_pos - out.getSize(), tmp_path);
+        out.clear();
+      }
+    }
+
+    if (out.getSize()) {
+      writeAt(fd, out.getDataPtr(), out.getSize(),
+              hdr.dataOffset + data_pos - out.getSize(), tmp_path);
+    }
+
+    hdr.fileSize = hdr.dataOffset + data_pos;
+    hdr.indexCrc = computeCRC32(data.entries.data(),
+                                hdr.numRecords * sizeof(Entry));
+    hdr.chunksCrc = computeCRC32(chunks.data(), hdr.numChunks * sizeof(Chunk));
+    hdr.headerCrc = computeHeaderCrc(hdr);
+    writeAt(fd, data.entries.data(), hdr.numRecords * sizeof(Entry),
+            index_offset, tmp_path);
+    writeAt(fd, chunks.data(), hdr.numChunks * sizeof(Chunk), chunks_offset,
+            tmp_path);
+    writeAt(fd, &hdr, sizeof(hdr), 0, tmp_path);
+
+    if (::fsync(fd)) {
+      MDException ex(errno);
+      ex.getMessage() << "Snapshot: Unable to sync " << tmp_path << ": ";
+      ex.getMessage() << strerror(errno);
+      throw ex;
+    }
+  } catch (MDException& e) {
+    ::close(fd);
+    ::unlink(tmp_path.c_str());
+    throw;
+  }
+
+  ::close(fd);
+
+  if (::rename(tmp_path.c_str(), data.path.c_str())) {
+    MDException ex(errno);
+    ex.getMessage() << "Snapshot: Unable to rename " << tmp_path << " to ";
+    ex.getMessage() << data.path << ": " << strerror(errno);
+    ::unlink(tmp_path.c_str());
+    throw ex;
+  }
+
+  return hdr.fileSize;
+}
+
+//------------------------------------------------------------------------------
+// Constructor
+//------------------------------------------------------------------------------
+ChangeLogSnapshot::ChangeLogSnapshot():
+  pMap(0), pMapLen(0), pHeader(0), pIndex(0), pChunks(0), pData(0)
+{}
+
+//------------------------------------------------------------------------------
+// Destructor
+//------------------------------------------------------------------------------
+ChangeLogSnapshot::~ChangeLogSnapshot()
+{
+  close();
+}
+
+//------------------------------------------------------------------------------
+// Map the snapshot and check that it matches the given change log
+//------------------------------------------------------------------------------
+bool
+ChangeLogSnapshot::open(const std::string& path, ChangeLogFile* log,
+                        const std::string& changelog_path, uint16_t log_magic,
+                        std::string& reason)
+{
+  close();
+  pPath = path;
+  int fd = ::open(path.c_str(), O_RDONLY);
+
+  if (fd == -1) {
+    reason = "no snapshot file";
+    return false;
+  }
+
+  struct stat info;
+
+  if (::fstat(fd, &info) || ((uint64_t)info.st_size < sizeof(Header))) {
+    ::close(fd);
+    reason = "snapshot file too short";
+    return false;
+  }
+
+  void* map = ::mmap(0, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+
+  if (map == MAP_FAILED) {
+    reason = "unable to mmap snapshot file: ";
+    reason += strerror(errno);
+    return false;
+  }
+
+  pMap = (char*)map;
+  pMapLen = info.st_size;
+  pHeader = (const Header*)pMap;
+
+  if ((pHeader->magic != kMagic) || (pHeader->version != kVersion) ||
+      (pHeader->logMagic != log_magic) ||
+      (pHeader->headerCrc != computeHeaderCrc(*pHeader))) {
+    reason = "invalid snapshot header";
+    close();
+    return false;
+  }
+
+  if ((pHeader->fileSize != pMapLen) ||
+      (pHeader->numChunks != (pHeader->numRecords + kChunkSize - 1) /
+       kChunkSize) ||
+      (pHeader->dataOffset != sizeof(Header) + pHeader->numRecords *
+       sizeof(Entry) + pHeader->numChunks * sizeof(Chunk)) ||
+      (pHeader->dataOffset > pMapLen)) {
+    reason = "snapshot file size does not match its header";
+    close();
+    return false;
+  }
+
+  pIndex = (const Entry*)(pMap + sizeof(Header));
+  pChunks = (const Chunk*)(pIndex + pHeader->numRecords);
+  pData = pMap + pHeader->dataOffset;
+
+  if ((computeCRC32(pIndex, pHeader->numRecords * sizeof(Entry)) !=
+       pHeader->indexCrc) ||
+      (computeCRC32(pChunks, pHeader->numChunks * sizeof(Chunk)) !=
+       pHeader->chunksCrc)) {
+    reason = "snapshot index checksum mismatch";
+    close();
+    return false;
+  }
+
+  for (uint64_t i = 0; i < pHeader->numChunks; ++i) {
+    if (pChunks[i].dataPos + pChunks[i].dataLen > pMapLen - pHeader->dataOffset) {
+      reason = "snapshot chunk out of bounds";
+      close();
+      return false;
+    }
+  }
+
+  // The snapshot must have been taken from this very change log
+  if (::stat(changelog_path.c_str(), &info) ||
+      ((uint64_t)info.st_dev != pHeader->logDevice) ||
+      ((uint64_t)info.st_ino != pHeader->logInode)) {
+    reason = "snapshot belongs to a different change log";
+    close();
+    return false;
+  }
+
+  uint64_t log_end = log->getNextOffset();
+
+  if (pHeader->logOffset > log_end) {
+    reason = "change log shorter than snapshot offset";
+    close();
+    return false;
+  }
+
+  // The snapshot offset must be the start of a record
+  if (pHeader->logOffset < log_end) {
+    try {
+      Buffer record;
+      log->readRecord(pHeader->logOffset, record);
+    } catch (MDException& e) {
+      reason = "no change log record at snapshot offset";
+      close();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Unmap the snapshot
+//------------------------------------------------------------------------------
+void
+ChangeLogSnapshot::close()
+{
+  if (pMap) {
+    ::munmap(pMap, pMapLen);
+  }
+
+  pMap = 0;
+  pMapLen = 0;
+  pHeader = 0;
+  pIndex = 0;
+  pChunks = 0;
+  pData = 0;
+}
+
+//------------------------------------------------------------------------------
+// Compute the checksum of the header, excluding the checksum field
+//------------------------------------------------------------------------------
+uint32_t
+ChangeLogSnapshot::computeHeaderCrc(const Header& hdr)
+{
+  Header copy = hdr;
+  copy.headerCrc = 0;
+  return computeCRC32(&copy, sizeof(copy));
+}
+
+//------------------------------------------------------------------------------
+// Verify the checksum of a chunk
+//------------------------------------------------------------------------------
+void
+ChangeLogSnapshot::verifyChunk(uint64_t chunk) const
+{
+  const Chunk& c = pChunks[chunk];
+
+  if (computeCRC32(pData + c.dataPos, c.dataLen) != c.crc) {
+    throwCorrupted(chunk);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Throw exception about a corrupted chunk
+//------------------------------------------------------------------------------
+void
+ChangeLogSnapshot::throwCorrupted(uint64_t chunk) const
+{
+  MDException ex(EFAULT);
+  ex.getMessage() << "Snapshot: Corrupted chunk " << chunk << " in " << pPath;
+  throw ex;
+}
+
+EOSNSNAMESPACE_END
@@ -0,0 +1,276 @@
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+//------------------------------------------------------------------------------
+//! @brief Binary snapshot of the live records of a change log file
+//------------------------------------------------------------------------------
+
+#pragma once
+#include "namespace/Namespace.hh"
+#include "namespace/MDException.hh"
+#include "namespace/utils/Buffer.hh"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+EOSNSNAMESPACE_BEGIN
+
+class ChangeLogFile;
+
+//------------------------------------------------------------------------------
+//! Snapshot of the records describing the current state of a change log file,
+//! i.e. the last update record of every object which was not deleted.
+//!
+//! Booting from the snapshot avoids scanning the whole change log: the
+//! records are read from a single mmaped file in parallel and only the part
+//! of the change log written after the snapshot needs to be scanned. The
+//! snapshot is bound to the change log it was taken from and is refused if
+//! the change log was replaced e.g. by compacting.
+//!
+//! Layout of the file, all integers in host byte order:
+//!   header
+//!   index:  numRecords x {id, log offset}
+//!   chunks: numChunks x {data position, data length, crc32}
+//!   data:   numRecords x {uint32 length, serialized object}
+//! Every chunk groups kChunkSize consecutive records.
+//------------------------------------------------------------------------------
+class ChangeLogSnapshot
+{
+public:
+  static constexpr uint32_t kMagic = 0x534e5345; ///< "ESNS"
+  static constexpr uint32_t kVersion = 1;
+  static constexpr uint64_t kChunkSize = 4096;
+
+  //----------------------------------------------------------------------------
+  //! Record to be stored in the snapshot
+  //----------------------------------------------------------------------------
+  struct Entry {
+    Entry(): id(0), logOffset(0) {}
+    Entry(uint64_t i, uint64_t o): id(i), logOffset(o) {}
+    uint64_t id;
+    uint64_t logOffset;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Everything needed to write a snapshot, gathered while the namespace is
+  //! locked and used afterwards without the lock
+  //----------------------------------------------------------------------------
+  struct Data {
+    Data(): log(0), logMagic(0), logDevice(0), logInode(0), logOffset(0),
+      largestId(0) {}
+    std::string path;
+    ChangeLogFile* log;
+    uint16_t logMagic;
+    uint64_t logDevice;
+    uint64_t logInode;
+    uint64_t logOffset;
+    uint64_t largestId;
+    std::vector<Entry> entries;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Get the path of the snapshot belonging to the given change log
+  //----------------------------------------------------------------------------
+  static std::string getPath(const std::string& changelog_path)
+  {
+    return changelog_path + ".snapshot";
+  }
+
+  //----------------------------------------------------------------------------
+  //! Fill in the change log information of the snapshot data. Must be called
+  //! while no mutations happen.
+  //!
+  //! @param data snapshot data
+  //! @param log change log file
+  //! @param changelog_path path of the change log file
+  //! @param log_magic content flag of the change log file
+  //----------------------------------------------------------------------------
+  static void prepare(Data& data, ChangeLogFile* log,
+                      const std::string& changelog_path, uint16_t log_magic);
+
+  //----------------------------------------------------------------------------
+  //! Write the snapshot. The records are copied from the change log so no
+  //! namespace lock is needed. The snapshot is written to a temporary file
+  //! which replaces the previous snapshot only once complete.
+  //!
+  //! @param data snapshot data, the entries get sorted by log offset
+  //!
+  //! @return size of the snapshot file
+  //----------------------------------------------------------------------------
+  static uint64_t write(Data& data);
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //----------------------------------------------------------------------------
+  ChangeLogSnapshot();
+
+  //----------------------------------------------------------------------------
+  //! Destructor
+  //----------------------------------------------------------------------------
+  ~ChangeLogSnapshot();
+
+  //----------------------------------------------------------------------------
+  //! Map the snapshot and check that it matches the given change log
+  //!
+  //! @param path snapshot path
+  //! @param log open change log file
+  //! @param changelog_path path of the change log file
+  //! @param log_magic content flag of the change log file
+  //! @param reason reason why the snapshot can not be used
+  //!
+  //! @return true if the snapshot can be used, otherwise false
+  //----------------------------------------------------------------------------
+  bool open(const std::string& path, ChangeLogFile* log,
+            const std::string& changelog_path, uint16_t log_magic,
+            std::string& reason);
+
+  //----------------------------------------------------------------------------
+  //! Unmap the snapshot
+  //----------------------------------------------------------------------------
+  void close();
+
+  //----------------------------------------------------------------------------
+  //! Change log offset up to which the snapshot is up to date
+  //----------------------------------------------------------------------------
+  uint64_t getLogOffset() const
+  {
+    return pHeader->logOffset;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Largest id seen in the change log at the time of the snapshot
+  //----------------------------------------------------------------------------
+  uint64_t getLargestId() const
+  {
+    return pHeader->largestId;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Number of records
+  //----------------------------------------------------------------------------
+  uint64_t getNumRecords() const
+  {
+    return pHeader->numRecords;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Number of chunks
+  //----------------------------------------------------------------------------
+  uint64_t getNumChunks() const
+  {
+    return pHeader->numChunks;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the index entry of the given record
+  //----------------------------------------------------------------------------
+  const Entry& getEntry(uint64_t i) const
+  {
+    return pIndex[i];
+  }
+
+  //----------------------------------------------------------------------------
+  //! Call func(index, buffer) for every record of the given chunk, the buffer
+  //! points into the mapped file. Different chunks may be processed by
+  //! different threads at the same time.
+  //!
+  //! @param chunk chunk number
+  //! @param checksum verify the crc32 checksum of the chunk
+  //----------------------------------------------------------------------------
+  template<typename Func>
+  void scanChunk(uint64_t chunk, bool checksum, Func func) const
+  {
+    const Chunk& c = pChunks[chunk];
+    char* ptr = pData + c.dataPos;
+    char* end = ptr + c.dataLen;
+
+    if (checksum) {
+      verifyChunk(chunk);
+    }
+
+    Buffer buffer(0);
+    uint64_t last = std::min((chunk + 1) * kChunkSize, pHeader->numRecords);
+
+    for (uint64_t i = chunk * kChunkSize; i < last; ++i) {
+      uint32_t len;
+
+      if (ptr + sizeof(len) > end) {
+        throwCorrupted(chunk);
+      }
+
+      memcpy(&len, ptr, sizeof(len));
+      ptr += sizeof(len);
+
+      if (ptr + len > end) {
+        throwCorrupted(chunk);
+      }
+
+      buffer.setDataPtr(ptr, len);
+      func(i, buffer);
+      ptr += len;
+    }
+  }
+
+private:
+  //----------------------------------------------------------------------------
+  //! Header of the snapshot file
+  //----------------------------------------------------------------------------
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t logMagic;
+    uint32_t headerCrc;
+    uint64_t logDevice;
+    uint64_t logInode;
+    uint64_t logOffset;
+    uint64_t largestId;
+    uint64_t numRecords;
+    uint64_t numChunks;
+    uint64_t dataOffset;
+    uint64_t fileSize;
+    uint64_t ctime;
+    uint32_t indexCrc;
+    uint32_t chunksCrc;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Chunk descriptor, the position is relative to the data section
+  //----------------------------------------------------------------------------
+  struct Chunk {
+    uint64_t dataPos;
+    uint64_t dataLen;
+    uint32_t crc;
+    uint32_t reserved;
+  };
+
+  static uint32_t computeHeaderCrc(const Header& hdr);
+  void verifyChunk(uint64_t chunk) const;
+  [[noreturn]] void throwCorrupted(uint64_t chunk) const;
+
+  char* pMap;
+  uint64_t pMapLen;
+  const Header* pHeader;
+  const Entry* pIndex;
+  const Chunk* pChunks;
+  char* pData;
+  std::string pPath;
+};
+
+EOSNSNAMESPACE_END
@@ -0,0 +1,272 @@
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+//------------------------------------------------------------------------------
+//! @brief Helpers for booting the change log based namespace with multiple
+//!        threads
+//------------------------------------------------------------------------------
+
+#pragma once
+#include "namespace/Namespace.hh"
+#include "namespace/interface/Misc.hh"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+EOSNSNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Get the default number of boot threads, one per core
+//------------------------------------------------------------------------------
+inline unsigned
+getDefaultBootThreads()
+{
+  unsigned nthreads = std::thread::hardware_concurrency();
+  return (nthreads ? nthreads : 8);
+}
+
+//------------------------------------------------------------------------------
+//! Call func(i, thread_index) for every i in [0, num) using the given number
+//! of threads. The threads grab the next unprocessed index from a shared
+//! cursor until all are done. With a single thread everything runs in the
+//! calling thread. The first exception thrown by the function is rethrown
+//! once all threads are done.
+//!
+//! @param num number of items
+//! @param nthreads number of threads
+//! @param func function called as func(index, thread_index)
+//------------------------------------------------------------------------------
+template<typename Func>
+void
+ParallelFor(size_t num, unsigned nthreads, Func func)
+{
+  if (nthreads <= 1 || num <= 1) {
+    for (size_t i = 0; i < num; ++i) {
+      func(i, 0u);
+    }
+
+    return;
+  }
+
+  nthreads = std::min<size_t>(nthreads, num);
+  std::atomic<size_t> next(0);
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  std::vector<std::thread> pool;
+  pool.reserve(nthreads);
+
+  for (unsigned i = 0; i < nthreads; ++i) {
+    pool.emplace_back([&, i]() {
+      try {
+        size_t item;
+
+        while ((item = next.fetch_add(1)) < num) {
+          func(item, i);
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+
+        if (!error) {
+          error = std::current_exception();
+        }
+
+        // Make the other threads stop early
+        next.store(num);
+      }
+    });
+  }
+
+  for (auto& thread : pool) {
+    thread.join();
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+//------------------------------------------------------------------------------
+//! Cut the map into chunks of consecutive elements in a single pass and call
+//! func(chunk, begin, end, thread_index) for every chunk using the given
+//! number of threads. The threads grab the next unprocessed chunk from a
+//! shared cursor until all are done. The chunks only depend on the map
+//! contents and the chunk size, not on the number of threads. The first
+//! exception thrown by the function is rethrown once all threads are done.
+//!
+//! @param map map to iterate over - must not be modified structurally
+//! @param nthreads number of threads
+//! @param chunk_size number of elements per chunk
+//! @param func function called as func(chunk, begin, end, thread_index)
+//!
+//! @return number of chunks
+//------------------------------------------------------------------------------
+template<typename Map, typename Func>
+size_t
+ForEachChunk(Map& map, unsigned nthreads, size_t chunk_size, Func func)
+{
+  std::vector<typename Map::iterator> starts;
+  starts.reserve(map.size() / chunk_size + 2);
+  size_t pos = 0;
+
+  for (auto it = map.begin(); it != map.end(); ++it, ++pos) {
+    if (pos % chunk_size == 0) {
+      starts.push_back(it);
+    }
+  }
+
+  starts.push_back(map.end());
+  size_t num_chunks = starts.size() - 1;
+  ParallelFor(num_chunks, nthreads, [&](size_t chunk, unsigned i) {
+    func(chunk, starts[chunk], starts[chunk + 1], i);
+  });
+  return num_chunks;
+}
+
+//------------------------------------------------------------------------------
+//! Apply the given function to every element of the map using the given
+//! number of threads.
+//!
+//! The map is cut into chunks of consecutive elements in a single pass, the
+//! threads then grab the next unprocessed chunk from a shared cursor until all
+//! are done. This way threads which hit expensive records do not hold back
+//! the others, as it happens when splitting the map in one equal size slice
+//! per thread. With a single thread everything runs in the calling thread.
+//! The first exception thrown by the function is rethrown once all threads
+//! are done.
+//!
+//! @param map map to iterate over - must not be modified structurally
+//! @param nthreads number of threads
+//! @param func function called as func(iterator&, thread_index)
+//------------------------------------------------------------------------------
+template<typename Map, typename Func>
+void
+ForEachChunked(Map& map, unsigned nthreads, Func func)
+{
+  static constexpr size_t kChunkSize = 4096;
+
+  if (nthreads <= 1 || map.size() <= kChunkSize) {
+    for (auto it = map.begin(); it != map.end(); ++it) {
+      func(it, 0u);
+    }
+
+    return;
+  }
+
+  typedef typename Map::iterator Iterator;
+  ForEachChunk(map, nthreads, kChunkSize,
+  [&](size_t, Iterator begin, Iterator end, unsigned i) {
+    for (auto it = begin; it != end; ++it) {
+      func(it, i);
+    }
+  });
+}
+
+//------------------------------------------------------------------------------
+//! Thread safe progress and timing report of one boot phase
+//------------------------------------------------------------------------------
+class BootPhase
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //!
+  //! @param prefix prefix of the progress tag e.g. "load "
+  //! @param name phase name
+  //! @param total expected number of items
+  //! @param nthreads number of threads working on the phase
+  //----------------------------------------------------------------------------
+  BootPhase(const char* prefix, const char* name, uint64_t total,
+            unsigned nthreads = 1):
+    mPrefix(prefix), mName(name), mTotal(total), mThreads(nthreads),
+    mDone(0), mProgress(0), mStart(std::chrono::steady_clock::now())
+  {}
+
+  //----------------------------------------------------------------------------
+  //! Account for one processed item, printing the progress every 2%
+  //----------------------------------------------------------------------------
+  void tick()
+  {
+    uint64_t done = ++mDone;
+    unsigned progress = mProgress.load();
+
+    // Phases of unknown size only report when finished
+    if ((mTotal == 0) || ((100.0 * done / mTotal) <= progress)) {
+      return;
+    }
+
+    if (!mProgress.compare_exchange_strong(progress, progress + 2)) {
+      return;
+    }
+
+    double elapsed = getElapsed();
+
+    if (progress == 0) {
+      fprintf(stderr, "PROGRESS [ %s%-64s ] %02u%% estimate none \n",
+              mPrefix, mName, progress);
+    } else {
+      double estimate = (mTotal - done) * elapsed / done;
+      fprintf(stderr, "PROGRESS [ %s%-64s ] %02u%% estimate %3.01fs "
+              "[ %.0fs/%.0fs ] [%lu/%lu]\n", mPrefix, mName, progress, estimate,
+              elapsed, elapsed + estimate, done, mTotal);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Finish the phase
+  //!
+  //! @param items number of processed items, if different from the number
+  //!        of calls to tick
+  //!
+  //! @return statistics of the phase
+  //----------------------------------------------------------------------------
+  BootPhaseStatistics finish(uint64_t items = UINT64_MAX)
+  {
+    BootPhaseStatistics stats;
+    stats.name = mName;
+    stats.items = (items == UINT64_MAX) ? mDone.load() : items;
+    stats.seconds = getElapsed();
+    stats.threads = mThreads;
+    fprintf(stderr, "ALERT    [ %-64s ] finished in %.01fs [ %lu items %.0f Hz "
+            "%u threads ]\n", mName, stats.seconds, stats.items,
+            stats.seconds ? stats.items / stats.seconds : 0.0, mThreads);
+    return stats;
+  }
+
+private:
+  double getElapsed() const
+  {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         mStart).count();
+  }
+
+  const char* mPrefix;
+  const char* mName;
+  uint64_t mTotal;
+  unsigned mThreads;
+  std::atomic<uint64_t> mDone;
+  std::atomic<unsigned> mProgress;
+  std::chrono::steady_clock::time_point mStart;
+};
+
+EOSNSNAMESPACE_END
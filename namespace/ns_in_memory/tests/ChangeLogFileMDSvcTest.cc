@@ -24,10 +24,12 @@
 #include <cppunit/extensions/HelperMacros.h>
 #include <stdint.h>
 #include <unistd.h>
+#include <fcntl.h>
 
 #include "namespace/utils/TestHelpers.hh"
 #include "namespace/ns_in_memory/persistency/ChangeLogFileMDSvc.hh"
 #include "namespace/ns_in_memory/persistency/ChangeLogContainerMDSvc.hh"
+#include "namespace/ns_in_memory/persistency/ChangeLogSnapshot.hh"
 
 
 //------------------------------------------------------------------------------
@@ -38,9 +40,11 @@ class ChangeLogFileMDSvcTest: public CppUnit::TestCase
   public:
     CPPUNIT_TEST_SUITE( ChangeLogFileMDSvcTest );
     CPPUNIT_TEST( reloadTest );
+    CPPUNIT_TEST( snapshotTest );
     CPPUNIT_TEST_SUITE_END();
 
     void reloadTest();
+    void snapshotTest();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION( ChangeLogFileMDSvcTest );
@@ -115,3 +119,110 @@ void ChangeLogFileMDSvcTest::reloadTest()
   delete fileSvc;
   unlink( fileName.c_str() );
 }
+
+//------------------------------------------------------------------------------
+// Check whether the last boot used the snapshot
+//------------------------------------------------------------------------------
+static bool bootedFromSnapshot( eos::ChangeLogFileMDSvc *fileSvc )
+{
+  for( auto &phase: fileSvc->getBootStatistics() )
+    if( phase.name == "file-snapshot-load" )
+      return true;
+  return false;
+}
+
+//------------------------------------------------------------------------------
+// Boot from a snapshot plus the tail of the change log
+//------------------------------------------------------------------------------
+void ChangeLogFileMDSvcTest::snapshotTest()
+{
+  eos::ChangeLogContainerMDSvc *contSvc = new eos::ChangeLogContainerMDSvc;
+  eos::ChangeLogFileMDSvc      *fileSvc = new eos::ChangeLogFileMDSvc;
+  fileSvc->setContMDService( contSvc );
+
+  std::map<std::string, std::string> config;
+  std::string fileName = getTempName( "/tmp", "eosns" );
+  std::string snapshotName = eos::ChangeLogSnapshot::getPath( fileName );
+  unlink( fileName.c_str() ); // the helper creates an empty file, not a log
+  config["changelog_path"] = fileName;
+  config["boot_threads"]   = "4";
+  fileSvc->configure( config );
+  CPPUNIT_ASSERT_NO_THROW( fileSvc->initialize() );
+
+  // Enough files for several snapshot chunks, some of them updated twice
+  const uint64_t numFiles = 10000;
+  std::vector<eos::IFileMD::id_t> ids;
+  for( uint64_t i = 0; i < numFiles; ++i )
+  {
+    std::shared_ptr<eos::IFileMD> file = fileSvc->createFile();
+    file->setName( "file" + std::to_string( i ) );
+    file->setSize( i );
+    fileSvc->updateStore( file.get() );
+    if( i % 3 == 0 )
+    {
+      file->setSize( 2 * i );
+      fileSvc->updateStore( file.get() );
+    }
+    ids.push_back( file->getId() );
+  }
+  fileSvc->removeFile( fileSvc->getFileMD( ids[1] ).get() );
+
+  void *snapshotData = fileSvc->snapshotPrepare();
+  CPPUNIT_ASSERT( snapshotData != 0 );
+
+  // Changes done while the snapshot is being written end up in the tail
+  fileSvc->removeFile( fileSvc->getFileMD( ids[2] ).get() );
+  std::shared_ptr<eos::IFileMD> file = fileSvc->getFileMD( ids[4] );
+  file->setSize( 12345 );
+  fileSvc->updateStore( file.get() );
+
+  CPPUNIT_ASSERT( fileSvc->snapshotWrite( snapshotData ) > 0 );
+  CPPUNIT_ASSERT( snapshotData == 0 );
+  CPPUNIT_ASSERT( access( snapshotName.c_str(), R_OK ) == 0 );
+
+  file = fileSvc->createFile();
+  file->setName( "tail" );
+  fileSvc->updateStore( file.get() );
+  eos::IFileMD::id_t tailId = file->getId();
+  file.reset();
+  fileSvc->finalize();
+
+  // Check the namespace rebuilt from the snapshot, and after refusing a
+  // corrupted snapshot
+  for( int pass = 0; pass < 2; ++pass )
+  {
+    CPPUNIT_ASSERT_NO_THROW( fileSvc->initialize() );
+    CPPUNIT_ASSERT( bootedFromSnapshot( fileSvc ) == ( pass == 0 ) );
+    CPPUNIT_ASSERT( fileSvc->getNumFiles() == numFiles - 1 );
+    CPPUNIT_ASSERT_THROW( fileSvc->getFileMD( ids[1] ), eos::MDException );
+    CPPUNIT_ASSERT_THROW( fileSvc->getFileMD( ids[2] ), eos::MDException );
+    CPPUNIT_ASSERT( fileSvc->getFileMD( ids[4] )->getSize() == 12345 );
+    CPPUNIT_ASSERT( fileSvc->getFileMD( tailId )->getName() == "tail" );
+
+    for( uint64_t i = 5; i < numFiles; ++i )
+    {
+      std::shared_ptr<eos::IFileMD> rec = fileSvc->getFileMD( ids[i] );
+      CPPUNIT_ASSERT( rec->getName() == "file" + std::to_string( i ) );
+      CPPUNIT_ASSERT( rec->getSize() == ( i % 3 == 0 ? 2 * i : i ) );
+    }
+
+    // New ids continue after the largest one ever used
+    file = fileSvc->createFile();
+    CPPUNIT_ASSERT( file->getId() == tailId + 1 );
+    file.reset();
+    fileSvc->finalize();
+
+    // Damage the last record of the snapshot
+    int fd = open( snapshotName.c_str(), O_RDWR );
+    CPPUNIT_ASSERT( fd != -1 );
+    off_t end = lseek( fd, 0, SEEK_END );
+    char byte = 0x55;
+    CPPUNIT_ASSERT( pwrite( fd, &byte, 1, end - 2 ) == 1 );
+    close( fd );
+  }
+
+  delete fileSvc;
+  delete contSvc;
+  unlink( fileName.c_str() );
+  unlink( snapshotName.c_str() );
+}
@@ -59,10 +59,12 @@ public:
   CPPUNIT_TEST(readWriteCorrectness);
   CPPUNIT_TEST(followingTest);
   CPPUNIT_TEST(fsckTest);
+  CPPUNIT_TEST(fileMDLayoutTest);
   CPPUNIT_TEST_SUITE_END();
   void readWriteCorrectness();
   void followingTest();
   void fsckTest();
+  void fileMDLayoutTest();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(ChangeLogTest);
@@ -588,3 +590,96 @@ void ChangeLogTest::fsckTest()
   unlink(fileNameBroken.c_str());
   unlink(fileNameRepaired.c_str());
 }
+
+//------------------------------------------------------------------------------
+// Packed file metadata layout
+//------------------------------------------------------------------------------
+void ChangeLogTest::fileMDLayoutTest()
+{
+  DummyFileMDSvc fmd;
+  eos::FileMD file(1, &fmd);
+  CPPUNIT_ASSERT(file.getFileMDSvc() == &fmd);
+  CPPUNIT_ASSERT(file.getName().empty());
+  CPPUNIT_ASSERT(!file.isLink());
+  CPPUNIT_ASSERT(file.numAttributes() == 0);
+  CPPUNIT_ASSERT(!file.pExtra);
+
+  // Locations move between the linked and unlinked parts in order
+  for (eos::IFileMD::location_t i = 1; i <= 6; ++i) {
+    file.addLocation(i);
+  }
+
+  file.addLocation(3);
+  CPPUNIT_ASSERT(file.getNumLocation() == 6);
+  file.unlinkLocation(2);
+  file.unlinkLocation(5);
+  CPPUNIT_ASSERT((file.getLocations() ==
+                  eos::IFileMD::LocationVector {1, 3, 4, 6}));
+  CPPUNIT_ASSERT((file.getUnlinkedLocations() ==
+                  eos::IFileMD::LocationVector {2, 5}));
+  CPPUNIT_ASSERT(file.getLocation(1) == 3);
+  CPPUNIT_ASSERT(file.getLocation(4) == 0);
+  file.removeLocation(2);
+  file.addLocation(7);
+  CPPUNIT_ASSERT((file.getLocations() ==
+                  eos::IFileMD::LocationVector {1, 3, 4, 6, 7}));
+  CPPUNIT_ASSERT((file.getUnlinkedLocations() ==
+                  eos::IFileMD::LocationVector {5}));
+  file.unlinkAllLocations();
+  CPPUNIT_ASSERT(file.getNumLocation() == 0);
+  CPPUNIT_ASSERT((file.getUnlinkedLocations() ==
+                  eos::IFileMD::LocationVector {5, 1, 3, 4, 6, 7}));
+  file.removeAllLocations();
+  CPPUNIT_ASSERT(file.getNumUnlinkedLocation() == 0);
+
+  // Checksums larger than the inline storage go to the extra block
+  char sha1[20], big[32];
+
+  for (unsigned i = 0; i < sizeof(big); ++i) {
+    big[i] = i + 1;
+    sha1[i % sizeof(sha1)] = i + 1;
+  }
+
+  file.setChecksum(sha1, sizeof(sha1));
+  CPPUNIT_ASSERT(file.checksumMatch(sha1));
+  CPPUNIT_ASSERT(file.getChecksum().getSize() == sizeof(sha1));
+  CPPUNIT_ASSERT(!file.pExtra);
+  file.setChecksum(big, sizeof(big));
+  CPPUNIT_ASSERT(file.checksumMatch(big));
+  CPPUNIT_ASSERT(file.getChecksum().getSize() == sizeof(big));
+  CPPUNIT_ASSERT(file.pExtra);
+  file.setChecksum(sha1, 4);
+  CPPUNIT_ASSERT(file.checksumMatch(sha1));
+  CPPUNIT_ASSERT(!file.pExtra);
+
+  // Link name and attributes are allocated on demand and released when empty
+  file.setName("file");
+  file.setLink("/eos/target");
+  file.setAttribute("user.key", "value");
+  CPPUNIT_ASSERT(file.isLink());
+  CPPUNIT_ASSERT(file.getAttribute("user.key") == "value");
+  CPPUNIT_ASSERT_THROW(file.getAttribute("user.missing"), eos::MDException);
+  eos::Buffer buffer;
+  file.serialize(buffer);
+  eos::FileMD copy(0, &fmd);
+  copy.deserialize(buffer);
+  CPPUNIT_ASSERT(copy.getName() == "file");
+  CPPUNIT_ASSERT(copy.getLink() == "/eos/target");
+  CPPUNIT_ASSERT(copy.getAttributes() == file.getAttributes());
+  CPPUNIT_ASSERT(copy.checksumMatch(sha1));
+  file.setLink("");
+  file.removeAttribute("user.key");
+  CPPUNIT_ASSERT(!file.pExtra);
+  eos::FileMD small(2, &fmd);
+  small.setName("file");
+  small.addLocation(1);
+  small.addLocation(2);
+  CPPUNIT_ASSERT(small.getMemoryUsage() ==
+                 sizeof(eos::FileMD) + strlen("file") + 1);
+
+  // Copies are read-only
+  eos::FileMD readOnly(copy);
+  CPPUNIT_ASSERT(readOnly.getFileMDSvc() == nullptr);
+  CPPUNIT_ASSERT(readOnly.getLink() == "/eos/target");
+  CPPUNIT_ASSERT_THROW(readOnly.serialize(buffer), eos::MDException);
+}
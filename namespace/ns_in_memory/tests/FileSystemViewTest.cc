@@ -237,8 +237,6 @@ void FileSystemViewTest::fileSystemViewTest()
 void FileSystemViewTest::fileIteratorTest()
 {
   eos::IFsView::FileList input_set;
-  input_set.set_deleted_key(0);
-  input_set.set_empty_key(0xffffffffffffffffll);
 
   for (int64_t i = 1; i < 10000; ++i) {
     if (i % 2 == 0) {
@@ -36,6 +36,7 @@
 #include "namespace/interface/ContainerIterators.hh"
 #include "namespace/ns_in_memory/views/HierarchicalView.hh"
 #include "namespace/ns_in_memory/accounting/QuotaStats.hh"
+#include "namespace/ns_in_memory/accounting/ContainerAccounting.hh"
 #include "namespace/ns_in_memory/persistency/ChangeLogContainerMDSvc.hh"
 #include "namespace/ns_in_memory/persistency/ChangeLogFileMDSvc.hh"
 
@@ -51,12 +52,14 @@ public:
   CPPUNIT_TEST(quotaTest);
   CPPUNIT_TEST(lostContainerTest);
   CPPUNIT_TEST(onlineCompactingTest);
+  CPPUNIT_TEST(parallelBootAccountingTest);
   CPPUNIT_TEST_SUITE_END();
 
   void reloadTest();
   void quotaTest();
   void lostContainerTest();
   void onlineCompactingTest();
+  void parallelBootAccountingTest();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(HierarchicalViewTest);
@@ -827,3 +830,66 @@ void HierarchicalViewTest::onlineCompactingTest()
   unlink(fileNameContMD.c_str());
   unlink(newFileLogName.c_str());
 }
+
+//------------------------------------------------------------------------------
+// The tree sizes must be right after a parallel boot, the accounting listener
+// is not thread safe
+//------------------------------------------------------------------------------
+void HierarchicalViewTest::parallelBootAccountingTest()
+{
+  try {
+    std::shared_ptr<eos::IContainerMDSvc> contSvc =
+      std::shared_ptr<eos::IContainerMDSvc>(new eos::ChangeLogContainerMDSvc());
+    std::shared_ptr<eos::IFileMDSvc> fileSvc =
+      std::shared_ptr<eos::IFileMDSvc>(new eos::ChangeLogFileMDSvc());
+    std::shared_ptr<eos::IView> view =
+      std::shared_ptr<eos::IView>(new eos::HierarchicalView());
+    fileSvc->setContMDService(contSvc.get());
+    contSvc->setFileMDService(fileSvc.get());
+    std::map<std::string, std::string> fileSettings;
+    std::map<std::string, std::string> contSettings;
+    std::map<std::string, std::string> settings;
+    std::string fileNameFileMD = getTempName("/tmp", "eosns");
+    std::string fileNameContMD = getTempName("/tmp", "eosns");
+    contSettings["changelog_path"] = fileNameContMD;
+    contSettings["boot_threads"] = "8";
+    fileSettings["changelog_path"] = fileNameFileMD;
+    fileSettings["boot_threads"] = "8";
+    fileSvc->configure(fileSettings);
+    contSvc->configure(contSettings);
+    view->setContainerMDSvc(contSvc.get());
+    view->setFileMDSvc(fileSvc.get());
+    view->configure(settings);
+    view->initialize();
+    // Enough files for many boot chunks, all accounted in the same tree
+    const uint64_t numDirs = 8;
+    const uint64_t numFiles = 5000;
+    uint64_t total = 0;
+
+    for (uint64_t i = 0; i < numDirs; ++i) {
+      std::string dir = "/test/dir" + std::to_string(i) + "/";
+      view->createContainer(dir, true);
+
+      for (uint64_t j = 0; j < numFiles; ++j) {
+        std::shared_ptr<eos::IFileMD> file =
+          view->createFile(dir + "file" + std::to_string(j));
+        file->setSize(j % 7 + 1);
+        view->updateFileStore(file.get());
+        total += j % 7 + 1;
+      }
+    }
+
+    view->finalize();
+    eos::ContainerAccounting accounting(contSvc.get());
+    fileSvc->addChangeListener(&accounting);
+    view->initialize();
+    CPPUNIT_ASSERT(view->getContainer("/test")->getTreeSize() == total);
+    CPPUNIT_ASSERT(view->getContainer("/test/dir3")->getTreeSize() ==
+                   total / numDirs);
+    view->finalize();
+    unlink(fileNameFileMD.c_str());
+    unlink(fileNameContMD.c_str());
+  } catch (eos::MDException& e) {
+    CPPUNIT_ASSERT_MESSAGE(e.getMessage().str(), false);
+  }
+}
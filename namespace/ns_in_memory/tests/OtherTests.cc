@@ -26,6 +26,8 @@
 
 #include "namespace/utils/TestHelpers.hh"
 #include "namespace/utils/PathProcessor.hh"
+#include "namespace/ns_in_memory/persistency/ParallelBoot.hh"
+#include <map>
 
 //------------------------------------------------------------------------------
 // Declaration
@@ -35,9 +37,11 @@ class OtherTests: public CppUnit::TestCase
   public:
     CPPUNIT_TEST_SUITE( OtherTests );
     CPPUNIT_TEST( pathSplitterTest );
+    CPPUNIT_TEST( parallelBootTest );
     CPPUNIT_TEST_SUITE_END();
 
     void pathSplitterTest();
+    void parallelBootTest();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION( OtherTests );
@@ -97,3 +101,64 @@ void OtherTests::pathSplitterTest()
   eos::PathProcessor::splitPath( elements, "" );
   CPPUNIT_ASSERT( elements.size() == 0 );
 }
+
+//------------------------------------------------------------------------------
+// Chunked parallel iteration used by the boot
+//------------------------------------------------------------------------------
+void OtherTests::parallelBootTest()
+{
+  std::map<uint64_t, uint64_t> map;
+
+  for (uint64_t i = 0; i < 100003; ++i) {
+    map[i] = 0;
+  }
+
+  for (unsigned nthreads : {1, 3, 16}) {
+    std::atomic<uint64_t> sum(0);
+    eos::BootPhase phase("", "test", map.size(), nthreads);
+    eos::ForEachChunked(map, nthreads,
+    [&](std::map<uint64_t, uint64_t>::iterator & it, unsigned) {
+      it->second++;
+      sum += it->first;
+      phase.tick();
+    });
+    eos::BootPhaseStatistics stats = phase.finish();
+    CPPUNIT_ASSERT(stats.items == map.size());
+    CPPUNIT_ASSERT(stats.threads == nthreads);
+    CPPUNIT_ASSERT(sum == 100002ull * 100003 / 2);
+  }
+
+  for (const auto& elem : map) {
+    CPPUNIT_ASSERT(elem.second == 3);
+  }
+
+  // Phases of unknown size only report when finished
+  eos::BootPhase phase("", "unknown", 0);
+  phase.tick();
+  CPPUNIT_ASSERT(phase.finish().items == 1);
+
+  // Exceptions are propagated to the caller
+  CPPUNIT_ASSERT_THROW(eos::ForEachChunked(map, 4,
+  [&](std::map<uint64_t, uint64_t>::iterator & it, unsigned) {
+    if (it->first == 50000) {
+      throw std::runtime_error("failure");
+    }
+  }), std::runtime_error);
+
+  // The chunks only depend on the map and the chunk size
+  typedef std::map<uint64_t, uint64_t>::iterator Iterator;
+
+  for (unsigned nthreads : {1, 5}) {
+    std::vector<uint64_t> firsts(26, UINT64_MAX);
+    size_t num_chunks = eos::ForEachChunk(map, nthreads, 4000,
+    [&](size_t chunk, Iterator begin, Iterator end, unsigned) {
+      firsts[chunk] = begin->first;
+      CPPUNIT_ASSERT(std::distance(begin, end) == (chunk < 25 ? 4000 : 3));
+    });
+    CPPUNIT_ASSERT(num_chunks == 26);
+
+    for (size_t chunk = 0; chunk < firsts.size(); ++chunk) {
+      CPPUNIT_ASSERT(firsts[chunk] == chunk * 4000);
+    }
+  }
+}
@@ -65,6 +65,17 @@ static const std::string sMaxSizeCacheFiles {"max_size_cache_files"};
 static const std::string sMaxNumCacheDirs {"max_num_cache_dirs"};
 //! Tag for max size (bytes) of dir/container entries cached at the MGM
 static const std::string sMaxSizeCacheDirs {"max_size_cache_dirs"};
+//! Tag for type of cache used for file entries i.e. "lru" or "sharded-lru",
+//! can't be changed once the namespace is initialized
+static const std::string sCacheTypeFiles {"cache_type_files"};
+//! Tag for type of cache used for dir/container entries i.e. "lru" or
+//! "sharded-lru", can't be changed once the namespace is initialized
+static const std::string sCacheTypeDirs {"cache_type_dirs"};
+//! Tag for max num of container paths cached by the view, 0 disables it
+static const std::string sMaxNumCachePaths {"max_num_cache_paths"};
+//! Tag marking a runtime reconfiguration of the view caches, the rest of the
+//! view configuration is left untouched
+static const std::string sReconfigureCachesOnly {"reconfigure_caches_only"};
 }
 
 //! Variable associated with the QuotaView
@@ -85,6 +96,9 @@ static const std::string sLogicalSize = ":logical_size";
 static const std::string sPhysicalSize = ":physical_size";
 //! Tag for number of files
 static const std::string sNumFiles = ":files";
+//! Hash holding, per quota flusher, the number of batches of pending quota
+//! deltas applied in the backend
+static const std::string sFlushedBatchesKey = "quota_flushed_batches";
 }
 
 // Variable associated with the FileSystemView
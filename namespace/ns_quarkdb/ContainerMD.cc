@@ -45,10 +45,6 @@ ContainerMD::ContainerMD(ContainerMD::id_t id, IFileMDSvc* file_svc,
     pFilesKey(stringify(id) + constants::sMapFilesSuffix),
     pDirsKey(stringify(id) + constants::sMapDirsSuffix), mClock(1)
 {
-  mSubcontainers->set_deleted_key("");
-  mFiles->set_deleted_key("");
-  mSubcontainers->set_empty_key("##_EMPTY_##");
-  mFiles->set_empty_key("##_EMPTY_##");
   mCont.set_id(id);
   mCont.set_mode(040755);
 
@@ -157,13 +153,13 @@ ContainerMD::findItem(const std::string& name)
   // We're looking for "name". Look inside subcontainer map to check if there's
   // a container with such name.
   //----------------------------------------------------------------------------
-  auto iter = mSubcontainers->find(name);
-  if(iter != mSubcontainers->end()) {
+  IContainerMD::id_t id;
+  if(mSubcontainers->get(name, id)) {
     //--------------------------------------------------------------------------
     // We have a hit, this is a ContainerMD. Retrieve result asynchronously
     // from container service.
     //--------------------------------------------------------------------------
-    ContainerIdentifier target(iter->second);
+    ContainerIdentifier target(id);
     lock.unlock();
 
     folly::Future<FileOrContainerMD> fut = pContSvc->getContainerMDFut(target.getUnderlyingUInt64())
@@ -182,13 +178,12 @@ ContainerMD::findItem(const std::string& name)
   //----------------------------------------------------------------------------
   // This is not a ContainerMD.. maybe it's a FileMD?
   //----------------------------------------------------------------------------
-  auto iter2 = mFiles->find(name);
-  if (iter2 != mFiles->end()) {
+  if (mFiles->get(name, id)) {
     //--------------------------------------------------------------------------
     // We have a hit, this is a FileMD. Retrieve result asynchronously
     // from file service.
     //--------------------------------------------------------------------------
-    FileIdentifier target(iter2->second);
+    FileIdentifier target(id);
     lock.unlock();
 
     folly::Future<FileOrContainerMD> fut = pFileSvc->getFileMDFut(target.getUnderlyingUInt64())
@@ -216,19 +211,26 @@ ContainerMD::findItem(const std::string& name)
 void
 ContainerMD::removeContainer(const std::string& name)
 {
-  std::unique_lock<std::shared_timed_mutex> lock(mMutex);
-  auto it = mSubcontainers->find(name);
+  {
+    std::unique_lock<std::shared_timed_mutex> lock(mMutex);
+    auto it = mSubcontainers->find(name);
 
-  if (it == mSubcontainers->end()) {
-    MDException e(ENOENT);
-    e.getMessage()  << __FUNCTION__ << " Container " << name << " not found";
-    throw e;
+    if (it == mSubcontainers->end()) {
+      MDException e(ENOENT);
+      e.getMessage()  << __FUNCTION__ << " Container " << name << " not found";
+      throw e;
+    }
+
+    mSubcontainers->erase(it);
+    // Delete container also from KV backend
+    pFlusher->hdel(pDirsKey, name);
   }
 
-  mSubcontainers->erase(it);
-  mSubcontainers->resize(0);
-  // Delete container also from KV backend
-  pFlusher->hdel(pDirsKey, name);
+  // Paths below this container might have changed
+  if (pContSvc) {
+    pContSvc->notifyListeners(this,
+                              IContainerMDChangeListener::SubcontainerRemoved);
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -357,7 +359,6 @@ ContainerMD::removeFile(const std::string& name)
   if (iter != mFiles->end()) {
     IFileMD::id_t id = iter->second;
     mFiles->erase(iter);
-    mFiles->resize(0);
     pFlusher->hdel(pFilesKey, name);
 
     try {
@@ -27,10 +27,11 @@
 
 #include "common/RWMutex.hh"
 #include "common/AssistedThread.hh"
-#include "common/ConcurrentQueue.hh"
+#include "common/BoundedConcurrentQueue.hh"
 #include "common/Murmur3.hh"
 #include "namespace/Namespace.hh"
 #include <google/dense_hash_map>
+#include <algorithm>
 #include <cstdint>
 #include <list>
 #include <map>
@@ -64,11 +65,104 @@ struct hasGetId {
   static constexpr bool value = test<EntryT>(int());
 };
 
+//------------------------------------------------------------------------------
+//! Estimate of the memory footprint of a cached entry. Specialize it for
+//! entry types that have a variable size, the default is the object size.
+//------------------------------------------------------------------------------
+template <class EntryT>
+struct LRUEntrySize {
+  static std::uint64_t
+  estimate(EntryT&)
+  {
+    return sizeof(EntryT);
+  }
+};
+
+//------------------------------------------------------------------------------
+//! Interface of a cache for namespace entries
+//------------------------------------------------------------------------------
+template <typename IdT, typename EntryT>
+class ILRU
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Destructor
+  //----------------------------------------------------------------------------
+  virtual ~ILRU() = default;
+
+  //----------------------------------------------------------------------------
+  //! Get entry
+  //!
+  //! @param id entry id
+  //!
+  //! @return shared ptr to requested object or nullptr if not found
+  //----------------------------------------------------------------------------
+  virtual std::shared_ptr<EntryT> get(IdT id) = 0;
+
+  //----------------------------------------------------------------------------
+  //! Put entry
+  //!
+  //! @param id entry id
+  //! @param entry entry object
+  //!
+  //! @return the object cached for the given id
+  //----------------------------------------------------------------------------
+  virtual
+  typename
+  std::enable_if<hasGetId<EntryT>::value, std::shared_ptr<EntryT>>::type
+      put(IdT id, std::shared_ptr<EntryT> obj) = 0;
+
+  //----------------------------------------------------------------------------
+  //! Remove entry from cache
+  //!
+  //! @param id entry id
+  //!
+  //! @return true if successfully removed from the cache, false otherwise
+  //----------------------------------------------------------------------------
+  virtual bool remove(IdT id) = 0;
+
+  //----------------------------------------------------------------------------
+  //! Get cache size
+  //----------------------------------------------------------------------------
+  virtual std::uint64_t size() const = 0;
+
+  //----------------------------------------------------------------------------
+  //! Get estimated memory footprint of the cached entries in bytes
+  //----------------------------------------------------------------------------
+  virtual std::uint64_t size_bytes() const = 0;
+
+  //----------------------------------------------------------------------------
+  //! Get maximim number of entries in the cache
+  //----------------------------------------------------------------------------
+  virtual std::uint64_t get_max_num() const = 0;
+
+  //----------------------------------------------------------------------------
+  //! Set max num entries
+  //!
+  //! @param max_num new maximum number of entries, if 0 then just drop the
+  //!                the current cache, if UINT64_MAX then flush the cache
+  //----------------------------------------------------------------------------
+  virtual void set_max_num(const std::uint64_t max_num) = 0;
+
+  //----------------------------------------------------------------------------
+  //! Get maximum estimated memory footprint of the cache in bytes
+  //----------------------------------------------------------------------------
+  virtual std::uint64_t get_max_size() const = 0;
+
+  //----------------------------------------------------------------------------
+  //! Set maximum estimated memory footprint of the cache
+  //!
+  //! @param max_size max size in bytes, 0 means no size limit while
+  //!                 UINT64_MAX leaves the current limit unchanged
+  //----------------------------------------------------------------------------
+  virtual void set_max_size(const std::uint64_t max_size) = 0;
+};
+
 //------------------------------------------------------------------------------
 //! LRU cache for namespace entries
 //------------------------------------------------------------------------------
 template <typename IdT, typename EntryT>
-class LRU
+class LRU : public ILRU<IdT, EntryT>
 {
 public:
   //----------------------------------------------------------------------------
@@ -90,7 +184,7 @@ public:
   //!
   //! @return shared ptr to requested object or nullptr if not found
   //----------------------------------------------------------------------------
-  std::shared_ptr<EntryT> get(IdT id);
+  std::shared_ptr<EntryT> get(IdT id) override;
 
   //----------------------------------------------------------------------------
   //! Put entry
@@ -104,7 +198,7 @@ public:
   //----------------------------------------------------------------------------
   typename
   std::enable_if<hasGetId<EntryT>::value, std::shared_ptr<EntryT>>::type
-      put(IdT id, std::shared_ptr<EntryT> obj);
+      put(IdT id, std::shared_ptr<EntryT> obj) override;
 
   //----------------------------------------------------------------------------
   //! Remove entry from cache
@@ -113,7 +207,7 @@ public:
   //!
   //! @return true if successfully removed from the cache, false otherwise
   //----------------------------------------------------------------------------
-  bool remove(IdT id);
+  bool remove(IdT id) override;
 
   //----------------------------------------------------------------------------
   //! Get cache size
@@ -121,21 +215,33 @@ public:
   //! @return cache size
   //----------------------------------------------------------------------------
   inline std::uint64_t
-  size() const
+  size() const override
   {
-    eos::common::RWMutexWriteLock lock_w(mMutex);
+    eos::common::RWMutexReadLock lock_r(mMutex);
     return mMap.size();
   }
 
+  //----------------------------------------------------------------------------
+  //! Get estimated memory footprint of the cached entries
+  //!
+  //! @return size in bytes
+  //----------------------------------------------------------------------------
+  inline std::uint64_t
+  size_bytes() const override
+  {
+    eos::common::RWMutexReadLock lock_r(mMutex);
+    return mSizeBytes;
+  }
+
   //----------------------------------------------------------------------------
   //! Get maximim number of entries in the cache
   //!
   //! @return maximum cache num entries
   //----------------------------------------------------------------------------
   inline std::uint64_t
-  get_max_num() const
+  get_max_num() const override
   {
-    eos::common::RWMutexWriteLock lock_w(mMutex);
+    eos::common::RWMutexReadLock lock_r(mMutex);
     return mMaxNum;
   }
 
@@ -146,21 +252,52 @@ public:
   //!                the current cache
   //----------------------------------------------------------------------------
   inline void
-  set_max_num(const std::uint64_t max_num)
+  set_max_num(const std::uint64_t max_num) override
   {
     eos::common::RWMutexWriteLock lock_w(mMutex);
 
     if (max_num == 0ull) {
       // Flush and disable cache
-      Purge(0.0);
+      Purge(0.0, UINT64_MAX);
       mMaxNum = 0ull;
+      mMap.resize(0);
     } else if (max_num == UINT64_MAX) {
-      Purge(0.0); // Flush cache
+      Purge(0.0, UINT64_MAX); // Flush cache
+      mMap.resize(0);
     } else {
       mMaxNum = max_num;
     }
   }
 
+  //----------------------------------------------------------------------------
+  //! Get maximum estimated memory footprint of the cache
+  //!
+  //! @return max size in bytes
+  //----------------------------------------------------------------------------
+  inline std::uint64_t
+  get_max_size() const override
+  {
+    eos::common::RWMutexReadLock lock_r(mMutex);
+    return mMaxSize;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Set maximum estimated memory footprint of the cache
+  //!
+  //! @param max_size max size in bytes, 0 means no size limit while
+  //!                 UINT64_MAX leaves the current limit unchanged
+  //----------------------------------------------------------------------------
+  inline void
+  set_max_size(const std::uint64_t max_size) override
+  {
+    if (max_size == UINT64_MAX) {
+      return;
+    }
+
+    eos::common::RWMutexWriteLock lock_w(mMutex);
+    mMaxSize = (max_size == 0ull) ? UINT64_MAX : max_size;
+  }
+
   //----------------------------------------------------------------------------
   //! Forbid copying or moving LRU objects
   //----------------------------------------------------------------------------
@@ -178,20 +315,48 @@ private:
   void CleanerJob(ThreadAssistant& assistant);
 
   //----------------------------------------------------------------------------
-  //! Purge entries until stop ratio is achieved
+  //! Check if the cache is above the given ratio of its limits
+  //!
+  //! @param ratio ratio of the max number of entries and max size
+  //----------------------------------------------------------------------------
+  inline bool
+  AboveLimits(double ratio) const
+  {
+    return (mMap.size() > ratio * mMaxNum) ||
+           ((mMaxSize != UINT64_MAX) && (mSizeBytes > ratio * mMaxSize));
+  }
+
+  //----------------------------------------------------------------------------
+  //! Purge entries until stop ratio is achieved or the given number of
+  //! entries have been visited. Entries which are still referenced are moved
+  //! to the end of the list, so that they are not scanned again by the next
+  //! purge.
   //!
   //! @param stop_ratio stop purge ratio
+  //! @param budget max number of entries visited, each entry is visited at
+  //!        most once per call
   //! @note This method must be called with the mutex protecting the map and
   //! the list locked.
   //----------------------------------------------------------------------------
-  void Purge(double stop_ratio);
+  void Purge(double stop_ratio, std::uint64_t budget);
 
   //! Percentage at which the cache purging stops
   static constexpr double sPurgeStopRatio = 0.9;
-  using ListT = std::list<std::shared_ptr<EntryT>>;
-  typename std::list<std::shared_ptr<EntryT>>::iterator ListIterT;
-  //using MapT = std::map<IdT, decltype(ListIterT)>;
-  using MapT = google::dense_hash_map<IdT, decltype(ListIterT),
+  //! Max number of entries visited by one purge triggered from put
+  static constexpr std::uint64_t sPurgeBudget = 10000;
+  //! Capacity of the queue of entries to be deallocated
+  static constexpr std::uint64_t sDeleteQueueSize = 4 * sPurgeBudget;
+
+  //----------------------------------------------------------------------------
+  //! List item holding the object and its estimated memory footprint
+  //----------------------------------------------------------------------------
+  struct ListItem {
+    std::shared_ptr<EntryT> mEntry;
+    std::uint64_t mSize;
+  };
+
+  using ListT = std::list<ListItem>;
+  using MapT = google::dense_hash_map<IdT, typename ListT::iterator,
         Murmur3::MurmurHasher<IdT>>;
   MapT mMap;   ///< Internal map pointing to obj in list
   ListT mList; ///< Internal list of objects where new/used objects are at the
@@ -200,20 +365,28 @@ private:
   //! mutable eos::common::RWMutex mMutex;
   mutable eos::common::RWMutex mMutex;
   std::uint64_t mMaxNum; ///< Maximum number of entries
-  eos::common::ConcurrentQueue< std::shared_ptr<EntryT> > mToDelete;
+  std::uint64_t mMaxSize; ///< Maximum estimated size in bytes
+  std::uint64_t mSizeBytes; ///< Estimated size of the cached entries
+  //! Entries to be deallocated by the cleaner thread
+  eos::common::BoundedConcurrentQueue< std::shared_ptr<EntryT> > mToDelete;
   AssistedThread mCleanerThread; ///< Thread doing the deallocations
 };
 
 // Definition of class static member
 template <typename IdT, typename EntryT>
 constexpr double LRU<IdT, EntryT>::sPurgeStopRatio;
+template <typename IdT, typename EntryT>
+constexpr std::uint64_t LRU<IdT, EntryT>::sPurgeBudget;
+template <typename IdT, typename EntryT>
+constexpr std::uint64_t LRU<IdT, EntryT>::sDeleteQueueSize;
 
 //------------------------------------------------------------------------------
 // Constructor
 //------------------------------------------------------------------------------
 template <typename IdT, typename EntryT>
 LRU<IdT, EntryT>::LRU(std::uint64_t max_num) :
-  mMap(), mList(), mMutex(), mMaxNum(max_num), mToDelete()
+  mMap(), mList(), mMutex(), mMaxNum(max_num), mMaxSize(UINT64_MAX),
+  mSizeBytes(0ull), mToDelete(sDeleteQueueSize)
 {
   mMap.set_empty_key(IdT(UINT64_MAX - 1));
   mMap.set_deleted_key(IdT(UINT64_MAX));
@@ -250,11 +423,10 @@ LRU<IdT, EntryT>::get(IdT id)
     return nullptr;
   }
 
-  // Move object to the end of the list i.e. recently accessed
-  auto iter_new = mList.insert(mList.end(), *iter_map->second);
-  mList.erase(iter_map->second);
-  mMap[id] = iter_new;
-  return *iter_new;
+  // Move object to the end of the list i.e. recently accessed, the list
+  // iterator stays valid.
+  mList.splice(mList.end(), mList, iter_map->second);
+  return iter_map->second->mEntry;
 }
 
 //------------------------------------------------------------------------------
@@ -264,6 +436,8 @@ template <typename IdT, typename EntryT>
 typename std::enable_if<hasGetId<EntryT>::value, std::shared_ptr<EntryT>>::type
     LRU<IdT, EntryT>::put(IdT id, std::shared_ptr<EntryT> obj)
 {
+  // Estimate the size outside the lock, it might need to lock the object
+  std::uint64_t entry_size = (obj ? LRUEntrySize<EntryT>::estimate(*obj) : 0);
   eos::common::RWMutexWriteLock lock_w(mMutex);
 
   if (mMaxNum == 0ull) {
@@ -273,18 +447,19 @@ typename std::enable_if<hasGetId<EntryT>::value, std::shared_ptr<EntryT>>::type
   auto iter_map = mMap.find(id);
 
   if (iter_map != mMap.end()) {
-    return *(iter_map->second);
+    return iter_map->second->mEntry;
   }
 
-  // Check if map full and purge some entries if necessary 10% of max size
-  if (mMap.size() >= mMaxNum) {
-    Purge(sPurgeStopRatio);
+  // Check if cache full and purge some entries if necessary 10% of max size
+  if ((mMap.size() >= mMaxNum) ||
+      ((mMaxSize != UINT64_MAX) && (mSizeBytes + entry_size > mMaxSize))) {
+    Purge(sPurgeStopRatio, sPurgeBudget);
   }
 
-  // @todo (esindril): add time based and for a fixed number of entries purging
-  auto iter = mList.insert(mList.end(), obj);
+  auto iter = mList.insert(mList.end(), ListItem {obj, entry_size});
   mMap[id] = iter;
-  return *iter;
+  mSizeBytes += entry_size;
+  return obj;
 }
 
 //------------------------------------------------------------------------------
@@ -301,6 +476,7 @@ LRU<IdT, EntryT>::remove(IdT id)
     return false;
   }
 
+  mSizeBytes -= iter_map->second->mSize;
   (void)mList.erase(iter_map->second);
   mMap.erase(iter_map);
   return true;
@@ -314,44 +490,52 @@ template <typename IdT, typename EntryT>
 void
 LRU<IdT, EntryT>::CleanerJob(ThreadAssistant& assistant)
 {
-  std::shared_ptr<EntryT> tmp;
+  std::vector<std::shared_ptr<EntryT>> batch;
+  bool sentinel = false;
 
-  while (!assistant.terminationRequested()) {
-    while (true) {
-      mToDelete.wait_pop(tmp);
+  // Run until the destructor pushes the null sentinel
+  while (!sentinel) {
+    batch.clear();
+    mToDelete.wait_pop_batch(batch, 1024);
 
-      if (tmp == nullptr) {
-        break;
-      } else {
-        tmp.reset();
+    for (const auto& entry : batch) {
+      if (entry == nullptr) {
+        sentinel = true;
       }
     }
   }
 }
 
 //------------------------------------------------------------------------------
-// Purge entries until stop ratio is achieved
+// Purge entries until stop ratio is achieved or budget is exhausted
 //------------------------------------------------------------------------------
 template <typename IdT, typename EntryT>
 void
-LRU<IdT, EntryT>::Purge(double stop_ratio)
+LRU<IdT, EntryT>::Purge(double stop_ratio, std::uint64_t budget)
 {
+  // Pinned entries are moved to the end so visit each entry at most once
+  std::uint64_t to_visit = std::min(budget, (std::uint64_t) mList.size());
   auto iter = mList.begin();
 
-  while ((iter != mList.end()) &&
-         (mMap.size() > stop_ratio * mMaxNum)) {
-    // If object is referenced also by someone else then skip it
-    if (iter->use_count() > 1) {
-      ++iter;
+  for (std::uint64_t visited = 0ull; (visited < to_visit) &&
+       AboveLimits(stop_ratio); ++visited) {
+    // If object is referenced also by someone else then move it out of the
+    // way of the next purge
+    if (iter->mEntry.use_count() > 1) {
+      auto iter_pinned = iter++;
+      mList.splice(mList.end(), mList, iter_pinned);
       continue;
     }
 
-    mMap.erase(IdT((*iter)->getId()));
-    mToDelete.push(*iter);
+    // The map is not compacted here, the slots of the erased entries are
+    // reused by following insertions.
+    mMap.erase(IdT(iter->mEntry->getId()));
+    mSizeBytes -= iter->mSize;
+
+    // If the cleaner falls behind the entry gets deallocated right here
+    (void) mToDelete.try_push(std::move(iter->mEntry));
     iter = mList.erase(iter);
   }
-
-  mMap.resize(0); // compact after deletion
 }
 
 EOSNSNAMESPACE_END
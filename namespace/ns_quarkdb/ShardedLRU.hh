@@ -0,0 +1,503 @@
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+//------------------------------------------------------------------------------
+//! @brief Sharded, read-mostly cache for namespace objects using CLOCK
+//!        (second-chance) eviction. Lookups only take the shared lock of the
+//!        shard owning the entry. Like the LRU, entries still referenced in
+//!        other parts of the program are never evicted.
+//------------------------------------------------------------------------------
+
+#ifndef __EOS_NS_SHARDED_LRU_HH__
+#define __EOS_NS_SHARDED_LRU_HH__
+
+#include "namespace/ns_quarkdb/LRU.hh"
+#include <google/dense_hash_map>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+EOSNSNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Sharded CLOCK cache for namespace entries
+//------------------------------------------------------------------------------
+template <typename IdT, typename EntryT>
+class ShardedLRU : public ILRU<IdT, EntryT>
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //!
+  //! @param max_num maximum number of entries in the cache
+  //! @param num_shards number of shards, rounded up to a power of two
+  //----------------------------------------------------------------------------
+  ShardedLRU(std::uint64_t max_num,
+             std::uint32_t num_shards = sDefaultNumShards);
+
+  //----------------------------------------------------------------------------
+  //! Destructor
+  //----------------------------------------------------------------------------
+  virtual ~ShardedLRU() = default;
+
+  //----------------------------------------------------------------------------
+  //! Get entry - only takes the shared lock of the corresponding shard
+  //!
+  //! @param id entry id
+  //!
+  //! @return shared ptr to requested object or nullptr if not found
+  //----------------------------------------------------------------------------
+  std::shared_ptr<EntryT> get(IdT id) override;
+
+  //----------------------------------------------------------------------------
+  //! Put entry
+  //!
+  //! @param id entry id
+  //! @param entry entry object
+  //!
+  //! @return the object cached for the given id. If the shard is full then
+  //!         entries which were not accessed since the last pass of the clock
+  //!         hand and are not referenced anywhere else are evicted.
+  //----------------------------------------------------------------------------
+  typename
+  std::enable_if<hasGetId<EntryT>::value, std::shared_ptr<EntryT>>::type
+      put(IdT id, std::shared_ptr<EntryT> obj) override;
+
+  //----------------------------------------------------------------------------
+  //! Remove entry from cache
+  //!
+  //! @param id entry id
+  //!
+  //! @return true if successfully removed from the cache, false otherwise
+  //----------------------------------------------------------------------------
+  bool remove(IdT id) override;
+
+  //----------------------------------------------------------------------------
+  //! Get cache size - does not take any lock
+  //----------------------------------------------------------------------------
+  std::uint64_t size() const override;
+
+  //----------------------------------------------------------------------------
+  //! Get estimated memory footprint of the cached entries - does not take any
+  //! lock
+  //----------------------------------------------------------------------------
+  std::uint64_t size_bytes() const override;
+
+  //----------------------------------------------------------------------------
+  //! Get maximim number of entries in the cache
+  //----------------------------------------------------------------------------
+  inline std::uint64_t
+  get_max_num() const override
+  {
+    return mMaxNum.load();
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get maximum estimated memory footprint of the cache
+  //----------------------------------------------------------------------------
+  inline std::uint64_t
+  get_max_size() const override
+  {
+    return mMaxSize.load();
+  }
+
+  //----------------------------------------------------------------------------
+  //! Set maximum estimated memory footprint of the cache
+  //!
+  //! @param max_size max size in bytes, 0 means no size limit while
+  //!                 UINT64_MAX leaves the current limit unchanged
+  //----------------------------------------------------------------------------
+  inline void
+  set_max_size(const std::uint64_t max_size) override
+  {
+    if (max_size != UINT64_MAX) {
+      mMaxSize = (max_size == 0ull) ? UINT64_MAX : max_size;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Set max num entries
+  //!
+  //! @param max_num new maximum number of entries, if 0 then just drop the
+  //!                the current cache, if UINT64_MAX then flush the cache
+  //----------------------------------------------------------------------------
+  void set_max_num(const std::uint64_t max_num) override;
+
+  //----------------------------------------------------------------------------
+  //! Get number of shards
+  //----------------------------------------------------------------------------
+  inline std::uint32_t
+  get_num_shards() const
+  {
+    return mShards.size();
+  }
+
+  //----------------------------------------------------------------------------
+  //! Forbid copying or moving ShardedLRU objects
+  //----------------------------------------------------------------------------
+  ShardedLRU(const ShardedLRU& other) = delete;
+  ShardedLRU& operator=(const ShardedLRU& other) = delete;
+  ShardedLRU(ShardedLRU&& other) = delete;
+  ShardedLRU& operator=(ShardedLRU&& other) = delete;
+
+private:
+  //----------------------------------------------------------------------------
+  //! Slot holding a cached entry
+  //----------------------------------------------------------------------------
+  struct Slot {
+    Slot(): mId(UINT64_MAX), mEntry(), mSize(0ull), mReferenced(false) {}
+
+    IdT mId; ///< Entry id
+    std::shared_ptr<EntryT> mEntry; ///< Cached object, nullptr if slot free
+    std::uint64_t mSize; ///< Estimated memory footprint of the object
+    std::atomic<bool> mReferenced; ///< Second chance bit set on access
+  };
+
+  //----------------------------------------------------------------------------
+  //! Shard of the cache
+  //----------------------------------------------------------------------------
+  struct Shard {
+    Shard(): mMutex(), mMap(), mSlots(), mFreeSlots(), mHand(0ull),
+      mSize(0ull), mSizeBytes(0ull)
+    {
+      mMap.set_empty_key(IdT(UINT64_MAX - 1));
+      mMap.set_deleted_key(IdT(UINT64_MAX));
+      mMutex.SetBlocking(true);
+    }
+
+    mutable eos::common::RWMutex mMutex; ///< Protect map and slots
+    //! Map from entry id to position in the slot array
+    google::dense_hash_map<IdT, std::uint64_t, Murmur3::MurmurHasher<IdT>> mMap;
+    std::deque<Slot> mSlots; ///< Slots traversed by the clock hand
+    std::vector<std::uint64_t> mFreeSlots; ///< Positions of free slots
+    std::uint64_t mHand; ///< Current position of the clock hand
+    std::atomic<std::uint64_t> mSize; ///< Number of cached entries
+    std::atomic<std::uint64_t> mSizeBytes; ///< Estimated size of the entries
+  };
+
+  //----------------------------------------------------------------------------
+  //! Get shard responsible for the given id. The shard is selected using the
+  //! high bits of the hash, the low bits are used by the per-shard map.
+  //----------------------------------------------------------------------------
+  inline Shard&
+  getShard(IdT id) const
+  {
+    if (mShardBits == 0) {
+      return *mShards[0];
+    }
+
+    return *mShards[mHasher(id) >> (64 - mShardBits)];
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get maximum number of entries in one shard
+  //----------------------------------------------------------------------------
+  inline std::uint64_t
+  getShardMaxNum() const
+  {
+    std::uint64_t max_num = mMaxNum.load();
+
+    if (max_num == UINT64_MAX) {
+      return max_num;
+    }
+
+    return (max_num + mShards.size() - 1) / mShards.size();
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get maximum estimated size in bytes of one shard
+  //----------------------------------------------------------------------------
+  inline std::uint64_t
+  getShardMaxSize() const
+  {
+    std::uint64_t max_size = mMaxSize.load();
+
+    if (max_size == UINT64_MAX) {
+      return max_size;
+    }
+
+    return (max_size + mShards.size() - 1) / mShards.size();
+  }
+
+  //----------------------------------------------------------------------------
+  //! Evict entries from the given shard until the target number of entries
+  //! and target size are reached, the step budget is used up or the clock
+  //! hand did two full turns. The hand position is kept in the shard so the
+  //! next call continues where this one stopped.
+  //!
+  //! @param shard shard to evict from
+  //! @param target target number of entries
+  //! @param target_bytes target estimated size in bytes
+  //! @param budget max number of slots visited by the clock hand
+  //! @param evicted container collecting the evicted objects so that they
+  //!        are deallocated after releasing the shard lock
+  //!
+  //! @note This method must be called with the shard mutex write locked.
+  //----------------------------------------------------------------------------
+  void Evict(Shard& shard, std::uint64_t target, std::uint64_t target_bytes,
+             std::uint64_t budget,
+             std::vector<std::shared_ptr<EntryT>>& evicted);
+
+  //! Percentage at which the cache eviction stops
+  static constexpr double sPurgeStopRatio = 0.9;
+  //! Max number of slots visited by one eviction triggered from put
+  static constexpr std::uint64_t sEvictBudget = 10000;
+  //! Default number of shards
+  static constexpr std::uint32_t sDefaultNumShards = 64;
+  std::vector<std::unique_ptr<Shard>> mShards; ///< Cache shards
+  std::uint32_t mShardBits; ///< log2 of the number of shards
+  Murmur3::MurmurHasher<IdT> mHasher; ///< Hasher used for shard selection
+  std::atomic<std::uint64_t> mMaxNum; ///< Maximum number of entries
+  std::atomic<std::uint64_t> mMaxSize; ///< Maximum estimated size in bytes
+};
+
+// Definition of class static members
+template <typename IdT, typename EntryT>
+constexpr double ShardedLRU<IdT, EntryT>::sPurgeStopRatio;
+template <typename IdT, typename EntryT>
+constexpr std::uint64_t ShardedLRU<IdT, EntryT>::sEvictBudget;
+template <typename IdT, typename EntryT>
+constexpr std::uint32_t ShardedLRU<IdT, EntryT>::sDefaultNumShards;
+
+//------------------------------------------------------------------------------
+// Constructor
+//------------------------------------------------------------------------------
+template <typename IdT, typename EntryT>
+ShardedLRU<IdT, EntryT>::ShardedLRU(std::uint64_t max_num,
+                                    std::uint32_t num_shards):
+  mShards(), mShardBits(0), mHasher(), mMaxNum(max_num), mMaxSize(UINT64_MAX)
+{
+  while ((1u << mShardBits) < num_shards) {
+    ++mShardBits;
+  }
+
+  for (std::uint32_t i = 0; i < (1u << mShardBits); ++i) {
+    mShards.emplace_back(new Shard());
+  }
+}
+
+//------------------------------------------------------------------------------
+// Get object
+//------------------------------------------------------------------------------
+template <typename IdT, typename EntryT>
+std::shared_ptr<EntryT>
+ShardedLRU<IdT, EntryT>::get(IdT id)
+{
+  Shard& shard = getShard(id);
+  eos::common::RWMutexReadLock lock_r(shard.mMutex);
+  auto iter_map = shard.mMap.find(id);
+
+  if (iter_map == shard.mMap.end()) {
+    return nullptr;
+  }
+
+  Slot& slot = shard.mSlots[iter_map->second];
+
+  // Avoid dirtying the cache line if the bit is already set
+  if (!slot.mReferenced.load(std::memory_order_relaxed)) {
+    slot.mReferenced.store(true, std::memory_order_relaxed);
+  }
+
+  return slot.mEntry;
+}
+
+//------------------------------------------------------------------------------
+// Put object
+//------------------------------------------------------------------------------
+template <typename IdT, typename EntryT>
+typename std::enable_if<hasGetId<EntryT>::value, std::shared_ptr<EntryT>>::type
+    ShardedLRU<IdT, EntryT>::put(IdT id, std::shared_ptr<EntryT> obj)
+{
+  std::uint64_t shard_max = getShardMaxNum();
+
+  if (shard_max == 0ull) {
+    return obj;
+  }
+
+  std::uint64_t shard_max_size = getShardMaxSize();
+  // Estimate the size outside the lock, it might need to lock the object
+  std::uint64_t entry_size = (obj ? LRUEntrySize<EntryT>::estimate(*obj) : 0);
+  // Evicted objects are deallocated only after releasing the lock
+  std::vector<std::shared_ptr<EntryT>> evicted;
+  Shard& shard = getShard(id);
+  eos::common::RWMutexWriteLock lock_w(shard.mMutex);
+  auto iter_map = shard.mMap.find(id);
+
+  if (iter_map != shard.mMap.end()) {
+    return shard.mSlots[iter_map->second].mEntry;
+  }
+
+  if ((shard.mSize.load() >= shard_max) ||
+      ((shard_max_size != UINT64_MAX) &&
+       (shard.mSizeBytes.load() + entry_size > shard_max_size))) {
+    Evict(shard, sPurgeStopRatio * shard_max,
+          (shard_max_size == UINT64_MAX) ? UINT64_MAX :
+          sPurgeStopRatio * shard_max_size, sEvictBudget, evicted);
+  }
+
+  std::uint64_t pos;
+
+  if (shard.mFreeSlots.empty()) {
+    pos = shard.mSlots.size();
+    shard.mSlots.emplace_back();
+  } else {
+    pos = shard.mFreeSlots.back();
+    shard.mFreeSlots.pop_back();
+  }
+
+  Slot& slot = shard.mSlots[pos];
+  slot.mId = id;
+  slot.mEntry = obj;
+  slot.mSize = entry_size;
+  slot.mReferenced.store(false);
+  shard.mMap[id] = pos;
+  ++shard.mSize;
+  shard.mSizeBytes += entry_size;
+  return obj;
+}
+
+//------------------------------------------------------------------------------
+// Remove object
+//------------------------------------------------------------------------------
+template <typename IdT, typename EntryT>
+bool
+ShardedLRU<IdT, EntryT>::remove(IdT id)
+{
+  std::shared_ptr<EntryT> tmp;
+  Shard& shard = getShard(id);
+  eos::common::RWMutexWriteLock lock_w(shard.mMutex);
+  auto iter_map = shard.mMap.find(id);
+
+  if (iter_map == shard.mMap.end()) {
+    return false;
+  }
+
+  Slot& slot = shard.mSlots[iter_map->second];
+  tmp.swap(slot.mEntry);
+  shard.mFreeSlots.push_back(iter_map->second);
+  shard.mMap.erase(iter_map);
+  --shard.mSize;
+  shard.mSizeBytes -= slot.mSize;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Get cache size
+//------------------------------------------------------------------------------
+template <typename IdT, typename EntryT>
+std::uint64_t
+ShardedLRU<IdT, EntryT>::size() const
+{
+  std::uint64_t total = 0ull;
+
+  for (const auto& shard : mShards) {
+    total += shard->mSize.load();
+  }
+
+  return total;
+}
+
+//------------------------------------------------------------------------------
+// Get estimated memory footprint of the cached entries
+//------------------------------------------------------------------------------
+template <typename IdT, typename EntryT>
+std::uint64_t
+ShardedLRU<IdT, EntryT>::size_bytes() const
+{
+  std::uint64_t total = 0ull;
+
+  for (const auto& shard : mShards) {
+    total += shard->mSizeBytes.load();
+  }
+
+  return total;
+}
+
+//------------------------------------------------------------------------------
+// Set max num entries
+//------------------------------------------------------------------------------
+template <typename IdT, typename EntryT>
+void
+ShardedLRU<IdT, EntryT>::set_max_num(const std::uint64_t max_num)
+{
+  if ((max_num == 0ull) || (max_num == UINT64_MAX)) {
+    if (max_num == 0ull) {
+      // Disable the cache before flushing so that no new entries get in
+      mMaxNum = 0ull;
+    }
+
+    for (auto& shard : mShards) {
+      std::vector<std::shared_ptr<EntryT>> evicted;
+      eos::common::RWMutexWriteLock lock_w(shard->mMutex);
+      // Clear all the second chance bits so that one pass is enough
+      for (auto& slot : shard->mSlots) {
+        slot.mReferenced.store(false);
+      }
+
+      Evict(*shard, 0ull, 0ull, 2 * shard->mSlots.size(), evicted);
+    }
+  } else {
+    mMaxNum = max_num;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Evict entries from the given shard
+//------------------------------------------------------------------------------
+template <typename IdT, typename EntryT>
+void
+ShardedLRU<IdT, EntryT>::Evict(Shard& shard, std::uint64_t target,
+                               std::uint64_t target_bytes,
+                               std::uint64_t budget,
+                               std::vector<std::shared_ptr<EntryT>>& evicted)
+{
+  std::uint64_t max_steps = std::min(budget, 2 * shard.mSlots.size());
+
+  for (std::uint64_t step = 0ull; (step < max_steps) &&
+       ((shard.mSize.load() > target) ||
+        (shard.mSizeBytes.load() > target_bytes)); ++step) {
+    if (shard.mHand >= shard.mSlots.size()) {
+      shard.mHand = 0ull;
+    }
+
+    std::uint64_t pos = shard.mHand++;
+    Slot& slot = shard.mSlots[pos];
+
+    // Skip free slots and objects referenced also by someone else
+    if (!slot.mEntry || (slot.mEntry.use_count() > 1)) {
+      continue;
+    }
+
+    // Recently accessed entries get a second chance
+    if (slot.mReferenced.exchange(false)) {
+      continue;
+    }
+
+    shard.mMap.erase(slot.mId);
+    evicted.emplace_back(std::move(slot.mEntry));
+    slot.mEntry.reset();
+    shard.mFreeSlots.push_back(pos);
+    --shard.mSize;
+    shard.mSizeBytes -= slot.mSize;
+  }
+}
+
+EOSNSNAMESPACE_END
+
+#endif // __EOS_NS_SHARDED_LRU_HH__
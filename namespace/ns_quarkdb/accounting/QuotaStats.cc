@@ -30,9 +30,19 @@
 #include "qclient/QScanner.hh"
 #include "qclient/QHash.hh"
 #include "common/StringTokenizer.hh"
+#include "common/Logging.hh"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cctype>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
 
 EOSNSNAMESPACE_BEGIN
 
+constexpr uint64_t QuotaStats::kJournalMagic;
+
 //------------------------------------------------------------------------------
 // *** Class QuotaNode implementaion ***
 //------------------------------------------------------------------------------
@@ -46,6 +56,7 @@ QuotaNode::QuotaNode(IQuotaStats* quota_stats, IContainerMD::id_t node_id)
   std::string snode_id = std::to_string(node_id);
   pQcl = static_cast<QuotaStats*>(quota_stats)->pQcl;
   pFlusher = static_cast<QuotaStats*>(quota_stats)->pFlusher;
+  pStats = static_cast<QuotaStats*>(quota_stats);
   pQuotaUidKey = QuotaStats::KeyQuotaUidMap(snode_id);
   pQuotaGidKey = QuotaStats::KeyQuotaGidMap(snode_id);
 }
@@ -56,19 +67,10 @@ QuotaNode::QuotaNode(IQuotaStats* quota_stats, IContainerMD::id_t node_id)
 void
 QuotaNode::addFile(const IFileMD* file)
 {
-  const std::string suid = std::to_string(file->getCUid());
-  const std::string sgid = std::to_string(file->getCGid());
   const int64_t size = pQuotaStats->getPhysicalSize(file);
-  const std::string physicalSize = std::to_string(size);
-  const std::string logicalSize = std::to_string(file->getSize());
-  pFlusher->exec("HINCRBYMULTI",
-                 pQuotaUidKey, suid + quota::sPhysicalSize, physicalSize,
-                 pQuotaGidKey, sgid + quota::sPhysicalSize, physicalSize,
-                 pQuotaUidKey, suid + quota::sLogicalSize,  logicalSize,
-                 pQuotaGidKey, sgid + quota::sLogicalSize,  logicalSize,
-                 pQuotaUidKey, suid + quota::sNumFiles,     "1",
-                 pQuotaGidKey, sgid + quota::sNumFiles,     "1"
-                );
+  const int64_t logicalSize = file->getSize();
+  pStats->queueDelta(pContainerId, file->getCUid(), file->getCGid(),
+                     logicalSize, size, 1);
   // Update the cached information
   pCore.addFile(
     file->getCUid(),
@@ -84,20 +86,10 @@ QuotaNode::addFile(const IFileMD* file)
 void
 QuotaNode::removeFile(const IFileMD* file)
 {
-  const std::string suid = std::to_string(file->getCUid());
-  const std::string sgid = std::to_string(file->getCGid());
   const int64_t size = pQuotaStats->getPhysicalSize(file);
-  const int64_t logicalSizeInt = file->getSize();
-  const std::string minusPhysicalSize = std::to_string(-size);
-  const std::string minusLogicalSize = std::to_string(-logicalSizeInt);
-  pFlusher->exec("HINCRBYMULTI",
-                 pQuotaUidKey, suid + quota::sPhysicalSize, minusPhysicalSize,
-                 pQuotaGidKey, sgid + quota::sPhysicalSize, minusPhysicalSize,
-                 pQuotaUidKey, suid + quota::sLogicalSize,  minusLogicalSize,
-                 pQuotaGidKey, sgid + quota::sLogicalSize,  minusLogicalSize,
-                 pQuotaUidKey, suid + quota::sNumFiles,     "-1",
-                 pQuotaGidKey, sgid + quota::sNumFiles,     "-1"
-                );
+  const int64_t logicalSize = file->getSize();
+  pStats->queueDelta(pContainerId, file->getCUid(), file->getCGid(),
+                     -logicalSize, -size, -1);
   // Update the cached information
   pCore.removeFile(
     file->getCUid(),
@@ -114,6 +106,8 @@ void
 QuotaNode::meld(const IQuotaNode* node)
 {
   const QuotaNode* impl_node = static_cast<const QuotaNode*>(node);
+  // Make sure the backend information of both nodes is complete
+  pStats->flush();
   // Meld in the uid map info
   qclient::QHash hmap(*pQcl,
                       QuotaStats::KeyQuotaUidMap(std::to_string(impl_node->getId())));
@@ -222,6 +216,10 @@ void
 QuotaNode::replaceCore(const QuotaNodeCore& updated)
 {
   pCore = updated;
+  // Push the pending deltas first, so that the journal doesn't hold any delta
+  // which would be replayed on top of the replaced information after a crash
+  std::lock_guard<std::mutex> lock(pStats->mMutexDeltas);
+  pStats->flushLocked();
   pFlusher->exec("DEL", pQuotaUidKey);
   pFlusher->exec("DEL", pQuotaGidKey);
 
@@ -266,7 +264,9 @@ QuotaNode::replaceCore(const QuotaNodeCore& updated)
 // Constructor
 //------------------------------------------------------------------------------
 QuotaStats::QuotaStats():
-  pQcl(nullptr), pFlusher(nullptr) {}
+  pQcl(nullptr), pFlusher(nullptr), mJournalFd(-1), mJournalRecords(0),
+  mBatch(1), mFlushIntervalMs(1000), mNumUpdates(0), mNumFlushes(0),
+  mNumRequests(0), mNumReplayed(0) {}
 
 
 //------------------------------------------------------------------------------
@@ -274,6 +274,16 @@ QuotaStats::QuotaStats():
 //------------------------------------------------------------------------------
 QuotaStats::~QuotaStats()
 {
+  mFlushThread.join();
+
+  if (pFlusher) {
+    flush();
+  }
+
+  if (mJournalFd >= 0) {
+    (void) close(mJournalFd);
+  }
+
   pNodeMap.clear();
 }
 
@@ -287,6 +297,7 @@ QuotaStats::configure(const std::map<std::string, std::string>& config)
   std::string qdb_flusher_id;
   const std::string key_cluster = "qdb_cluster";
   const std::string key_flusher = "qdb_flusher_quota";
+  const std::string key_interval = "quota_flush_interval_ms";
 
   if (pQcl == nullptr && pFlusher == nullptr) {
     QdbContactDetails contactDetails = ConfigurationParser::parse(config);
@@ -296,9 +307,31 @@ QuotaStats::configure(const std::map<std::string, std::string>& config)
                         << " configuration was provided");
     }
 
+    if (config.find(key_interval) != config.end()) {
+      const std::string& sinterval = config.at(key_interval);
+      char* end = nullptr;
+      unsigned long interval = strtoul(sinterval.c_str(), &end, 10);
+
+      if (sinterval.empty() || !isdigit(sinterval[0]) || (end == nullptr) ||
+          (*end != '\0') || (interval > UINT32_MAX)) {
+        throw_mdexception(EINVAL, __FUNCTION__ << " Invalid " << key_interval
+                          << " configuration: " << sinterval);
+      }
+
+      mFlushIntervalMs = interval;
+    }
+
     std::string qdb_flusher_id = config.at(key_flusher);
     pQcl = BackendClient::getInstance(contactDetails);
     pFlusher = MetadataFlusherFactory::getInstance(qdb_flusher_id, contactDetails);
+    mFlusherId = qdb_flusher_id;
+
+    openJournal(MetadataFlusherFactory::getQueuePath() + qdb_flusher_id +
+                ".deltas");
+
+    if (mFlushIntervalMs) {
+      mFlushThread.reset(&QuotaStats::flushLoop, this);
+    }
   }
 }
 
@@ -361,10 +394,257 @@ QuotaStats::removeNode(IContainerMD::id_t node_id)
   }
 
   std::string snode_id = std::to_string(node_id);
+  // Push the pending deltas first, they must not be replayed after the removal
+  std::lock_guard<std::mutex> lock(mMutexDeltas);
+  flushLocked();
   pFlusher->del(KeyQuotaUidMap(snode_id));
   pFlusher->del(KeyQuotaGidMap(snode_id));
 }
 
+//------------------------------------------------------------------------------
+// Accumulate a usage change of a quota node
+//------------------------------------------------------------------------------
+void
+QuotaStats::queueDelta(IContainerMD::id_t node_id, uint64_t uid, uint64_t gid,
+                       int64_t logical, int64_t physical, int64_t files)
+{
+  DeltaRecord rec {node_id, uid, gid, logical, physical, files};
+  std::lock_guard<std::mutex> lock(mMutexDeltas);
+  bool journaled = false;
+
+  if (mFlushIntervalMs && (mJournalFd >= 0)) {
+    if (write(mJournalFd, &rec, sizeof(rec)) == sizeof(rec)) {
+      ++mJournalRecords;
+      journaled = true;
+    } else {
+      eos_static_err("msg=\"failed to journal quota delta, writing it through\" "
+                     "flusher=%s errno=%d", mFlusherId.c_str(), errno);
+    }
+  }
+
+  applyDeltaLocked(rec);
+  ++mNumUpdates;
+
+  if (!journaled) {
+    flushLocked();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Add a usage change to the pending deltas
+//------------------------------------------------------------------------------
+void
+QuotaStats::applyDeltaLocked(const DeltaRecord& rec)
+{
+  NodeDelta& node = mDeltas[rec.mNodeId];
+  UsageDelta& user = node.mUid[rec.mUid];
+  UsageDelta& group = node.mGid[rec.mGid];
+  user.space += rec.mLogical;
+  user.physicalSpace += rec.mPhysical;
+  user.files += rec.mFiles;
+  group.space += rec.mLogical;
+  group.physicalSpace += rec.mPhysical;
+  group.files += rec.mFiles;
+}
+
+//------------------------------------------------------------------------------
+// Push the pending quota deltas to the metadata flusher
+//------------------------------------------------------------------------------
+void
+QuotaStats::flush()
+{
+  std::lock_guard<std::mutex> lock(mMutexDeltas);
+  flushLocked();
+}
+
+//------------------------------------------------------------------------------
+// Push the pending deltas, must be called with mMutexDeltas locked
+//------------------------------------------------------------------------------
+void
+QuotaStats::flushLocked()
+{
+  if (mDeltas.empty()) {
+    return;
+  }
+
+  // Append the non-zero fields of one user or group to the request
+  auto add_fields = [](std::vector<std::string>& req, const std::string & key,
+  const std::map<uint64_t, UsageDelta>& deltas) {
+    for (const auto& elem : deltas) {
+      const std::string sid = std::to_string(elem.first);
+      const UsageDelta& delta = elem.second;
+
+      if (delta.physicalSpace) {
+        req.insert(req.end(), {key, sid + quota::sPhysicalSize,
+                               std::to_string(delta.physicalSpace)});
+      }
+
+      if (delta.space) {
+        req.insert(req.end(), {key, sid + quota::sLogicalSize,
+                               std::to_string(delta.space)});
+      }
+
+      if (delta.files) {
+        req.insert(req.end(), {key, sid + quota::sNumFiles,
+                               std::to_string(delta.files)});
+      }
+    }
+  };
+  std::vector<std::string> req {"HINCRBYMULTI"};
+
+  for (const auto& elem : mDeltas) {
+    const std::string snode_id = std::to_string(elem.first);
+    add_fields(req, KeyQuotaUidMap(snode_id), elem.second.mUid);
+    add_fields(req, KeyQuotaGidMap(snode_id), elem.second.mGid);
+  }
+
+  // Updates cancelling out don't need to go to the backend. Otherwise all
+  // of them are pushed in a single request together with the increment of the
+  // flushed batches, so that they are either all persisted in the flusher
+  // queue or none of them.
+  if (req.size() > 1) {
+    req.insert(req.end(), {quota::sFlushedBatchesKey, mFlusherId, "1"});
+    pFlusher->execute(req);
+    ++mBatch;
+    ++mNumRequests;
+  }
+
+  mDeltas.clear();
+  ++mNumFlushes;
+
+  if (mJournalRecords) {
+    resetJournalLocked();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Open the journal of the pending deltas and replay the left over deltas
+//------------------------------------------------------------------------------
+void
+QuotaStats::openJournal(const std::string& path)
+{
+  JournalHeader header {0, 0};
+  std::vector<DeltaRecord> records;
+  {
+    std::ifstream file(path, std::ios::binary);
+
+    if (file.read((char*)&header, sizeof(header)) &&
+        (header.mMagic == kJournalMagic)) {
+      DeltaRecord rec;
+
+      // A record partially written before a crash never made it into the
+      // pending deltas either, so it is dropped
+      while (file.read((char*)&rec, sizeof(rec))) {
+        records.push_back(rec);
+      }
+    }
+  }
+  // The flushed batches are only up to date once the flusher queue drained
+  uint64_t flushed = getFlushedBatches();
+  std::lock_guard<std::mutex> lock(mMutexDeltas);
+  mBatch = flushed + 1;
+  mJournalFd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                    0644);
+
+  if (mJournalFd < 0) {
+    eos_static_err("msg=\"failed to open quota journal, deltas are written "
+                   "through\" path=%s errno=%d", path.c_str(), errno);
+  }
+
+  if (!records.empty()) {
+    if (header.mBatch > flushed) {
+      eos_static_notice("msg=\"replaying quota deltas from journal\" path=%s "
+                        "batch=%lu records=%lu", path.c_str(), header.mBatch,
+                        records.size());
+
+      for (const auto& rec : records) {
+        applyDeltaLocked(rec);
+      }
+
+      mNumReplayed += records.size();
+      flushLocked();
+    } else {
+      eos_static_info("msg=\"quota deltas from journal already flushed\" "
+                      "path=%s batch=%lu flushed=%lu", path.c_str(),
+                      header.mBatch, flushed);
+    }
+  }
+
+  resetJournalLocked();
+}
+
+//------------------------------------------------------------------------------
+// Truncate the journal and start it for the current batch
+//------------------------------------------------------------------------------
+void
+QuotaStats::resetJournalLocked()
+{
+  mJournalRecords = 0;
+
+  if (mJournalFd < 0) {
+    return;
+  }
+
+  JournalHeader header {kJournalMagic, mBatch};
+
+  if ((ftruncate(mJournalFd, 0) != 0) ||
+      (write(mJournalFd, &header, sizeof(header)) != sizeof(header))) {
+    eos_static_err("msg=\"failed to reset quota journal, deltas are written "
+                   "through\" flusher=%s errno=%d", mFlusherId.c_str(), errno);
+    (void) close(mJournalFd);
+    mJournalFd = -1;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Get the number of batches of deltas applied in the backend
+//------------------------------------------------------------------------------
+uint64_t
+QuotaStats::getFlushedBatches()
+{
+  pFlusher->synchronize();
+  qclient::QHash hash(*pQcl, quota::sFlushedBatchesKey);
+  std::string sval = hash.hget(mFlusherId);
+  return (sval.empty() ? 0 : std::stoull(sval));
+}
+
+//------------------------------------------------------------------------------
+// Loop flushing the pending deltas every flush interval
+//------------------------------------------------------------------------------
+void
+QuotaStats::flushLoop(ThreadAssistant& assistant)
+{
+  while (!assistant.terminationRequested()) {
+    assistant.wait_for(std::chrono::milliseconds(mFlushIntervalMs));
+    flush();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Get statistics of the quota updates
+//------------------------------------------------------------------------------
+QuotaStats::Statistics
+QuotaStats::getStatistics()
+{
+  Statistics stats;
+  stats.updates = mNumUpdates;
+  stats.flushes = mNumFlushes;
+  stats.requests = mNumRequests;
+  {
+    std::lock_guard<std::mutex> lock(mMutexDeltas);
+    stats.pendingNodes = mDeltas.size();
+    stats.replayed = mNumReplayed;
+  }
+
+  if (pFlusher) {
+    MetadataFlusher::Statistics flusher_stats = pFlusher->getStatistics();
+    stats.queueSize = flusher_stats.pending;
+    stats.maxQueueSize = flusher_stats.maxPending;
+  }
+
+  return stats;
+}
+
 //------------------------------------------------------------------------------
 // Get the set of all quota node ids. The quota node id corresponds to the
 // container id.
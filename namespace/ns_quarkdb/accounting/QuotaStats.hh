@@ -24,6 +24,10 @@
 #pragma once
 #include "namespace/Namespace.hh"
 #include "namespace/interface/IQuota.hh"
+#include "common/AssistedThread.hh"
+#include <atomic>
+#include <map>
+#include <mutex>
 
 namespace qclient
 {
@@ -60,6 +64,10 @@ class MetadataFlusher;
 //!     gid1:files          --> val3,
 //!     ...
 //!     gidm:files          --> val3m }
+//!
+//! File additions and removals only update the cached information and the
+//! pending deltas kept by QuotaStats, which are journaled locally and written
+//! to the backend as one combined update every flush interval.
 //------------------------------------------------------------------------------
 class QuotaNode : public IQuotaNode
 {
@@ -108,6 +116,7 @@ private:
   qclient::QClient* pQcl; ///< Backend client from QuotaStats
   std::shared_ptr<MetadataFlusher>
   pFlusher; ///< Metadata flusher object from QuotaStats
+  QuotaStats* pStats; ///< Quota stats object owning the pending deltas
 };
 
 //------------------------------------------------------------------------------
@@ -159,7 +168,116 @@ public:
   //----------------------------------------------------------------------------
   std::unordered_set<IContainerMD::id_t> getAllIds() override;
 
+  //----------------------------------------------------------------------------
+  //! Push the pending quota deltas of all the quota nodes to the metadata
+  //! flusher as a single combined update, then truncate the journal.
+  //----------------------------------------------------------------------------
+  void flush();
+
+  //----------------------------------------------------------------------------
+  //! Statistics of the quota updates
+  //----------------------------------------------------------------------------
+  struct Statistics {
+    uint64_t updates = 0; ///< File additions/removals accounted
+    uint64_t flushes = 0; ///< Non-empty flushes
+    uint64_t requests = 0; ///< Combined requests pushed to the flusher
+    uint64_t replayed = 0; ///< Deltas replayed from the journal at startup
+    uint64_t pendingNodes = 0; ///< Quota nodes with pending deltas
+    int64_t queueSize = 0; ///< Requests pending in the flusher queue
+    int64_t maxQueueSize = 0; ///< Largest flusher queue size observed
+  };
+
+  //----------------------------------------------------------------------------
+  //! Get statistics of the quota updates
+  //----------------------------------------------------------------------------
+  Statistics getStatistics();
+
 private:
+  //! Pending usage changes of one user or group
+  struct UsageDelta {
+    int64_t space = 0;
+    int64_t physicalSpace = 0;
+    int64_t files = 0;
+  };
+
+  //! Pending usage changes of one quota node
+  struct NodeDelta {
+    std::map<uint64_t, UsageDelta> mUid;
+    std::map<uint64_t, UsageDelta> mGid;
+  };
+
+  //! Journal header identifying the batch the journaled deltas belong to
+  struct JournalHeader {
+    uint64_t mMagic;
+    uint64_t mBatch;
+  };
+
+  //! Journal record of one usage change
+  struct DeltaRecord {
+    uint64_t mNodeId;
+    uint64_t mUid;
+    uint64_t mGid;
+    int64_t mLogical;
+    int64_t mPhysical;
+    int64_t mFiles;
+  };
+
+  static constexpr uint64_t kJournalMagic = 0x45515547524e4c31; ///< Magic
+
+  //----------------------------------------------------------------------------
+  //! Accumulate a usage change of a quota node. The change is appended to the
+  //! journal before it is accumulated so that it survives a crash, and
+  //! written through immediately if the flush interval is 0 or the journal
+  //! is not available.
+  //!
+  //! @param node_id quota node id
+  //! @param uid user id
+  //! @param gid group id
+  //! @param logical logical size delta
+  //! @param physical physical size delta
+  //! @param files number of files delta
+  //----------------------------------------------------------------------------
+  void queueDelta(IContainerMD::id_t node_id, uint64_t uid, uint64_t gid,
+                  int64_t logical, int64_t physical, int64_t files);
+
+  //----------------------------------------------------------------------------
+  //! Add a usage change to the pending deltas, must be called with
+  //! mMutexDeltas locked
+  //----------------------------------------------------------------------------
+  void applyDeltaLocked(const DeltaRecord& rec);
+
+  //----------------------------------------------------------------------------
+  //! Push the pending deltas, must be called with mMutexDeltas locked. The
+  //! request also increments the number of flushed batches in the backend,
+  //! which tells at startup whether the journaled deltas were already pushed.
+  //----------------------------------------------------------------------------
+  void flushLocked();
+
+  //----------------------------------------------------------------------------
+  //! Open the journal of the pending deltas and replay the deltas left over
+  //! by a previous run which did not make it to the metadata flusher
+  //!
+  //! @param path journal file path
+  //----------------------------------------------------------------------------
+  void openJournal(const std::string& path);
+
+  //----------------------------------------------------------------------------
+  //! Truncate the journal and start it for the current batch, must be called
+  //! with mMutexDeltas locked
+  //----------------------------------------------------------------------------
+  void resetJournalLocked();
+
+  //----------------------------------------------------------------------------
+  //! Get the number of batches of deltas applied in the backend, waiting
+  //! for the metadata flusher to drain its queue first
+  //----------------------------------------------------------------------------
+  uint64_t getFlushedBatches();
+
+  //----------------------------------------------------------------------------
+  //! Loop flushing the pending deltas every flush interval
+  //----------------------------------------------------------------------------
+  void flushLoop(ThreadAssistant& assistant);
+
   //----------------------------------------------------------------------------
   //! Get quota node uid map key
   //!
@@ -191,6 +309,20 @@ private:
   std::map<IContainerMD::id_t, std::unique_ptr<IQuotaNode>> pNodeMap; ///< Map of quota nodes
   qclient::QClient* pQcl; ///< Backend client
   std::shared_ptr<MetadataFlusher> pFlusher; ///< Metadata flusher object
+  //! Mutex protecting the pending deltas and ordering the requests which
+  //! overwrite quota nodes with the flushed deltas
+  std::mutex mMutexDeltas;
+  std::map<IContainerMD::id_t, NodeDelta> mDeltas; ///< Pending deltas
+  std::string mFlusherId; ///< Quota flusher id
+  int mJournalFd; ///< Journal of the pending deltas, -1 if not available
+  uint64_t mJournalRecords; ///< Records appended to the journal
+  uint64_t mBatch; ///< Sequence number of the batch accumulating deltas
+  uint32_t mFlushIntervalMs; ///< Flush interval, 0 means write-through
+  std::atomic<uint64_t> mNumUpdates; ///< File additions/removals accounted
+  std::atomic<uint64_t> mNumFlushes; ///< Non-empty flushes
+  std::atomic<uint64_t> mNumRequests; ///< Requests pushed to the flusher
+  uint64_t mNumReplayed; ///< Deltas replayed from the journal
+  AssistedThread mFlushThread; ///< Thread flushing the pending deltas
 };
 
 EOSNSNAMESPACE_END
@@ -84,6 +84,20 @@ ContainerMDSvc::configure(const std::map<std::string, std::string>& config)
       mMetadataProvider->setContainerMDCacheNum(std::stoull(mCacheNum));
     }
   }
+
+  if (config.find(constants::sMaxSizeCacheDirs) != config.end()) {
+    mCacheSize = config.at(constants::sMaxSizeCacheDirs);
+
+    if (mMetadataProvider) {
+      mMetadataProvider->setContainerMDCacheSize(std::stoull(mCacheSize));
+    }
+  }
+
+  if (config.find(constants::sCacheTypeDirs) != config.end()) {
+    // Validate the type now, it's applied when the service is initialized
+    (void) MetadataProvider::parseCacheType(config.at(constants::sCacheTypeDirs));
+    mCacheType = config.at(constants::sCacheTypeDirs);
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -120,10 +134,22 @@ ContainerMDSvc::initialize()
     throw e;
   }
 
+  // Both cache types are applied here, before any metadata is served
+  if (!mCacheType.empty()) {
+    mMetadataProvider->setContainerMDCacheType
+    (MetadataProvider::parseCacheType(mCacheType));
+  }
+
+  mMetadataProvider->initialize();
+
   if (!mCacheNum.empty()) {
     mMetadataProvider->setContainerMDCacheNum(std::stoull(mCacheNum));
   }
 
+  if (!mCacheSize.empty()) {
+    mMetadataProvider->setContainerMDCacheSize(std::stoull(mCacheSize));
+  }
+
   SafetyCheck();
   mNumConts.store(pQcl->execute(RequestBuilder::getNumberOfContainers())
                   .get()->integer);
@@ -225,6 +225,8 @@ private:
   std::atomic<uint64_t> mNumConts;      ///< Total number of containers
   std::string
   mCacheNum;                ///< Temporary workaround to store cache size
+  std::string mCacheSize;   ///< Cache max size applied at initialization
+  std::string mCacheType;   ///< Cache type applied at initialization
 };
 
 EOSNSNAMESPACE_END
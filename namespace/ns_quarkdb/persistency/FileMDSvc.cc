@@ -77,17 +77,29 @@ FileMDSvc::configure(const std::map<std::string, std::string>& config)
     mMetaMap.setClient(*pQcl);
     mUnifiedInodeProvider.configure(mMetaMap);
     pFlusher = MetadataFlusherFactory::getInstance(qdb_flusher_id, contactDetails);
-    mMetadataProvider.reset(new MetadataProvider(contactDetails, pContSvc, this));
+    mMetadataProvider.reset(new MetadataProvider(contactDetails, pContSvc,
+                            this));
     static_cast<ContainerMDSvc*>(pContSvc)->setMetadataProvider
     (mMetadataProvider.get());
     static_cast<ContainerMDSvc*>(pContSvc)->setInodeProvider
     (&mUnifiedInodeProvider);
   }
 
+  if (config.find(constants::sCacheTypeFiles) != config.end()) {
+    // Applied when the container service initializes the provider
+    mMetadataProvider->setFileMDCacheType(MetadataProvider::parseCacheType
+                                          (config.at(constants::sCacheTypeFiles)));
+  }
+
   if (config.find(constants::sMaxNumCacheFiles) != config.end()) {
     std::string val = config.at(constants::sMaxNumCacheFiles);
     mMetadataProvider->setFileMDCacheNum(std::stoull(val));
   }
+
+  if (config.find(constants::sMaxSizeCacheFiles) != config.end()) {
+    std::string val = config.at(constants::sMaxSizeCacheFiles);
+    mMetadataProvider->setFileMDCacheSize(std::stoull(val));
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -115,8 +115,6 @@ public:
   {
     mQcl = &qcl;
     mTarget = trg;
-    mContents.set_deleted_key("");
-    mContents.set_empty_key("##_EMPTY_##");
     folly::Future<ContainerType> fut = mPromise.getFuture();
     // There's a particularly evil race condition here: From the point we call
     // execCB and onwards, we must assume that the callback has arrived,
@@ -174,7 +172,7 @@ public:
         return set_exception(st);
       }
 
-      mContents[filename] = value;
+      mContents.insert_or_assign(filename, value);
     }
 
     // Fire off next request?
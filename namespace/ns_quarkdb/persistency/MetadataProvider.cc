@@ -36,12 +36,79 @@ using std::placeholders::_1;
 
 EOSNSNAMESPACE_BEGIN
 
+//! Estimated overhead of one extended attribute or child entry
+static constexpr std::uint64_t sEntryOverhead = 64;
+
+//------------------------------------------------------------------------------
+// Estimate of the memory footprint of a cached FileMD
+//------------------------------------------------------------------------------
+template <>
+struct LRUEntrySize<IFileMD> {
+  static std::uint64_t
+  estimate(IFileMD& file)
+  {
+    return sizeof(FileMD) + file.getName().size() +
+           (file.getNumLocation() + file.getNumUnlinkedLocation()) *
+           sizeof(IFileMD::location_t) + file.numAttributes() * sEntryOverhead;
+  }
+};
+
+//------------------------------------------------------------------------------
+// Estimate of the memory footprint of a cached ContainerMD including the
+// maps of children
+//------------------------------------------------------------------------------
+template <>
+struct LRUEntrySize<IContainerMD> {
+  static std::uint64_t
+  estimate(IContainerMD& cont)
+  {
+    return sizeof(ContainerMD) + cont.getName().size() +
+           (cont.getNumFiles() + cont.getNumContainers() + cont.numAttributes()) *
+           sEntryOverhead;
+  }
+};
+
+//------------------------------------------------------------------------------
+// Parse cache type from its string representation
+//------------------------------------------------------------------------------
+MetadataProvider::CacheType
+MetadataProvider::parseCacheType(const std::string& type)
+{
+  if (type == "lru") {
+    return CacheType::kLRU;
+  } else if (type == "sharded-lru") {
+    return CacheType::kShardedLRU;
+  }
+
+  throw_mdexception(EINVAL, "Unknown namespace cache type: " << type);
+}
+
+//------------------------------------------------------------------------------
+// Build a cache of the given type
+//------------------------------------------------------------------------------
+template <typename IdT, typename EntryT>
+std::unique_ptr<ILRU<IdT, EntryT>>
+MetadataProvider::makeCache(CacheType type, uint64_t max_num)
+{
+  if (type == CacheType::kShardedLRU) {
+    return std::unique_ptr<ILRU<IdT, EntryT>>
+           (new ShardedLRU<IdT, EntryT>(max_num));
+  }
+
+  return std::unique_ptr<ILRU<IdT, EntryT>>(new LRU<IdT, EntryT>(max_num));
+}
+
 //------------------------------------------------------------------------------
 // Constructor
 //------------------------------------------------------------------------------
 MetadataProvider::MetadataProvider(const QdbContactDetails& contactDetails,
                                    IContainerMDSvc* contsvc, IFileMDSvc* filesvc)
-  : mContSvc(contsvc), mFileSvc(filesvc), mContainerCache(3e6), mFileCache(3e7)
+  : mContSvc(contsvc), mFileSvc(filesvc),
+    mContainerCache(makeCache<ContainerIdentifier, IContainerMD>
+                    (CacheType::kLRU, 3e6)),
+    mFileCache(makeCache<FileIdentifier, IFileMD>(CacheType::kLRU, 3e7)),
+    mInitialized(false), mFileCacheType(CacheType::kLRU),
+    mContainerCacheType(CacheType::kLRU)
 {
   mExecutor.reset(new folly::IOThreadPoolExecutor(16));
 
@@ -57,55 +124,67 @@ MetadataProvider::MetadataProvider(const QdbContactDetails& contactDetails,
 folly::Future<IContainerMDPtr>
 MetadataProvider::retrieveContainerMD(ContainerIdentifier id)
 {
-  std::unique_lock<std::mutex> lock(mMutex);
   // A ContainerMD can be in three states: Not in cache, inside in-flight cache,
-  // and cached. Is it inside in-flight cache?
-  auto it = mInFlightContainers.find(id);
-
-  if (it != mInFlightContainers.end()) {
-    // Cache hit: A container with such ID has been staged already. Once a
-    // response arrives, all futures tied to that container will be activated
-    // automatically, with the same IContainerMDPtr.
-    return it->second.getFuture();
-  }
-
-  // Nope.. is it inside the long-lived cache?
-  IContainerMDPtr result = mContainerCache.get(id);
-
-  if (result) {
-    lock.unlock();
+  // and cached. Is it inside the long-lived cache? Lookups here don't need
+  // the in-flight stripe lock, entries are moved from the in-flight area into
+  // the cache while holding it.
+  IContainerMDPtr result = mContainerCache->get(id);
+
+  if (result == nullptr) {
+    auto& stripe = mInFlightContainers.getStripe(id);
+    std::unique_lock<std::mutex> lock(stripe.mMutex);
+    // Nope.. is it inside in-flight cache?
+    auto it = stripe.mMap.find(id);
+
+    if (it != stripe.mMap.end()) {
+      // Cache hit: A container with such ID has been staged already. Once a
+      // response arrives, all futures tied to that container will be activated
+      // automatically, with the same IContainerMDPtr.
+      ++mContainerCounters.mCoalesced;
+      return it->second.getFuture();
+    }
 
-    // Handle special case where we're dealing with a tombstone.
-    if (result->isDeleted()) {
-      return folly::makeFuture<IContainerMDPtr>
-             (make_mdexception(ENOENT, "Container #" << id.getUnderlyingUInt64()
-                               << " does not exist (found deletion tombstone)"));
+    // The fetch might have completed before we took the lock, check again
+    result = mContainerCache->get(id);
+
+    if (result == nullptr) {
+      ++mContainerCounters.mMisses;
+      // Nope, need to fetch, and insert into the in-flight staging area. Merge
+      // three asynchronous operations into one.
+      folly::Future<eos::ns::ContainerMdProto> protoFut =
+        MetadataFetcher::getContainerFromId(pickQcl(id), id);
+      folly::Future<IContainerMD::FileMap> fileMapFut =
+        MetadataFetcher::getFilesInContainer(pickQcl(id), id);
+      folly::Future<IContainerMD::ContainerMap> containerMapFut =
+        MetadataFetcher::getSubContainers(pickQcl(id), id);
+      folly::Future<IContainerMDPtr> fut =
+        folly::collect(protoFut, fileMapFut, containerMapFut)
+        .via(mExecutor.get())
+        .then(std::bind(&MetadataProvider::processIncomingContainerMD, this, id,
+                        _1))
+      .onError([this, id](const folly::exception_wrapper & e) {
+        // If the operation failed, clear the in-flight cache.
+        auto& stripe = mInFlightContainers.getStripe(id);
+        std::lock_guard<std::mutex> lock(stripe.mMutex);
+        stripe.mMap.erase(id);
+        return folly::makeFuture<IContainerMDPtr>(e);
+      });
+      auto& splitter = stripe.mMap[id];
+      splitter = folly::FutureSplitter<IContainerMDPtr>(std::move(fut));
+      return splitter.getFuture();
     }
+  }
+
+  ++mContainerCounters.mHits;
 
-    return folly::makeFuture<IContainerMDPtr>(std::move(result));
+  // Handle special case where we're dealing with a tombstone.
+  if (result->isDeleted()) {
+    return folly::makeFuture<IContainerMDPtr>
+           (make_mdexception(ENOENT, "Container #" << id.getUnderlyingUInt64()
+                             << " does not exist (found deletion tombstone)"));
   }
 
-  // Nope, need to fetch, and insert into the in-flight staging area. Merge
-  // three asynchronous operations into one.
-  folly::Future<eos::ns::ContainerMdProto> protoFut =
-    MetadataFetcher::getContainerFromId(pickQcl(id), id);
-  folly::Future<IContainerMD::FileMap> fileMapFut =
-    MetadataFetcher::getFilesInContainer(pickQcl(id), id);
-  folly::Future<IContainerMD::ContainerMap> containerMapFut =
-    MetadataFetcher::getSubContainers(pickQcl(id), id);
-  folly::Future<IContainerMDPtr> fut =
-    folly::collect(protoFut, fileMapFut, containerMapFut)
-    .via(mExecutor.get())
-    .then(std::bind(&MetadataProvider::processIncomingContainerMD, this, id, _1))
-  .onError([this, id](const folly::exception_wrapper & e) {
-    // If the operation failed, clear the in-flight cache.
-    std::lock_guard<std::mutex> lock(mMutex);
-    mInFlightContainers.erase(id);
-    return folly::makeFuture<IContainerMDPtr>(e);
-  });
-  mInFlightContainers[id] = folly::FutureSplitter<IContainerMDPtr>(std::move(
-                              fut));
-  return mInFlightContainers[id].getFuture();
+  return folly::makeFuture<IContainerMDPtr>(std::move(result));
 }
 
 //------------------------------------------------------------------------------
@@ -114,46 +193,60 @@ MetadataProvider::retrieveContainerMD(ContainerIdentifier id)
 folly::Future<IFileMDPtr>
 MetadataProvider::retrieveFileMD(FileIdentifier id)
 {
-  std::unique_lock<std::mutex> lock(mMutex);
   // A FileMD can be in three states: Not in cache, inside in-flight cache,
-  // and cached. Is it inside in-flight cache?
-  auto it = mInFlightFiles.find(id);
-
-  if (it != mInFlightFiles.end()) {
-    // Cache hit: A container with such ID has been staged already. Once a
-    // response arrives, all futures tied to that container will be activated
-    // automatically, with the same IContainerMDPtr.
-    return it->second.getFuture();
-  }
-
-  // Nope.. is it inside the long-lived cache?
-  IFileMDPtr result = mFileCache.get(id);
-
-  if (result) {
-    lock.unlock();
+  // and cached. Is it inside the long-lived cache? Lookups here don't need
+  // the in-flight stripe lock, entries are moved from the in-flight area into
+  // the cache while holding it.
+  IFileMDPtr result = mFileCache->get(id);
+
+  if (result == nullptr) {
+    auto& stripe = mInFlightFiles.getStripe(id);
+    std::unique_lock<std::mutex> lock(stripe.mMutex);
+    // Nope.. is it inside in-flight cache?
+    auto it = stripe.mMap.find(id);
+
+    if (it != stripe.mMap.end()) {
+      // Cache hit: A file with such ID has been staged already. Once a
+      // response arrives, all futures tied to that file will be activated
+      // automatically, with the same IFileMDPtr.
+      ++mFileCounters.mCoalesced;
+      return it->second.getFuture();
+    }
 
-    // Handle special case where we're dealing with a tombstone.
-    if (result->isDeleted()) {
-      return folly::makeFuture<IFileMDPtr>
-             (make_mdexception(ENOENT, "File #" << id.getUnderlyingUInt64()
-                               << " does not exist (found deletion tombstone)"));
+    // The fetch might have completed before we took the lock, check again
+    result = mFileCache->get(id);
+
+    if (result == nullptr) {
+      ++mFileCounters.mMisses;
+      // Nope, need to fetch, and insert into the in-flight staging area.
+      folly::Future<IFileMDPtr> fut =
+        MetadataFetcher::getFileFromId(pickQcl(id), id)
+        .via(mExecutor.get())
+        .then(std::bind(&MetadataProvider::processIncomingFileMdProto, this, id,
+                        _1))
+      .onError([this, id](const folly::exception_wrapper & e) {
+        // If the operation failed, clear the in-flight cache.
+        auto& stripe = mInFlightFiles.getStripe(id);
+        std::lock_guard<std::mutex> lock(stripe.mMutex);
+        stripe.mMap.erase(id);
+        return folly::makeFuture<IFileMDPtr>(e);
+      });
+      auto& splitter = stripe.mMap[id];
+      splitter = folly::FutureSplitter<IFileMDPtr>(std::move(fut));
+      return splitter.getFuture();
     }
+  }
 
-    return folly::makeFuture<IFileMDPtr>(std::move(result));
+  ++mFileCounters.mHits;
+
+  // Handle special case where we're dealing with a tombstone.
+  if (result->isDeleted()) {
+    return folly::makeFuture<IFileMDPtr>
+           (make_mdexception(ENOENT, "File #" << id.getUnderlyingUInt64()
+                             << " does not exist (found deletion tombstone)"));
   }
 
-  // Nope, need to fetch, and insert into the in-flight staging area.
-  folly::Future<IFileMDPtr> fut = MetadataFetcher::getFileFromId(pickQcl(id), id)
-                                  .via(mExecutor.get())
-                                  .then(std::bind(&MetadataProvider::processIncomingFileMdProto, this, id, _1))
-  .onError([this, id](const folly::exception_wrapper & e) {
-    // If the operation failed, clear the in-flight cache.
-    std::lock_guard<std::mutex> lock(mMutex);
-    mInFlightFiles.erase(id);
-    return folly::makeFuture<IFileMDPtr>(e);
-  });
-  mInFlightFiles[id] = folly::FutureSplitter<IFileMDPtr>(std::move(fut));
-  return mInFlightFiles[id].getFuture();
+  return folly::makeFuture<IFileMDPtr>(std::move(result));
 }
 
 //----------------------------------------------------------------------------
@@ -171,8 +264,9 @@ MetadataProvider::hasFileMD(FileIdentifier id)
 void
 MetadataProvider::insertFileMD(FileIdentifier id, IFileMDPtr item)
 {
-  std::lock_guard<std::mutex> lock(mMutex);
-  mFileCache.put(id, item);
+  auto& stripe = mInFlightFiles.getStripe(id);
+  std::lock_guard<std::mutex> lock(stripe.mMutex);
+  mFileCache->put(id, item);
 }
 
 //------------------------------------------------------------------------------
@@ -182,8 +276,9 @@ void
 MetadataProvider::insertContainerMD(ContainerIdentifier id,
                                     IContainerMDPtr item)
 {
-  std::lock_guard<std::mutex> lock(mMutex);
-  mContainerCache.put(id, item);
+  auto& stripe = mInFlightContainers.getStripe(id);
+  std::lock_guard<std::mutex> lock(stripe.mMutex);
+  mContainerCache->put(id, item);
 }
 
 //------------------------------------------------------------------------------
@@ -191,8 +286,7 @@ MetadataProvider::insertContainerMD(ContainerIdentifier id,
 //------------------------------------------------------------------------------
 void MetadataProvider::setFileMDCacheNum(uint64_t max_num)
 {
-  std::lock_guard<std::mutex> lock(mMutex);
-  mFileCache.set_max_num(max_num);
+  mFileCache->set_max_num(max_num);
 }
 
 //------------------------------------------------------------------------------
@@ -200,8 +294,81 @@ void MetadataProvider::setFileMDCacheNum(uint64_t max_num)
 //------------------------------------------------------------------------------
 void MetadataProvider::setContainerMDCacheNum(uint64_t max_num)
 {
-  std::lock_guard<std::mutex> lock(mMutex);
-  mContainerCache.set_max_num(max_num);
+  mContainerCache->set_max_num(max_num);
+}
+
+//------------------------------------------------------------------------------
+// Change file cache max size.
+//------------------------------------------------------------------------------
+void MetadataProvider::setFileMDCacheSize(uint64_t max_size)
+{
+  mFileCache->set_max_size(max_size);
+}
+
+//------------------------------------------------------------------------------
+// Change container cache max size.
+//------------------------------------------------------------------------------
+void MetadataProvider::setContainerMDCacheSize(uint64_t max_size)
+{
+  mContainerCache->set_max_size(max_size);
+}
+
+//------------------------------------------------------------------------------
+// Initialize the provider
+//------------------------------------------------------------------------------
+void MetadataProvider::initialize()
+{
+  std::lock_guard<std::mutex> lock(mInitMutex);
+
+  if (mInitialized) {
+    return;
+  }
+
+  if (mFileCacheType != CacheType::kLRU) {
+    uint64_t max_size = mFileCache->get_max_size();
+    mFileCache = makeCache<FileIdentifier, IFileMD>(mFileCacheType,
+                 mFileCache->get_max_num());
+    mFileCache->set_max_size(max_size);
+  }
+
+  if (mContainerCacheType != CacheType::kLRU) {
+    uint64_t max_size = mContainerCache->get_max_size();
+    mContainerCache = makeCache<ContainerIdentifier, IContainerMD>
+                      (mContainerCacheType, mContainerCache->get_max_num());
+    mContainerCache->set_max_size(max_size);
+  }
+
+  mInitialized = true;
+}
+
+//------------------------------------------------------------------------------
+// Set file cache type
+//------------------------------------------------------------------------------
+void MetadataProvider::setFileMDCacheType(CacheType type)
+{
+  std::lock_guard<std::mutex> lock(mInitMutex);
+
+  if (mInitialized && (type != mFileCacheType)) {
+    throw_mdexception(EBUSY, "File cache type can't be changed once the "
+                      "namespace is initialized");
+  }
+
+  mFileCacheType = type;
+}
+
+//------------------------------------------------------------------------------
+// Set container cache type
+//------------------------------------------------------------------------------
+void MetadataProvider::setContainerMDCacheType(CacheType type)
+{
+  std::lock_guard<std::mutex> lock(mInitMutex);
+
+  if (mInitialized && (type != mContainerCacheType)) {
+    throw_mdexception(EBUSY, "Container cache type can't be changed once the "
+                      "namespace is initialized");
+  }
+
+  mContainerCacheType = type;
 }
 
 //------------------------------------------------------------------------------
@@ -216,7 +383,6 @@ MetadataProvider::processIncomingContainerMD(ContainerIdentifier id,
     IContainerMD::ContainerMap
     > tup)
 {
-  std::lock_guard<std::mutex> lock(mMutex);
   // Unpack tuple. (sigh)
   eos::ns::ContainerMdProto& proto = std::get<0>(tup);
   IContainerMD::FileMap& fileMap = std::get<1>(tup);
@@ -228,12 +394,14 @@ MetadataProvider::processIncomingContainerMD(ContainerIdentifier id,
   containerMD->initialize(std::move(proto), std::move(fileMap),
                           std::move(containerMap));
   // Drop inFlightContainers future..
-  auto it = mInFlightContainers.find(id);
-  eos_assert(it != mInFlightContainers.end());
-  mInFlightContainers.erase(it);
+  auto& stripe = mInFlightContainers.getStripe(id);
+  std::lock_guard<std::mutex> lock(stripe.mMutex);
+  auto it = stripe.mMap.find(id);
+  eos_assert(it != stripe.mMap.end());
+  stripe.mMap.erase(it);
   // Insert into the cache ...
   IContainerMDPtr item { containerMD };
-  mContainerCache.put(id, item);
+  mContainerCache->put(id, item);
   return item;
 }
 
@@ -245,19 +413,20 @@ IFileMDPtr
 MetadataProvider::processIncomingFileMdProto(FileIdentifier id,
     eos::ns::FileMdProto proto)
 {
-  std::lock_guard<std::mutex> lock(mMutex);
   // Things look sane?
   eos_assert(proto.id() == id.getUnderlyingUInt64());
   // Yep, construct FileMD object..
   FileMD* fileMD = new FileMD(0, mFileSvc);
   fileMD->initialize(std::move(proto));
   // Drop inFlightFiles future..
-  auto it = mInFlightFiles.find(id);
-  eos_assert(it != mInFlightFiles.end());
-  mInFlightFiles.erase(it);
+  auto& stripe = mInFlightFiles.getStripe(id);
+  std::lock_guard<std::mutex> lock(stripe.mMutex);
+  auto it = stripe.mMap.find(id);
+  eos_assert(it != stripe.mMap.end());
+  stripe.mMap.erase(it);
   // Insert into the cache ...
   IFileMDPtr item { fileMD };
-  mFileCache.put(id, item);
+  mFileCache->put(id, item);
   return item;
 }
 
@@ -268,11 +437,14 @@ CacheStatistics MetadataProvider::getFileMDCacheStats()
 {
   CacheStatistics stats;
   stats.enabled = true;
-  stats.occupancy = mFileCache.size();
-  stats.maxNum = mFileCache.get_max_num();
-
-  std::lock_guard<std::mutex> lock(mMutex);
+  stats.occupancy = mFileCache->size();
+  stats.maxNum = mFileCache->get_max_num();
+  stats.sizeBytes = mFileCache->size_bytes();
+  stats.maxSize = mFileCache->get_max_size();
   stats.inFlight = mInFlightFiles.size();
+  stats.hits = mFileCounters.mHits.load();
+  stats.misses = mFileCounters.mMisses.load();
+  stats.coalesced = mFileCounters.mCoalesced.load();
   return stats;
 }
 
@@ -283,11 +455,14 @@ CacheStatistics MetadataProvider::getContainerMDCacheStats()
 {
   CacheStatistics stats;
   stats.enabled = true;
-  stats.occupancy = mContainerCache.size();
-  stats.maxNum = mContainerCache.get_max_num();
-
-  std::lock_guard<std::mutex> lock(mMutex);
+  stats.occupancy = mContainerCache->size();
+  stats.maxNum = mContainerCache->get_max_num();
+  stats.sizeBytes = mContainerCache->size_bytes();
+  stats.maxSize = mContainerCache->get_max_size();
   stats.inFlight = mInFlightContainers.size();
+  stats.hits = mContainerCounters.mHits.load();
+  stats.misses = mContainerCounters.mMisses.load();
+  stats.coalesced = mContainerCounters.mCoalesced.load();
   return stats;
 }
 
@@ -27,10 +27,15 @@
 #include "namespace/interface/IContainerMD.hh"
 #include "namespace/Namespace.hh"
 #include "namespace/ns_quarkdb/LRU.hh"
+#include "namespace/ns_quarkdb/ShardedLRU.hh"
 #include "namespace/interface/Misc.hh"
 #include <qclient/QClient.hh>
 #include <folly/futures/Future.h>
 #include <folly/futures/FutureSplitter.h>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
 
 namespace folly
 {
@@ -50,11 +55,38 @@ class MetadataProvider
 {
 public:
   //----------------------------------------------------------------------------
-  //! Constructor
+  //! Type of cache used for the metadata objects
+  //----------------------------------------------------------------------------
+  enum class CacheType {
+    kLRU,       ///< Single lock LRU, see LRU.hh
+    kShardedLRU ///< Sharded CLOCK cache, see ShardedLRU.hh
+  };
+
+  //----------------------------------------------------------------------------
+  //! Parse cache type from its string representation i.e. "lru" or
+  //! "sharded-lru"
+  //!
+  //! @param type string representation
+  //!
+  //! @return cache type, throws MDException if type is unknown
+  //----------------------------------------------------------------------------
+  static CacheType parseCacheType(const std::string& type);
+
+  //----------------------------------------------------------------------------
+  //! Constructor - the caches are of type kLRU until the provider is
+  //! initialized with other cache types
   //----------------------------------------------------------------------------
   MetadataProvider(const QdbContactDetails& contactDetails, IContainerMDSvc* contsvc,
                    IFileMDSvc* filemvc);
 
+  //----------------------------------------------------------------------------
+  //! Initialize the provider, building the caches of the configured types.
+  //! Must be called before the provider serves any requests, since the caches
+  //! are accessed without synchronization afterwards. Calling it again has
+  //! no effect.
+  //----------------------------------------------------------------------------
+  void initialize();
+
   //----------------------------------------------------------------------------
   //! Retrieve ContainerMD by ID
   //----------------------------------------------------------------------------
@@ -90,6 +122,29 @@ public:
   //----------------------------------------------------------------------------
   void setContainerMDCacheNum(uint64_t max_num);
 
+  //----------------------------------------------------------------------------
+  //! Change file cache max size in bytes, 0 means no size limit
+  //----------------------------------------------------------------------------
+  void setFileMDCacheSize(uint64_t max_size);
+
+  //----------------------------------------------------------------------------
+  //! Change container cache max size in bytes, 0 means no size limit
+  //----------------------------------------------------------------------------
+  void setContainerMDCacheSize(uint64_t max_size);
+
+  //----------------------------------------------------------------------------
+  //! Set file cache type, applied when the provider is initialized. Throws
+  //! MDException if the type differs from the one of an initialized provider.
+  //----------------------------------------------------------------------------
+  void setFileMDCacheType(CacheType type);
+
+  //----------------------------------------------------------------------------
+  //! Set container cache type, applied when the provider is initialized.
+  //! Throws MDException if the type differs from the one of an initialized
+  //! provider.
+  //----------------------------------------------------------------------------
+  void setContainerMDCacheType(CacheType type);
+
   //----------------------------------------------------------------------------
   //! Get file cache statistics
   //----------------------------------------------------------------------------
@@ -101,6 +156,70 @@ public:
   CacheStatistics getContainerMDCacheStats();
 
 private:
+  //! Number of bits used to select the stripe of the in-flight tables
+  static constexpr size_t kInFlightStripeBits = 6;
+
+  //----------------------------------------------------------------------------
+  //! Table of in-flight requests split in stripes selected by the hash of the
+  //! id, each stripe protected by its own mutex
+  //----------------------------------------------------------------------------
+  template <typename IdT, typename EntryT>
+  struct InFlightTable {
+    //--------------------------------------------------------------------------
+    //! Stripe of the in-flight table
+    //--------------------------------------------------------------------------
+    struct Stripe {
+      std::mutex mMutex;
+      std::unordered_map<IdT, folly::FutureSplitter<EntryT>,
+          Murmur3::MurmurHasher<IdT>> mMap;
+    };
+
+    //--------------------------------------------------------------------------
+    //! Get stripe responsible for the given id
+    //--------------------------------------------------------------------------
+    Stripe& getStripe(IdT id)
+    {
+      return mStripes[mHasher(id) >> (64 - kInFlightStripeBits)];
+    }
+
+    //--------------------------------------------------------------------------
+    //! Get total number of in-flight requests
+    //--------------------------------------------------------------------------
+    size_t size()
+    {
+      size_t total = 0;
+
+      for (auto& stripe : mStripes) {
+        std::lock_guard<std::mutex> lock(stripe.mMutex);
+        total += stripe.mMap.size();
+      }
+
+      return total;
+    }
+
+    std::array<Stripe, (1 << kInFlightStripeBits)> mStripes;
+    Murmur3::MurmurHasher<IdT> mHasher;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Lookup counters of one type of metadata
+  //----------------------------------------------------------------------------
+  struct LookupCounters {
+    std::atomic<uint64_t> mHits {0}; ///< Found in the long-lived cache
+    std::atomic<uint64_t> mMisses {0}; ///< Triggered a backend fetch
+    std::atomic<uint64_t> mCoalesced {0}; ///< Joined an in-flight fetch
+  };
+
+  //----------------------------------------------------------------------------
+  //! Build a cache of the given type
+  //!
+  //! @param type cache type
+  //! @param max_num maximum number of entries in the cache
+  //----------------------------------------------------------------------------
+  template <typename IdT, typename EntryT>
+  static std::unique_ptr<ILRU<IdT, EntryT>>
+  makeCache(CacheType type, uint64_t max_num);
+
   //----------------------------------------------------------------------------
   //! Turn an incoming FileMDProto into FileMD, removing from the inFlight
   //! staging area, and inserting into the cache
@@ -133,13 +252,19 @@ private:
   std::vector<qclient::QClient*> mQclPool;
   IContainerMDSvc* mContSvc;
   IFileMDSvc* mFileSvc;
-  std::mutex mMutex;
-  std::map<ContainerIdentifier,
-      folly::FutureSplitter<IContainerMDPtr>> mInFlightContainers;
-  std::map<FileIdentifier, folly::FutureSplitter<IFileMDPtr>> mInFlightFiles;
-  LRU<ContainerIdentifier, IContainerMD> mContainerCache;
-  LRU<FileIdentifier, IFileMD> mFileCache;
+  InFlightTable<ContainerIdentifier, IContainerMDPtr> mInFlightContainers;
+  InFlightTable<FileIdentifier, IFileMDPtr> mInFlightFiles;
+  LookupCounters mContainerCounters;
+  LookupCounters mFileCounters;
+  //! Caches are accessed without holding any in-flight stripe lock, so that
+  //! cache hits never serialize on them. They are only replaced by initialize.
+  std::unique_ptr<ILRU<ContainerIdentifier, IContainerMD>> mContainerCache;
+  std::unique_ptr<ILRU<FileIdentifier, IFileMD>> mFileCache;
   std::unique_ptr<folly::Executor> mExecutor;
+  std::mutex mInitMutex; ///< Serialize initialization and cache type changes
+  bool mInitialized; ///< Set once the caches of the configured types are built
+  CacheType mFileCacheType; ///< Configured file cache type
+  CacheType mContainerCacheType; ///< Configured container cache type
 };
 
 EOSNSNAMESPACE_END
@@ -29,53 +29,159 @@ EOSNSNAMESPACE_BEGIN
 // Constructor
 //------------------------------------------------------------------------------
 NextInodeProvider::NextInodeProvider()
-  : pHash(nullptr), pField(""), mNextId(0), mBlockEnd(-1), mStepIncrease(1)
+  : pHash(nullptr), pField(""), mState(0), mNextEnd(-1), mNextStep(0),
+    mStepIncrease(1)
 {
 }
 
+//------------------------------------------------------------------------------
+// Destructor
+//------------------------------------------------------------------------------
+NextInodeProvider::~NextInodeProvider()
+{
+  std::lock_guard<std::mutex> lock(mMtx);
+
+  if (mPending.valid()) {
+    mPending.wait();
+  }
+}
+
 //------------------------------------------------------------------------------
 // Get first free id
 //------------------------------------------------------------------------------
 int64_t NextInodeProvider::getFirstFreeId()
 {
   std::lock_guard<std::mutex> lock(mMtx);
+  uint64_t state = mState.load();
+  int64_t offset = (state & 0xffffffff);
+  int64_t start, len;
 
-  if (mBlockEnd < mNextId) {
-    IFileMD::id_t id = 0;
-    std::string sval = pHash->hget(pField);
+  if (readBlock(state >> 32, start, len) && (offset < len)) {
+    return start + offset;
+  }
 
-    if (!sval.empty()) {
-      id = std::stoull(sval);
-    }
+  int64_t next_end = waitNextBlock();
 
-    return id + 1;
+  if (next_end >= 0) {
+    return next_end - mNextStep + 1;
   }
 
-  return mNextId;
+  IFileMD::id_t id = 0;
+  std::string sval = pHash->hget(pField);
+
+  if (!sval.empty()) {
+    id = std::stoull(sval);
+  }
+
+  return id + 1;
 }
 
 //------------------------------------------------------------------------------
 // The hash contains the current largest *reserved* inode we've seen so far.
-// To obtain the next free one, we increment that counter and return its value.
-// We reserve inodes by blocks to avoid roundtrips to the db, increasing the
-// block-size slowly up to 5000 so as to avoid wasting lots of inodes if the MGM
-// is unstable and restarts often.
+// We reserve inodes by blocks to avoid roundtrips to the db, the next block is
+// always reserved before handing out ids from the current one so uniqueness
+// across restarts is guaranteed. Within a block ids are handed out with an
+// atomic increment, only the thread exhausting the block takes the mutex.
 //------------------------------------------------------------------------------
 int64_t NextInodeProvider::reserve()
 {
-  std::lock_guard<std::mutex> lock(mMtx);
+  while (true) {
+    uint64_t state = mState.fetch_add(1);
+    uint64_t gen = (state >> 32);
+    int64_t offset = (state & 0xffffffff);
+    int64_t start, len;
+
+    if (readBlock(gen, start, len) && (offset < len)) {
+      return start + offset;
+    }
 
-  if (mBlockEnd < mNextId) {
-    mBlockEnd = pHash->hincrby(pField, mStepIncrease);
-    mNextId = mBlockEnd - mStepIncrease + 1;
+    // Block exhausted - unless somebody else already did it, switch to the
+    // next one and retry
+    std::lock_guard<std::mutex> lock(mMtx);
 
-    // Increase step for next round
-    if (mStepIncrease <= 5000) {
-      mStepIncrease++;
+    if ((mState.load() >> 32) == gen) {
+      switchBlock(gen + 1);
     }
   }
+}
+
+//------------------------------------------------------------------------------
+// Read the block of the given generation
+//------------------------------------------------------------------------------
+bool NextInodeProvider::readBlock(uint64_t gen, int64_t& start,
+                                  int64_t& len) const
+{
+  const Block& block = mBlocks[gen & 1];
+
+  if (block.mGen.load() != (int64_t) gen) {
+    return false;
+  }
+
+  start = block.mStart.load();
+  len = block.mLen.load();
+  // Make sure the block was not reused while reading it
+  return (block.mGen.load() == (int64_t) gen);
+}
+
+//------------------------------------------------------------------------------
+// Take the next reserved block into use and reserve the following one
+//------------------------------------------------------------------------------
+void NextInodeProvider::switchBlock(uint64_t gen)
+{
+  int64_t step;
+  int64_t end = waitNextBlock();
+
+  if (end >= 0) {
+    step = mNextStep;
+    mNextEnd = -1;
+  } else {
+    step = nextStep();
+    end = pHash->hincrby(pField, step);
+  }
+
+  // The block being replaced belongs to generation gen - 2, the threads still
+  // looking at it fail the generation check and retry
+  Block& block = mBlocks[gen & 1];
+  block.mGen.store(-1);
+  block.mStart.store(end - step + 1);
+  block.mLen.store(step);
+  block.mGen.store(gen);
+  mState.store(gen << 32);
+  // Reserve the next block ahead of exhaustion
+  mNextStep = nextStep();
+  qclient::QHash* hash = pHash;
+  std::string field = pField;
+  int64_t next_step = mNextStep;
+  mPending = std::async(std::launch::async, [hash, field, next_step]() -> int64_t {
+    return hash->hincrby(field, next_step);
+  });
+}
+
+//------------------------------------------------------------------------------
+// Wait for the pending block reservation
+//------------------------------------------------------------------------------
+int64_t NextInodeProvider::waitNextBlock()
+{
+  if (mPending.valid()) {
+    mNextEnd = mPending.get();
+  }
+
+  return mNextEnd;
+}
+
+//------------------------------------------------------------------------------
+// Get the size of the next block to reserve
+//------------------------------------------------------------------------------
+int64_t NextInodeProvider::nextStep()
+{
+  int64_t step = mStepIncrease;
+
+  // Increase step for next round
+  if (mStepIncrease <= 5000) {
+    mStepIncrease++;
+  }
 
-  return mNextId++;
+  return step;
 }
 
 //------------------------------------------------------------------------------
@@ -23,6 +23,8 @@
 
 #pragma once
 #include "namespace/Namespace.hh"
+#include <atomic>
+#include <future>
 #include <mutex>
 
 namespace qclient {
@@ -33,6 +35,12 @@ EOSNSNAMESPACE_BEGIN
 
 //------------------------------------------------------------------------------
 //! Class NextInodeProvider
+//!
+//! Ids are handed out from blocks reserved in the backend. Within a block an
+//! id is obtained with a single atomic increment, the mutex is only taken to
+//! switch to the next block. The next block is reserved asynchronously as soon
+//! as the current one is taken into use, so the backend roundtrip is normally
+//! off the critical path.
 //------------------------------------------------------------------------------
 class NextInodeProvider
 {
@@ -43,6 +51,11 @@ public:
   //----------------------------------------------------------------------------
   NextInodeProvider();
 
+  //----------------------------------------------------------------------------
+  //! Destructor - waits for any pending block reservation
+  //----------------------------------------------------------------------------
+  ~NextInodeProvider();
+
   //----------------------------------------------------------------------------
   //! Configuration method
   //!
@@ -62,11 +75,54 @@ public:
   int64_t reserve();
 
 private:
-  std::mutex mMtx;
+  //----------------------------------------------------------------------------
+  //! Block of reserved ids. The fields are written under mMtx while no thread
+  //! can obtain ids from the block, readers validate them through mGen.
+  //----------------------------------------------------------------------------
+  struct Block {
+    std::atomic<int64_t> mGen {-1}; ///< Generation using the block, -1 if none
+    std::atomic<int64_t> mStart {0}; ///< First id of the block
+    std::atomic<int64_t> mLen {0}; ///< Number of ids in the block
+  };
+
+  //----------------------------------------------------------------------------
+  //! Read the block of the given generation
+  //!
+  //! @return true if the block is in use by the given generation
+  //----------------------------------------------------------------------------
+  bool readBlock(uint64_t gen, int64_t& start, int64_t& len) const;
+
+  //----------------------------------------------------------------------------
+  //! Take the next reserved block into use and reserve the following one.
+  //! Must be called with mMtx locked.
+  //!
+  //! @param gen generation of the next block
+  //----------------------------------------------------------------------------
+  void switchBlock(uint64_t gen);
+
+  //----------------------------------------------------------------------------
+  //! Wait for the pending block reservation. Must be called with mMtx locked.
+  //!
+  //! @return last id of the reserved block or -1 if nothing was reserved
+  //----------------------------------------------------------------------------
+  int64_t waitNextBlock();
+
+  //----------------------------------------------------------------------------
+  //! Get the size of the next block to reserve. The block size increases
+  //! slowly so as to avoid wasting lots of inodes if the MGM restarts often.
+  //----------------------------------------------------------------------------
+  int64_t nextStep();
+
+  std::mutex mMtx; ///< Mutex protecting block switches and the members below
   qclient::QHash* pHash; ///< qclient hash - no ownership
   std::string pField;
-  int64_t mNextId;
-  int64_t mBlockEnd;
+  //! Generation of the current block in the upper 32 bits and the offset of
+  //! the next id within the block in the lower 32 bits
+  std::atomic<uint64_t> mState;
+  Block mBlocks[2]; ///< Current and previous block, indexed by generation
+  std::future<int64_t> mPending; ///< Pending reservation of the next block
+  int64_t mNextEnd; ///< Last id of the reserved next block, -1 if none
+  int64_t mNextStep; ///< Size of the reserved next block
   int64_t mStepIncrease;
 };
 
@@ -26,7 +26,12 @@
 #include "namespace/ns_quarkdb/persistency/ContainerMDSvc.hh"
 #include "namespace/ns_quarkdb/persistency/FileMDSvc.hh"
 #include "namespace/ns_quarkdb/views/HierarchicalView.hh"
+#include "namespace/utils/CompactNameMap.hh"
+#include <google/dense_hash_map>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <random>
 #include <string>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -211,17 +216,101 @@ RunReader(void* tconf)
   return nullptr;
 }
 
+//------------------------------------------------------------------------------
+// Fill the given child map, then measure memory per entry and lookup latency
+//------------------------------------------------------------------------------
+template <typename MapT>
+static void
+BenchmarkChildMap(const std::string& label, MapT& map,
+                  const std::vector<std::string>& names)
+{
+  eos::common::LinuxMemConsumption::linux_mem_t mem[2];
+  eos::common::LinuxMemConsumption::GetMemoryFootprint(mem[0]);
+
+  for (size_t i = 0; i < names.size(); ++i) {
+    map.insert(std::make_pair(names[i], static_cast<eos::IFileMD::id_t>(i)));
+  }
+
+  eos::common::LinuxMemConsumption::GetMemoryFootprint(mem[1]);
+  std::vector<size_t> order(names.size());
+
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+
+  std::shuffle(order.begin(), order.end(), std::mt19937_64(42));
+  size_t found = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  for (size_t i : order) {
+    found += (map.find(names[i]) != map.end());
+  }
+
+  auto duration = std::chrono::steady_clock::now() - start;
+  double bytes_per_entry = (mem[1].resident > mem[0].resident) ?
+                           (double)(mem[1].resident - mem[0].resident) / names.size() : 0;
+  double ns_per_lookup = (double)std::chrono::duration_cast
+                         <std::chrono::nanoseconds>(duration).count() / names.size();
+  fprintf(stderr, "ALL      %-20s entries=%zu found=%zu bytes/entry=%.01f "
+          "lookup=%.01f ns\n", label.c_str(), names.size(), found,
+          bytes_per_entry, ns_per_lookup);
+}
+
+//------------------------------------------------------------------------------
+// Compare the dense hash child map with the compact one, each is built in a
+// separate scope so that the resident memory growth can be attributed.
+//------------------------------------------------------------------------------
+static void
+RunChildMapBenchmark(size_t n_entries)
+{
+  std::vector<std::string> names;
+  names.reserve(n_entries);
+
+  for (size_t i = 0; i < n_entries; ++i) {
+    char name[64];
+    snprintf(static_cast<char*>(name), sizeof(name) - 1,
+             "file____________________%08u", static_cast<unsigned int>(i));
+    names.emplace_back(static_cast<char*>(name));
+  }
+
+  std::cerr << "# ***********************************************************"
+            << std::endl;
+  std::cerr << "[i] Child map benchmark ..." << std::endl;
+  std::cerr << "# ***********************************************************"
+            << std::endl;
+  {
+    google::dense_hash_map<std::string, eos::IFileMD::id_t,
+          Murmur3::MurmurHasher<std::string>> map;
+    map.set_deleted_key("");
+    map.set_empty_key("##_EMPTY_##");
+    BenchmarkChildMap("dense_hash_map", map, names);
+  }
+  {
+    eos::IContainerMD::FileMap map;
+    BenchmarkChildMap("CompactNameMap", map, names);
+  }
+  std::cerr << "# ***********************************************************"
+            << std::endl;
+}
+
 //------------------------------------------------------------------------------
 // Main function
 //----------------------------------------------------------------------------
 int
 main(int argc, char** argv)
 {
+  if ((argc == 3) && (std::string(argv[1]) == "--child-maps")) {
+    RunChildMapBenchmark(std::stoull(argv[2]));
+    return 0;
+  }
+
   // Check up the commandline params
   if (argc != 5) {
     std::cerr << "Usage:" << std::endl;
     std::cerr << "  eos-namespace-benchmark <qdb_host> <qdb_port> "
               << "<level1-dirs> <level3-files> " << std::endl;
+    std::cerr << "  eos-namespace-benchmark --child-maps <entries>"
+              << std::endl;
     return 1;
   }
 
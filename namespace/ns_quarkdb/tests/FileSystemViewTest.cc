@@ -31,6 +31,7 @@
 #include "namespace/interface/ContainerIterators.hh"
 #include "namespace/utils/TestHelpers.hh"
 #include "namespace/utils/RmrfHelper.hh"
+#include "namespace/Prefetcher.hh"
 #include <gtest/gtest.h>
 #include <cstdlib>
 #include <cstdint>
@@ -394,6 +395,64 @@ TEST_F(FileSystemViewF, FileListIterator) {
   ASSERT_TRUE(eos::ns::testing::verifyContents(fsview()->getStreamingFileList(4), std::set<eos::IFileMD::id_t> { 4 } ));
 }
 
+//------------------------------------------------------------------------------
+// Streaming through a file list with a bounded prefetch window
+//------------------------------------------------------------------------------
+TEST_F(FileSystemViewF, PrefetchingFileListIterator)
+{
+  view()->createContainer("/test/prefetch/", true);
+  std::set<eos::IFileMD::id_t> ids;
+
+  for (int i = 0; i < 500; ++i) {
+    std::shared_ptr<eos::IFileMD> file =
+      view()->createFile(SSTR("/test/prefetch/file" << i));
+    file->addLocation(7);
+    view()->updateFileStore(file.get());
+    ids.insert(file->getId());
+  }
+
+  mdFlusher()->synchronize();
+  shut_down_everything();
+
+  for (bool parents : { false, true }) {
+    eos::PrefetchingFileListIterator it(view(),
+                                        fsview()->getStreamingFileList(7), 16, parents);
+    std::set<eos::IFileMD::id_t> found;
+
+    for (; it.valid(); it.next()) {
+      std::shared_ptr<eos::IFileMD> fmd = it.getFileMD();
+      ASSERT_TRUE(fmd != nullptr);
+      ASSERT_EQ(fmd->getId(), it.getElement());
+      ASSERT_TRUE(fmd->hasLocation(7));
+      found.insert(it.getElement());
+    }
+
+    ASSERT_EQ(found, ids);
+  }
+
+  eos::PrefetchingFileListIterator empty(view(),
+                                         fsview()->getStreamingFileList(8));
+  ASSERT_FALSE(empty.valid());
+  // Prefetch a set of file ids one window at a time
+  shut_down_everything();
+  auto prefetched = ids.cbegin();
+  size_t num_windows = 0;
+
+  for (auto it = ids.cbegin(); it != ids.cend(); ++it) {
+    if (it == prefetched) {
+      prefetched = eos::Prefetcher::prefetchFileMDsAndWait(view(), it,
+                   ids.cend(), true, 100);
+      ASSERT_EQ(std::min<size_t>(100, std::distance(it, ids.cend())),
+                (size_t) std::distance(it, prefetched));
+      ++num_windows;
+    }
+
+    ASSERT_EQ(*it, fileSvc()->getFileMD(*it)->getId());
+  }
+
+  ASSERT_EQ(5u, num_windows);
+}
+
 //------------------------------------------------------------------------------
 // Tests targetting FileSystemHandler
 //------------------------------------------------------------------------------
@@ -502,8 +561,6 @@ TEST_F(FileSystemViewF, FileSystemHandler) {
 
 TEST(SetChangeList, BasicSanity) {
   eos::IFsView::FileList contents;
-  contents.set_deleted_key(0);
-  contents.set_empty_key(0xffffffffffffffffll);
 
   eos::SetChangeList<eos::IFileMD::id_t> changeList;
   contents.insert(5);
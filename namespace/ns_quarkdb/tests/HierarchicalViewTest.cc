@@ -563,3 +563,58 @@ TEST_F(HierarchicalViewF, AddContainerWithConflicts)
 
   cont1->addContainer(cont4.get()); // conflicts with itself, thus, no conflict
 }
+
+TEST_F(HierarchicalViewF, PathLookupCache)
+{
+  eos::PathLookupCache& cache =
+    static_cast<eos::HierarchicalView*>(view())->getPathLookupCache();
+  eos::IContainerMDPtr cont1 = view()->createContainer("/eos/dev/d1/d2/d3", true);
+  view()->createFile("/eos/dev/d1/d2/d3/file1");
+  ASSERT_EQ(view()->getFile("/eos/dev/d1/d2/d3/file1")->getName(), "file1");
+  ASSERT_EQ(cache.size(), 6u);
+
+  // Rename of an intermediate directory drops all paths below it
+  eos::IContainerMDPtr d1 = view()->getContainer("/eos/dev/d1");
+  view()->renameContainer(d1.get(), "d1-renamed");
+  ASSERT_EQ(cache.size(), 3u);
+  ASSERT_THROW(view()->getFile("/eos/dev/d1/d2/d3/file1"), eos::MDException);
+  ASSERT_EQ(view()->getFile("/eos/dev/d1-renamed/d2/d3/file1")->getName(),
+            "file1");
+  ASSERT_EQ(view()->getContainer("/eos/dev/d1-renamed/d2/d3")->getId(),
+            cont1->getId());
+
+  // Lookups through symlinks must not pollute the cache
+  view()->createLink("/eos/dev/link", "d1-renamed/d2");
+  ASSERT_EQ(view()->getContainer("/eos/dev/link/d3")->getId(), cont1->getId());
+  eos::ContainerIdentifier id;
+  std::string path;
+  ASSERT_EQ(cache.lookup({"eos", "dev", "link", "d3"}, id, path), 2u);
+  ASSERT_EQ(path, "/eos/dev/");
+}
+
+TEST(PathLookupCache, ClockEviction)
+{
+  eos::PathLookupCache cache(4);
+  uint64_t gen = cache.getGeneration();
+  cache.insert("/", eos::ContainerIdentifier(1), gen);
+  cache.insert("/a/", eos::ContainerIdentifier(2), gen);
+  cache.insert("/b/", eos::ContainerIdentifier(3), gen);
+  cache.insert("/c/", eos::ContainerIdentifier(4), gen);
+  cache.insert("/c/d/", eos::ContainerIdentifier(5), gen);
+  ASSERT_EQ(cache.size(), 4u);
+
+  // The first sweep clears all reference bits, the root is never evicted
+  eos::ContainerIdentifier id;
+  std::string path;
+  ASSERT_EQ(cache.lookup({"a"}, id, path), 0u);
+
+  // Referenced paths are spared once, so /b/ survives while /c/ is evicted
+  // together with the paths below it
+  ASSERT_EQ(cache.lookup({"b"}, id, path), 1u);
+  cache.insert("/e/", eos::ContainerIdentifier(6), gen);
+  ASSERT_EQ(cache.size(), 3u);
+  ASSERT_EQ(cache.lookup({"c"}, id, path), 0u);
+  ASSERT_EQ(cache.lookup({"b"}, id, path), 1u);
+  ASSERT_EQ(cache.lookup({"e"}, id, path), 1u);
+  ASSERT_EQ(id, eos::ContainerIdentifier(6));
+}
@@ -25,6 +25,8 @@
 #include "qclient/QHash.hh"
 #include "Namespace.hh"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <thread>
 #include <vector>
 
 EOSNSTESTING_BEGIN
@@ -66,4 +68,51 @@ TEST_F(NextInodeProviderTest, BasicSanity)
   qcl->del("ns-tests-next-inode-provider");
 }
 
+TEST_F(NextInodeProviderTest, ConcurrentReserve)
+{
+  std::unique_ptr<qclient::QClient> qcl = createQClient();
+  qclient::QHash myhash;
+  myhash.setKey("ns-tests-next-inode-provider");
+  myhash.setClient(*qcl.get());
+  myhash.hdel("counter");
+  constexpr size_t numThreads = 8;
+  constexpr size_t perThread = 20000;
+  std::vector<std::vector<int64_t>> ids(numThreads);
+  {
+    NextInodeProvider inodeProvider;
+    inodeProvider.configure(myhash, "counter");
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < numThreads; i++) {
+      threads.emplace_back([&, i]() {
+        for (size_t j = 0; j < perThread; j++) {
+          ids[i].push_back(inodeProvider.reserve());
+        }
+      });
+    }
+
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+  // Every thread sees increasing ids and no id is handed out twice
+  std::vector<int64_t> all;
+
+  for (auto& vect : ids) {
+    ASSERT_TRUE(std::is_sorted(vect.begin(), vect.end()));
+    all.insert(all.end(), vect.begin(), vect.end());
+  }
+
+  std::sort(all.begin(), all.end());
+  ASSERT_EQ(all.size(), numThreads * perThread);
+  ASSERT_EQ(all[0], 1);
+  ASSERT_TRUE(std::adjacent_find(all.begin(), all.end()) == all.end());
+  // A new provider continues after everything reserved so far
+  NextInodeProvider inodeProvider;
+  inodeProvider.configure(myhash, "counter");
+  ASSERT_GT(inodeProvider.getFirstFreeId(), all.back());
+  ASSERT_GT(inodeProvider.reserve(), all.back());
+  qcl->del("ns-tests-next-inode-provider");
+}
+
 EOSNSTESTING_END
@@ -25,9 +25,13 @@
 #include "namespace/ns_quarkdb/ConfigurationParser.hh"
 #include "namespace/ns_quarkdb/QdbContactDetails.hh"
 #include "namespace/ns_quarkdb/LRU.hh"
+#include "namespace/ns_quarkdb/ShardedLRU.hh"
+#include "namespace/utils/CompactNameMap.hh"
+#include "namespace/utils/CompressedIdSet.hh"
 #include "namespace/utils/PathProcessor.hh"
 #include "namespace/utils/TestHelpers.hh"
 #include <gtest/gtest.h>
+#include <set>
 #include <sstream>
 
 //------------------------------------------------------------------------------
@@ -128,6 +132,377 @@ TEST(LRU, BasicSanity)
   ASSERT_TRUE(!cache.get(100));
 }
 
+TEST(LRU, SizeLimit)
+{
+  struct Entry {
+    explicit Entry(std::uint64_t id) : id_(id) {}
+
+    std::uint64_t
+    getId() const
+    {
+      return id_;
+    }
+
+    std::uint64_t id_;
+  };
+  std::uint64_t max_entries = 100;
+  eos::LRU<std::uint64_t, Entry> cache{1000};
+  cache.set_max_size(max_entries * sizeof(Entry));
+  ASSERT_EQ(max_entries * sizeof(Entry), cache.get_max_size());
+  // Keep a reference to the first entry which is never evicted
+  std::shared_ptr<Entry> pinned = std::make_shared<Entry>(0);
+  ASSERT_TRUE(cache.put(0, pinned));
+
+  for (std::uint64_t id = 1; id < 10 * max_entries; ++id) {
+    ASSERT_TRUE(cache.put(id, std::make_shared<Entry>(id)));
+    ASSERT_TRUE(cache.size_bytes() <= max_entries * sizeof(Entry));
+  }
+
+  ASSERT_EQ(cache.size() * sizeof(Entry), cache.size_bytes());
+  ASSERT_TRUE(cache.get(0));
+  ASSERT_TRUE(cache.get(10 * max_entries - 1));
+  // UINT64_MAX leaves the limit unchanged while 0 removes it
+  cache.set_max_size(UINT64_MAX);
+  ASSERT_EQ(max_entries * sizeof(Entry), cache.get_max_size());
+  cache.set_max_size(0);
+  ASSERT_EQ(UINT64_MAX, cache.get_max_size());
+  // Flush the cache, only the pinned entry survives
+  cache.set_max_num(UINT64_MAX);
+  ASSERT_EQ(1u, cache.size());
+  ASSERT_EQ(sizeof(Entry), cache.size_bytes());
+}
+
+TEST(ShardedLRU, BasicSanity)
+{
+  struct Entry {
+    explicit Entry(std::uint64_t id) : id_(id) {}
+
+    ~Entry() = default;
+
+    std::uint64_t
+    getId() const
+    {
+      return id_;
+    }
+
+    std::uint64_t id_;
+  };
+  std::uint64_t max_size = 1000;
+  std::uint64_t delta = 55;
+  // Use only one shard so that eviction is deterministic
+  eos::ShardedLRU<std::uint64_t, Entry> cache{max_size, 1};
+  ASSERT_EQ(1u, cache.get_num_shards());
+
+  // Fill completely the cache
+  for (std::uint64_t id = 0; id < max_size; ++id) {
+    ASSERT_TRUE(cache.put(id, std::make_shared<Entry>(id)));
+  }
+
+  ASSERT_EQ(max_size, cache.size());
+
+  // Access only the first half of the entries, they get a second chance
+  for (std::uint64_t id = 0; id < max_size / 2; ++id) {
+    ASSERT_TRUE(cache.get(id)->getId() == id);
+  }
+
+  // This triggers eviction of 100 elements not recently accessed
+  for (auto extra_id = max_size; extra_id < max_size + delta; ++extra_id) {
+    ASSERT_TRUE(cache.put(extra_id, std::make_shared<Entry>(extra_id)));
+  }
+
+  ASSERT_EQ((std::uint64_t)955, cache.size());
+
+  for (std::uint64_t id = 0; id < max_size / 2; ++id) {
+    ASSERT_TRUE(cache.get(id));
+  }
+
+  ASSERT_FALSE(cache.get(max_size / 2));
+  std::shared_ptr<Entry> elem = cache.get(999);
+  ASSERT_TRUE(elem);
+
+  // Add another max_size elements
+  for (std::uint64_t id = 2 * max_size; id < 3 * max_size; ++id) {
+    ASSERT_TRUE(cache.put(id, std::make_shared<Entry>(id)));
+  }
+
+  // Object 999 should still be in cache as we hold a reference to it
+  ASSERT_TRUE(cache.get(999));
+  ASSERT_TRUE(cache.remove(999));
+  ASSERT_FALSE(cache.get(999));
+  ASSERT_FALSE(cache.remove(999));
+  // Flush cache, only referenced objects survive
+  cache.set_max_num(UINT64_MAX);
+  ASSERT_EQ(0u, cache.size());
+  ASSERT_EQ(max_size, cache.get_max_num());
+  // Disable cache
+  cache.set_max_num(0);
+  ASSERT_EQ(0u, cache.get_max_num());
+  ASSERT_TRUE(cache.put(1, std::make_shared<Entry>(1)));
+  ASSERT_EQ(0u, cache.size());
+}
+
+TEST(ShardedLRU, MultipleShards)
+{
+  struct Entry {
+    explicit Entry(std::uint64_t id) : id_(id) {}
+
+    std::uint64_t
+    getId() const
+    {
+      return id_;
+    }
+
+    std::uint64_t id_;
+  };
+  std::uint64_t max_size = 10000;
+  eos::ShardedLRU<std::uint64_t, Entry> cache{max_size, 60};
+  ASSERT_EQ(64u, cache.get_num_shards());
+
+  for (std::uint64_t id = 0; id < 10 * max_size; ++id) {
+    ASSERT_TRUE(cache.put(id, std::make_shared<Entry>(id)));
+  }
+
+  ASSERT_TRUE(cache.size() <= max_size + cache.get_num_shards());
+  ASSERT_TRUE(cache.size() >= 0.8 * max_size);
+  ASSERT_TRUE(cache.get(10 * max_size - 1));
+}
+
+TEST(ShardedLRU, SizeLimit)
+{
+  struct Entry {
+    explicit Entry(std::uint64_t id) : id_(id) {}
+
+    std::uint64_t
+    getId() const
+    {
+      return id_;
+    }
+
+    std::uint64_t id_;
+  };
+  std::uint64_t max_entries = 100;
+  eos::ShardedLRU<std::uint64_t, Entry> cache{1000, 1};
+  cache.set_max_size(max_entries * sizeof(Entry));
+
+  for (std::uint64_t id = 0; id < 10 * max_entries; ++id) {
+    ASSERT_TRUE(cache.put(id, std::make_shared<Entry>(id)));
+    ASSERT_TRUE(cache.size_bytes() <= max_entries * sizeof(Entry));
+  }
+
+  ASSERT_EQ(cache.size() * sizeof(Entry), cache.size_bytes());
+  ASSERT_TRUE(cache.get(10 * max_entries - 1));
+}
+
+TEST(ShardedLRU, EvictBudget)
+{
+  struct Entry {
+    explicit Entry(std::uint64_t id) : id_(id) {}
+
+    std::uint64_t
+    getId() const
+    {
+      return id_;
+    }
+
+    std::uint64_t id_;
+  };
+  std::uint64_t max_size = 20000;
+  eos::ShardedLRU<std::uint64_t, Entry> cache{max_size, 1};
+
+  for (std::uint64_t id = 0; id < max_size; ++id) {
+    ASSERT_TRUE(cache.put(id, std::make_shared<Entry>(id)));
+  }
+
+  // All entries get a second chance so the first put only uses up its step
+  // budget clearing reference bits without evicting anything
+  for (std::uint64_t id = 0; id < max_size; ++id) {
+    ASSERT_TRUE(cache.get(id));
+  }
+
+  ASSERT_TRUE(cache.put(max_size, std::make_shared<Entry>(max_size)));
+  ASSERT_EQ(max_size + 1, cache.size());
+  // The next put continues from the clock hand and clears the rest of the
+  // bits, the one after that finally evicts
+  ASSERT_TRUE(cache.put(max_size + 1, std::make_shared<Entry>(max_size + 1)));
+  ASSERT_EQ(max_size + 2, cache.size());
+  ASSERT_TRUE(cache.put(max_size + 2, std::make_shared<Entry>(max_size + 2)));
+  ASSERT_TRUE(cache.size() <= max_size);
+  ASSERT_TRUE(cache.get(max_size + 2));
+}
+
+TEST(CompactNameMap, BasicSanity)
+{
+  eos::CompactNameMap<std::uint64_t> map;
+  ASSERT_TRUE(map.empty());
+  ASSERT_TRUE(map.find("abc") == map.end());
+  ASSERT_TRUE(map.insert(std::make_pair("abc", 1)).second);
+  ASSERT_FALSE(map.insert(std::make_pair("abc", 2)).second);
+  ASSERT_TRUE(map.insert(std::make_pair("", 3)).second);
+  ASSERT_TRUE(map.insert(std::make_pair(std::string(300, 'x'), 4)).second);
+  ASSERT_EQ(map.size(), 3u);
+  auto it = map.find("abc");
+  ASSERT_TRUE(it != map.end());
+  ASSERT_EQ(it->first, "abc");
+  ASSERT_EQ(it->second, 1u);
+  std::uint64_t id = 0;
+  ASSERT_TRUE(map.get(std::string(300, 'x'), id));
+  ASSERT_EQ(id, 4u);
+  ASSERT_TRUE(map.get("", id));
+  ASSERT_EQ(id, 3u);
+  ASSERT_FALSE(map.get("ab", id));
+  ASSERT_EQ(map.erase("abc"), 1u);
+  ASSERT_EQ(map.erase("abc"), 0u);
+  ASSERT_TRUE(map.find("abc") == map.end());
+  ASSERT_EQ(map.size(), 2u);
+  size_t count = 0;
+
+  for (auto iter = map.begin(); iter != map.end(); ++iter) {
+    count++;
+  }
+
+  ASSERT_EQ(count, 2u);
+  map.clear();
+  ASSERT_TRUE(map.empty());
+  ASSERT_TRUE(map.begin() == map.end());
+}
+
+TEST(CompactNameMap, MatchesReference)
+{
+  eos::CompactNameMap<std::uint64_t> map;
+  std::map<std::string, std::uint64_t> reference;
+
+  for (std::uint64_t i = 0; i < 20000; ++i) {
+    std::string name = "file-" + std::to_string((i * 7919) % 15000);
+
+    if (i % 3 == 0) {
+      ASSERT_EQ(map.erase(name), reference.erase(name));
+    } else {
+      ASSERT_EQ(map.insert(std::make_pair(name, i)).second,
+                reference.insert(std::make_pair(name, i)).second);
+    }
+  }
+
+  ASSERT_EQ(map.size(), reference.size());
+  map.compact();
+  std::map<std::string, std::uint64_t> contents(map.begin(), map.end());
+  ASSERT_EQ(contents, reference);
+
+  for (const auto& elem : reference) {
+    std::uint64_t id = 0;
+    ASSERT_TRUE(map.get(elem.first, id));
+    ASSERT_EQ(id, elem.second);
+  }
+}
+
+TEST(CompactNameMap, InsertOrAssign)
+{
+  eos::CompactNameMap<std::uint64_t> map;
+  ASSERT_EQ(map.count("abc"), 0u);
+  map.insert_or_assign("abc", 1);
+  ASSERT_EQ(map.count("abc"), 1u);
+  map.insert_or_assign("abc", 2);
+  ASSERT_EQ(map.size(), 1u);
+  ASSERT_EQ(map.find("abc")->second, 2u);
+  eos::CompactNameMap<std::uint64_t> other = std::move(map);
+  ASSERT_EQ(other.size(), 1u);
+  other.insert_or_assign("def", 3);
+  ASSERT_EQ(other.erase("abc"), 1u);
+  std::map<std::string, std::uint64_t> contents(other.begin(), other.end());
+  ASSERT_EQ(contents, (std::map<std::string, std::uint64_t> { {"def", 3} }));
+}
+
+TEST(CompactNameMap, EraseWhileIterating)
+{
+  eos::CompactNameMap<std::uint64_t> map;
+
+  for (std::uint64_t id = 0; id < 100; ++id) {
+    map.insert(std::make_pair("name" + std::to_string(id), id));
+  }
+
+  size_t capacity = map.getMemoryUsage();
+  size_t count = 0;
+
+  // Erasing the last entry keeps the table, the iterator still reaches end()
+  for (auto it = map.begin(); it != map.end();) {
+    map.erase(it++);
+    ++count;
+  }
+
+  ASSERT_EQ(count, 100u);
+  ASSERT_TRUE(map.empty());
+  ASSERT_TRUE(map.begin() == map.end());
+  ASSERT_EQ(capacity, map.getMemoryUsage());
+  ASSERT_TRUE(map.insert(std::make_pair("abc", 1)).second);
+  ASSERT_EQ(map.find("abc")->second, 1u);
+  ASSERT_EQ(map.size(), 1u);
+}
+
+TEST(CompressedIdSet, BasicSanity)
+{
+  eos::CompressedIdSet set;
+  ASSERT_TRUE(set.empty());
+  ASSERT_TRUE(set.begin() == set.end());
+  ASSERT_TRUE(set.find(5) == set.end());
+  ASSERT_TRUE(set.insert(5));
+  ASSERT_FALSE(set.insert(5));
+  ASSERT_TRUE(set.insert(0));
+  ASSERT_TRUE(set.insert(UINT64_MAX));
+  ASSERT_TRUE(set.insert(1ull << 40));
+  ASSERT_EQ(set.size(), 4u);
+  std::vector<std::uint64_t> contents(set.begin(), set.end());
+  ASSERT_EQ(contents, std::vector<std::uint64_t>({ 0, 5, 1ull << 40, UINT64_MAX }));
+  ASSERT_EQ(*set.find(1ull << 40), 1ull << 40);
+  ASSERT_EQ(*set.lower_bound(6), 1ull << 40);
+  ASSERT_EQ(*set.select(3), UINT64_MAX);
+  ASSERT_EQ(set.erase(5), 1u);
+  ASSERT_EQ(set.erase(5), 0u);
+  ASSERT_FALSE(set.contains(5));
+  ASSERT_TRUE(set.contains(0));
+
+  // Iteration continues after the current id when the set is modified
+  auto it = set.begin();
+  ASSERT_EQ(*it, 0u);
+  set.erase(0);
+  set.insert(7);
+  ++it;
+  ASSERT_EQ(*it, 7u);
+  set.clear();
+  ASSERT_TRUE(set.empty());
+  ASSERT_TRUE(set.begin() == set.end());
+}
+
+TEST(CompressedIdSet, MatchesReference)
+{
+  eos::CompressedIdSet set;
+  std::set<std::uint64_t> reference;
+
+  // Dense ranges switch blocks between array and bitmap representation
+  for (std::uint64_t i = 0; i < 400000; ++i) {
+    std::uint64_t id = (i * 7919) % 150000 + ((i % 5 == 0) ? (1ull << 33) : 0);
+
+    if (i % 3 == 0) {
+      ASSERT_EQ(set.erase(id), reference.erase(id));
+    } else {
+      ASSERT_EQ(set.insert(id), reference.insert(id).second);
+    }
+  }
+
+  ASSERT_EQ(set.size(), reference.size());
+  set.shrink();
+  ASSERT_TRUE(std::equal(reference.begin(), reference.end(), set.begin()));
+  size_t rank = 0;
+
+  for (auto id : reference) {
+    ASSERT_TRUE(set.contains(id));
+
+    if (rank++ % 1000 == 0) {
+      ASSERT_EQ(*set.select(rank - 1), id);
+    }
+  }
+
+  ASSERT_LT(set.getMemoryUsage(), reference.size() * 4);
+}
+
 TEST(PathProcessor, AbsPathTest)
 {
   std::string path = "/a/b/c/d/";
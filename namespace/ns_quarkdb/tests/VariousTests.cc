@@ -31,7 +31,11 @@
 #include "namespace/ns_quarkdb/persistency/RequestBuilder.hh"
 #include "namespace/ns_quarkdb/views/HierarchicalView.hh"
 #include "namespace/ns_quarkdb_static/accounting/FileSystemView.hh"
+#include "namespace/ns_quarkdb_static/accounting/ContainerAccounting.hh"
+#include "namespace/ns_quarkdb_static/accounting/SyncTimeAccounting.hh"
 #include "namespace/ns_quarkdb_static/flusher/MetadataFlusher.hh"
+#include "namespace/ns_quarkdb/accounting/QuotaStats.hh"
+#include "namespace/ns_quarkdb/Constants.hh"
 #include "namespace/ns_quarkdb/FileMD.hh"
 #include "namespace/ns_quarkdb/ContainerMD.hh"
 #include "namespace/common/QuotaNodeCore.hh"
@@ -403,6 +407,257 @@ TEST_F(VariousTests, createContainerMadness) {
   view()->getContainer("/eos/dev/my-dir-3/my-dir-4/what-am-i-doing/bbbbbbb/chicken");
 }
 
+TEST_F(VariousTests, CacheTypeAfterInitialize) {
+  // The caches are accessed without locks once the namespace is initialized,
+  // their type can no longer be changed
+  std::map<std::string, std::string> config {{constants::sCacheTypeFiles, "lru"}};
+  fileSvc()->configure(config);
+  config[constants::sCacheTypeFiles] = "sharded-lru";
+  ASSERT_THROW(fileSvc()->configure(config), MDException);
+  config = {{constants::sCacheTypeDirs, "sharded-lru"}};
+  containerSvc()->configure(config);
+  ASSERT_THROW(containerSvc()->initialize(), MDException);
+}
+
+TEST_F(VariousTests, ContainerAccounting) {
+  eos::common::RWMutex ns_mutex;
+  eos::QuarkContainerAccounting accounting(containerSvc(), &ns_mutex, 0);
+  IContainerMDPtr root = view()->getContainer("/");
+  IContainerMDPtr top = view()->createContainer("/eos/", true);
+  IContainerMDPtr a = view()->createContainer("/eos/a/", true);
+  IContainerMDPtr b = view()->createContainer("/eos/a/b/", true);
+  IContainerMDPtr c = view()->createContainer("/eos/a/b/c/", true);
+  IContainerMDPtr d = view()->createContainer("/eos/d/", true);
+  uint64_t root_size = root->getTreeSize();
+
+  for (int i = 0; i < 1000; ++i) {
+    accounting.QueueForUpdate(c->getId(), 10);
+    accounting.QueueForUpdate(b->getId(), 1);
+  }
+
+  accounting.QueueForUpdate(d->getId(), 7);
+  accounting.QueueForUpdate(a->getId(), 100);
+  accounting.QueueForUpdate(a->getId(), -50);
+  accounting.PropagateUpdates();
+
+  ASSERT_EQ(c->getTreeSize(), 10000u);
+  ASSERT_EQ(b->getTreeSize(), 11000u);
+  ASSERT_EQ(a->getTreeSize(), 11050u);
+  ASSERT_EQ(d->getTreeSize(), 7u);
+  ASSERT_EQ(top->getTreeSize(), 11057u);
+  ASSERT_EQ(root->getTreeSize(), root_size);
+
+  // Every ancestor is updated once, no matter how many updates it received
+  eos::QuarkContainerAccounting::Statistics stats = accounting.GetStatistics();
+  ASSERT_EQ(stats.batches, 1u);
+  ASSERT_EQ(stats.lastQueued, 4u);
+  ASSERT_EQ(stats.lastUpdated, 5u);
+
+  // Deltas cancelling out within a batch don't touch the containers
+  accounting.QueueForUpdate(c->getId(), 5);
+  accounting.QueueForUpdate(c->getId(), -5);
+  accounting.PropagateUpdates();
+  ASSERT_EQ(c->getTreeSize(), 10000u);
+  ASSERT_EQ(accounting.GetStatistics().lastUpdated, 0u);
+}
+
+//------------------------------------------------------------------------------
+// Quota size mapper accounting the logical size of the files
+//------------------------------------------------------------------------------
+static uint64_t
+quotaSizeMapper(const eos::IFileMD* file)
+{
+  return file->getSize();
+}
+
+TEST_F(VariousTests, QuotaWriteCombining) {
+  setSizeMapper(quotaSizeMapper);
+  IContainerMDPtr cont = view()->createContainer("/eos/quota/", true);
+  eos::IQuotaNode* node = view()->registerQuotaNode(cont.get());
+  eos::QuotaStats* stats = dynamic_cast<eos::QuotaStats*>(view()->getQuotaStats());
+  ASSERT_TRUE(stats);
+  stats->flush();
+  eos::QuotaStats::Statistics before = stats->getStatistics();
+
+  for (int i = 0; i < 100; ++i) {
+    IFileMDPtr file = view()->createFile(SSTR("/eos/quota/file-" << i));
+    file->setCUid(i % 2 + 1);
+    file->setCGid(7);
+    file->setSize(10);
+    node->addFile(file.get());
+  }
+
+  // A file added and removed again doesn't reach the backend at all
+  IFileMDPtr tmp = view()->createFile("/eos/quota/tmp");
+  tmp->setCUid(5);
+  tmp->setCGid(5);
+  tmp->setSize(1000);
+  node->addFile(tmp.get());
+  node->removeFile(tmp.get());
+
+  // All updates of the node are combined into a single request
+  stats->flush();
+  eos::QuotaStats::Statistics after = stats->getStatistics();
+  ASSERT_EQ(after.updates - before.updates, 102u);
+  ASSERT_EQ(after.requests - before.requests, 1u);
+  ASSERT_EQ(after.pendingNodes, 0u);
+
+  shut_down_everything();
+  node = view()->getQuotaNode(view()->getContainer("/eos/quota/").get());
+  ASSERT_TRUE(node);
+  ASSERT_EQ(node->getNumFilesByUser(1), 50u);
+  ASSERT_EQ(node->getNumFilesByUser(2), 50u);
+  ASSERT_EQ(node->getNumFilesByUser(5), 0u);
+  ASSERT_EQ(node->getUsedSpaceByGroup(7), 1000u);
+  ASSERT_EQ(node->getNumFilesByGroup(7), 100u);
+  ASSERT_EQ(node->getNumFilesByGroup(5), 0u);
+}
+
+TEST_F(VariousTests, QuotaJournalReplay) {
+  // Standalone quota stats with their own flusher and journal, never flushing
+  // on their own while the test runs
+  std::map<std::string, std::string> config = {
+    {"qdb_cluster", "localhost:9999"},
+    {"qdb_password", "turtles_turtles_turtles_turtles_turtles"},
+    {"qdb_flusher_quota", "tests_quota_journal"},
+    {"quota_flush_interval_ms", "3600000"}
+  };
+  const std::string journal = "/tmp/eos-ns-tests/tests_quota_journal.deltas";
+  const std::string backup = journal + ".backup";
+  IContainerMDPtr cont = view()->createContainer("/eos/journal/", true);
+  const std::string snode_id = std::to_string(cont->getId());
+  {
+    eos::QuotaStats stats;
+    stats.configure(config);
+    stats.registerSizeMapper(quotaSizeMapper);
+    eos::IQuotaNode* node = stats.registerNewNode(cont->getId());
+
+    for (int i = 0; i < 10; ++i) {
+      IFileMDPtr file = view()->createFile(SSTR("/eos/journal/file-" << i));
+      file->setCUid(3);
+      file->setCGid(4);
+      file->setSize(100);
+      node->addFile(file.get());
+    }
+
+    ASSERT_EQ(stats.getStatistics().pendingNodes, 1u);
+    ASSERT_EQ(system(SSTR("cp " << journal << " " << backup).c_str()), 0);
+  }
+  // Crash after pushing the deltas to the flusher, before truncating the
+  // journal: nothing is replayed
+  ASSERT_EQ(system(SSTR("cp " << backup << " " << journal).c_str()), 0);
+  {
+    eos::QuotaStats stats;
+    stats.configure(config);
+    ASSERT_EQ(stats.getStatistics().replayed, 0u);
+    eos::IQuotaNode* node = stats.getQuotaNode(cont->getId());
+    ASSERT_TRUE(node);
+    ASSERT_EQ(node->getNumFilesByUser(3), 10u);
+    ASSERT_EQ(node->getUsedSpaceByGroup(4), 1000u);
+  }
+  // Crash before pushing the deltas to the flusher: take the backend back to
+  // the state before the push, the deltas are replayed from the journal
+  eos::MetadataFlusherFactory::getInstance("tests_quota_journal",
+      getContactDetails())->synchronize();
+  qcl().exec("DEL", eos::quota::sPrefix + snode_id + ":" +
+             eos::quota::sUidsSuffix).get();
+  qcl().exec("DEL", eos::quota::sPrefix + snode_id + ":" +
+             eos::quota::sGidsSuffix).get();
+  qcl().exec("HINCRBY", eos::quota::sFlushedBatchesKey, "tests_quota_journal",
+             "-1").get();
+  ASSERT_EQ(system(SSTR("cp " << backup << " " << journal).c_str()), 0);
+  {
+    eos::QuotaStats stats;
+    stats.configure(config);
+    ASSERT_EQ(stats.getStatistics().replayed, 10u);
+  }
+  eos::QuotaStats stats;
+  stats.configure(config);
+  eos::IQuotaNode* node = stats.getQuotaNode(cont->getId());
+  ASSERT_TRUE(node);
+  ASSERT_EQ(node->getNumFilesByUser(3), 10u);
+  ASSERT_EQ(node->getNumFilesByGroup(4), 10u);
+  ASSERT_EQ(node->getUsedSpaceByUser(3), 1000u);
+}
+
+TEST_F(VariousTests, QuotaInvalidFlushInterval) {
+  for (const std::string interval : {"", "abc", "10ms", "-1", "99999999999"}) {
+    std::map<std::string, std::string> config = {
+      {"qdb_cluster", "localhost:9999"},
+      {"qdb_password", "turtles_turtles_turtles_turtles_turtles"},
+      {"qdb_flusher_quota", "tests_quota_invalid"},
+      {"quota_flush_interval_ms", interval}
+    };
+    eos::QuotaStats stats;
+    ASSERT_THROW(stats.configure(config), eos::MDException) << interval;
+  }
+}
+
+TEST_F(VariousTests, SyncTimeAccounting) {
+  eos::common::RWMutex ns_mutex;
+  eos::QuarkSyncTimeAccounting accounting(containerSvc(), &ns_mutex, 0);
+  IContainerMDPtr top = view()->createContainer("/eos/", true);
+  IContainerMDPtr a = view()->createContainer("/eos/a/", true);
+  IContainerMDPtr b = view()->createContainer("/eos/a/b/", true);
+  IContainerMDPtr c = view()->createContainer("/eos/a/c/", true);
+  IContainerMDPtr d = view()->createContainer("/eos/a/b/d/", true);
+
+  for (auto cont : {top, a, b, c, d}) {
+    cont->setAttribute("sys.mtime.propagation", "1");
+    cont->setMTime({100, 0});
+    cont->setTMTime({100, 0});
+  }
+
+  c->setMTime({300, 0});
+  d->setMTime({200, 0});
+  accounting.QueueForUpdate(d->getId());
+  accounting.QueueForUpdate(c->getId());
+  accounting.PropagateUpdates();
+
+  // Every ancestor ends up with the most recent time of its subtree
+  IContainerMD::tmtime_t tmtime;
+  d->getTMTime(tmtime);
+  ASSERT_EQ(tmtime.tv_sec, 200);
+  b->getTMTime(tmtime);
+  ASSERT_EQ(tmtime.tv_sec, 200);
+  c->getTMTime(tmtime);
+  ASSERT_EQ(tmtime.tv_sec, 300);
+  a->getTMTime(tmtime);
+  ASSERT_EQ(tmtime.tv_sec, 300);
+  top->getTMTime(tmtime);
+  ASSERT_EQ(tmtime.tv_sec, 300);
+
+  // Both paths are merged at /eos/a/ so each container is updated only once
+  eos::QuarkSyncTimeAccounting::Statistics stats = accounting.GetStatistics();
+  ASSERT_EQ(stats.batches, 1u);
+  ASSERT_EQ(stats.lastQueued, 2u);
+  ASSERT_EQ(stats.lastUpdated, 5u);
+  ASSERT_EQ(stats.merged, 1u);
+  ASSERT_EQ(stats.lastSkipped, 0u);
+
+  // An older update stops at the first ancestor with a newer sync time
+  d->setMTime({250, 0});
+  accounting.QueueForUpdate(d->getId());
+  accounting.PropagateUpdates();
+  b->getTMTime(tmtime);
+  ASSERT_EQ(tmtime.tv_sec, 250);
+  a->getTMTime(tmtime);
+  ASSERT_EQ(tmtime.tv_sec, 300);
+  stats = accounting.GetStatistics();
+  ASSERT_EQ(stats.lastUpdated, 2u);
+  ASSERT_EQ(stats.lastSkipped, 1u);
+
+  // Containers without the propagation attribute stop the propagation
+  top->removeAttribute("sys.mtime.propagation");
+  c->setMTime({400, 0});
+  accounting.QueueForUpdate(c->getId());
+  accounting.PropagateUpdates();
+  a->getTMTime(tmtime);
+  ASSERT_EQ(tmtime.tv_sec, 400);
+  top->getTMTime(tmtime);
+  ASSERT_EQ(tmtime.tv_sec, 300);
+}
+
 TEST_F(VariousTests, ChecksumFormatting) {
   std::shared_ptr<eos::IContainerMD> root = view()->getContainer("/");
   ASSERT_EQ(root->getId(), 1);
@@ -604,6 +859,36 @@ TEST_F(FileMDFetching, CorruptionTest) {
   }
 }
 
+TEST_F(FileMDFetching, LookupCounters) {
+  std::shared_ptr<eos::IFileMD> file1 = view()->createFile("/my-file.txt", true);
+  ASSERT_EQ(file1->getId(), 1);
+  file1.reset();
+  shut_down_everything();
+
+  // Concurrent misses for the same id share a single backend fetch
+  CacheStatistics before = fileSvc()->getCacheStatistics();
+  folly::Future<IFileMDPtr> fut1 = fileSvc()->getFileMDFut(1);
+  folly::Future<IFileMDPtr> fut2 = fileSvc()->getFileMDFut(1);
+  ASSERT_EQ(fut1.get(), fut2.get());
+  CacheStatistics after = fileSvc()->getCacheStatistics();
+  ASSERT_EQ(after.misses - before.misses, 1u);
+  // The fetch may have completed before the second lookup
+  ASSERT_EQ((after.coalesced - before.coalesced) + (after.hits - before.hits),
+            1u);
+
+  // Lookups of cached entries are hits
+  ASSERT_EQ(fileSvc()->getFileMD(1)->getId(), 1u);
+  CacheStatistics cached = fileSvc()->getCacheStatistics();
+  ASSERT_EQ(cached.hits - after.hits, 1u);
+  ASSERT_EQ(cached.misses, after.misses);
+  ASSERT_EQ(cached.coalesced, after.coalesced);
+
+  // Lookups of missing entries are misses, the failure is not cached
+  ASSERT_THROW(fileSvc()->getFileMDFut(2).get(), MDException);
+  ASSERT_THROW(fileSvc()->getFileMDFut(2).get(), MDException);
+  ASSERT_EQ(fileSvc()->getCacheStatistics().misses - cached.misses, 2u);
+}
+
 TEST_F(NamespaceExplorerF, BasicSanity) {
   populateDummyData1();
 
@@ -673,6 +958,73 @@ TEST_F(NamespaceExplorerF, BasicSanity) {
   ASSERT_FALSE(explorer2.fetch(item));
 }
 
+TEST_F(NamespaceExplorerF, ParallelMatchesSequential) {
+  populateDummyData1();
+
+  ExplorationOptions options;
+  options.depthLimit = 999;
+  std::vector<std::string> expected;
+  NamespaceItem item;
+
+  NamespaceExplorer explorer("/", options, qcl());
+  while(explorer.fetch(item)) {
+    expected.emplace_back(item.fullPath);
+  }
+
+  ASSERT_FALSE(expected.empty());
+
+  for(size_t inFlight : {1, 3, 1000}) {
+    options.maxContainersInFlight = inFlight;
+    options.maxFilesInFlight = inFlight;
+    std::vector<std::string> results;
+
+    NamespaceExplorer explorer2("/", options, qcl());
+    while(explorer2.fetch(item)) {
+      results.emplace_back(item.fullPath);
+    }
+
+    ASSERT_EQ(results, expected);
+  }
+}
+
+TEST_F(NamespaceExplorerF, PrefetchStaysBounded) {
+  for(size_t i = 0; i < 200; i++) {
+    std::string dir = SSTR("/wide/d" << i);
+    view()->createContainer(dir, true);
+    view()->createFile(SSTR(dir << "/f1"), true);
+    view()->createContainer(SSTR(dir << "/sub"), true);
+  }
+
+  mdFlusher()->synchronize();
+
+  ExplorationOptions options;
+  options.depthLimit = 999;
+  std::vector<std::string> expected;
+  NamespaceItem item;
+
+  NamespaceExplorer explorer("/", options, qcl());
+  while(explorer.fetch(item)) {
+    expected.emplace_back(item.fullPath);
+  }
+
+  ASSERT_EQ(expected.size(), 602u);
+
+  options.maxContainersInFlight = 10;
+  std::vector<std::string> results;
+
+  NamespaceExplorer explorer2("/", options, qcl());
+  while(explorer2.fetch(item)) {
+    results.emplace_back(item.fullPath);
+  }
+
+  ASSERT_EQ(results, expected);
+
+  // The wide directory is still prefetched, but never beyond the limit plus
+  // the container the search visits next
+  ASSERT_GE(explorer2.getPeakContainersInFlight(), 2u);
+  ASSERT_LE(explorer2.getPeakContainersInFlight(), 11u);
+}
+
 TEST_F(NamespaceExplorerF, LinkedAttributes) {
   std::shared_ptr<eos::IContainerMD> root = view()->getContainer("/");
   ASSERT_EQ(root->getId(), 1);
@@ -21,23 +21,167 @@
 #include "common/Parallel.hh"
 #include "namespace/Constants.hh"
 #include "namespace/ns_in_memory/persistency/ChangeLogConstants.hh"
+#include "namespace/ns_in_memory/persistency/ChangeLogSnapshot.hh"
+#include "namespace/ns_in_memory/persistency/ParallelBoot.hh"
 #include "namespace/ns_quarkdb_static/accounting/FileSystemView.hh"
 #include "namespace/ns_quarkdb/persistency/RequestBuilder.hh"
 #include "namespace/ns_quarkdb/QdbContactDetails.hh"
 #include "namespace/utils/StringConvertion.hh"
 #include "namespace/utils/DataHelper.hh"
 #include "google/protobuf/io/zero_copy_stream_impl.h"
+#include <cstdio>
+#include <sstream>
+#include <unistd.h>
 
 // Static global variable
 static std::string sBkndHost;
 static std::int32_t sBkndPort;
-static long long int sAsyncBatch = 1023;
 static qclient::QClient* sQcl;
 static qclient::AsyncHandler sAh;
 static size_t sThreads = 1;
+//! Maximum number of in-flight requests per conversion thread
+static uint64_t sInflight = 1024;
+//! Number of files/containers committed as one unit of the checkpoint
+static constexpr size_t sChunkSize = 65536;
+static eos::ConvertCheckpoint sCheckpoint;
+
+//------------------------------------------------------------------------------
+// Create a backend client for one of the conversion threads
+//------------------------------------------------------------------------------
+static std::unique_ptr<qclient::QClient>
+CreateQClient()
+{
+  qclient::Options opts;
+  opts.transparentRedirects = true;
+  opts.retryStrategy = qclient::RetryStrategy::NoRetries();
+  return std::unique_ptr<qclient::QClient>(new qclient::QClient(
+        qclient::Members(sBkndHost, sBkndPort), std::move(opts)));
+}
+
+//------------------------------------------------------------------------------
+// Wait for all in-flight requests, terminate on backend errors
+//------------------------------------------------------------------------------
+static void
+WaitForBackend(qclient::AsyncHandler& ah, const char* func)
+{
+  if (!ah.Wait()) {
+    std::cerr << func << " Got error response from the backend" << std::endl;
+    std::terminate();
+  }
+}
 
 EOSNSNAMESPACE_BEGIN
 
+//------------------------------------------------------------------------------
+//           ************* ConvertCheckpoint Class ************
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Destructor
+//------------------------------------------------------------------------------
+ConvertCheckpoint::~ConvertCheckpoint()
+{
+  if (mFile) {
+    fclose(mFile);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Open the checkpoint file
+//------------------------------------------------------------------------------
+size_t
+ConvertCheckpoint::open(const std::string& path, const std::string& identity)
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  mPath = path;
+  mDone.clear();
+  bool valid = false;
+  FILE* in = fopen(path.c_str(), "r");
+
+  if (in) {
+    char* line = nullptr;
+    size_t len = 0;
+    ssize_t nread = getline(&line, &len, in);
+    valid = ((nread > 0) && (std::string(line, nread) == identity + "\n"));
+
+    while (valid && ((nread = getline(&line, &len, in)) > 0)) {
+      // A record is only valid if completely written
+      std::istringstream iss(std::string(line, nread));
+      std::string phase, status;
+      uint64_t chunk;
+
+      if ((iss >> phase >> chunk >> status) && (status == "ok")) {
+        mDone.emplace(phase, chunk);
+      }
+    }
+
+    free(line);
+    fclose(in);
+
+    if (!valid) {
+      std::cerr << "Ignoring checkpoint " << path << " written for different "
+                << "changelogs" << std::endl;
+    }
+  }
+
+  mFile = fopen(path.c_str(), valid ? "a" : "w");
+
+  if (mFile == nullptr) {
+    MDException e(errno);
+    e.getMessage() << "Failed to open checkpoint file " << path;
+    throw e;
+  }
+
+  if (!valid) {
+    fprintf(mFile, "%s\n", identity.c_str());
+    fflush(mFile);
+    fsync(fileno(mFile));
+  }
+
+  return mDone.size();
+}
+
+//------------------------------------------------------------------------------
+// Check if the given unit was already committed
+//------------------------------------------------------------------------------
+bool
+ConvertCheckpoint::isDone(const std::string& phase, uint64_t chunk)
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  return (mDone.count(std::make_pair(phase, chunk)) != 0);
+}
+
+//------------------------------------------------------------------------------
+// Record the given unit as committed
+//------------------------------------------------------------------------------
+void
+ConvertCheckpoint::markDone(const std::string& phase, uint64_t chunk)
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  mDone.emplace(phase, chunk);
+
+  if (mFile) {
+    fprintf(mFile, "%s %lu ok\n", phase.c_str(), chunk);
+    fflush(mFile);
+    fsync(fileno(mFile));
+  }
+}
+
+//------------------------------------------------------------------------------
+// Remove the checkpoint once the conversion is complete
+//------------------------------------------------------------------------------
+void
+ConvertCheckpoint::remove()
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (mFile) {
+    fclose(mFile);
+    mFile = nullptr;
+    unlink(mPath.c_str());
+  }
+}
+
 //------------------------------------------------------------------------------
 //           ************* ConvertFileMD Class ************
 //------------------------------------------------------------------------------
@@ -55,6 +199,9 @@ ConvertFileMD::ConvertFileMD(IFileMD::id_t id, IFileMDSvc* fileMDSvc):
 void
 ConvertFileMD::updateInternal()
 {
+  ctime_t ctime, mtime;
+  getCTime(ctime);
+  getMTime(mtime);
   mFile.set_id(pId);
   mFile.set_cont_id(pContainerId);
   mFile.set_uid(pCUid);
@@ -62,22 +209,24 @@ ConvertFileMD::updateInternal()
   mFile.set_size(pSize);
   mFile.set_layout_id(pLayoutId);
   mFile.set_flags(pFlags);
-  mFile.set_name(pName);
-  mFile.set_link_name(pLinkName);
-  mFile.set_ctime(&pCTime, sizeof(pCTime));
-  mFile.set_mtime(&pMTime, sizeof(pMTime));
-  mFile.set_checksum(pChecksum.getDataPtr(), pChecksum.getSize());
-
-  for (const auto& loc : pLocation) {
-    mFile.add_locations(loc);
+  mFile.set_name(getName());
+  mFile.set_link_name(getLink());
+  mFile.set_ctime(&ctime, sizeof(ctime));
+  mFile.set_mtime(&mtime, sizeof(mtime));
+  mFile.set_checksum(getChecksumPtr(), pChecksumSize);
+
+  for (size_t i = 0; i < pLocations.numLinked(); ++i) {
+    mFile.add_locations(pLocations.linked(i));
   }
 
-  for (const auto& unlinked : pUnlinkedLocation) {
-    mFile.add_unlink_locations(unlinked);
+  for (size_t i = 0; i < pLocations.numUnlinked(); ++i) {
+    mFile.add_unlink_locations(pLocations.unlinked(i));
   }
 
-  for (const auto& xattr : pXAttrs) {
-    (*mFile.mutable_xattrs())[xattr.first] = xattr.second;
+  if (pExtra) {
+    for (const auto& xattr : pExtra->mXAttrs) {
+      (*mFile.mutable_xattrs())[xattr.first] = xattr.second;
+    }
   }
 }
 
@@ -467,30 +616,33 @@ ConvertContainerMDSvc::recreateContainer(IdMap::iterator& it,
 void
 ConvertContainerMDSvc::commitToBackend()
 {
-  std::uint64_t total = pIdMap.size();
-  int nthreads = sThreads;
-  int chunk = total / nthreads;
-  int last_chunk = chunk + total - (chunk * nthreads);
-  // Parallel loop
-  eos::common::Parallel::For(0, nthreads, [&](int i) {
-    std::int64_t count = 0;
+  unsigned nthreads = sThreads;
+  std::vector<std::unique_ptr<qclient::QClient>> clients(nthreads);
+  BootPhase phase("commit ", "containers", pIdMap.size(), nthreads);
+  ForEachChunk(pIdMap, nthreads, sChunkSize, [&](size_t chunk,
+               IdMap::iterator begin, IdMap::iterator end, unsigned i) {
+    // Chunk committed by a previous run
+    if (sCheckpoint.isDone("containers", chunk)) {
+      for (auto it = begin; it != end; ++it) {
+        phase.tick();
+      }
+
+      return;
+    }
+
+    if (!clients[i]) {
+      clients[i] = CreateQClient();
+    }
+
+    qclient::QClient& qclient = *clients[i];
     qclient::AsyncHandler ah;
-    eos::ConvertContainerMD* conv_cont = nullptr;
-    std::shared_ptr<IContainerMD> container;
-    IdMap::iterator it = pIdMap.begin();
-    std::advance(it, i * chunk);
-    qclient::Options opts;
-    opts.transparentRedirects = true;
-    opts.retryStrategy = qclient::RetryStrategy::NoRetries();
-    qclient::QClient qclient(qclient::Members(sBkndHost, sBkndPort),
-                             std::move(opts));
-    int max_elem = (i == (nthreads - 1) ? last_chunk : chunk);
+    uint64_t inflight = 0;
 
-    for (int n = 0; n < max_elem; ++n) {
-      ++count;
-      container = it->second.ptr;
-      conv_cont = dynamic_cast<eos::ConvertContainerMD*>(container.get());
-      ++it;
+    for (auto it = begin; it != end; ++it) {
+      phase.tick();
+      std::shared_ptr<IContainerMD> container = it->second.ptr;
+      eos::ConvertContainerMD* conv_cont =
+        dynamic_cast<eos::ConvertContainerMD*>(container.get());
 
       if (conv_cont == nullptr) {
         std::cerr << "Skipping null container id: " << it->first << std::endl;
@@ -518,15 +670,9 @@ ConvertContainerMDSvc::commitToBackend()
           conv_cont->commitFiles(ah, qclient);
         }
 
-        if ((count & sAsyncBatch) == 0) {
-          if (!ah.Wait()) {
-            std::cerr << __FUNCTION__ << " Got error response from the backend"
-                      << std::endl;
-            std::terminate();
-          }
-
-          std::cout << "Processed " << count << "/" << total << " directories "
-                    << std::endl;
+        if (++inflight >= sInflight) {
+          WaitForBackend(ah, __FUNCTION__);
+          inflight = 0;
         }
       } catch (const std::runtime_error& qdb_err) {
         MDException e(ENOENT);
@@ -536,13 +682,11 @@ ConvertContainerMDSvc::commitToBackend()
       }
     }
 
-    // Wait for any other replies
-    if (!ah.Wait()) {
-      std::cerr << __FUNCTION__
-                << "ERROR: Failed to commit to backend" << std::endl;
-      std::terminate();
-    }
+    // Wait for any other replies before recording the chunk as committed
+    WaitForBackend(ah, __FUNCTION__);
+    sCheckpoint.markDone("containers", chunk);
   });
+  phase.finish();
 }
 
 
@@ -595,40 +739,39 @@ ConvertFileMDSvc::initialize()
   pFollowStart = pChangeLog->getFirstOffset();
   FileMDScanner scanner(pIdMap, pSlaveMode);
   pFollowStart = pChangeLog->scanAllRecords(&scanner);
-  std::uint64_t total = pIdMap.size();
-  int nthreads = sThreads;
-  int chunk = total / nthreads;
-  int last_chunk = chunk + pIdMap.size() - (chunk * nthreads);
-  auto start = std::time(nullptr);
+  unsigned nthreads = sThreads;
   std::mutex mutex_lost_found;
   mFirstFreeId = scanner.getLargestId() + 1;
+  std::vector<std::unique_ptr<qclient::QClient>> clients(nthreads);
+  uint64_t count = 0;
+  BootPhase phase("convert ", "files", pIdMap.size(), nthreads);
   // Recreate the files
-  eos::common::Parallel::For(0, nthreads, [&](int i) noexcept {
-    std::int64_t count = 0;
-    IdMap::iterator it = pIdMap.begin();
-    std::advance(it, i * chunk);
-    qclient::AsyncHandler ah;
-    qclient::Options opts;
-    opts.transparentRedirects = true;
-    opts.retryStrategy = qclient::RetryStrategy::NoRetries();
-    qclient::QClient qclient(qclient::Members(sBkndHost, sBkndPort),
-                             std::move(opts));
-    int max_elem = ((i == (nthreads - 1) ? last_chunk : chunk));
-
-    for (int n = 0; n < max_elem; ++n) {
-      ++count;
+  ForEachChunk(pIdMap, nthreads, sChunkSize, [&](size_t chunk,
+               IdMap::iterator begin, IdMap::iterator end, unsigned i) {
+    // Files of a chunk committed by a previous run still need to be attached
+    // and accounted, only the backend writes are skipped
+    bool commit = !sCheckpoint.isDone("files", chunk);
+
+    if (!clients[i]) {
+      clients[i] = CreateQClient();
+    }
 
-      if ((count & sAsyncBatch) == 0) {
-        if (!ah.Wait()) {
-          std::cerr << __FUNCTION__ << " Got error response from the backend"
-                    << std::endl;
-          std::terminate();
+    qclient::QClient& qclient = *clients[i];
+    qclient::AsyncHandler ah;
+    uint64_t inflight = 0;
+    auto add_to_qdb = [&](IFileMD * file) {
+      if (commit) {
+        addFileToQdb(static_cast<ConvertFileMD*>(file), ah, qclient);
+
+        if (++inflight >= sInflight) {
+          WaitForBackend(ah, "ConvertFileMDSvc::initialize");
+          inflight = 0;
         }
-
-        std::cout << "Tid: " << std::this_thread::get_id() << " processed "
-                  << count << "/" << max_elem << " files " << std::endl;
       }
+    };
 
+    for (auto it = begin; it != end; ++it) {
+      phase.tick();
       // Unpack the serialized buffers
       std::shared_ptr<IFileMD> file = std::make_shared<ConvertFileMD>(0, this);
 
@@ -641,7 +784,6 @@ ConvertFileMDSvc::initialize()
         std::terminate();
       }
 
-      ++it;
       std::shared_ptr<IContainerMD> cont = nullptr;
 
       try {
@@ -653,7 +795,7 @@ ConvertFileMDSvc::initialize()
       if (!cont || (file->getContainerId() == 0)) {
         std::lock_guard<std::mutex> lock(mutex_lost_found);
         attachBroken("orphans", file.get());
-        addFileToQdb((ConvertFileMD*)file.get(), ah, qclient);
+        add_to_qdb(file.get());
         continue;
       }
 
@@ -667,11 +809,11 @@ ConvertFileMDSvc::initialize()
         mtx->unlock();
         std::lock_guard<std::mutex> lock(mutex_lost_found);
         attachBroken("name_conflicts", file.get());
-        addFileToQdb((ConvertFileMD*)file.get(), ah, qclient);
+        add_to_qdb(file.get());
       } else {
         cont->addFile(file.get());
         mtx->unlock();
-        addFileToQdb((ConvertFileMD*)file.get(), ah, qclient);
+        add_to_qdb(file.get());
         // Populate the FileSystemView and QuotaView
         mConvQView->addQuotaInfo(file.get());
         mConvFsView->addFileInfo(file.get());
@@ -682,7 +824,7 @@ ConvertFileMDSvc::initialize()
           mContAcc->QueueForUpdate(file->getContainerId(), file->getSize());
 
           // Update every 100k files from thread 0 only
-          if ((count % 100000 == 0) && (i == 0)) {
+          if ((i == 0) && (++count % 100000 == 0)) {
             mSyncTimeAcc->PropagateUpdates();
             mContAcc->PropagateUpdates();
           }
@@ -690,27 +832,17 @@ ConvertFileMDSvc::initialize()
       }
     }
 
-    // wait for any other replies
-    if (!ah.Wait()) {
-      std::cerr << "ERROR: Failed to commit to backend" << std::endl;
-      std::terminate();
+    // Wait for any other replies before recording the chunk as committed
+    WaitForBackend(ah, "ConvertFileMDSvc::initialize");
+
+    if (commit) {
+      sCheckpoint.markDone("files", chunk);
     }
   });
   // Propagate any remaining updates
   mSyncTimeAcc->PropagateUpdates();
   mContAcc->PropagateUpdates();
-  // Get the rate
-  auto finish = std::time(nullptr);
-
-  if (finish != (std::time_t)(-1)) {
-    std::chrono::seconds duration(finish - start);
-
-    if (duration.count()) {
-      double rate = (double)total / duration.count();
-      std::cout << "Processed files at " << rate << " Hz" << std::endl;
-    }
-  }
-
+  phase.finish();
   pIdMap.clear();
 }
 
@@ -1072,6 +1204,13 @@ usage()
             << "    dir_chlog  - directory changelog              " << std::endl
             << "    bknd_host  - Backend host destination         " << std::endl
             << "    bknd_port  - Backend port destination         " << std::endl
+            << std::endl
+            << "  Environment variables:                          " << std::endl
+            << "    CONVERSION_THREADS    - number of threads     " << std::endl
+            << "    CONVERSION_INFLIGHT   - max in-flight requests per thread"
+            << std::endl
+            << "    CONVERSION_CHECKPOINT - checkpoint file, default "
+            << "<file_chlog>.convert-checkpoint" << std::endl
             << std::endl;
 }
 //------------------------------------------------------------------------------
@@ -1087,8 +1226,14 @@ main(int argc, char* argv[])
     sThreads = atoi(conversionThreads);
   }
 
-  std::cerr << "Using " << sThreads << " parallel threads for conversion" <<
-            std::endl;
+  const char* conversionInflight = getenv("CONVERSION_INFLIGHT");
+
+  if (conversionInflight) {
+    sInflight = std::max(1, atoi(conversionInflight));
+  }
+
+  std::cerr << "Using " << sThreads << " parallel threads for conversion with "
+            << sInflight << " in-flight requests per thread" << std::endl;
 
   if (argc != 5) {
     usage();
@@ -1109,12 +1254,6 @@ main(int argc, char* argv[])
     return 1;
   }
 
-  if (setenv("EOS_NS_BOOT_PARALLEL", "1", 1)) {
-    std::cerr << "ERROR: failed to set EOS_NS_BOOT_PARALLEL env variable"
-              << std::endl;
-    return 1;
-  }
-
   try {
     std::string file_chlog(argv[1]);
     std::string dir_chlog(argv[2]);
@@ -1125,6 +1264,8 @@ main(int argc, char* argv[])
     // Check file and directory changelog files
     struct stat info = {0};
     std::list<std::string> lst_files {file_chlog, dir_chlog};
+    std::ostringstream identity;
+    identity << "eos-ns-convert-checkpoint chunk=" << sChunkSize;
 
     for (auto& fn : lst_files) {
       int ret = stat(fn.c_str(), &info);
@@ -1133,6 +1274,30 @@ main(int argc, char* argv[])
         std::cerr << "Unable to access file: " << fn << std::endl;
         return EIO;
       }
+
+      identity << " " << fn << ":" << info.st_ino << ":" << info.st_size << ":"
+               << info.st_mtime;
+    }
+
+    // Booting from a snapshot changes the order in which the containers are
+    // chunked so the snapshot is part of the identity as well
+    struct stat snap_info = {0};
+
+    if (stat(eos::ChangeLogSnapshot::getPath(dir_chlog).c_str(), &snap_info) == 0) {
+      identity << " snapshot:" << snap_info.st_ino << ":" << snap_info.st_size
+               << ":" << snap_info.st_mtime;
+    }
+
+    // Resume from the checkpoint of an interrupted conversion of the same
+    // changelogs, if any
+    const char* checkpointPath = getenv("CONVERSION_CHECKPOINT");
+    std::string checkpoint_path = (checkpointPath ? checkpointPath :
+                                   file_chlog + ".convert-checkpoint");
+    size_t num_done = sCheckpoint.open(checkpoint_path, identity.str());
+
+    if (num_done) {
+      std::cout << "Resuming conversion from checkpoint " << checkpoint_path
+                << ", " << num_done << " units already committed" << std::endl;
     }
 
     std::time_t start = std::time(nullptr);
@@ -1194,13 +1359,21 @@ main(int argc, char* argv[])
     std::cout << "Commit quota and file system view ..." << std::endl;
     std::time_t views_start = std::time(nullptr);
     // Commit the quota view information
-    quota_view->commitToBackend();
+    if (!sCheckpoint.isDone("quota")) {
+      quota_view->commitToBackend();
+      sCheckpoint.markDone("quota");
+    }
+
     std::time_t quota_end = std::time(nullptr);
     std::chrono::seconds quota_duration {quota_end - views_start};
     std::cout << "Quota init: " << quota_duration.count() << " seconds"
               << std::endl;
     // Commit the file system view information
-    fs_view->commitToBackend();
+    if (!sCheckpoint.isDone("fsview")) {
+      fs_view->commitToBackend();
+      sCheckpoint.markDone("fsview");
+    }
+
     std::time_t fsview_end = std::time(nullptr);
     std::chrono::seconds fsview_duration {fsview_end - quota_end};
     std::cout << "FsView init: " << fsview_duration.count() << " seconds"
@@ -1231,6 +1404,7 @@ main(int argc, char* argv[])
               " seconds" << std::endl;
     std::chrono::seconds full_duration {std::time(nullptr) - start};
     std::cout << "Conversion duration: " << full_duration.count() << std::endl;
+    sCheckpoint.remove();
   } catch (const std::runtime_error& e) {
     std::cerr << "Exception thrown: " << e.what() << std::endl;
     return 1;
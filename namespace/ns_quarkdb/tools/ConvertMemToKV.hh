@@ -36,11 +36,77 @@
 #include "proto/FileMd.pb.h"
 #include "common/RWMutex.hh"
 #include <cstdint>
+#include <mutex>
+#include <set>
 
 EOSNSNAMESPACE_BEGIN
 
 using QuotaNodeMapT = std::map<std::string, eos::QuotaNodeCore::UsageInfo>;
 
+//------------------------------------------------------------------------------
+//! Class ConvertCheckpoint
+//!
+//! Records which parts of the conversion were already committed to the
+//! backend so that an interrupted conversion can be resumed. The in-memory
+//! namespace is always rebuilt from the changelogs, only the backend writes
+//! of the completed chunks and phases are skipped. All backend writes are
+//! idempotent so redoing a partially committed chunk is harmless.
+//!
+//! The checkpoint is a text file with a header line identifying the
+//! changelogs followed by one "<phase> <chunk>" line per completed unit.
+//------------------------------------------------------------------------------
+class ConvertCheckpoint
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //----------------------------------------------------------------------------
+  ConvertCheckpoint(): mFile(nullptr) {}
+
+  //----------------------------------------------------------------------------
+  //! Destructor
+  //----------------------------------------------------------------------------
+  ~ConvertCheckpoint();
+
+  //----------------------------------------------------------------------------
+  //! Open the checkpoint file. An existing checkpoint is only used if it was
+  //! written for the same changelogs, otherwise it is discarded.
+  //!
+  //! @param path checkpoint file path
+  //! @param identity string identifying the converted changelogs
+  //!
+  //! @return number of completed units found in the checkpoint
+  //----------------------------------------------------------------------------
+  size_t open(const std::string& path, const std::string& identity);
+
+  //----------------------------------------------------------------------------
+  //! Check if the given unit was already committed
+  //!
+  //! @param phase conversion phase
+  //! @param chunk chunk within the phase
+  //----------------------------------------------------------------------------
+  bool isDone(const std::string& phase, uint64_t chunk = 0);
+
+  //----------------------------------------------------------------------------
+  //! Record the given unit as committed, the record is flushed to disk
+  //!
+  //! @param phase conversion phase
+  //! @param chunk chunk within the phase
+  //----------------------------------------------------------------------------
+  void markDone(const std::string& phase, uint64_t chunk = 0);
+
+  //----------------------------------------------------------------------------
+  //! Remove the checkpoint once the conversion is complete
+  //----------------------------------------------------------------------------
+  void remove();
+
+private:
+  std::mutex mMutex; ///< Mutex protecting the members below
+  std::string mPath; ///< Checkpoint file path
+  FILE* mFile; ///< Checkpoint file opened for appending
+  std::set<std::pair<std::string, uint64_t>> mDone; ///< Completed units
+};
+
 //------------------------------------------------------------------------------
 //! Class ConvertQuotaView
 //------------------------------------------------------------------------------
@@ -23,6 +23,7 @@
 #include "namespace/interface/IContainerMDSvc.hh"
 #include "namespace/interface/IFileMDSvc.hh"
 #include "namespace/ns_quarkdb/persistency/ContainerMDSvc.hh"
+#include "namespace/ns_quarkdb/Constants.hh"
 #include "namespace/utils/PathProcessor.hh"
 #include <cerrno>
 #include <ctime>
@@ -42,7 +43,8 @@ EOSNSNAMESPACE_BEGIN
 //------------------------------------------------------------------------------
 HierarchicalView::HierarchicalView()
   : pContainerSvc(nullptr), pFileSvc(nullptr),
-    pQuotaStats(new QuotaStats()), pRoot(nullptr)
+    pQuotaStats(new QuotaStats()), pRoot(nullptr), mPathCache(1000000),
+    mPathCacheRegistered(false)
 {
   pExecutor.reset(new folly::IOThreadPoolExecutor(8));
 }
@@ -73,6 +75,16 @@ HierarchicalView::configure(const std::map<std::string, std::string>& config)
     throw e;
   }
 
+  auto it = config.find(constants::sMaxNumCachePaths);
+
+  if (it != config.end()) {
+    mPathCache.setMaxNum(std::stoull(it->second));
+  }
+
+  if (config.find(constants::sReconfigureCachesOnly) != config.end()) {
+    return;
+  }
+
   delete pQuotaStats;
   pQuotaStats = new QuotaStats();
   pQuotaStats->configure(config);
@@ -94,6 +106,11 @@ HierarchicalView::initialize1()
 {
   pContainerSvc->initialize();
 
+  if (!mPathCacheRegistered) {
+    pContainerSvc->addChangeListener(&mPathCache);
+    mPathCacheRegistered = true;
+  }
+
   // Get root container
   try {
     pRoot = pContainerSvc->getContainerMD(1);
@@ -143,6 +160,7 @@ HierarchicalView::finalize()
 {
   pContainerSvc->finalize();
   pFileSvc->finalize();
+  mPathCache.clear();
   delete pQuotaStats;
   pQuotaStats = nullptr;
 }
@@ -184,11 +202,7 @@ HierarchicalView::getItem(const std::string& uri, bool follow)
   //----------------------------------------------------------------------------
   std::deque<std::string> pendingChunks;
   eos::PathProcessor::insertChunksIntoDeque(pendingChunks, uri);
-  //----------------------------------------------------------------------------
-  // Initial state: We're at "/", and have to look up all chunks.
-  //----------------------------------------------------------------------------
-  FileOrContainerMD initialState {nullptr, pRoot};
-  return getPathInternal(initialState, pendingChunks, follow, 0);
+  return getPathFromRoot(pendingChunks, follow);
 }
 
 //------------------------------------------------------------------------------
@@ -199,13 +213,61 @@ static FileOrContainerMD toFileOrContainerMD(IContainerMDPtr ptr)
   return {nullptr, ptr};
 }
 
+//------------------------------------------------------------------------------
+// Lookup a given path starting from the root, skipping the longest prefix
+// found in the path lookup cache.
+//------------------------------------------------------------------------------
+folly::Future<FileOrContainerMD>
+HierarchicalView::getPathFromRoot(std::deque<std::string> chunks, bool follow)
+{
+  uint64_t generation = mPathCache.getGeneration();
+  ContainerIdentifier cachedId;
+  std::string cachedPath;
+  size_t cachedChunks = mPathCache.lookup(chunks, cachedId, cachedPath);
+
+  if (cachedChunks == 0) {
+    //--------------------------------------------------------------------------
+    // Initial state: We're at "/", and have to look up all chunks.
+    //--------------------------------------------------------------------------
+    return getPathInternal(FileOrContainerMD {nullptr, pRoot}, chunks, follow,
+                           0, "/", generation);
+  }
+
+  std::deque<std::string> remaining(chunks.begin() + cachedChunks,
+                                    chunks.end());
+  folly::Future<IContainerMDPtr> fut = pContainerSvc->getContainerMDFut(
+                                         cachedId.getUnderlyingUInt64());
+
+  if (fut.isReady() && fut.hasValue()) {
+    return getPathInternal(FileOrContainerMD {nullptr, fut.get()}, remaining,
+                           follow, 0, cachedPath, generation);
+  }
+
+  //----------------------------------------------------------------------------
+  // Container not in memory, resume once fetched. Should the fetch fail,
+  // fall back to the full lookup starting from "/".
+  //----------------------------------------------------------------------------
+  return fut.via(pExecutor.get())
+  .then([this, chunks, remaining, follow, cachedPath, generation]
+  (folly::Try<IContainerMDPtr>&& cont) {
+    if (cont.hasException()) {
+      return getPathInternal(FileOrContainerMD {nullptr, pRoot}, chunks, follow,
+                             0, "/", mPathCache.getGeneration());
+    }
+
+    return getPathInternal(FileOrContainerMD {nullptr, cont.value()}, remaining,
+                           follow, 0, cachedPath, generation);
+  });
+}
+
 //------------------------------------------------------------------------------
 // Lookup a given path - deferred function.
 //------------------------------------------------------------------------------
 folly::Future<FileOrContainerMD>
 HierarchicalView::getPathDeferred(folly::Future<FileOrContainerMD> fut,
                                   std::deque<std::string> pendingChunks,
-                                  bool follow, size_t expendedEffort)
+                                  bool follow, size_t expendedEffort,
+                                  std::string statePath, uint64_t generation)
 {
   //----------------------------------------------------------------------------
   // We're blocked on a network request. "Pause" execution of getPathInternal
@@ -216,7 +278,7 @@ HierarchicalView::getPathDeferred(folly::Future<FileOrContainerMD> fut,
   //----------------------------------------------------------------------------
   return fut.via(pExecutor.get())
          .then(std::bind(&HierarchicalView::getPathInternal, this, _1, pendingChunks,
-                         follow, expendedEffort));
+                         follow, expendedEffort, statePath, generation));
 }
 
 //------------------------------------------------------------------------------
@@ -225,7 +287,8 @@ HierarchicalView::getPathDeferred(folly::Future<FileOrContainerMD> fut,
 folly::Future<FileOrContainerMD>
 HierarchicalView::getPathDeferred(folly::Future<IContainerMDPtr> fut,
                                   std::deque<std::string> pendingChunks,
-                                  bool follow, size_t expendedEffort)
+                                  bool follow, size_t expendedEffort,
+                                  std::string statePath, uint64_t generation)
 {
   //----------------------------------------------------------------------------
   // Same as getPathDeferred taking FileOrContainerMD.
@@ -233,7 +296,7 @@ HierarchicalView::getPathDeferred(folly::Future<IContainerMDPtr> fut,
   return fut.via(pExecutor.get())
          .then(toFileOrContainerMD)
          .then(std::bind(&HierarchicalView::getPathInternal, this, _1, pendingChunks,
-                         follow, expendedEffort));
+                         follow, expendedEffort, statePath, generation));
 }
 
 //------------------------------------------------------------------------------
@@ -242,7 +305,8 @@ HierarchicalView::getPathDeferred(folly::Future<IContainerMDPtr> fut,
 folly::Future<FileOrContainerMD>
 HierarchicalView::getPathInternal(FileOrContainerMD state,
                                   std::deque<std::string> pendingChunks,
-                                  bool follow, size_t expendedEffort)
+                                  bool follow, size_t expendedEffort,
+                                  std::string statePath, uint64_t generation)
 {
   //----------------------------------------------------------------------------
   // Our goal is to consume pendingChunks until it's empty.
@@ -272,6 +336,13 @@ HierarchicalView::getPathInternal(FileOrContainerMD state,
              "No such file or directory"));
     }
 
+    //--------------------------------------------------------------------------
+    // Remember where this container lives, if we know its full path.
+    //--------------------------------------------------------------------------
+    if (state.container && !statePath.empty()) {
+      mPathCache.insert(statePath, state.container->getIdentifier(), generation);
+    }
+
     if (pendingChunks.empty()) {
       if (!(follow && state.file && state.file->isLink())) {
         //------------------------------------------------------------------------
@@ -296,6 +367,7 @@ HierarchicalView::getPathInternal(FileOrContainerMD state,
 
       if (pendingChunks.front() == "..") {
         pendingChunks.pop_front();
+        statePath.clear();
         folly::Future<IContainerMDPtr> fut = pContainerSvc->getContainerMD(
                                                state.container->getParentId());
 
@@ -303,7 +375,8 @@ HierarchicalView::getPathInternal(FileOrContainerMD state,
           //--------------------------------------------------------------------
           // We're blocked, "pause" execution, unblock caller.
           //--------------------------------------------------------------------
-          return getPathDeferred(std::move(fut), pendingChunks, follow, expendedEffort);
+          return getPathDeferred(std::move(fut), pendingChunks, follow, expendedEffort,
+                                 statePath, generation);
         }
 
         state.container = fut.get();
@@ -316,6 +389,12 @@ HierarchicalView::getPathInternal(FileOrContainerMD state,
       //------------------------------------------------------------------------
       folly::Future<FileOrContainerMD> next = state.container->findItem(
           pendingChunks.front());
+
+      if (!statePath.empty()) {
+        statePath += pendingChunks.front();
+        statePath += "/";
+      }
+
       pendingChunks.pop_front();
 
       //------------------------------------------------------------------------
@@ -329,7 +408,8 @@ HierarchicalView::getPathInternal(FileOrContainerMD state,
         //----------------------------------------------------------------------
         // We're blocked, "pause" execution, unblock caller.
         //----------------------------------------------------------------------
-        return getPathDeferred(std::move(next), pendingChunks, follow, expendedEffort);
+        return getPathDeferred(std::move(next), pendingChunks, follow, expendedEffort,
+                               statePath, generation);
       }
     }
 
@@ -367,10 +447,12 @@ HierarchicalView::getPathInternal(FileOrContainerMD state,
         // This is an absolute symlink: Our state becomes pRoot again.
         //----------------------------------------------------------------------
         state = FileOrContainerMD {nullptr, pRoot};
+        statePath = "/";
       } else {
         //----------------------------------------------------------------------
         // This is a relative symlink: State becomes symlink's parent container.
         //----------------------------------------------------------------------
+        statePath.clear();
         folly::Future<IContainerMDPtr> fut = pContainerSvc->getContainerMD(
                                                state.file->getContainerId());
 
@@ -378,7 +460,8 @@ HierarchicalView::getPathInternal(FileOrContainerMD state,
           //--------------------------------------------------------------------
           // We're blocked, "pause" execution, unblock caller.
           //--------------------------------------------------------------------
-          return getPathDeferred(std::move(fut), pendingChunks, follow, expendedEffort);
+          return getPathDeferred(std::move(fut), pendingChunks, follow, expendedEffort,
+                                 statePath, generation);
         }
 
         state.container = fut.get();
@@ -429,8 +512,7 @@ HierarchicalView::createFile(const std::string& uri, uid_t uid, gid_t gid)
 
   std::string lastChunk = chunks.back();
   chunks.pop_back();
-  FileOrContainerMD item = getPathInternal(FileOrContainerMD {nullptr, pRoot},
-                           chunks, true, 0).get();
+  FileOrContainerMD item = getPathFromRoot(chunks, true).get();
 
   if (item.file) {
     throw_mdexception(ENOTDIR, "Not a directory");
@@ -682,8 +764,7 @@ HierarchicalView::getPathExpectContainer(const std::deque<std::string>& chunks)
     return pRoot;
   }
 
-  return getPathInternal(FileOrContainerMD {nullptr, pRoot}, chunks, true, 0)
-         .then(extractContainerMD);
+  return getPathFromRoot(chunks, true).then(extractContainerMD);
 }
 
 //------------------------------------------------------------------------------
@@ -29,6 +29,7 @@
 #include "namespace/interface/IFileMDSvc.hh"
 #include "namespace/interface/IView.hh"
 #include "namespace/ns_quarkdb/accounting/QuotaStats.hh"
+#include "namespace/ns_quarkdb/views/PathLookupCache.hh"
 
 #ifdef __clang__
 #pragma clang diagnostic ignored "-Wunused-private-field"
@@ -291,27 +292,49 @@ public:
     return false;
   }
 
+  //----------------------------------------------------------------------------
+  //! Get the container path lookup cache
+  //----------------------------------------------------------------------------
+  PathLookupCache& getPathLookupCache()
+  {
+    return mPathCache;
+  }
+
 private:
+  //----------------------------------------------------------------------------
+  //! Lookup a given path starting from the root, skipping the longest prefix
+  //! found in the path lookup cache.
+  //----------------------------------------------------------------------------
+  folly::Future<FileOrContainerMD>
+  getPathFromRoot(std::deque<std::string> chunks, bool follow);
+
   //----------------------------------------------------------------------------
   //! Lookup a given path - internal function.
+  //!
+  //! @param statePath full path of the container in state, used to populate
+  //!        the path lookup cache - empty if not known
+  //! @param generation path lookup cache generation when the lookup started
   //----------------------------------------------------------------------------
   folly::Future<FileOrContainerMD>
   getPathInternal(FileOrContainerMD state, std::deque<std::string> pendingChunks,
-    bool follow, size_t expendedEffort);
+    bool follow, size_t expendedEffort, std::string statePath = "",
+    uint64_t generation = 0);
 
   //----------------------------------------------------------------------------
   //! Lookup a given path - deferred function.
   //----------------------------------------------------------------------------
   folly::Future<FileOrContainerMD>
   getPathDeferred(folly::Future<FileOrContainerMD> fut, std::deque<std::string> pendingChunks,
-    bool follow, size_t expendedEffort);
+    bool follow, size_t expendedEffort, std::string statePath,
+    uint64_t generation);
 
   //----------------------------------------------------------------------------
   //! Lookup a given path - deferred function.
   //----------------------------------------------------------------------------
   folly::Future<FileOrContainerMD>
   getPathDeferred(folly::Future<IContainerMDPtr> fut, std::deque<std::string> pendingChunks,
-    bool follow, size_t expendedEffort);
+    bool follow, size_t expendedEffort, std::string statePath,
+    uint64_t generation);
 
   //----------------------------------------------------------------------------
   //! Lookup a given path, expect a container there.
@@ -334,6 +357,8 @@ private:
   IQuotaStats* pQuotaStats;
   std::shared_ptr<IContainerMD> pRoot;
   std::unique_ptr<folly::Executor> pExecutor;
+  PathLookupCache mPathCache; ///< Container path to container id cache
+  bool mPathCacheRegistered; ///< Path cache registered as listener
 };
 
 EOSNSNAMESPACE_END
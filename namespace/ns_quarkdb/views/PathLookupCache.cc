@@ -0,0 +1,265 @@
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "namespace/ns_quarkdb/views/PathLookupCache.hh"
+#include "namespace/interface/IContainerMD.hh"
+#include <mutex>
+#include <tuple>
+
+EOSNSNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+// Constructor
+//------------------------------------------------------------------------------
+PathLookupCache::PathLookupCache(uint64_t max_num):
+  mMaxNum(max_num), mGeneration(0)
+{}
+
+//------------------------------------------------------------------------------
+// Change the max number of cached paths
+//------------------------------------------------------------------------------
+void
+PathLookupCache::setMaxNum(uint64_t max_num)
+{
+  mMaxNum = max_num;
+
+  if (max_num == 0) {
+    clear();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Get the number of cached paths
+//------------------------------------------------------------------------------
+uint64_t
+PathLookupCache::size() const
+{
+  std::shared_lock<std::shared_timed_mutex> lock(mMutex);
+  return mPathToId.size();
+}
+
+//------------------------------------------------------------------------------
+// Find the longest cached prefix of the given path chunks
+//------------------------------------------------------------------------------
+size_t
+PathLookupCache::lookup(const std::deque<std::string>& chunks,
+                        ContainerIdentifier& id, std::string& path) const
+{
+  if (mMaxNum.load() == 0) {
+    return 0;
+  }
+
+  std::string prefix = "/";
+  size_t found = 0;
+  std::shared_lock<std::shared_timed_mutex> lock(mMutex);
+
+  if (mPathToId.empty()) {
+    return 0;
+  }
+
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    if (chunks[i] == "." || chunks[i] == "..") {
+      break;
+    }
+
+    prefix += chunks[i];
+    prefix += "/";
+    auto it = mPathToId.find(prefix);
+
+    // Parents of cached paths are always cached, no point going deeper
+    if (it == mPathToId.end()) {
+      break;
+    }
+
+    if (!it->second.mReferenced.load(std::memory_order_relaxed)) {
+      it->second.mReferenced.store(true, std::memory_order_relaxed);
+    }
+
+    found = i + 1;
+    id = ContainerIdentifier(it->second.mId);
+    path = it->first;
+  }
+
+  return found;
+}
+
+//------------------------------------------------------------------------------
+// Insert path of container
+//------------------------------------------------------------------------------
+void
+PathLookupCache::insert(const std::string& path, ContainerIdentifier id,
+                        uint64_t generation)
+{
+  uint64_t max_num = mMaxNum.load();
+
+  if ((max_num == 0) || path.empty() || (path.back() != '/')) {
+    return;
+  }
+
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(mMutex);
+    auto it = mPathToId.find(path);
+
+    if ((it != mPathToId.end()) && (it->second.mId == id.getUnderlyingUInt64())) {
+      return;
+    }
+  }
+
+  std::unique_lock<std::shared_timed_mutex> lock(mMutex);
+
+  if (generation != mGeneration.load()) {
+    return;
+  }
+
+  while (mPathToId.size() >= max_num) {
+    if (!evictNoLock()) {
+      return;
+    }
+  }
+
+  // Keep the invariant that parents of cached paths are cached
+  if (path != "/") {
+    size_t pos = path.rfind('/', path.length() - 2);
+
+    if (mPathToId.find(path.substr(0, pos + 1)) == mPathToId.end()) {
+      return;
+    }
+  }
+
+  // Conflicting entries mean we missed an invalidation, drop them
+  auto it_path = mPathToId.find(path);
+  auto it_id = mIdToPath.find(id.getUnderlyingUInt64());
+
+  if (((it_path != mPathToId.end()) &&
+       (it_path->second.mId != id.getUnderlyingUInt64())) ||
+      ((it_id != mIdToPath.end()) && (it_id->second != path))) {
+    if (it_id != mIdToPath.end()) {
+      erasePrefixNoLock(std::string(it_id->second), true);
+    }
+
+    erasePrefixNoLock(path, true);
+    ++mGeneration;
+    return;
+  }
+
+  mPathToId.emplace(std::piecewise_construct, std::forward_as_tuple(path),
+                    std::forward_as_tuple(id.getUnderlyingUInt64()));
+  mIdToPath[id.getUnderlyingUInt64()] = path;
+}
+
+//------------------------------------------------------------------------------
+// Drop all cached paths below the given container
+//------------------------------------------------------------------------------
+void
+PathLookupCache::invalidateBelow(ContainerIdentifier id)
+{
+  if (mMaxNum.load() == 0) {
+    return;
+  }
+
+  std::unique_lock<std::shared_timed_mutex> lock(mMutex);
+  ++mGeneration;
+  auto it = mIdToPath.find(id.getUnderlyingUInt64());
+
+  if (it != mIdToPath.end()) {
+    erasePrefixNoLock(std::string(it->second), false);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Drop all cached paths
+//------------------------------------------------------------------------------
+void
+PathLookupCache::clear()
+{
+  std::unique_lock<std::shared_timed_mutex> lock(mMutex);
+  ++mGeneration;
+  mPathToId.clear();
+  mIdToPath.clear();
+}
+
+//------------------------------------------------------------------------------
+// Notification about changes to containers
+//------------------------------------------------------------------------------
+void
+PathLookupCache::containerMDChanged(IContainerMD* obj, Action type)
+{
+  switch (type) {
+  case IContainerMDChangeListener::SubcontainerRemoved:
+    invalidateBelow(obj->getIdentifier());
+    break;
+
+  default:
+    break;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Drop all cached paths starting with the given prefix
+//------------------------------------------------------------------------------
+void
+PathLookupCache::erasePrefixNoLock(const std::string& prefix, bool inclusive)
+{
+  auto it = mPathToId.lower_bound(prefix);
+
+  while ((it != mPathToId.end()) &&
+         (it->first.compare(0, prefix.length(), prefix) == 0)) {
+    if (!inclusive && (it->first.length() == prefix.length())) {
+      ++it;
+      continue;
+    }
+
+    mIdToPath.erase(it->second.mId);
+    it = mPathToId.erase(it);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Evict the path under the clock hand with all paths below it
+//------------------------------------------------------------------------------
+bool
+PathLookupCache::evictNoLock()
+{
+  auto it = mPathToId.lower_bound(mClockHand);
+
+  // Every full sweep clears all reference bits, two of them always find a
+  // victim unless only the root is left
+  for (size_t i = 0; i <= 2 * mPathToId.size(); ++i) {
+    if (it == mPathToId.end()) {
+      it = mPathToId.begin();
+
+      if (it == mPathToId.end()) {
+        return false;
+      }
+    }
+
+    if ((it->first == "/") || it->second.mReferenced.exchange(false)) {
+      ++it;
+      continue;
+    }
+
+    // The paths after the evicted range follow, lower_bound lands on them
+    mClockHand = it->first;
+    erasePrefixNoLock(mClockHand, true);
+    return true;
+  }
+
+  return false;
+}
+
+EOSNSNAMESPACE_END
@@ -0,0 +1,172 @@
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+//------------------------------------------------------------------------------
+//! @brief Cache of container paths to container ids, used to skip the
+//!        component by component walk when looking up deep paths.
+//------------------------------------------------------------------------------
+
+#pragma once
+#include "namespace/Namespace.hh"
+#include "namespace/interface/IContainerMDSvc.hh"
+#include "namespace/interface/Identifiers.hh"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+EOSNSNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Class PathLookupCache
+//!
+//! Maps the full path of a container e.g. "/eos/dir1/dir2/" to its id. Only
+//! paths made of real containers are stored, never paths going through
+//! symlinks. If a path is cached then so are all its parent paths, which
+//! allows invalidating a whole subtree with a single range erase. Whenever a
+//! subcontainer is removed from a container, which is what both renames and
+//! removals do, all paths below the container are dropped. When the cache is
+//! full, paths are evicted following the CLOCK algorithm: lookups mark the
+//! paths they go through as referenced, and the clock hand sweeps the paths in
+//! order, sparing the referenced ones once. A path is evicted together with
+//! all paths below it, which are never hotter than the path itself since
+//! looking them up goes through it. The root path is never evicted.
+//!
+//! Every invalidation bumps the generation number. Lookups remember the
+//! generation at the time they started and their results are only inserted
+//! if nothing was invalidated in the meantime.
+//------------------------------------------------------------------------------
+class PathLookupCache : public IContainerMDChangeListener
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //!
+  //! @param max_num max number of cached paths, 0 disables the cache
+  //----------------------------------------------------------------------------
+  PathLookupCache(uint64_t max_num);
+
+  //----------------------------------------------------------------------------
+  //! Destructor
+  //----------------------------------------------------------------------------
+  virtual ~PathLookupCache() = default;
+
+  //----------------------------------------------------------------------------
+  //! Change the max number of cached paths, 0 disables and empties the cache
+  //----------------------------------------------------------------------------
+  void setMaxNum(uint64_t max_num);
+
+  //----------------------------------------------------------------------------
+  //! Get the max number of cached paths
+  //----------------------------------------------------------------------------
+  uint64_t getMaxNum() const
+  {
+    return mMaxNum.load();
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the number of cached paths
+  //----------------------------------------------------------------------------
+  uint64_t size() const;
+
+  //----------------------------------------------------------------------------
+  //! Get the current generation, to be passed back when inserting
+  //----------------------------------------------------------------------------
+  uint64_t getGeneration() const
+  {
+    return mGeneration.load();
+  }
+
+  //----------------------------------------------------------------------------
+  //! Find the longest cached prefix of the given path chunks. The search stops
+  //! at the first "." or ".." chunk.
+  //!
+  //! @param chunks path chunks
+  //! @param id id of the container matching the longest cached prefix
+  //! @param path path of the container matching the longest cached prefix
+  //!
+  //! @return number of chunks covered by the cached prefix, 0 if none
+  //----------------------------------------------------------------------------
+  size_t lookup(const std::deque<std::string>& chunks, ContainerIdentifier& id,
+                std::string& path) const;
+
+  //----------------------------------------------------------------------------
+  //! Insert path of container
+  //!
+  //! @param path full path of the container ending with "/"
+  //! @param id container id
+  //! @param generation generation at the time the lookup started
+  //----------------------------------------------------------------------------
+  void insert(const std::string& path, ContainerIdentifier id,
+              uint64_t generation);
+
+  //----------------------------------------------------------------------------
+  //! Drop all cached paths below the given container
+  //!
+  //! @param id container id
+  //----------------------------------------------------------------------------
+  void invalidateBelow(ContainerIdentifier id);
+
+  //----------------------------------------------------------------------------
+  //! Drop all cached paths
+  //----------------------------------------------------------------------------
+  void clear();
+
+  //----------------------------------------------------------------------------
+  //! IContainerMDChangeListener interface
+  //----------------------------------------------------------------------------
+  virtual void containerMDChanged(IContainerMD* obj, Action type) override;
+
+private:
+  //----------------------------------------------------------------------------
+  //! Drop all cached paths starting with the given prefix - the write lock
+  //! must be held.
+  //----------------------------------------------------------------------------
+  void erasePrefixNoLock(const std::string& prefix, bool inclusive);
+
+  //----------------------------------------------------------------------------
+  //! Evict the path under the clock hand, with all paths below it, skipping
+  //! the referenced paths - the write lock must be held.
+  //!
+  //! @return true if anything was evicted, otherwise false
+  //----------------------------------------------------------------------------
+  bool evictNoLock();
+
+  //----------------------------------------------------------------------------
+  //! Cached path entry
+  //----------------------------------------------------------------------------
+  struct Entry {
+    Entry(uint64_t id): mId(id), mReferenced(true) {}
+
+    uint64_t mId; ///< Container id
+    //! Set by lookups holding only the read lock, cleared by the clock hand
+    mutable std::atomic<bool> mReferenced;
+  };
+
+  std::atomic<uint64_t> mMaxNum; ///< Max number of cached paths
+  std::atomic<uint64_t> mGeneration; ///< Bumped by every invalidation
+  mutable std::shared_timed_mutex mMutex; ///< Mutex protecting the maps
+  std::map<std::string, Entry> mPathToId; ///< Path to container id
+  std::unordered_map<uint64_t, std::string> mIdToPath; ///< Reverse mapping
+  std::string mClockHand; ///< Path the next eviction starts from
+};
+
+EOSNSNAMESPACE_END
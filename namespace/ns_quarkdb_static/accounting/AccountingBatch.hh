@@ -0,0 +1,163 @@
+//------------------------------------------------------------------------------
+//! @brief Helpers shared by the listeners propagating batches of updates
+//!        up the container hierarchy
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#pragma once
+#include "namespace/MDException.hh"
+#include "namespace/Namespace.hh"
+#include "namespace/interface/IContainerMDSvc.hh"
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+EOSNSNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Statistics of the batches propagated by an accounting listener
+//------------------------------------------------------------------------------
+struct AccountingStatistics {
+  uint64_t batches = 0; ///< Number of non-empty batches propagated
+  uint64_t queued = 0; ///< Containers with queued updates
+  uint64_t updated = 0; ///< Containers updated, ancestors included
+  uint64_t merged = 0; ///< Ancestor walks merged into an already seen path
+  uint64_t lastQueued = 0; ///< Containers queued in the last batch
+  uint64_t lastUpdated = 0; ///< Containers updated in the last batch
+  uint64_t lastResolveUs = 0; ///< Time to resolve the last batch
+  uint64_t lastLockUs = 0; ///< Time under the namespace lock, last batch
+  uint64_t totalLockUs = 0; ///< Total time under the namespace lock
+  uint64_t maxLockUs = 0; ///< Longest time under the namespace lock
+
+  //----------------------------------------------------------------------------
+  //! Account for a propagated batch
+  //!
+  //! @param num_queued containers queued in the batch
+  //! @param num_updated containers updated, ancestors included
+  //! @param num_merged ancestor walks merged into an already seen path
+  //! @param resolve_us time to resolve the batch
+  //! @param lock_us time under the namespace lock
+  //----------------------------------------------------------------------------
+  void Record(uint64_t num_queued, uint64_t num_updated, uint64_t num_merged,
+              uint64_t resolve_us, uint64_t lock_us)
+  {
+    ++batches;
+    queued += num_queued;
+    updated += num_updated;
+    merged += num_merged;
+    lastQueued = num_queued;
+    lastUpdated = num_updated;
+    lastResolveUs = resolve_us;
+    lastLockUs = lock_us;
+    totalLockUs += lock_us;
+    maxLockUs = std::max(maxLockUs, lock_us);
+  }
+};
+
+//------------------------------------------------------------------------------
+//! Resolve a queued container and its ancestors, walking up until reaching
+//! the root, an already resolved ancestor or a container for which the init
+//! function returns false. Every container is looked up only once per batch
+//! and gets its depth below the topmost resolved ancestor.
+//!
+//! @param svc container metadata service
+//! @param id id of the queued container
+//! @param nodes resolved containers, NodeT must provide the mCont, mParentId
+//!        and mDepth members
+//! @param path scratch vector holding the containers resolved by this walk
+//! @param init function called for every newly resolved node, returns
+//!        whether the walk continues with the parent
+//!
+//! @return true if the walk joined an already resolved path, otherwise false
+//------------------------------------------------------------------------------
+template <typename NodeT, typename InitT>
+bool
+ResolveAncestors(IContainerMDSvc* svc, IContainerMD::id_t id,
+                 std::unordered_map<IContainerMD::id_t, NodeT>& nodes,
+                 std::vector<IContainerMD::id_t>& path, InitT init)
+{
+  bool merged = false;
+  uint16_t depth = 0;
+  path.clear();
+
+  while ((id > 1) && (path.size() < 255)) {
+    auto it = nodes.find(id);
+
+    if (it != nodes.end()) {
+      depth = it->second.mDepth + 1;
+      merged = true;
+      break;
+    }
+
+    std::shared_ptr<IContainerMD> cont;
+
+    try {
+      cont = svc->getContainerMD(id);
+    } catch (const MDException& e) {
+      break;
+    }
+
+    NodeT& node = nodes[id];
+    node.mCont = cont;
+    node.mParentId = cont->getParentId();
+    path.push_back(id);
+
+    if (!init(node)) {
+      break;
+    }
+
+    id = node.mParentId;
+  }
+
+  for (auto it = path.rbegin(); it != path.rend(); ++it) {
+    nodes[*it].mDepth = depth++;
+  }
+
+  return merged;
+}
+
+//------------------------------------------------------------------------------
+//! Order the resolved containers from the deepest to the topmost
+//!
+//! @param nodes resolved containers
+//! @param order containers accepted by the filter, deepest first
+//! @param filter function returning whether a node takes part in the order
+//------------------------------------------------------------------------------
+template <typename NodeT, typename FilterT>
+void
+OrderByDepth(std::unordered_map<IContainerMD::id_t, NodeT>& nodes,
+             std::vector<NodeT*>& order, FilterT filter)
+{
+  order.clear();
+  order.reserve(nodes.size());
+
+  for (auto& elem : nodes) {
+    if (filter(elem.second)) {
+      order.push_back(&elem.second);
+    }
+  }
+
+  std::sort(order.begin(), order.end(), [](const NodeT * a, const NodeT * b) {
+    return a->mDepth > b->mDepth;
+  });
+}
+
+EOSNSNAMESPACE_END
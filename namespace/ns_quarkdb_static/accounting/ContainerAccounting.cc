@@ -17,6 +17,8 @@
  ************************************************************************/
 
 #include "namespace/ns_quarkdb_static/accounting/ContainerAccounting.hh"
+#include "common/Logging.hh"
+#include <algorithm>
 #include <iostream>
 #include <chrono>
 
@@ -100,30 +102,60 @@ QuarkContainerAccounting::RemoveTree(IContainerMD* obj, int64_t dsize)
 void
 QuarkContainerAccounting::QueueForUpdate(IContainerMD::id_t id, int64_t dsize)
 {
-  uint16_t deepness = 0;
-  std::shared_ptr<IContainerMD> cont;
+  if (id <= 1) {
+    return;
+  }
+
   std::lock_guard<std::mutex> scope_lock(mMutexBatch);
-  auto& batch = mBatch[mAccumulateIndx];
+  mBatch[mAccumulateIndx].mMap[id] += dsize;
+}
 
-  while ((id > 1) && (deepness < 255)) {
-    try {
-      cont = mContainerMDSvc->getContainerMD(id);
-    } catch (const MDException& e) {
-      // TODO (esindril): error message using default logging
-      break;
+//------------------------------------------------------------------------------
+// Resolve the containers of the batch along with their ancestors and sum up
+// the deltas bottom-up
+//------------------------------------------------------------------------------
+uint64_t
+QuarkContainerAccounting::AggregateBatch(const UpdateT& batch,
+    std::unordered_map<IContainerMD::id_t, NodeT>& nodes,
+    std::vector<NodeT*>& order)
+{
+  uint64_t num_merged = 0;
+  std::vector<IContainerMD::id_t> path;
+  nodes.reserve(batch.mMap.size() * 2);
+  // Every container takes part in the accounting of its ancestors
+  auto all_nodes = [](const NodeT&) {
+    return true;
+  };
+
+  for (auto const& elem : batch.mMap) {
+    // Walk up until reaching the root or an already resolved ancestor
+    if (ResolveAncestors(mContainerMDSvc, elem.first, nodes, path, all_nodes)) {
+      ++num_merged;
     }
 
-    auto it_map = batch.mMap.find(id);
+    auto it_node = nodes.find(elem.first);
 
-    if (it_map != batch.mMap.end()) {
-      it_map->second += dsize;
-    } else {
-      batch.mMap.emplace(id, dsize);
+    if (it_node != nodes.end()) {
+      it_node->second.mDelta += elem.second;
+    }
+  }
+
+  // Sum the deltas into the parents one level at a time, deepest first
+  OrderByDepth(nodes, order, all_nodes);
+
+  for (auto node : order) {
+    if (node->mDelta == 0) {
+      continue;
     }
 
-    id = cont->getParentId();
-    ++deepness;
+    auto it_parent = nodes.find(node->mParentId);
+
+    if (it_parent != nodes.end()) {
+      it_parent->second.mDelta += node->mDelta;
+    }
   }
+
+  return num_merged;
 }
 
 //------------------------------------------------------------------------------
@@ -133,6 +165,10 @@ QuarkContainerAccounting::QueueForUpdate(IContainerMD::id_t id, int64_t dsize)
 void
 QuarkContainerAccounting::PropagateUpdates()
 {
+  using namespace std::chrono;
+  std::unordered_map<IContainerMD::id_t, NodeT> nodes;
+  std::vector<NodeT*> order;
+
   while (true) {
     if (mShutdown) {
       break;
@@ -146,22 +182,53 @@ QuarkContainerAccounting::PropagateUpdates()
     }
 
     auto& batch = mBatch[mCommitIndx];
-    {
-      // Need to lock the namespace
-      eos::common::RWMutexWriteLock wr_lock(*gNsRwMutex);
-      std::shared_ptr<IContainerMD> cont;
-
-      for (auto const& elem : batch.mMap) {
-        try {
-          cont = mContainerMDSvc->getContainerMD(elem.first);
-          cont->updateTreeSize(elem.second);
-          mContainerMDSvc->updateStore(cont.get());
-        } catch (const MDException& e) {
-          // TODO: (esindril) error message using default logging
-          continue;
+
+    if (!batch.mMap.empty()) {
+      // Resolving the ancestors may need lookups in the backend, do it
+      // before taking the namespace lock as a prefetch
+      auto start = steady_clock::now();
+      uint64_t num_merged = AggregateBatch(batch, nodes, order);
+      auto resolved = steady_clock::now();
+      uint64_t num_updated = 0;
+      {
+        // Need to lock the namespace
+        eos::common::RWMutexWriteLock wr_lock(*gNsRwMutex);
+
+        std::shared_ptr<IContainerMD> cont;
+
+        for (auto node : order) {
+          if (node->mDelta == 0) {
+            continue;
+          }
+
+          // Fetch again under the lock, the container might have been
+          // removed since it was resolved
+          try {
+            cont = mContainerMDSvc->getContainerMD(node->mCont->getId());
+            cont->updateTreeSize(node->mDelta);
+            mContainerMDSvc->updateStore(cont.get());
+            ++num_updated;
+          } catch (const MDException& e) {
+            continue;
+          }
         }
       }
+      auto done = steady_clock::now();
+      uint64_t resolve_us = duration_cast<microseconds>(resolved - start).count();
+      uint64_t lock_us = duration_cast<microseconds>(done - resolved).count();
+      {
+        std::lock_guard<std::mutex> scope_lock(mMutexStats);
+        mStats.Record(batch.mMap.size(), num_updated, num_merged, resolve_us,
+                      lock_us);
+      }
+      eos_static_debug("msg=\"propagated container accounting\" queued=%lu "
+                       "updated=%lu merged=%lu resolve_us=%lu lock_us=%lu",
+                       batch.mMap.size(), num_updated, num_merged, resolve_us,
+                       lock_us);
+      nodes.clear();
+      order.clear();
     }
+
     batch.mMap.clear();
 
     if (mUpdateIntervalSec) {
@@ -172,4 +239,14 @@ QuarkContainerAccounting::PropagateUpdates()
   }
 }
 
+//------------------------------------------------------------------------------
+// Get statistics of the propagated batches
+//------------------------------------------------------------------------------
+QuarkContainerAccounting::Statistics
+QuarkContainerAccounting::GetStatistics()
+{
+  std::lock_guard<std::mutex> scope_lock(mMutexStats);
+  return mStats;
+}
+
 EOSNSNAMESPACE_END
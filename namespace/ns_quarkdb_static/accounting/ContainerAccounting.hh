@@ -24,8 +24,10 @@
 #pragma once
 #include "namespace/Namespace.hh"
 #include "namespace/interface/IContainerMDSvc.hh"
+#include "namespace/ns_quarkdb_static/accounting/AccountingBatch.hh"
 #include "namespace/interface/IFileMDSvc.hh"
 #include "common/RWMutex.hh"
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <vector>
@@ -106,7 +108,8 @@ public:
   void RemoveTree(IContainerMD* obj, int64_t dsize);
 
   //----------------------------------------------------------------------------
-  //! Queue info for update
+  //! Queue info for update. Only the given container is recorded, the
+  //! ancestors are resolved once per batch when the updates are propagated.
   //!
   //! @param pid container id
   //! @param dsize size change
@@ -119,6 +122,14 @@ public:
   //----------------------------------------------------------------------------
   void PropagateUpdates();
 
+  //! Statistics of the propagated batches
+  typedef AccountingStatistics Statistics;
+
+  //----------------------------------------------------------------------------
+  //! Get statistics of the propagated batches
+  //----------------------------------------------------------------------------
+  Statistics GetStatistics();
+
 private:
 
   //! Update structure containing the nodes that need an update. We try to
@@ -128,6 +139,29 @@ private:
     std::unordered_map<IContainerMD::id_t, int64_t> mMap; ///< Map updates
   };
 
+  //! Container taking part in the propagation of a batch
+  struct NodeT {
+    std::shared_ptr<IContainerMD> mCont; ///< Container object
+    IContainerMD::id_t mParentId = 0; ///< Parent container id
+    uint16_t mDepth = 0; ///< Depth below the topmost resolved ancestor
+    int64_t mDelta = 0; ///< Own delta, then the delta of the whole subtree
+  };
+
+  //----------------------------------------------------------------------------
+  //! Resolve the containers of the batch and all their ancestors, each one
+  //! looked up only once, then sum up the deltas bottom-up so that every
+  //! container ends up with the total delta of its subtree.
+  //!
+  //! @param batch batch of updates
+  //! @param nodes resolved containers
+  //! @param order containers ordered from the deepest to the topmost
+  //!
+  //! @return number of ancestor walks which joined an already resolved path
+  //----------------------------------------------------------------------------
+  uint64_t AggregateBatch(const UpdateT& batch,
+                      std::unordered_map<IContainerMD::id_t, NodeT>& nodes,
+                      std::vector<NodeT*>& order);
+
   //! Vector of two elements containing the batch which is currently being
   //! accumulated and the batch which is being committed to the namespace by
   //! the asynchronous thread
@@ -140,6 +174,8 @@ private:
   uint32_t mUpdateIntervalSec; ///< Interval in seconds when updates are pushed
   IContainerMDSvc* mContainerMDSvc; ///< container MD service
   eos::common::RWMutex* gNsRwMutex; ///< Global (MGM) name RW mutex
+  std::mutex mMutexStats; ///< Mutex protecting the statistics
+  Statistics mStats; ///< Statistics of the propagated batches
 };
 
 EOSNSNAMESPACE_END
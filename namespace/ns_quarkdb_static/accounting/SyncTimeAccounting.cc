@@ -17,11 +17,25 @@
  ************************************************************************/
 
 #include "namespace/ns_quarkdb_static/accounting/SyncTimeAccounting.hh"
+#include <algorithm>
 #include <iostream>
 #include <chrono>
 
 EOSNSNAMESPACE_BEGIN
 
+namespace
+{
+//------------------------------------------------------------------------------
+// Check if the first sync time is more recent than the second one
+//------------------------------------------------------------------------------
+bool
+IsNewer(const IContainerMD::tmtime_t& a, const IContainerMD::tmtime_t& b)
+{
+  return ((a.tv_sec > b.tv_sec) ||
+          ((a.tv_sec == b.tv_sec) && (a.tv_nsec > b.tv_nsec)));
+}
+}
+
 //------------------------------------------------------------------------------
 // Constructor
 //------------------------------------------------------------------------------
@@ -74,18 +88,50 @@ QuarkSyncTimeAccounting::containerMDChanged(IContainerMD* obj, Action type)
 void
 QuarkSyncTimeAccounting::QueueForUpdate(IContainerMD::id_t id)
 {
+  if (id == 0u) {
+    return;
+  }
+
   std::lock_guard<std::mutex> scope_lock(mMutexBatch);
-  auto& batch = mBatch[mAccumulateIndx];
-  auto it_map = batch.mMap.find(id);
-
-  if (it_map != batch.mMap.end()) {
-    auto& it_lst = it_map->second;
-    // Move it from current location to the end of the list (most recent)
-    batch.mLstUpd.splice(batch.mLstUpd.end(), batch.mLstUpd, it_lst);
-  } else {
-    auto it_new = batch.mLstUpd.emplace(batch.mLstUpd.end(), id);
-    batch.mMap[id] = it_new;
+  (void) mBatch[mAccumulateIndx].mSet.insert(id);
+}
+
+//------------------------------------------------------------------------------
+// Resolve the containers of the batch and their ancestors
+//------------------------------------------------------------------------------
+uint64_t
+QuarkSyncTimeAccounting::ResolveBatch(const UpdateT& batch,
+                                      std::unordered_map<IContainerMD::id_t, NodeT>& nodes,
+                                      std::vector<NodeT*>& order)
+{
+  uint64_t num_merged = 0;
+  std::vector<IContainerMD::id_t> path;
+  nodes.reserve(batch.mSet.size() * 2);
+
+  // Only traverse if there is an attribute saying so
+  auto propagate = [](NodeT & node) {
+    node.mPropagate = node.mCont->hasAttribute("sys.mtime.propagation");
+    return node.mPropagate;
+  };
+
+  for (auto const& elem : batch.mSet) {
+    // Walk up until reaching the root, a container which does not propagate
+    // or an already resolved ancestor
+    if (ResolveAncestors(mContainerMDSvc, elem, nodes, path, propagate)) {
+      ++num_merged;
+    }
+
+    auto it_node = nodes.find(elem);
+
+    if (it_node != nodes.end()) {
+      it_node->second.mQueued = true;
+    }
   }
+
+  OrderByDepth(nodes, order, [](const NodeT & node) {
+    return node.mPropagate;
+  });
+  return num_merged;
 }
 
 //------------------------------------------------------------------------------
@@ -94,6 +140,10 @@ QuarkSyncTimeAccounting::QueueForUpdate(IContainerMD::id_t id)
 void
 QuarkSyncTimeAccounting::PropagateUpdates()
 {
+  using namespace std::chrono;
+  std::unordered_map<IContainerMD::id_t, NodeT> nodes;
+  std::vector<NodeT*> order;
+
   while (true) {
     if (mShutdown) {
       break;
@@ -106,70 +156,101 @@ QuarkSyncTimeAccounting::PropagateUpdates()
       std::swap(mAccumulateIndx, mCommitIndx);
     }
 
-    uint16_t deepness = 0;
-    IContainerMD::id_t id = 0;
-    std::set<IContainerMD::id_t> upd_nodes;
-    auto& lst = mBatch[mCommitIndx].mLstUpd;
+    auto& batch = mBatch[mCommitIndx];
 
-    // Start updating form the last node (most recent) and also collect the
-    // nodes that we've updated so that older updates don't propagate further
-    // up than strictly necessary.
-    for (auto it_id = lst.rbegin(); it_id != lst.rend(); ++it_id) {
-      deepness = 0;
-      id = *it_id;
+    if (!batch.mSet.empty()) {
+      // Resolve the containers without holding the namespace lock, this only
+      // serves as a prefetch, they are fetched again under the lock
+      auto start = steady_clock::now();
+      uint64_t num_merged = ResolveBatch(batch, nodes, order);
+      auto resolved = steady_clock::now();
+      uint64_t num_updated = 0;
+      uint64_t num_skipped = 0;
+      {
+        eos::common::RWMutexWriteLock wr_lock(*gNsRwMutex);
 
-      if (id == 0u) {
-        continue;
-      }
+        // Deepest containers first so that every ancestor gets the most
+        // recent sync time of its whole subtree in a single update
+        for (auto node : order) {
+          if (!node->mQueued && !node->mPending) {
+            continue;
+          }
 
-      eos_debug("Container_id=%lu sync time", id);
-      IContainerMD::ctime_t mtime {0};
-      eos::common::RWMutexWriteLock wr_lock(*gNsRwMutex);
+          bool changed = false;
+          bool newer = false;
 
-      while ((id > 1) && (deepness < 255)) {
-        std::shared_ptr<IContainerMD> cont;
+          try {
+            // The container might have been removed since it was resolved
+            auto cont = mContainerMDSvc->getContainerMD(node->mCont->getId());
 
-        // If node is already in the set of updates then don't bother
-        // propagating this update
-        if (upd_nodes.count(id)) {
-          break;
-        }
+            // If there was a temporary ETAG this has to be removed
+            if (cont->hasAttribute("sys.tmp.etag")) {
+              cont->removeAttribute("sys.tmp.etag");
+              changed = true;
+            }
 
-        try {
-          cont = mContainerMDSvc->getContainerMD(id);
+            if (node->mQueued) {
+              IContainerMD::ctime_t mtime {0};
+              cont->getMTime(mtime);
 
-          // Only traverse if there there is an attribute saying so
-          if (!cont->hasAttribute("sys.mtime.propagation")) {
-            break;
-          }
+              if (!node->mPending || IsNewer(mtime, node->mTMTime)) {
+                node->mTMTime = mtime;
+              }
+            }
 
-	  // If there was a temporary ETAG this has not to be removed
-	  if (cont->hasAttribute("sys.tmp.etag")) {
-	    cont->removeAttribute("sys.tmp.etag");
-	  }
+            newer = cont->setTMTime(node->mTMTime);
 
-          if (deepness == 0u) {
-            cont->getMTime(mtime);
+            if (newer || changed || node->mQueued) {
+              mContainerMDSvc->updateStore(cont.get());
+              ++num_updated;
+            }
+          } catch (const MDException& e) {
+            continue;
           }
 
-          if (!cont->setTMTime(mtime) && deepness) {
-            break;
+          eos_debug("container_id=%lu sync time updated=%i", node->mCont->getId(),
+                    newer);
+
+          // Stop here if the ancestor already carries a newer sync time,
+          // the containers queued in the batch always propagate further up
+          if (!newer && !node->mQueued) {
+            ++num_skipped;
+            continue;
           }
 
-          (void) upd_nodes.insert(id);
-          mContainerMDSvc->updateStore(cont.get());
-        } catch (MDException& e) {
-          cont = nullptr;
-          break;
-        }
+          auto it_parent = nodes.find(node->mParentId);
+
+          if ((it_parent != nodes.end()) && it_parent->second.mPropagate) {
+            NodeT& parent = it_parent->second;
 
-        id = cont->getParentId();
-        ++deepness;
+            if (!parent.mPending || IsNewer(node->mTMTime, parent.mTMTime)) {
+              parent.mTMTime = node->mTMTime;
+            }
+
+            parent.mPending = true;
+          }
+        }
       }
+      auto done = steady_clock::now();
+      uint64_t resolve_us = duration_cast<microseconds>(resolved - start).count();
+      uint64_t lock_us = duration_cast<microseconds>(done - resolved).count();
+      {
+        std::lock_guard<std::mutex> scope_lock(mMutexStats);
+        mStats.Record(batch.mSet.size(), num_updated, num_merged, resolve_us,
+                      lock_us);
+        mStats.skipped += num_skipped;
+        mStats.lastSkipped = num_skipped;
+      }
+      eos_static_debug("msg=\"propagated sync time\" queued=%lu updated=%lu "
+                       "merged=%lu skipped=%lu resolve_us=%lu lock_us=%lu",
+                       batch.mSet.size(), num_updated, num_merged, num_skipped,
+                       resolve_us, lock_us);
+      nodes.clear();
+      order.clear();
     }
 
     // Clean up the batch
-    mBatch[mCommitIndx].Clean();
+    batch.Clean();
 
     if (mUpdateIntervalSec) {
       std::this_thread::sleep_for(std::chrono::seconds(mUpdateIntervalSec));
@@ -179,4 +260,14 @@ QuarkSyncTimeAccounting::PropagateUpdates()
   }
 }
 
+//------------------------------------------------------------------------------
+// Get statistics of the propagated batches
+//------------------------------------------------------------------------------
+QuarkSyncTimeAccounting::Statistics
+QuarkSyncTimeAccounting::GetStatistics()
+{
+  std::lock_guard<std::mutex> scope_lock(mMutexStats);
+  return mStats;
+}
+
 EOSNSNAMESPACE_END
@@ -25,12 +25,15 @@
 #include "namespace/MDException.hh"
 #include "namespace/Namespace.hh"
 #include "namespace/interface/IContainerMDSvc.hh"
+#include "namespace/ns_quarkdb_static/accounting/AccountingBatch.hh"
 #include "common/Logging.hh"
 #include "common/RWMutex.hh"
 #include <mutex>
 #include <thread>
-#include <list>
+#include <memory>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <atomic>
 
 EOSNSNAMESPACE_BEGIN
@@ -86,25 +89,59 @@ public:
   //----------------------------------------------------------------------------
   void QueueForUpdate(IContainerMD::id_t id);
 
+  //----------------------------------------------------------------------------
+  //! Statistics of the propagated batches
+  //----------------------------------------------------------------------------
+  struct Statistics : public AccountingStatistics {
+    uint64_t skipped = 0; ///< Propagations stopped by a newer sync time
+    uint64_t lastSkipped = 0; ///< Propagations stopped in the last batch
+  };
+
+  //----------------------------------------------------------------------------
+  //! Get statistics of the propagated batches
+  //----------------------------------------------------------------------------
+  Statistics GetStatistics();
+
 private:
 
-  //! Update structure containing a list of the nodes that need an update in
-  //! the order that the updates need to be applied and also a map used for
-  //! filtering out multiple updates to the same container ID. Try to optimise
-  //! the number of updates to a container by keeping only the last one.
+  //! Update structure containing the containers whose mtime changed. The
+  //! order of the updates does not matter since every ancestor only keeps
+  //! the most recent sync time coming from its subtree.
   struct UpdateT {
-    std::list<IContainerMD::id_t> mLstUpd; ///< Ordered list of updates
-    //! Map used for fast search/insert operations
-    std::unordered_map<IContainerMD::id_t,
-        std::list<IContainerMD::id_t>::iterator > mMap;
+    std::unordered_set<IContainerMD::id_t> mSet; ///< Containers to update
 
     void Clean()
     {
-      mLstUpd.clear();
-      mMap.clear();
+      mSet.clear();
     }
   };
 
+  //! Container taking part in the propagation of a batch
+  struct NodeT {
+    std::shared_ptr<IContainerMD> mCont; ///< Container object
+    IContainerMD::id_t mParentId = 0; ///< Parent container id
+    uint16_t mDepth = 0; ///< Depth below the topmost resolved ancestor
+    bool mPropagate = false; ///< Container has sys.mtime.propagation
+    bool mQueued = false; ///< Container is part of the batch
+    bool mPending = false; ///< Container received a sync time to apply
+    IContainerMD::tmtime_t mTMTime {0, 0}; ///< Most recent subtree sync time
+  };
+
+  //----------------------------------------------------------------------------
+  //! Resolve the containers of the batch and all their ancestors up to the
+  //! first one without the sys.mtime.propagation attribute, each one looked
+  //! up only once.
+  //!
+  //! @param batch batch of updates
+  //! @param nodes resolved containers
+  //! @param order containers ordered from the deepest to the topmost
+  //!
+  //! @return number of ancestor walks which joined an already resolved path
+  //----------------------------------------------------------------------------
+  uint64_t ResolveBatch(const UpdateT& batch,
+                        std::unordered_map<IContainerMD::id_t, NodeT>& nodes,
+                        std::vector<NodeT*>& order);
+
   //! Vector of two elements containing the batch which is currently being
   //! accumulated and the batch which is being committed to the namespace by the
   //! asynchronous thread
@@ -117,6 +154,8 @@ private:
   uint32_t mUpdateIntervalSec; ///< Interval in seconds when updates are pushed
   IContainerMDSvc* mContainerMDSvc; ///< Container meta-data service
   eos::common::RWMutex* gNsRwMutex; ///< Global(MGM) namespace RW mutex
+  std::mutex mMutexStats; ///< Mutex protecting the statistics
+  Statistics mStats; ///< Statistics of the propagated batches
 };
 
 EOSNSNAMESPACE_END
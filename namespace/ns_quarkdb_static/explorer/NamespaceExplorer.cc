@@ -21,6 +21,8 @@
 #include "namespace/ns_quarkdb/persistency/MetadataFetcher.hh"
 #include "namespace/utils/Attributes.hh"
 #include "common/Assert.hh"
+#include <algorithm>
+#include <limits>
 #include <memory>
 #include <numeric>
 
@@ -37,6 +39,30 @@ SearchNode::SearchNode(NamespaceExplorer &expl, ContainerIdentifier d, eos::Sear
 {
   fileMap = MetadataFetcher::getFilesInContainer(qcl, ContainerIdentifier(id));
   containerMap = MetadataFetcher::getSubContainers(qcl, ContainerIdentifier(id));
+  explorer.numContainersInFlight++;
+  explorer.peakContainersInFlight = std::max(explorer.peakContainersInFlight,
+                                    explorer.numContainersInFlight);
+
+  if (explorer.options.maxContainersInFlight != 0) {
+    prefetchIt = explorer.prefetchQueue.insert(explorer.prefetchQueue.end(), this);
+    inPrefetchQueue = true;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Destructor
+//------------------------------------------------------------------------------
+SearchNode::~SearchNode()
+{
+  if (fetchesInFlight) {
+    explorer.numContainersInFlight--;
+  }
+
+  explorer.numPendingFiles -= pendingFileMds.size();
+
+  if (inPrefetchQueue) {
+    explorer.prefetchQueue.erase(prefetchIt);
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -45,6 +71,8 @@ SearchNode::SearchNode(NamespaceExplorer &expl, ContainerIdentifier d, eos::Sear
 //------------------------------------------------------------------------------
 void SearchNode::handleAsync()
 {
+  checkArrived();
+
   if (!pendingFileMdsLoaded && fileMap.ready()) {
     stageFileMds();
   }
@@ -54,6 +82,57 @@ void SearchNode::handleAsync()
   }
 }
 
+//------------------------------------------------------------------------------
+// Stop counting this container as in flight once all its first round
+// requests have arrived
+//------------------------------------------------------------------------------
+void SearchNode::checkArrived()
+{
+  if (fetchesInFlight && containerMd.ready() && fileMap.ready() &&
+      containerMap.ready()) {
+    fetchesInFlight = false;
+    explorer.numContainersInFlight--;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Stage file mds and children whose maps have arrived, as long as we stay
+// within the prefetch limits. Children are staged as far as the containers in
+// flight allow, so the children of wide containers are prefetched in several
+// steps. Subcontainers which the expansion decider filters out are never
+// staged.
+//------------------------------------------------------------------------------
+bool SearchNode::prefetch()
+{
+  const ExplorationOptions& opts = explorer.options;
+  checkArrived();
+
+  if (!pendingFileMdsLoaded && fileMap.ready() &&
+      explorer.numPendingFiles + fileMap->size() <= opts.maxFilesInFlight) {
+    stageFileMds();
+  }
+
+  if (!childrenLoaded && containerMap.ready()) {
+    ExpansionDecider* decider = opts.expansionDecider.get();
+
+    if (decider) {
+      if (!containerMd.ready()) {
+        return false;
+      }
+
+      if (!decider->shouldExpandContainer(getContainerInfo())) {
+        return pendingFileMdsLoaded && !fetchesInFlight;
+      }
+    }
+
+    if (explorer.numContainersInFlight < opts.maxContainersInFlight) {
+      stageChildren(opts.maxContainersInFlight - explorer.numContainersInFlight);
+    }
+  }
+
+  return pendingFileMdsLoaded && childrenLoaded && !fetchesInFlight;
+}
+
 //------------------------------------------------------------------------------
 // Unconditionally stage file mds, block if necessary. Call this only if:
 // - Search really needs the result.
@@ -77,6 +156,8 @@ void SearchNode::stageFileMds()
   for (auto it = sortedFileMap.begin(); it != sortedFileMap.end(); it++) {
     pendingFileMds.push_back(MetadataFetcher::getFileFromId(qcl, FileIdentifier(it->second)));
   }
+
+  explorer.numPendingFiles += pendingFileMds.size();
 }
 
 //------------------------------------------------------------------------------
@@ -89,7 +170,15 @@ std::unique_ptr<SearchNode> SearchNode::expand()
     return {}; // nope, this node is being filtered out
   }
 
-  stageChildren();
+  if (children.empty()) {
+    // In parallel mode stage only the child visited next, prefetching takes
+    // care of the rest within the limits
+    stageChildren(explorer.options.maxContainersInFlight ? 1 :
+                  std::numeric_limits<size_t>::max());
+  }
+
+  // Both maps have arrived by now, the container md when it was visited
+  checkArrived();
 
   if (children.empty()) {
     return {}; // nullptr, node has no more children to expand
@@ -119,29 +208,40 @@ struct FilesystemEntryComparator {
 };
 
 //------------------------------------------------------------------------------
-// Unconditionally stage container mds, block if necessary. Call this only if:
+// Unconditionally stage up to max_children container mds, in name order,
+// block if necessary. Call this only if:
 // - Search really needs the result.
 // - When prefetching, when you know containerMap is ready.
 //------------------------------------------------------------------------------
-void SearchNode::stageChildren()
+void SearchNode::stageChildren(size_t max_children)
 {
   if (childrenLoaded) {
     return;
   }
 
-  childrenLoaded = true;
-  // containerMap is hashmap, thus unsorted... must sort first by filename.. sigh.
-  // storing into a vector and calling std::sort might be faster, TODO
-  std::map<std::string, IContainerMD::id_t, FilesystemEntryComparator> sortedContainerMap;
+  if (!childrenSorted) {
+    childrenSorted = true;
+    // containerMap is hashmap, thus unsorted... must sort first by filename.. sigh.
+    // storing into a vector and calling std::sort might be faster, TODO
+    std::map<std::string, IContainerMD::id_t, FilesystemEntryComparator> sortedContainerMap;
+
+    for (auto it = containerMap->begin(); it != containerMap->end(); it++) {
+      sortedContainerMap[it->first] = it->second;
+    }
 
-  for (auto it = containerMap->begin(); it != containerMap->end(); it++) {
-    sortedContainerMap[it->first] = it->second;
+    for (auto it = sortedContainerMap.begin(); it != sortedContainerMap.end();
+         it++) {
+      unstagedChildren.push_back(it->second);
+    }
   }
 
-  for (auto it = sortedContainerMap.begin(); it != sortedContainerMap.end();
-       it++) {
-    children.emplace_back(new SearchNode(explorer, ContainerIdentifier(it->second), this));
+  for (; max_children > 0 && !unstagedChildren.empty(); --max_children) {
+    children.emplace_back(new SearchNode(explorer,
+                                         ContainerIdentifier(unstagedChildren.front()), this));
+    unstagedChildren.pop_front();
   }
+
+  childrenLoaded = unstagedChildren.empty();
 }
 
 //------------------------------------------------------------------------------
@@ -157,6 +257,7 @@ bool SearchNode::fetchChild(eos::ns::FileMdProto& output)
 
   output = pendingFileMds[0].get();
   pendingFileMds.pop_front();
+  explorer.numPendingFiles--;
   return true;
 }
 
@@ -281,6 +382,31 @@ std::string NamespaceExplorer::buildDfsPath()
   return ss.str();
 }
 
+//------------------------------------------------------------------------------
+// Advance prefetching of queued containers. Queue order is creation order,
+// thus roughly breadth-first. Examine at most maxContainersInFlight nodes per
+// call, so that a huge queue of nodes staged by the DFS itself doesn't make
+// every call expensive.
+//------------------------------------------------------------------------------
+void NamespaceExplorer::prefetch()
+{
+  size_t budget = options.maxContainersInFlight;
+  auto it = prefetchQueue.begin();
+
+  while (it != prefetchQueue.end() && budget-- > 0) {
+    SearchNode* node = *it;
+    // Staging children appends to the queue, it's fine - the iterator
+    // remains valid, and they'll be looked at during this pass if in budget.
+    bool done = node->prefetch();
+    it++;
+
+    if (done) {
+      prefetchQueue.erase(node->prefetchIt);
+      node->inPrefetchQueue = false;
+    }
+  }
+}
+
 //------------------------------------------------------------------------------
 // Handle linked attributes
 //------------------------------------------------------------------------------
@@ -374,6 +500,7 @@ bool NamespaceExplorer::fetch(NamespaceItem& item)
 
     // Has top node been visited yet?
     if (!dfsPath.back()->isVisited()) {
+      prefetch();
       dfsPath.back()->visit();
       item.isFile = false;
       item.fullPath = buildDfsPath();
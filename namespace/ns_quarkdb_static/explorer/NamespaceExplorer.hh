@@ -32,6 +32,8 @@
 #include <string>
 #include <vector>
 #include <deque>
+#include <limits>
+#include <list>
 #include <folly/futures/Future.h>
 
 namespace qclient
@@ -58,6 +60,17 @@ struct ExplorationOptions {
   bool populateLinkedAttributes = false;
   bool prefixLinks = false; // only relevant if populateLinkedAttributes is true
 
+  //----------------------------------------------------------------------------
+  // Parallel exploration: max number of containers whose fetches are in
+  // flight, and of file mds, which may be fetched ahead of the search cursor.
+  // The search itself may add the one container it visits next on top. With
+  // zero containers only the children of the container currently being
+  // explored are fetched. Results are emitted in the same order in both
+  // modes.
+  //----------------------------------------------------------------------------
+  size_t maxContainersInFlight = 0;
+  size_t maxFilesInFlight = 100000;
+
   //----------------------------------------------------------------------------
   // You must supply the view if populateLinkedAttributes = true
   //----------------------------------------------------------------------------
@@ -89,6 +102,7 @@ class SearchNode
 {
 public:
   SearchNode(NamespaceExplorer &explorer, ContainerIdentifier id, SearchNode* prnt);
+  ~SearchNode();
   inline ContainerIdentifier getID() const
   {
     return id;
@@ -100,6 +114,10 @@ public:
   // Handle asynchronous operations - call this as often as possible!
   void handleAsync();
 
+  // Stage whatever is ready within the prefetch limits, never blocks. Return
+  // true if there's nothing left to prefetch for this node.
+  bool prefetch();
+
   // Explicit transfer of ownership
   std::unique_ptr<SearchNode> expand();
 
@@ -124,6 +142,7 @@ public:
   eos::ns::ContainerMdProto& getContainerInfo();
 
 private:
+  friend class NamespaceExplorer;
   NamespaceExplorer &explorer;
   ContainerIdentifier id;
   qclient::QClient& qcl;
@@ -140,12 +159,22 @@ private:
   bool pendingFileMdsLoaded = false;
 
   std::deque<std::unique_ptr<SearchNode>> children; // expanded containers
+  std::deque<IContainerMD::id_t> unstagedChildren; // sorted, not yet expanded
+  bool childrenSorted = false;
   bool childrenLoaded = false;
 
+  // Whether the first round of requests is still counted as in flight
+  bool fetchesInFlight = true;
+
+  // Position inside the explorer's prefetch queue, if queued
+  std::list<SearchNode*>::iterator prefetchIt;
+  bool inPrefetchQueue = false;
+
   // @todo (gbitzes): Replace this mess with a nice iterator object which
   // provides all children of a container, fully asynchronous with prefetching.
   void stageFileMds();
-  void stageChildren();
+  void stageChildren(size_t max_children = std::numeric_limits<size_t>::max());
+  void checkArrived();
 };
 
 //------------------------------------------------------------------------------
@@ -153,7 +182,9 @@ private:
 //! Useful for "Find" commands - no consistency guarantees, if a write is in
 //! the flusher, it might not be seen here.
 //!
-//! Implemented by simple DFS on the namespace.
+//! Implemented by simple DFS on the namespace. In parallel mode, containers
+//! ahead of the DFS cursor are prefetched breadth-first, keeping up to
+//! maxContainersInFlight of them staged at any time.
 //------------------------------------------------------------------------------
 class NamespaceExplorer
 {
@@ -170,11 +201,25 @@ public:
   //----------------------------------------------------------------------------
   bool fetch(NamespaceItem& result);
 
+  //----------------------------------------------------------------------------
+  //! Get the max number of containers which had fetches in flight at the
+  //! same time so far
+  //----------------------------------------------------------------------------
+  size_t getPeakContainersInFlight() const
+  {
+    return peakContainersInFlight;
+  }
+
 private:
   friend class SearchNode;
   std::string buildStaticPath();
   std::string buildDfsPath();
 
+  //----------------------------------------------------------------------------
+  // Advance prefetching of queued containers, never blocks
+  //----------------------------------------------------------------------------
+  void prefetch();
+
   //----------------------------------------------------------------------------
   // Handle linked attributes
   //----------------------------------------------------------------------------
@@ -192,6 +237,12 @@ private:
   bool searchOnFile = false;
   bool searchOnFileEnded = false;
 
+  // Must outlive dfsPath, nodes remove themselves from the queue on destruction
+  std::list<SearchNode*> prefetchQueue;
+  size_t numContainersInFlight = 0;
+  size_t peakContainersInFlight = 0;
+  size_t numPendingFiles = 0;
+
   std::vector<std::unique_ptr<SearchNode>> dfsPath;
   std::map<std::string, eos::IContainerMD::XAttrMap> cachedAttrs;
 };
@@ -17,6 +17,7 @@
  ************************************************************************/
 
 #include <inttypes.h>
+#include <algorithm>
 #include <iostream>
 #include <list>
 #include <sstream>
@@ -40,7 +41,7 @@ EOSNSNAMESPACE_BEGIN
 //------------------------------------------------------------------------------
 MetadataFlusher::MetadataFlusher(const std::string& path,
                                  const QdbContactDetails& contactDetails) :
-  id(basename(path.c_str())),
+  id(basename(path.c_str())), mMaxPending(0), mEnqueued(0), mAcknowledged(0),
   notifier(*this),
   backgroundFlusher(contactDetails.members, contactDetails.constructOptions(),
                     notifier, new qclient::RocksDBPersistency(path)),
@@ -59,23 +60,55 @@ MetadataFlusher::~MetadataFlusher()
 }
 
 //------------------------------------------------------------------------------
-// Regularly print queue statistics
+// Regularly sample and print queue statistics
 //------------------------------------------------------------------------------
 void MetadataFlusher::queueSizeMonitoring(qclient::ThreadAssistant& assistant)
 {
-  while (!assistant.terminationRequested()) {
-    if (backgroundFlusher.size()) {
-      eos_static_info("id=%s total-pending=%" PRId64 " enqueued=%" PRId64
-                      " acknowledged=%" PRId64,
-                      id.c_str(), backgroundFlusher.size(),
-                      backgroundFlusher.getEnqueuedAndClear(),
-                      backgroundFlusher.getAcknowledgedAndClear());
+  int64_t enqueued = 0;
+  int64_t acknowledged = 0;
+
+  for (uint64_t round = 1; !assistant.terminationRequested(); ++round) {
+    int64_t pending = backgroundFlusher.size();
+    int64_t new_enqueued = backgroundFlusher.getEnqueuedAndClear();
+    int64_t new_acknowledged = backgroundFlusher.getAcknowledgedAndClear();
+    mEnqueued += new_enqueued;
+    mAcknowledged += new_acknowledged;
+    enqueued += new_enqueued;
+    acknowledged += new_acknowledged;
+
+    if (pending > mMaxPending) {
+      mMaxPending = pending;
+    }
+
+    if (round % 10 == 0) {
+      if (pending) {
+        eos_static_info("id=%s total-pending=%" PRId64 " max-pending=%" PRId64
+                        " enqueued=%" PRId64 " acknowledged=%" PRId64,
+                        id.c_str(), pending, mMaxPending.load(), enqueued,
+                        acknowledged);
+      }
+
+      enqueued = 0;
+      acknowledged = 0;
     }
 
-    assistant.wait_for(std::chrono::seconds(10));
+    assistant.wait_for(std::chrono::seconds(1));
   }
 }
 
+//------------------------------------------------------------------------------
+// Get statistics of the flusher queue
+//------------------------------------------------------------------------------
+MetadataFlusher::Statistics MetadataFlusher::getStatistics()
+{
+  Statistics stats;
+  stats.pending = backgroundFlusher.size();
+  stats.maxPending = std::max(mMaxPending.load(), stats.pending);
+  stats.enqueued = mEnqueued;
+  stats.acknowledged = mAcknowledged;
+  return stats;
+}
+
 //------------------------------------------------------------------------------
 // Queue an hset command
 //------------------------------------------------------------------------------
@@ -190,6 +223,11 @@ void MetadataFlusherFactory::setQueuePath(const std::string& newpath)
   queuePath = newpath;
 }
 
+std::string MetadataFlusherFactory::getQueuePath()
+{
+  return queuePath;
+}
+
 std::shared_ptr<MetadataFlusher>
 MetadataFlusherFactory::getInstance(const std::string& id,
                                     const QdbContactDetails& contactDetails)
@@ -215,6 +253,27 @@ MetadataFlusherFactory::getInstance(const std::string& id,
   return instances[key];
 }
 
+//------------------------------------------------------------------------------
+// Get statistics of the queues of all flusher instances
+//------------------------------------------------------------------------------
+std::map<std::string, MetadataFlusher::Statistics>
+MetadataFlusherFactory::getStatistics()
+{
+  std::map<std::string, MetadataFlusher::Statistics> stats;
+  std::lock_guard<std::mutex> lock(MetadataFlusherFactory::mtx);
+
+  for (const auto& elem : instances) {
+    MetadataFlusher::Statistics flusher_stats = elem.second->getStatistics();
+    MetadataFlusher::Statistics& total = stats[std::get<0>(elem.first)];
+    total.pending += flusher_stats.pending;
+    total.maxPending = std::max(total.maxPending, flusher_stats.maxPending);
+    total.enqueued += flusher_stats.enqueued;
+    total.acknowledged += flusher_stats.acknowledged;
+  }
+
+  return stats;
+}
+
 //------------------------------------------------------------------------------
 // Class to receive notifications from the BackgroundFlusher
 //------------------------------------------------------------------------------
@@ -28,6 +28,7 @@
 #include "namespace/ns_quarkdb/LRU.hh"
 #include "qclient/BackgroundFlusher.hh"
 #include "qclient/AssistedThread.hh"
+#include <atomic>
 #include <list>
 #include <map>
 
@@ -100,9 +101,27 @@ public:
   //----------------------------------------------------------------------------
   void synchronize(ItemIndex targetIndex = -1);
 
+  //----------------------------------------------------------------------------
+  //! Statistics of the flusher queue, sampled every second
+  //----------------------------------------------------------------------------
+  struct Statistics {
+    int64_t pending = 0; ///< Requests currently in the queue
+    int64_t maxPending = 0; ///< Largest queue size observed
+    int64_t enqueued = 0; ///< Total requests enqueued
+    int64_t acknowledged = 0; ///< Total requests acknowledged by the backend
+  };
+
+  //----------------------------------------------------------------------------
+  //! Get statistics of the flusher queue
+  //----------------------------------------------------------------------------
+  Statistics getStatistics();
+
 private:
   void queueSizeMonitoring(qclient::ThreadAssistant& assistant);
   std::string id;
+  std::atomic<int64_t> mMaxPending; ///< Largest queue size observed
+  std::atomic<int64_t> mEnqueued; ///< Total requests enqueued
+  std::atomic<int64_t> mAcknowledged; ///< Total requests acknowledged
 
   FlusherNotifier notifier;
   qclient::BackgroundFlusher backgroundFlusher;
@@ -116,6 +135,14 @@ public:
   getInstance(const std::string& id,
               const QdbContactDetails& contactDetails);
   static void setQueuePath(const std::string& newpath);
+  static std::string getQueuePath();
+
+  //----------------------------------------------------------------------------
+  //! Get statistics of the queues of all flusher instances
+  //!
+  //! @return map of flusher id to queue statistics
+  //----------------------------------------------------------------------------
+  static std::map<std::string, MetadataFlusher::Statistics> getStatistics();
 private:
   static std::string queuePath;
   static std::mutex mtx;
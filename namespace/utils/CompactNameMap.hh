@@ -0,0 +1,526 @@
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+//------------------------------------------------------------------------------
+//! @brief Memory efficient map of child names to ids, meant for containers
+//!        holding millions of entries
+//------------------------------------------------------------------------------
+
+#pragma once
+#include "namespace/Namespace.hh"
+#include "common/Murmur3.hh"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+EOSNSNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Class CompactNameMap
+//!
+//! Map of child names to ids used as file and subcontainer index of the
+//! containers, see IContainerMD::FileMap and ContainerMap. Names and ids are
+//! interned back to back in a single arena, the hash table is open addressing
+//! over 8 byte slots holding the arena offset and the name hash. Compared to
+//! one std::string plus dense hash slack per entry, this needs roughly name
+//! length + 25 bytes per entry.
+//!
+//! Erased entries leave garbage in the arena, which is reclaimed on the next
+//! rehash once it makes up half of the arena. Iteration order is undefined.
+//! Insertions invalidate all iterators, erase only invalidates iterators to
+//! the erased entry, so erasing while iterating is fine. Not thread-safe,
+//! same as the map it replaces.
+//------------------------------------------------------------------------------
+template <typename IdT>
+class CompactNameMap
+{
+public:
+  using value_type = std::pair<std::string, IdT>;
+
+  //----------------------------------------------------------------------------
+  //! Iterator materializing one (name, id) pair at a time, only when it is
+  //! dereferenced
+  //----------------------------------------------------------------------------
+  class const_iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = CompactNameMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+
+    const_iterator(): mMap(nullptr), mPos(0), mLoaded(false) {}
+
+    reference operator*() const
+    {
+      load();
+      return mValue;
+    }
+
+    pointer operator->() const
+    {
+      load();
+      return &mValue;
+    }
+
+    const_iterator& operator++()
+    {
+      ++mPos;
+      settle();
+      return *this;
+    }
+
+    const_iterator operator++(int)
+    {
+      const_iterator tmp = *this;
+      ++(*this);
+      return tmp;
+    }
+
+    bool operator==(const const_iterator& other) const
+    {
+      return (mMap == other.mMap) && (mPos == other.mPos);
+    }
+
+    bool operator!=(const const_iterator& other) const
+    {
+      return !(*this == other);
+    }
+
+  private:
+    friend class CompactNameMap;
+
+    const_iterator(const CompactNameMap* map, size_t pos):
+      mMap(map), mPos(pos), mLoaded(false)
+    {
+      settle();
+    }
+
+    //! Skip to the next live slot
+    void settle()
+    {
+      mLoaded = false;
+
+      while ((mPos < mMap->mSlots.size()) &&
+             !isLive(mMap->mSlots[mPos].mOffset)) {
+        ++mPos;
+      }
+    }
+
+    //! Materialize the value of the current slot
+    void load() const
+    {
+      if (!mLoaded) {
+        mMap->readEntry(mMap->mSlots[mPos].mOffset, mValue);
+        mLoaded = true;
+      }
+    }
+
+    const CompactNameMap* mMap;
+    size_t mPos;
+    mutable value_type mValue;
+    mutable bool mLoaded;
+  };
+
+  using iterator = const_iterator;
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //----------------------------------------------------------------------------
+  CompactNameMap(): mSize(0), mTombstones(0), mGarbage(0)
+  {
+    mArena.push_back('\0'); // offset 0 marks empty slots
+  }
+
+  //----------------------------------------------------------------------------
+  //! Number of entries
+  //----------------------------------------------------------------------------
+  size_t size() const
+  {
+    return mSize;
+  }
+
+  bool empty() const
+  {
+    return (mSize == 0);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Iterators
+  //----------------------------------------------------------------------------
+  const_iterator begin() const
+  {
+    return const_iterator(this, 0);
+  }
+
+  const_iterator end() const
+  {
+    return const_iterator(this, mSlots.size());
+  }
+
+  //----------------------------------------------------------------------------
+  //! Find entry with the given name
+  //----------------------------------------------------------------------------
+  const_iterator find(const std::string& name) const
+  {
+    size_t pos = findSlot(name, hashName(name));
+
+    if (pos == kNotFound) {
+      return end();
+    }
+
+    return const_iterator(this, pos);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get id of the entry with the given name, cheaper than find
+  //!
+  //! @return true if found, otherwise false
+  //----------------------------------------------------------------------------
+  bool get(const std::string& name, IdT& id) const
+  {
+    size_t pos = findSlot(name, hashName(name));
+
+    if (pos == kNotFound) {
+      return false;
+    }
+
+    memcpy(&id, &mArena[mSlots[pos].mOffset], sizeof(IdT));
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Number of entries with the given name, 0 or 1
+  //----------------------------------------------------------------------------
+  size_t count(const std::string& name) const
+  {
+    return (findSlot(name, hashName(name)) == kNotFound) ? 0 : 1;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Insert entry, or overwrite the id of the existing entry with the given
+  //! name. Replaces operator[], ids can't be handed out by reference since
+  //! they live in the arena.
+  //----------------------------------------------------------------------------
+  void insert_or_assign(const std::string& name, IdT id)
+  {
+    size_t pos = findSlot(name, hashName(name));
+
+    if (pos == kNotFound) {
+      (void) insert(std::make_pair(name, id));
+      return;
+    }
+
+    memcpy(&mArena[mSlots[pos].mOffset], &id, sizeof(IdT));
+  }
+
+  //----------------------------------------------------------------------------
+  //! Insert entry, existing entries are not overwritten
+  //!
+  //! @return pair of iterator to the entry with the given name and whether
+  //!         the insertion took place
+  //----------------------------------------------------------------------------
+  std::pair<const_iterator, bool> insert(const value_type& entry)
+  {
+    uint32_t hash = hashName(entry.first);
+    size_t pos = findSlot(entry.first, hash);
+
+    if (pos != kNotFound) {
+      return std::make_pair(const_iterator(this, pos), false);
+    }
+
+    if ((mSize + mTombstones + 1) * 4 > mSlots.size() * 3) {
+      rehash(std::max<size_t>(mSize + 1, 8) * 2);
+    }
+
+    uint32_t offset = appendEntry(entry.first, entry.second);
+    size_t mask = mSlots.size() - 1;
+    pos = hash & mask;
+
+    while (isLive(mSlots[pos].mOffset)) {
+      pos = (pos + 1) & mask;
+    }
+
+    if (mSlots[pos].mOffset == kTombstone) {
+      --mTombstones;
+    }
+
+    mSlots[pos].mOffset = offset;
+    mSlots[pos].mHash = hash;
+    ++mSize;
+    return std::make_pair(const_iterator(this, pos), true);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Erase entry with the given name
+  //!
+  //! @return number of erased entries
+  //----------------------------------------------------------------------------
+  size_t erase(const std::string& name)
+  {
+    size_t pos = findSlot(name, hashName(name));
+
+    if (pos == kNotFound) {
+      return 0;
+    }
+
+    eraseSlot(pos);
+    return 1;
+  }
+
+  void erase(const_iterator it)
+  {
+    eraseSlot(it.mPos);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Remove all entries and release memory
+  //----------------------------------------------------------------------------
+  void clear()
+  {
+    std::vector<Slot>().swap(mSlots);
+    std::vector<char>(1, '\0').swap(mArena);
+    mSize = mTombstones = mGarbage = 0;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Drop tombstones and arena garbage, shrinking memory to fit
+  //----------------------------------------------------------------------------
+  void compact()
+  {
+    mGarbage = mArena.size(); // force arena compaction
+    rehash(mSize + mSize / 3 + 1);
+    mArena.shrink_to_fit();
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get number of bytes allocated by the map
+  //----------------------------------------------------------------------------
+  size_t getMemoryUsage() const
+  {
+    return sizeof(*this) + mSlots.capacity() * sizeof(Slot) +
+           mArena.capacity();
+  }
+
+private:
+  //! Hash table slot
+  struct Slot {
+    uint32_t mOffset; ///< Offset of the entry in the arena
+    uint32_t mHash; ///< Lower bits of the name hash
+  };
+
+  static constexpr uint32_t kTombstone = UINT32_MAX;
+  static constexpr size_t kNotFound = SIZE_MAX;
+
+  static bool isLive(uint32_t offset)
+  {
+    return (offset != 0) && (offset != kTombstone);
+  }
+
+  static uint32_t hashName(const std::string& name)
+  {
+    return static_cast<uint32_t>(Murmur3::MurmurHasher<std::string>()(name));
+  }
+
+  //----------------------------------------------------------------------------
+  //! Arena entry layout: id, name length as varint, name bytes
+  //----------------------------------------------------------------------------
+  uint32_t appendEntry(const std::string& name, IdT id)
+  {
+    size_t offset = mArena.size();
+
+    if (offset + sizeof(IdT) + 5 + name.size() >= kTombstone) {
+      throw std::length_error("CompactNameMap arena exceeds 4GB");
+    }
+
+    // Grow by a quarter instead of doubling, the arena is the bulk of memory
+    size_t needed = offset + sizeof(IdT) + 5 + name.size();
+
+    if (needed > mArena.capacity()) {
+      mArena.reserve(std::max(needed,
+                              mArena.capacity() + mArena.capacity() / 4));
+    }
+
+    mArena.resize(offset + sizeof(IdT));
+    memcpy(&mArena[offset], &id, sizeof(IdT));
+    size_t len = name.size();
+
+    while (len >= 0x80) {
+      mArena.push_back(static_cast<char>((len & 0x7f) | 0x80));
+      len >>= 7;
+    }
+
+    mArena.push_back(static_cast<char>(len));
+    mArena.insert(mArena.end(), name.begin(), name.end());
+    return static_cast<uint32_t>(offset);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Decode the name of the entry at the given offset
+  //----------------------------------------------------------------------------
+  const char* entryName(uint32_t offset, size_t& len) const
+  {
+    const unsigned char* ptr = reinterpret_cast<const unsigned char*>
+                               (&mArena[offset + sizeof(IdT)]);
+    len = 0;
+    int shift = 0;
+
+    while (*ptr & 0x80) {
+      len |= static_cast<size_t>(*ptr & 0x7f) << shift;
+      shift += 7;
+      ++ptr;
+    }
+
+    len |= static_cast<size_t>(*ptr) << shift;
+    return reinterpret_cast<const char*>(ptr + 1);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Entry size in the arena, needed for garbage accounting
+  //----------------------------------------------------------------------------
+  size_t entrySize(uint32_t offset) const
+  {
+    size_t len;
+    const char* name = entryName(offset, len);
+    return (name + len) - &mArena[offset];
+  }
+
+  void readEntry(uint32_t offset, value_type& value) const
+  {
+    size_t len;
+    const char* name = entryName(offset, len);
+    value.first.assign(name, len);
+    memcpy(&value.second, &mArena[offset], sizeof(IdT));
+  }
+
+  size_t findSlot(const std::string& name, uint32_t hash) const
+  {
+    if (mSlots.empty()) {
+      return kNotFound;
+    }
+
+    size_t mask = mSlots.size() - 1;
+    size_t pos = hash & mask;
+
+    while (mSlots[pos].mOffset != 0) {
+      if ((mSlots[pos].mHash == hash) && isLive(mSlots[pos].mOffset)) {
+        size_t len;
+        const char* candidate = entryName(mSlots[pos].mOffset, len);
+
+        if ((len == name.size()) &&
+            (memcmp(candidate, name.data(), len) == 0)) {
+          return pos;
+        }
+      }
+
+      pos = (pos + 1) & mask;
+    }
+
+    return kNotFound;
+  }
+
+  void eraseSlot(size_t pos)
+  {
+    mGarbage += entrySize(mSlots[pos].mOffset);
+    mSlots[pos].mOffset = kTombstone;
+    ++mTombstones;
+    --mSize;
+
+    // Drop everything once empty but keep the table size, so that iterators
+    // held by the caller still compare against end() correctly
+    if (mSize == 0) {
+      std::fill(mSlots.begin(), mSlots.end(), Slot {0, 0});
+      mArena.resize(1);
+      mTombstones = mGarbage = 0;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Rebuild the table with room for at least min_slots, dropping tombstones.
+  //! The arena is compacted as well if at least half of it is garbage.
+  //----------------------------------------------------------------------------
+  void rehash(size_t min_slots)
+  {
+    size_t capacity = 8;
+
+    while (capacity < min_slots) {
+      capacity <<= 1;
+    }
+
+    bool compact_arena = (mGarbage * 2 >= mArena.size());
+    std::vector<Slot> slots(capacity, Slot {0, 0});
+    std::vector<char> arena;
+
+    if (compact_arena) {
+      arena.reserve(mArena.size() - mGarbage);
+      arena.push_back('\0');
+    }
+
+    for (const Slot& old : mSlots) {
+      if (!isLive(old.mOffset)) {
+        continue;
+      }
+
+      uint32_t offset = old.mOffset;
+
+      if (compact_arena) {
+        size_t sz = entrySize(old.mOffset);
+        offset = static_cast<uint32_t>(arena.size());
+        arena.insert(arena.end(), mArena.begin() + old.mOffset,
+                     mArena.begin() + old.mOffset + sz);
+      }
+
+      size_t pos = old.mHash & (capacity - 1);
+
+      while (slots[pos].mOffset != 0) {
+        pos = (pos + 1) & (capacity - 1);
+      }
+
+      slots[pos].mOffset = offset;
+      slots[pos].mHash = old.mHash;
+    }
+
+    mSlots.swap(slots);
+    mTombstones = 0;
+
+    if (compact_arena) {
+      mArena.swap(arena);
+      mGarbage = 0;
+    }
+  }
+
+  std::vector<Slot> mSlots; ///< Open addressing table, size is power of 2
+  std::vector<char> mArena; ///< Interned ids and names
+  size_t mSize; ///< Number of live entries
+  size_t mTombstones; ///< Number of erased slots
+  size_t mGarbage; ///< Bytes of erased entries in the arena
+};
+
+template <typename IdT>
+constexpr uint32_t CompactNameMap<IdT>::kTombstone;
+
+template <typename IdT>
+constexpr size_t CompactNameMap<IdT>::kNotFound;
+
+EOSNSNAMESPACE_END
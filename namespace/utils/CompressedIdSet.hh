@@ -0,0 +1,527 @@
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+//------------------------------------------------------------------------------
+//! @brief Compressed sorted set of 64 bit ids, meant for the per filesystem
+//!        file lists
+//------------------------------------------------------------------------------
+
+#pragma once
+#include "namespace/Namespace.hh"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+EOSNSNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Class CompressedIdSet
+//!
+//! Roaring style set of 64 bit ids. The ids are split in blocks of 2^16
+//! consecutive values sharing the upper 48 bits. Each block stores the lower
+//! 16 bits either as a sorted array, 2 bytes per id, or once it holds more
+//! than 4096 ids as a bitmap of 8KB. The blocks are kept sorted by key in a
+//! vector and located with a binary search.
+//!
+//! Compared to the dense_hash_set previously used for the file lists, which
+//! needs 16 to 32 bytes per id, this takes a bit over 2 bytes per id for
+//! sparse lists and down to 1 bit per id for dense ones. Iteration is in
+//! ascending id order. Iterators remain usable across modifications: they
+//! continue from the first id greater than the current one. Not thread-safe,
+//! same as the set it replaces.
+//------------------------------------------------------------------------------
+class CompressedIdSet
+{
+public:
+  using value_type = uint64_t;
+
+  //----------------------------------------------------------------------------
+  //! Forward iterator in ascending id order
+  //----------------------------------------------------------------------------
+  class const_iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = CompressedIdSet::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+
+    const_iterator(): mSet(nullptr), mBlock(0), mPos(0), mVersion(0),
+      mValue(0) {}
+
+    reference operator*() const
+    {
+      return mValue;
+    }
+
+    pointer operator->() const
+    {
+      return &mValue;
+    }
+
+    const_iterator& operator++()
+    {
+      if (mVersion != mSet->mVersion) {
+        // Set modified since we last looked, continue after the current id
+        *this = (mValue == UINT64_MAX) ? mSet->end() :
+                mSet->lower_bound(mValue + 1);
+        return *this;
+      }
+
+      ++mPos;
+      settle();
+      return *this;
+    }
+
+    const_iterator operator++(int)
+    {
+      const_iterator tmp = *this;
+      ++(*this);
+      return tmp;
+    }
+
+    bool operator==(const const_iterator& other) const
+    {
+      return (mSet == other.mSet) && (isEnd() == other.isEnd()) &&
+             (isEnd() || (mValue == other.mValue));
+    }
+
+    bool operator!=(const const_iterator& other) const
+    {
+      return !(*this == other);
+    }
+
+  private:
+    friend class CompressedIdSet;
+
+    const_iterator(const CompressedIdSet* set, size_t block, uint32_t pos):
+      mSet(set), mBlock(block), mPos(pos), mVersion(set->mVersion), mValue(0)
+    {
+      settle();
+    }
+
+    bool isEnd() const
+    {
+      return (mBlock >= mSet->mBlocks.size());
+    }
+
+    //! Move to the first id at or after the current position
+    void settle()
+    {
+      while (mBlock < mSet->mBlocks.size()) {
+        const Block& block = mSet->mBlocks[mBlock];
+
+        if (block.mBitmap) {
+          mPos = nextBit(block.mData, mPos);
+
+          if (mPos < kBlockSize) {
+            mValue = (block.mKey << kKeyShift) | mPos;
+            return;
+          }
+        } else if (mPos < block.mCount) {
+          mValue = (block.mKey << kKeyShift) | block.mData[mPos];
+          return;
+        }
+
+        ++mBlock;
+        mPos = 0;
+      }
+
+      mBlock = mSet->mBlocks.size();
+      mPos = 0;
+    }
+
+    const CompressedIdSet* mSet;
+    size_t mBlock; ///< Index of the current block
+    uint32_t mPos; ///< Array index or bit position inside the block
+    uint64_t mVersion; ///< Set version the position refers to
+    value_type mValue; ///< Current id
+  };
+
+  using iterator = const_iterator;
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //----------------------------------------------------------------------------
+  CompressedIdSet(): mSize(0), mVersion(0) {}
+
+  //----------------------------------------------------------------------------
+  //! Number of ids
+  //----------------------------------------------------------------------------
+  size_t size() const
+  {
+    return mSize;
+  }
+
+  bool empty() const
+  {
+    return (mSize == 0);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Iterators
+  //----------------------------------------------------------------------------
+  const_iterator begin() const
+  {
+    return const_iterator(this, 0, 0);
+  }
+
+  const_iterator end() const
+  {
+    return const_iterator(this, mBlocks.size(), 0);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get iterator to the first id not less than the given one
+  //----------------------------------------------------------------------------
+  const_iterator lower_bound(value_type id) const
+  {
+    size_t index = findBlock(id >> kKeyShift);
+
+    if ((index == mBlocks.size()) || (mBlocks[index].mKey != (id >> kKeyShift))) {
+      return const_iterator(this, index, 0);
+    }
+
+    const Block& block = mBlocks[index];
+    uint16_t low = static_cast<uint16_t>(id);
+
+    if (block.mBitmap) {
+      return const_iterator(this, index, low);
+    }
+
+    return const_iterator(this, index, static_cast<uint32_t>
+                          (std::lower_bound(block.mData.begin(), block.mData.end(), low) -
+                           block.mData.begin()));
+  }
+
+  //----------------------------------------------------------------------------
+  //! Find the given id
+  //----------------------------------------------------------------------------
+  const_iterator find(value_type id) const
+  {
+    const_iterator it = lower_bound(id);
+
+    if (it.isEnd() || (*it != id)) {
+      return end();
+    }
+
+    return it;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Check whether the given id is in the set, cheaper than find
+  //----------------------------------------------------------------------------
+  bool contains(value_type id) const
+  {
+    size_t index = findBlock(id >> kKeyShift);
+
+    if ((index == mBlocks.size()) || (mBlocks[index].mKey != (id >> kKeyShift))) {
+      return false;
+    }
+
+    const Block& block = mBlocks[index];
+    uint16_t low = static_cast<uint16_t>(id);
+
+    if (block.mBitmap) {
+      return testBit(block.mData, low);
+    }
+
+    return std::binary_search(block.mData.begin(), block.mData.end(), low);
+  }
+
+  size_t count(value_type id) const
+  {
+    return contains(id) ? 1 : 0;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Insert id
+  //!
+  //! @return true if the id was inserted, false if it was already there
+  //----------------------------------------------------------------------------
+  bool insert(value_type id)
+  {
+    uint64_t key = id >> kKeyShift;
+    uint16_t low = static_cast<uint16_t>(id);
+    size_t index = findBlock(key);
+
+    if ((index == mBlocks.size()) || (mBlocks[index].mKey != key)) {
+      mBlocks.insert(mBlocks.begin() + index, Block(key));
+    }
+
+    Block& block = mBlocks[index];
+
+    if (block.mBitmap) {
+      if (testBit(block.mData, low)) {
+        return false;
+      }
+
+      block.mData[low >> 4] |= (1u << (low & 15));
+    } else {
+      auto it = std::lower_bound(block.mData.begin(), block.mData.end(), low);
+
+      if ((it != block.mData.end()) && (*it == low)) {
+        return false;
+      }
+
+      if (block.mCount == kArrayMax) {
+        toBitmap(block);
+        block.mData[low >> 4] |= (1u << (low & 15));
+      } else {
+        // Grow by a quarter instead of doubling, the arrays are the bulk of
+        // memory for sparse lists
+        if (block.mData.size() == block.mData.capacity()) {
+          size_t pos = it - block.mData.begin();
+          block.mData.reserve(block.mData.size() +
+                              std::max<size_t>(4, block.mData.size() / 4));
+          it = block.mData.begin() + pos;
+        }
+
+        block.mData.insert(it, low);
+      }
+    }
+
+    ++block.mCount;
+    ++mSize;
+    ++mVersion;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Insert range of ids
+  //----------------------------------------------------------------------------
+  template <typename It>
+  void insert(It first, It last)
+  {
+    for (; first != last; ++first) {
+      insert(*first);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Erase id
+  //!
+  //! @return number of erased ids
+  //----------------------------------------------------------------------------
+  size_t erase(value_type id)
+  {
+    uint64_t key = id >> kKeyShift;
+    uint16_t low = static_cast<uint16_t>(id);
+    size_t index = findBlock(key);
+
+    if ((index == mBlocks.size()) || (mBlocks[index].mKey != key)) {
+      return 0;
+    }
+
+    Block& block = mBlocks[index];
+
+    if (block.mBitmap) {
+      if (!testBit(block.mData, low)) {
+        return 0;
+      }
+
+      block.mData[low >> 4] &= ~(1u << (low & 15));
+
+      if (--block.mCount < kArrayMax / 2) {
+        toArray(block);
+      }
+    } else {
+      auto it = std::lower_bound(block.mData.begin(), block.mData.end(), low);
+
+      if ((it == block.mData.end()) || (*it != low)) {
+        return 0;
+      }
+
+      block.mData.erase(it);
+
+      if (--block.mCount == 0) {
+        mBlocks.erase(mBlocks.begin() + index);
+      }
+    }
+
+    --mSize;
+    ++mVersion;
+    return 1;
+  }
+
+  void erase(const_iterator it)
+  {
+    erase(*it);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the id with the given rank in ascending order, rank < size()
+  //----------------------------------------------------------------------------
+  const_iterator select(size_t rank) const
+  {
+    for (size_t index = 0; index < mBlocks.size(); ++index) {
+      const Block& block = mBlocks[index];
+
+      if (rank >= block.mCount) {
+        rank -= block.mCount;
+        continue;
+      }
+
+      if (!block.mBitmap) {
+        return const_iterator(this, index, static_cast<uint32_t>(rank));
+      }
+
+      for (uint32_t word = 0; word < kBitmapWords; ++word) {
+        uint32_t bits = block.mData[word];
+        uint32_t ones = __builtin_popcount(bits);
+
+        if (rank >= ones) {
+          rank -= ones;
+          continue;
+        }
+
+        while (rank--) {
+          bits &= bits - 1;
+        }
+
+        return const_iterator(this, index, (word << 4) + __builtin_ctz(bits));
+      }
+    }
+
+    return end();
+  }
+
+  //----------------------------------------------------------------------------
+  //! Remove all ids and release memory
+  //----------------------------------------------------------------------------
+  void clear()
+  {
+    std::vector<Block>().swap(mBlocks);
+    mSize = 0;
+    ++mVersion;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Release the spare capacity left by insertions and deletions
+  //----------------------------------------------------------------------------
+  void shrink()
+  {
+    for (auto& block : mBlocks) {
+      block.mData.shrink_to_fit();
+    }
+
+    mBlocks.shrink_to_fit();
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get number of bytes allocated by the set
+  //----------------------------------------------------------------------------
+  size_t getMemoryUsage() const
+  {
+    size_t total = sizeof(*this) + mBlocks.capacity() * sizeof(Block);
+
+    for (const auto& block : mBlocks) {
+      total += block.mData.capacity() * sizeof(uint16_t);
+    }
+
+    return total;
+  }
+
+private:
+  static constexpr uint32_t kKeyShift = 16;
+  static constexpr uint32_t kBlockSize = 1u << kKeyShift;
+  static constexpr uint32_t kBitmapWords = kBlockSize / 16;
+  static constexpr uint32_t kArrayMax = 4096; ///< Bitmap is cheaper above
+
+  //! Ids sharing the upper 48 bits
+  struct Block {
+    explicit Block(uint64_t key): mKey(key), mCount(0), mBitmap(false) {}
+    uint64_t mKey; ///< Upper 48 bits of the ids
+    uint32_t mCount; ///< Number of ids in the block
+    bool mBitmap; ///< Data is a bitmap instead of a sorted array
+    std::vector<uint16_t> mData; ///< Sorted lower 16 bits or bitmap
+  };
+
+  static bool testBit(const std::vector<uint16_t>& bitmap, uint16_t low)
+  {
+    return (bitmap[low >> 4] >> (low & 15)) & 1u;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Position of the first set bit at or after pos, kBlockSize if none
+  //----------------------------------------------------------------------------
+  static uint32_t nextBit(const std::vector<uint16_t>& bitmap, uint32_t pos)
+  {
+    if (pos >= kBlockSize) {
+      return kBlockSize;
+    }
+
+    uint32_t word = pos >> 4;
+    uint32_t bits = bitmap[word] & (0xffffu << (pos & 15));
+
+    while (bits == 0) {
+      if (++word == kBitmapWords) {
+        return kBlockSize;
+      }
+
+      bits = bitmap[word];
+    }
+
+    return (word << 4) + __builtin_ctz(bits);
+  }
+
+  static void toBitmap(Block& block)
+  {
+    std::vector<uint16_t> bitmap(kBitmapWords, 0);
+
+    for (uint16_t low : block.mData) {
+      bitmap[low >> 4] |= (1u << (low & 15));
+    }
+
+    block.mData.swap(bitmap);
+    block.mBitmap = true;
+  }
+
+  static void toArray(Block& block)
+  {
+    std::vector<uint16_t> array;
+    array.reserve(block.mCount);
+
+    for (uint32_t pos = nextBit(block.mData, 0); pos < kBlockSize;
+         pos = nextBit(block.mData, pos + 1)) {
+      array.push_back(static_cast<uint16_t>(pos));
+    }
+
+    block.mData.swap(array);
+    block.mBitmap = false;
+  }
+
+  //! Index of the first block with key not less than the given one
+  size_t findBlock(uint64_t key) const
+  {
+    return std::lower_bound(mBlocks.begin(), mBlocks.end(), key,
+    [](const Block & block, uint64_t k) {
+      return block.mKey < k;
+    }) - mBlocks.begin();
+  }
+
+  std::vector<Block> mBlocks; ///< Blocks sorted by key
+  size_t mSize; ///< Number of ids
+  uint64_t mVersion; ///< Bumped on every modification, checked by iterators
+};
+
+EOSNSNAMESPACE_END
@@ -41,20 +41,13 @@ bool pickRandomFile(const IFsView::FileList &filelist, eos::IFileMD::id_t &retva
     return false;
   }
 
-  std::uniform_int_distribution<> distribution(0, filelist.bucket_count() - 1);
-
-  while(true) {
-    std::unique_lock<std::mutex> lock(generatorMtx);
-    eos::IFileMD::id_t randomPosition = distribution(generator);
-    lock.unlock();
-
-    // Is there an element at that location on the table?
-    auto it = filelist.begin(randomPosition);
-    if(it != filelist.end(randomPosition)) {
-      retval = *it;
-      return true;
-    }
-  }
+  std::uniform_int_distribution<uint64_t> distribution(0, filelist.size() - 1);
+  std::unique_lock<std::mutex> lock(generatorMtx);
+  uint64_t rank = distribution(generator);
+  lock.unlock();
+
+  retval = *filelist.select(rank);
+  return true;
 }
 
 EOSNSNAMESPACE_END
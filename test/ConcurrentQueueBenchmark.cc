@@ -0,0 +1,103 @@
+//------------------------------------------------------------------------------
+// File: ConcurrentQueueBenchmark.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+
+//------------------------------------------------------------------------------
+//! @brief Throughput of the mutex based and the bounded lock-free queue with
+//!        several producers and consumers
+//------------------------------------------------------------------------------
+
+#include "common/BoundedConcurrentQueue.hh"
+#include "common/ConcurrentQueue.hh"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace eos::common;
+
+//------------------------------------------------------------------------------
+// Push and pop num_items per thread pair, return the rate in items per second
+//------------------------------------------------------------------------------
+template <typename Push, typename Pop>
+double
+QueueThroughput(unsigned num_threads, uint64_t num_items, Push push, Pop pop)
+{
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+
+  for (unsigned t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&]() {
+      for (uint64_t i = 0; i < num_items; ++i) {
+        push(i);
+      }
+    });
+    threads.emplace_back([&]() {
+      for (uint64_t i = 0; i < num_items; ++i) {
+        pop();
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  double elapsed = std::chrono::duration<double>
+                   (std::chrono::steady_clock::now() - start).count();
+  return (num_threads * num_items) / elapsed;
+}
+
+int main(int argc, char* argv[])
+{
+  const uint64_t num_items = (argc > 1) ? strtoull(argv[1], nullptr, 10) :
+                             100000;
+
+  for (unsigned num_threads : {
+         1, 4
+       }) {
+    ConcurrentQueue<uint64_t> locked;
+    double locked_rate = QueueThroughput(num_threads, num_items,
+    [&](uint64_t i) {
+      locked.push(i);
+    }, [&]() {
+      uint64_t value;
+      locked.wait_pop(value);
+    });
+    BoundedConcurrentQueue<uint64_t> bounded(4096);
+    double bounded_rate = QueueThroughput(num_threads, num_items,
+    [&](uint64_t i) {
+      bounded.push(i);
+    }, [&]() {
+      uint64_t value;
+      bounded.wait_pop(value);
+    });
+    std::cout << "producers=consumers=" << num_threads
+              << " ConcurrentQueue=" << (uint64_t) locked_rate << " Hz"
+              << " BoundedConcurrentQueue=" << (uint64_t) bounded_rate << " Hz"
+              << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,80 @@
+//------------------------------------------------------------------------------
+// File: ShardedCacheBenchmark.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+
+//------------------------------------------------------------------------------
+//! @brief Concurrent lookups in an unbounded and a bounded sharded cache
+//------------------------------------------------------------------------------
+
+#include "common/ShardedCache.hh"
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+typedef ShardedCache<uint64_t, uint64_t, IdentityHash<uint64_t>> TestCache;
+
+int main()
+{
+  const uint64_t num_keys = 100000;
+  const uint64_t num_lookups = 1000000;
+  const unsigned num_threads = 4;
+
+  for (size_t capacity : {
+         (size_t) 0, (size_t)(num_keys / 4)
+       }) {
+    TestCache cache(8, 1000 * 60, capacity);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+
+    for (unsigned t = 0; t < num_threads; t++) {
+      threads.emplace_back([&cache, t, num_keys, num_lookups]() {
+        uint64_t key = t;
+
+        for (uint64_t i = 0; i < num_lookups / num_threads; i++) {
+          key = (key * 6364136223846793005ull + 1442695040888963407ull);
+          uint64_t k = (key >> 33) % num_keys;
+
+          if (!cache.retrieve(k)) {
+            cache.store(k, std::unique_ptr<uint64_t>(new uint64_t(k)));
+          }
+        }
+      });
+    }
+
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    double elapsed = std::chrono::duration<double>
+                     (std::chrono::steady_clock::now() - start).count();
+    ShardedCacheStatistics stats = cache.getStatistics();
+    std::cout << "capacity=" << capacity << " rate="
+              << (uint64_t)(num_lookups / elapsed) << " Hz hits=" << stats.hits
+              << " misses=" << stats.misses << " evictions=" << stats.evictions
+              << " entries=" << stats.entries << " memory=" << stats.memory
+              << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,138 @@
+//------------------------------------------------------------------------------
+// File: ConcurrentQueueTest.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "common/BoundedConcurrentQueue.hh"
+#include "common/ConcurrentQueue.hh"
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace eos::common;
+
+//------------------------------------------------------------------------------
+// Single threaded push/pop, capacity and batch pop
+//------------------------------------------------------------------------------
+TEST(BoundedConcurrentQueue, BasicSanity)
+{
+  BoundedConcurrentQueue<std::unique_ptr<int>> queue(5);
+  ASSERT_EQ(8u, queue.capacity());
+  ASSERT_TRUE(queue.empty());
+
+  for (int i = 0; i < 8; ++i) {
+    ASSERT_TRUE(queue.try_push(std::unique_ptr<int>(new int(i))));
+  }
+
+  std::unique_ptr<int> extra(new int(8));
+  ASSERT_FALSE(queue.try_push(std::move(extra)));
+  ASSERT_TRUE(extra != nullptr);
+  ASSERT_EQ(8u, queue.size());
+  std::unique_ptr<int> value;
+  ASSERT_TRUE(queue.try_pop(value));
+  ASSERT_EQ(0, *value);
+  std::vector<std::unique_ptr<int>> batch;
+  ASSERT_EQ(3u, queue.pop_batch(batch, 3));
+  ASSERT_EQ(4u, queue.pop_batch(batch, 100));
+  ASSERT_EQ(0u, queue.pop_batch(batch, 100));
+
+  ASSERT_EQ(7u, batch.size());
+
+  for (int i = 0; i < 7; ++i) {
+    ASSERT_EQ(i + 1, *batch[i]);
+  }
+
+  ASSERT_FALSE(queue.wait_pop(value, std::chrono::milliseconds(10)));
+  ASSERT_TRUE(queue.empty());
+}
+
+//------------------------------------------------------------------------------
+// Multiple producers and consumers - every element is popped exactly once,
+// producers block while the queue is full and consumers while it is empty
+//------------------------------------------------------------------------------
+TEST(BoundedConcurrentQueue, MultiProducerMultiConsumer)
+{
+  const uint64_t num_producers = 4;
+  const uint64_t num_items = 20000;
+  BoundedConcurrentQueue<uint64_t> queue(64);
+  std::vector<std::thread> threads;
+  std::vector<uint64_t> sums(4, 0);
+  std::vector<uint64_t> counts(4, 0);
+
+  for (uint64_t p = 0; p < num_producers; ++p) {
+    threads.emplace_back([&queue, num_items]() {
+      for (uint64_t i = 1; i <= num_items; ++i) {
+        queue.push(i);
+      }
+
+      // Sentinel for one consumer
+      queue.push(0);
+    });
+  }
+
+  for (size_t c = 0; c < sums.size(); ++c) {
+    threads.emplace_back([&queue, &sums, &counts, c]() {
+      std::vector<uint64_t> batch;
+      size_t sentinels = 0;
+
+      while (sentinels == 0) {
+        batch.clear();
+
+        if (c % 2) {
+          uint64_t value;
+          queue.wait_pop(value);
+          batch.push_back(value);
+        } else {
+          queue.wait_pop_batch(batch, 16);
+        }
+
+        for (auto value : batch) {
+          if (value == 0) {
+            ++sentinels;
+          } else {
+            sums[c] += value;
+            ++counts[c];
+          }
+        }
+      }
+
+      // Hand back the sentinels meant for the other consumers
+      for (size_t i = 1; i < sentinels; ++i) {
+        queue.push(0);
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  uint64_t sum = 0, count = 0;
+
+  for (size_t c = 0; c < sums.size(); ++c) {
+    sum += sums[c];
+    count += counts[c];
+  }
+
+  ASSERT_EQ(num_producers * num_items, count);
+  ASSERT_EQ(num_producers * num_items * (num_items + 1) / 2, sum);
+}
@@ -24,6 +24,9 @@
 #include "common/Logging.hh"
 #include "Namespace.hh"
 #include "gtest/gtest.h"
+#include <cstring>
+#include <thread>
+#include <vector>
 
 //------------------------------------------------------------------------------
 // Test the proper static allocation and destruction of the global logging
@@ -42,4 +45,105 @@ TEST(Logging, Log)
   function_using_logging();
 }
 
+//------------------------------------------------------------------------------
+// Test the asynchronous mode - all lines must be written and the lines of
+// every thread must keep their order
+//------------------------------------------------------------------------------
+TEST(Logging, AsyncFanOut)
+{
+  using namespace eos::common;
+  const int num_threads = 8;
+  const int num_lines = 1000;
+  FILE* fd = tmpfile();
+  ASSERT_TRUE(fd != nullptr);
+  gLogging.SetLogPriority(LOG_INFO);
+  gLogging.AddFanOut("*", fd);
+  gLogging.SetAsync(true);
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back([i]() {
+      for (int j = 0; j < num_lines; ++j) {
+        const char* line = eos_static_info("msg=\"async test\" thread=%d line=%d",
+                                           i, j);
+        EXPECT_TRUE(strstr(line, "async test") != nullptr);
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  gLogging.Flush();
+  gLogging.SetAsync(false);
+  gLogging.gLogFanOut.erase("*");
+  rewind(fd);
+  char buffer[4096];
+  int count = 0;
+  std::vector<int> last(num_threads, -1);
+
+  while (fgets(buffer, sizeof(buffer), fd)) {
+    const char* ptr = strstr(buffer, "thread=");
+
+    if (ptr) {
+      int thread, line;
+      ASSERT_EQ(2, sscanf(ptr, "thread=%d line=%d", &thread, &line));
+      ASSERT_EQ(last[thread] + 1, line);
+      last[thread] = line;
+      ++count;
+    }
+  }
+
+  fclose(fd);
+  ASSERT_EQ(num_threads * num_lines, count);
+}
+
+//------------------------------------------------------------------------------
+// Test that the asynchronous lines reach the in-memory log and that switching
+// back to the synchronous mode writes out the queued lines
+//------------------------------------------------------------------------------
+TEST(Logging, AsyncLogMemory)
+{
+  using namespace eos::common;
+  const int num_lines = 100;
+  FILE* fd = tmpfile();
+  ASSERT_TRUE(fd != nullptr);
+  gLogging.SetLogPriority(LOG_INFO);
+  gLogging.AddFanOut("*", fd);
+  gLogging.SetAsync(true);
+
+  for (int i = 0; i < num_lines; ++i) {
+    const char* line = eos_static_notice("msg=\"memory test\" line=%d", i);
+    ASSERT_TRUE(strstr(line, "memory test") != nullptr);
+  }
+
+  gLogging.SetAsync(false);
+  gLogging.gLogFanOut.erase("*");
+  {
+    XrdSysMutexHelper scope_lock(gLogging.gMutex);
+    unsigned long index = gLogging.gLogCircularIndex[LOG_NOTICE];
+    ASSERT_TRUE(index >= (unsigned long) num_lines);
+
+    for (int i = 0; i < num_lines; ++i) {
+      const XrdOucString& line = gLogging.gLogMemory[LOG_NOTICE][(index - num_lines
+                                 + i) % gLogging.gCircularIndexSize];
+      std::string expected = "line=" + std::to_string(i);
+      ASSERT_TRUE(strstr(line.c_str(), expected.c_str()) != nullptr);
+    }
+  }
+  rewind(fd);
+  char buffer[4096];
+  int count = 0;
+
+  while (fgets(buffer, sizeof(buffer), fd)) {
+    if (strstr(buffer, "memory test")) {
+      ++count;
+    }
+  }
+
+  fclose(fd);
+  ASSERT_EQ(num_lines, count);
+}
+
 EOSCOMMONTESTING_END
@@ -24,6 +24,10 @@
 #include "gtest/gtest.h"
 #include "common/RWMutex.hh"
 #include "common/StacktraceHere.hh"
+#include "common/StripedRWMutex.hh"
+#include <atomic>
+#include <thread>
+#include <vector>
 
 //------------------------------------------------------------------------------
 // Check stacktrace generation
@@ -130,3 +134,135 @@ TEST(RWMutex, MultiWrLockTest)
   ASSERT_NO_THROW(mutex.UnLockWrite());
   t.join();
 }
+
+//------------------------------------------------------------------------------
+// Striped mutex - readers always see a consistent state while writers update
+// it concurrently
+//------------------------------------------------------------------------------
+TEST(StripedRWMutex, ConcurrentReadersWriters)
+{
+  eos::common::RWMutex mutex;
+  mutex.SetBlocking(true);
+  mutex.SetStriped();
+  uint64_t first = 0, second = 0;
+  std::atomic<bool> inconsistent {false};
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&, i]() {
+      for (int j = 0; j < 20000; ++j) {
+        if ((i < 2) && (j % 10 == 0)) {
+          eos::common::RWMutexWriteLock wr_lock(mutex);
+          ++first;
+          ++second;
+        } else {
+          eos::common::RWMutexReadLock rd_lock(mutex);
+
+          if (first != second) {
+            inconsistent = true;
+          }
+        }
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_FALSE(inconsistent);
+  ASSERT_EQ(4000u, first);
+}
+
+//------------------------------------------------------------------------------
+// Striped mutex - a re-entrant read lock does not deadlock against a pending
+// writer and the writer times out while readers are inside
+//------------------------------------------------------------------------------
+TEST(StripedRWMutex, ReentrantReadAndTimeout)
+{
+  eos::common::StripedRWMutex mutex;
+  ASSERT_EQ(0, mutex.LockRead());
+  std::atomic<bool> written {false};
+  std::thread t([&]() {
+    ASSERT_EQ(ETIMEDOUT, mutex.TimedWrLock(50 * 1000 * 1000));
+    ASSERT_EQ(0, mutex.LockWrite());
+    written = true;
+    ASSERT_EQ(0, mutex.UnLockWrite());
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ASSERT_EQ(0, mutex.LockRead());
+  ASSERT_FALSE(written);
+  ASSERT_EQ(0, mutex.UnLockRead());
+  ASSERT_EQ(0, mutex.UnLockRead());
+  t.join();
+  ASSERT_TRUE(written);
+  // Readers from other threads time out while a writer holds the lock
+  ASSERT_EQ(0, mutex.LockWrite());
+  std::thread r([&]() {
+    ASSERT_EQ(ETIMEDOUT, mutex.TimedRdLock(50 * 1000 * 1000));
+  });
+  r.join();
+  ASSERT_EQ(0, mutex.UnLockWrite());
+  ASSERT_EQ(0, mutex.TimedRdLock(50 * 1000 * 1000));
+  ASSERT_EQ(0, mutex.UnLockRead());
+}
+
+//------------------------------------------------------------------------------
+// Contention profiler - samples are accounted per call site and the report
+// only exists once the profiling was enabled
+//------------------------------------------------------------------------------
+TEST(RWMutexProfiler, CallSites)
+{
+  using eos::common::RWMutexProfiler;
+  ASSERT_EQ(0u, RWMutexProfiler::GetBucket(999));
+  ASSERT_EQ(1u, RWMutexProfiler::GetBucket(1000));
+  ASSERT_EQ(2u, RWMutexProfiler::GetBucket(3000));
+  ASSERT_EQ(RWMutexProfiler::kNumBuckets - 1,
+            RWMutexProfiler::GetBucket(UINT64_MAX));
+  eos::common::RWMutex mutex;
+  ASSERT_TRUE(mutex.PrintContentionProfile("test").empty());
+  mutex.SetContentionProfiling(true, 1);
+  ASSERT_TRUE(mutex.GetContentionProfiler() != nullptr);
+
+  for (int i = 0; i < 10; ++i) {
+    eos::common::RWMutexReadLock rd_lock(mutex);
+  }
+
+  {
+    eos::common::RWMutexWriteLock wr_lock(mutex);
+  }
+
+  auto sites = mutex.GetContentionProfiler()->GetCallSites();
+  ASSERT_EQ(2u, sites.size());
+  uint64_t reads = 0, writes = 0;
+
+  for (const auto& site : sites) {
+    ASSERT_EQ("RWMutexTest.cc", site.mFile);
+    (site.mWrite ? writes : reads) += site.mSamples;
+  }
+
+  ASSERT_EQ(10u, reads);
+  ASSERT_EQ(1u, writes);
+  std::string report = mutex.PrintContentionProfile("test", 0, true);
+  ASSERT_NE(std::string::npos, report.find("ns.contention.test.RWMutexTest.cc:"));
+  mutex.SetContentionProfiling(false);
+  ASSERT_TRUE(mutex.GetContentionProfiler() == nullptr);
+  mutex.ResetContentionProfile();
+  ASSERT_EQ(std::string::npos, mutex.PrintContentionProfile("test").find(".cc:"));
+  // Move assignment releases the profiler owned by the target
+  eos::common::RWMutex other;
+  other.SetContentionProfiling(true, 1);
+  mutex.SetContentionProfiling(true, 1);
+  RWMutexProfiler* profiler = mutex.GetContentionProfiler();
+  other = std::move(mutex);
+  ASSERT_EQ(profiler, other.GetContentionProfiler());
+  ASSERT_TRUE(mutex.GetContentionProfiler() == nullptr);
+  // Move construction takes over the implementation and the profiler
+  eos::common::RWMutex moved(std::move(other));
+  ASSERT_EQ(profiler, moved.GetContentionProfiler());
+  ASSERT_TRUE(other.GetContentionProfiler() == nullptr);
+
+  {
+    eos::common::RWMutexWriteLock wr_lock(moved);
+  }
+}
@@ -0,0 +1,103 @@
+//------------------------------------------------------------------------------
+// File: ShardedCacheTest.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "common/ShardedCache.hh"
+
+typedef ShardedCache<uint64_t, uint64_t, IdentityHash<uint64_t>> TestCache;
+
+//------------------------------------------------------------------------------
+// Store, replace, retrieve and invalidate
+//------------------------------------------------------------------------------
+TEST(ShardedCache, BasicSanity)
+{
+  TestCache cache(4, 1000 * 60);
+  std::shared_ptr<uint64_t> value;
+  ASSERT_TRUE(cache.store(1, std::unique_ptr<uint64_t>(new uint64_t(10))));
+  ASSERT_FALSE(cache.store(1, std::unique_ptr<uint64_t>(new uint64_t(11)),
+                           value, false));
+  ASSERT_EQ(10u, *value);
+  ASSERT_TRUE(cache.store(1, std::unique_ptr<uint64_t>(new uint64_t(12)),
+                          value, true));
+  ASSERT_EQ(12u, *cache.retrieve(1));
+  ASSERT_FALSE(cache.retrieve(2));
+  ASSERT_TRUE(cache.invalidate(1));
+  ASSERT_FALSE(cache.invalidate(1));
+  ASSERT_FALSE(cache.retrieve(1));
+  ShardedCacheStatistics stats = cache.getStatistics();
+  ASSERT_EQ(1u, stats.hits);
+  ASSERT_EQ(2u, stats.misses);
+  ASSERT_EQ(0u, stats.entries);
+  ASSERT_EQ(0u, cache.getCapacity());
+}
+
+//------------------------------------------------------------------------------
+// The capacity is enforced and the CLOCK eviction keeps the entries which
+// are retrieved repeatedly
+//------------------------------------------------------------------------------
+TEST(ShardedCache, BoundedClockEviction)
+{
+  TestCache cache(0, 1000 * 60, 100);
+  ASSERT_EQ(100u, cache.getCapacity());
+
+  for (uint64_t i = 0; i < 10; i++) {
+    cache.store(i, std::unique_ptr<uint64_t>(new uint64_t(i)));
+  }
+
+  for (uint64_t i = 10; i < 1000; i++) {
+    // Keep the first ten entries hot
+    for (uint64_t hot = 0; hot < 10; hot++) {
+      ASSERT_TRUE(cache.retrieve(hot) != nullptr);
+    }
+
+    cache.store(i, std::unique_ptr<uint64_t>(new uint64_t(i)));
+  }
+
+  ShardedCacheStatistics stats = cache.getStatistics();
+  ASSERT_EQ(100u, stats.entries);
+  ASSERT_EQ(900u, stats.evictions);
+  ASSERT_TRUE(cache.retrieve(999) != nullptr);
+  // Entries held by a client survive the eviction
+  std::shared_ptr<uint64_t> held = cache.retrieve(999);
+
+  for (uint64_t i = 1000; i < 1200; i++) {
+    cache.store(i, std::unique_ptr<uint64_t>(new uint64_t(i)));
+  }
+
+  ASSERT_EQ(999u, *held);
+}
+
+//------------------------------------------------------------------------------
+// Consecutive small keys, e.g. pids, are spread over all shards
+//------------------------------------------------------------------------------
+TEST(ShardedCache, ShardSpread)
+{
+  // 256 shards of 8 entries each, 4 per shard on average: with a poor shard
+  // selection most of the keys would collide and get evicted
+  TestCache cache(8, 1000 * 60, 256 * 8);
+
+  for (uint64_t pid = 1; pid <= 1024; pid++) {
+    cache.store(pid, std::unique_ptr<uint64_t>(new uint64_t(pid)));
+  }
+
+  ASSERT_LT(cache.getStatistics().evictions, 50u);
+}
@@ -96,4 +96,112 @@ TEST(ThreadPoolTest, ScaleUpAndDownTest)
 
   // Check if we have scaled down to 2 threads
   ASSERT_EQ(2, threadIds.size());
-}
\ No newline at end of file
+}
+
+TEST(ThreadPoolTest, PriorityTest)
+{
+  ThreadPool pool(1, 1);
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  std::mutex mutex;
+  std::vector<int> order;
+  // Keep the only thread busy while the other tasks get queued
+  auto blocker = pool.PushTask<void>([released] { released.wait(); });
+  std::vector<std::future<void>> futures;
+  int values[] = {2, 1, 0};
+  ThreadPool::Priority priorities[] = {ThreadPool::Priority::Low,
+                                       ThreadPool::Priority::Normal,
+                                       ThreadPool::Priority::High};
+
+  for (int i = 0; i < 3; i++) {
+    int value = values[i];
+    futures.emplace_back(pool.PushTask<void>([&mutex, &order, value] {
+      std::lock_guard<std::mutex> lock(mutex);
+      order.push_back(value);
+    }, priorities[i]));
+  }
+
+  release.set_value();
+
+  for (auto&& future : futures) {
+    future.get();
+  }
+
+  ASSERT_EQ(std::vector<int>({0, 1, 2}), order);
+}
+
+TEST(ThreadPoolTest, WorkStealingTest)
+{
+  ThreadPool pool(4, 4, 10, 12, 10, "stealing", true);
+  // Tasks pushed from a worker go to its own deque, the idle workers have to
+  // steal them
+  auto future = pool.PushTask<int>([&pool] {
+    std::vector<std::future<int>> futures;
+
+    for (int i = 0; i < 1000; i++) {
+      futures.emplace_back(pool.PushTask<int>([] {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        return 1;
+      }));
+    }
+
+    int sum = 0;
+
+    for (auto&& future : futures) {
+      sum += future.get();
+    }
+
+    return sum;
+  });
+  ASSERT_EQ(1000, future.get());
+  ThreadPool::Metrics metrics = pool.GetMetrics();
+  // The outer task is accounted only after its future is ready
+  ASSERT_GE(metrics.mExecuted, 1000u);
+  ASSERT_GT(metrics.mStolen, 0u);
+  ASSERT_EQ(0u, metrics.mQueued);
+}
+
+TEST(ThreadPoolTest, WorkStealingLongTaskTest)
+{
+  ThreadPool pool(2, 2, 10, 12, 10, "stealing_long", true);
+  std::promise<void> releaseLong, releaseOther;
+  std::shared_future<void> longReleased = releaseLong.get_future().share();
+  std::shared_future<void> otherReleased = releaseOther.get_future().share();
+  std::atomic<int> started {0};
+  // Keep both workers busy while the long task and the short ones get queued
+  auto blocker1 = pool.PushTask<void>([&started, otherReleased] {
+    started++;
+    otherReleased.wait();
+  });
+  auto blocker2 = pool.PushTask<void>([&started, otherReleased] {
+    started++;
+    otherReleased.wait();
+  });
+
+  while (started.load() < 2) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  auto longTask = pool.PushTask<void>([longReleased] { longReleased.wait(); });
+  std::vector<std::future<int>> futures;
+
+  for (int i = 0; i < 100; i++) {
+    futures.emplace_back(pool.PushTask<int>([] { return 1; }));
+  }
+
+  releaseOther.set_value();
+  // The short tasks grabbed together with the long one must not wait for it
+  int sum = 0;
+
+  for (auto&& future : futures) {
+    ASSERT_EQ(std::future_status::ready,
+              future.wait_for(std::chrono::seconds(10)));
+    sum += future.get();
+  }
+
+  ASSERT_EQ(100, sum);
+  ASSERT_EQ(std::future_status::timeout,
+            longTask.wait_for(std::chrono::seconds(0)));
+  releaseLong.set_value();
+  longTask.get();
+}
@@ -0,0 +1,231 @@
+//------------------------------------------------------------------------------
+// File: XrdMqSharedObjectTests.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "mq/XrdMqSharedObject.hh"
+#include "mq/XrdMqMessage.hh"
+#include "common/SymKeys.hh"
+
+//------------------------------------------------------------------------------
+// Build a binary encoded message body
+//------------------------------------------------------------------------------
+static std::string
+MakeBinaryBody(const std::vector<std::string>& fields)
+{
+  std::string body = XRDMQSHAREDHASH_BINARY;
+
+  for (const auto& field : fields) {
+    XrdMqSharedObjectManager::AppendBinaryField(body, field.c_str(),
+        field.length());
+  }
+
+  return body;
+}
+
+//------------------------------------------------------------------------------
+// Encoding and in place parsing of length-prefixed fields
+//------------------------------------------------------------------------------
+TEST(XrdMqSharedObject, BinaryField)
+{
+  std::string buf;
+  XrdMqSharedObjectManager::AppendBinaryField(buf, "key", 3);
+  XrdMqSharedObjectManager::AppendBinaryField(buf, "", 0);
+  XrdMqSharedObjectManager::AppendBinaryField(buf, "a,b:c|d~e%f&g", 13);
+  ASSERT_EQ("3:key,0:,13:a,b:c|d~e%f&g,", buf);
+  size_t pos = 0, len = 0;
+  ASSERT_STREQ("key", XrdMqSharedObjectManager::ParseBinaryField(buf, pos,
+               &len));
+  ASSERT_EQ(3u, len);
+  ASSERT_STREQ("", XrdMqSharedObjectManager::ParseBinaryField(buf, pos, &len));
+  ASSERT_EQ(0u, len);
+  ASSERT_STREQ("a,b:c|d~e%f&g",
+               XrdMqSharedObjectManager::ParseBinaryField(buf, pos, &len));
+  ASSERT_EQ(13u, len);
+  ASSERT_EQ(buf.length(), pos);
+
+  // Malformed fields
+  for (std::string bad : {
+         "", ":key,", "4:key,", "3:key", "3:keys", "3key,", "99999999999999:x,"
+       }) {
+    pos = 0;
+    ASSERT_EQ(nullptr, XrdMqSharedObjectManager::ParseBinaryField(bad, pos))
+        << bad;
+    ASSERT_EQ(0u, pos);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Apply binary encoded updates, multiplexed updates and deletions
+//------------------------------------------------------------------------------
+TEST(XrdMqSharedObject, ParseBinaryMessage)
+{
+  XrdMqSharedObjectManager som;
+  som.EnableBroadCast(false);
+  XrdOucString error;
+  XrdMqMessage message("XrdMqSharedHashMessage");
+  message.SetBody(MakeBinaryBody({"update", "/eos/host1/fst/data01", "hash", "",
+                                  "stat.geotag", "site::rack&1",
+                                  "stat.boot", "booted"
+                                 }).c_str());
+  ASSERT_TRUE(som.ParseEnvMessage(&message, error)) << error.c_str();
+  XrdMqSharedHash* hash = som.GetObject("/eos/host1/fst/data01", "hash");
+  ASSERT_TRUE(hash != nullptr);
+  ASSERT_EQ("site::rack&1", hash->Get("stat.geotag"));
+  ASSERT_EQ("booted", hash->Get("stat.boot"));
+  // Multiplexed update of two subjects
+  som.CreateSharedHash("/eos/host1/fst/data02", "");
+  message.SetBody(MakeBinaryBody({"update",
+                                  "/eos/host1/fst/data01%/eos/host1/fst/data02",
+                                  "hash", "", "#0#stat.boot", "down",
+                                  "#1#stat.boot", "booting"
+                                 }).c_str());
+  ASSERT_TRUE(som.ParseEnvMessage(&message, error)) << error.c_str();
+  ASSERT_EQ("down", hash->Get("stat.boot"));
+  ASSERT_EQ("booting",
+            som.GetObject("/eos/host1/fst/data02", "hash")->Get("stat.boot"));
+  // Deletion
+  message.SetBody(MakeBinaryBody({"delete", "/eos/host1/fst/data01", "hash", "",
+                                  "stat.boot"
+                                 }).c_str());
+  ASSERT_TRUE(som.ParseEnvMessage(&message, error)) << error.c_str();
+  ASSERT_EQ("", hash->Get("stat.boot"));
+  ASSERT_EQ("site::rack&1", hash->Get("stat.geotag"));
+  // Truncated record
+  std::string body = MakeBinaryBody({"update", "/eos/host1/fst/data01", "hash",
+                                     "", "stat.boot"
+                                    });
+  message.SetBody(body.c_str());
+  ASSERT_FALSE(som.ParseEnvMessage(&message, error));
+}
+
+//------------------------------------------------------------------------------
+// Compressed messages are uncompressed before parsing
+//------------------------------------------------------------------------------
+TEST(XrdMqSharedObject, ParseCompressedMessage)
+{
+  XrdMqSharedObjectManager som;
+  som.EnableBroadCast(false);
+  XrdOucString error;
+  std::vector<std::string> fields {"update", "/eos/host1/fst/data01", "hash",
+                                   ""};
+
+  for (int i = 0; i < 100; ++i) {
+    fields.push_back("stat.key" + std::to_string(i));
+    fields.push_back(std::to_string(i));
+  }
+
+  std::string body = MakeBinaryBody(fields);
+  std::string compressed;
+  ASSERT_TRUE(eos::common::SymKey::ZBase64(body, compressed));
+  ASSERT_EQ(0, compressed.compare(0, strlen(XRDMQSHAREDHASH_COMPRESSED),
+                                  XRDMQSHAREDHASH_COMPRESSED));
+  ASSERT_LT(compressed.length(), body.length());
+  XrdMqMessage message("XrdMqSharedHashMessage");
+  message.SetBody(compressed.c_str());
+  ASSERT_TRUE(som.ParseEnvMessage(&message, error)) << error.c_str();
+  XrdMqSharedHash* hash = som.GetObject("/eos/host1/fst/data01", "hash");
+  ASSERT_TRUE(hash != nullptr);
+  ASSERT_EQ(100u, hash->GetSize());
+  ASSERT_EQ("42", hash->Get("stat.key42"));
+  message.SetBody("zbase64:garbage");
+  ASSERT_FALSE(som.ParseEnvMessage(&message, error));
+}
+
+//------------------------------------------------------------------------------
+// Shared object manager giving access to the keys of the mux transaction
+//------------------------------------------------------------------------------
+class MuxSharedObjectManager : public XrdMqSharedObjectManager
+{
+public:
+  //----------------------------------------------------------------------------
+  // Check if the key is part of the mux transaction and reset the transaction
+  //----------------------------------------------------------------------------
+  bool TakeMuxKey(const std::string& subject, const std::string& key)
+  {
+    XrdSysMutexHelper lock(MuxTransactionsMutex);
+    bool found = (MuxTransactions[subject].count(key) != 0);
+    MuxTransactions[subject].clear();
+    return found;
+  }
+};
+
+//------------------------------------------------------------------------------
+// Delta publishing drops insignificant and unchanged updates
+//------------------------------------------------------------------------------
+TEST(XrdMqSharedObject, DeltaPublishing)
+{
+  const std::string subject = "/eos/host1/fst/data01";
+  MuxSharedObjectManager som;
+  som.CreateSharedHash(subject.c_str(), "/eos/*/mgm");
+  XrdMqSharedHash* hash = som.GetObject(subject.c_str(), "hash");
+  ASSERT_TRUE(hash != nullptr);
+  som.EnableDeltaPublishing(true);
+  som.SetPublishThreshold("stat.disk.load", 0.05, 0.1);
+  // Keep the updates in the mux transaction instead of sending them
+  ASSERT_TRUE(som.OpenMuxTransaction("hash", "/eos/*/mgm"));
+  hash->Set("stat.disk.load", "0.5");
+  ASSERT_TRUE(som.TakeMuxKey(subject, "stat.disk.load"));
+  hash->Set("stat.boot", "booted");
+  ASSERT_TRUE(som.TakeMuxKey(subject, "stat.boot"));
+  // Below the absolute or the relative threshold, stored but not broadcast
+  hash->Set("stat.disk.load", "0.54");
+  ASSERT_EQ("0.54", hash->Get("stat.disk.load"));
+  ASSERT_FALSE(som.TakeMuxKey(subject, "stat.disk.load"));
+  hash->Set("stat.disk.load", "0.46");
+  ASSERT_EQ("0.46", hash->Get("stat.disk.load"));
+  ASSERT_FALSE(som.TakeMuxKey(subject, "stat.disk.load"));
+  // Small steps are judged against the last broadcast value
+  hash->Set("stat.disk.load", "0.56");
+  ASSERT_EQ("0.56", hash->Get("stat.disk.load"));
+  ASSERT_TRUE(som.TakeMuxKey(subject, "stat.disk.load"));
+  // Above both thresholds
+  hash->Set("stat.disk.load", "0.7");
+  ASSERT_EQ("0.7", hash->Get("stat.disk.load"));
+  ASSERT_TRUE(som.TakeMuxKey(subject, "stat.disk.load"));
+  // Unchanged values are not broadcast
+  hash->Set("stat.boot", "booted");
+  ASSERT_FALSE(som.TakeMuxKey(subject, "stat.boot"));
+  // Keys without threshold are published whenever they change
+  hash->Set("stat.boot", "booting");
+  ASSERT_EQ("booting", hash->Get("stat.boot"));
+  ASSERT_TRUE(som.TakeMuxKey(subject, "stat.boot"));
+  // Non numeric values are always significant
+  hash->Set("stat.disk.load", "n/a");
+  ASSERT_EQ("n/a", hash->Get("stat.disk.load"));
+  ASSERT_TRUE(som.TakeMuxKey(subject, "stat.disk.load"));
+  // Local updates are never broadcast
+  hash->Set("stat.disk.load", "0.6");
+  ASSERT_TRUE(som.TakeMuxKey(subject, "stat.disk.load"));
+  hash->Set("stat.disk.load", "0.61", false);
+  ASSERT_EQ("0.61", hash->Get("stat.disk.load"));
+  ASSERT_FALSE(som.TakeMuxKey(subject, "stat.disk.load"));
+  // Published values older than the refresh interval are sent again
+  som.EnableDeltaPublishing(true, std::chrono::seconds(0));
+  hash->Set("stat.disk.load", "0.62");
+  ASSERT_EQ("0.62", hash->Get("stat.disk.load"));
+  ASSERT_TRUE(som.TakeMuxKey(subject, "stat.disk.load"));
+  som.EnableDeltaPublishing(false);
+  hash->Set("stat.disk.load", "0.63");
+  ASSERT_EQ("0.63", hash->Get("stat.disk.load"));
+  ASSERT_TRUE(som.TakeMuxKey(subject, "stat.disk.load"));
+  som.CloseMuxTransaction();
+}